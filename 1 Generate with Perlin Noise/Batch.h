@@ -0,0 +1,63 @@
+/// \file Batch.h
+/// \brief Header for batches of terrain generation jobs.
+///
+/// A batch is read from a manifest, which is a text file with one job per
+/// line and comma separated fields: the seed, the shape parameter (mu for
+/// Perlin noise, omega for amortized noise), the elevation cap, the row and
+/// column of the origin, the width and height, the number of octaves, and
+/// the name of the output file without an extension. Blank lines, lines
+/// starting with #, and a header line that doesn't start with a number are
+/// skipped. Each job must have an output file name of its own, since jobs
+/// run at the same time would otherwise write to the same file. The jobs are shared out among a pool of workers, each of which
+/// runs in its own thread and runs one job at a time. Jobs with the same
+/// seed and shape parameter are handed out next to each other, so that a
+/// worker can hang on to the generator it made for one of them and use it
+/// for the next.
+
+// Copyright Ian Parberry, May 2014.
+//
+// This file is made available under the GNU All-Permissive License.
+//
+// Copying and distribution of this file, with or without modification,
+// are permitted in any medium without royalty provided the copyright
+// notice and this notice are preserved.  This file is offered as-is,
+// without any warranty.
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+/// \brief Terrain generation job.
+
+struct BatchJob{
+  int nLine; ///< Line of the manifest that it is on.
+  unsigned int nSeed; ///< Random number seed.
+  float fParam; ///< Shape parameter, mu or omega.
+  float fAltitude; ///< Elevation cap.
+  int nRow; ///< Row of the origin.
+  int nCol; ///< Column of the origin.
+  int nWidth; ///< Width in points.
+  int nHeight; ///< Height in points.
+  int nOctaves; ///< Number of octaves.
+  std::string strOutput; ///< Name of the output file without extension.
+
+  bool bSucceeded; ///< Whether the output file was saved.
+  bool bReused; ///< Whether the generator was used for an earlier job.
+  long long nBytes; ///< Size of the output file in bytes.
+  float fElapsed; ///< Time from start to finish in seconds.
+}; //BatchJob
+
+/// \brief Batch worker.
+///
+/// Runs jobs one at a time in a thread of its own, keeping whatever it
+/// likes from one job to the next.
+
+class CBatchWorker{
+  public:
+    virtual ~CBatchWorker(); ///< Destructor.
+    virtual bool Run(BatchJob& job) = 0; ///< Run a job.
+}; //CBatchWorker
+
+bool ReadBatchManifest(const char* filename, std::vector<BatchJob>& jobs, int& nRejected); ///< Read a manifest.
+bool RunBatch(std::vector<BatchJob>& jobs, std::vector<CBatchWorker*>& workers); ///< Run a batch of jobs.
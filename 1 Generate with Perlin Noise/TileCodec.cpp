@@ -0,0 +1,206 @@
+/// \file TileCodec.cpp
+/// \brief Code for the compressed tile codec.
+
+// Copyright Ian Parberry, May 2014.
+//
+// This file is made available under the GNU All-Permissive License.
+//
+// Copying and distribution of this file, with or without modification,
+// are permitted in any medium without royalty provided the copyright
+// notice and this notice are preserved.  This file is offered as-is,
+// without any warranty.
+
+#include <string.h>
+
+#include "TileCodec.h"
+
+#if defined(_MSC_VER) //Windows Visual Studio
+  #include <intrin.h>
+#endif
+
+const int RICE_KBITS = 5; ///< Number of bits used to store a Rice parameter.
+const int RICE_MAXK = 16; ///< Largest Rice parameter.
+const int RICE_ESCAPE = 24; ///< Quotients this large are escaped.
+const int RICE_VALUEBITS = 17; ///< Number of bits in an escaped value.
+
+/// Count the trailing zero bits of a nonzero number.
+/// \param x A nonzero number.
+/// \return Number of zero bits below the least significant one bit.
+
+inline int CountTrailingZeros(unsigned int x){
+#if defined(_MSC_VER) //Windows Visual Studio
+  unsigned long n;
+  _BitScanForward(&n, x);
+  return (int)n;
+#else
+  return __builtin_ctz(x);
+#endif
+} //CountTrailingZeros
+
+/// Get the value that a height is predicted to be when encoding, which is the height
+/// to its left, or the height above it if it is at the start of a row.
+/// \param p Pointer to the heights of a tile.
+/// \param i Row.
+/// \param j Column.
+/// \param n Tile size.
+/// \return Predicted height.
+
+inline int PredictHeight(const unsigned short* p, const int i, const int j, const int n){
+  if(j > 0)return p[i*n + j - 1];
+  if(i > 0)return p[(i - 1)*n];
+  return 0;
+} //PredictHeight
+
+/// Get the largest possible size of a compressed tile.
+/// \param n Tile size.
+/// \return Size in bytes of a buffer large enough for any compressed tile.
+
+unsigned long long RiceTileBound(const int n){
+  const unsigned long long count = (unsigned long long)n*n; //number of heights
+  const unsigned long long blocks = (count + RICE_BLOCKSIZE - 1)/RICE_BLOCKSIZE; //number of blocks
+  return (count*(RICE_ESCAPE + RICE_VALUEBITS) + blocks*RICE_KBITS + 7)/8;
+} //RiceTileBound
+
+/// Compress a tile.
+/// \param src Heights of an n by n tile in row-major order.
+/// \param n Tile size.
+/// \param dest Buffer of at least RiceTileBound(n) bytes for the compressed tile.
+/// \return Size of the compressed tile in bytes.
+
+unsigned long long RiceEncodeTile(const unsigned short* src, const int n, unsigned char* dest){
+  const int count = n*n; //number of heights
+  unsigned int value[RICE_BLOCKSIZE]; //mapped differences for one block
+  unsigned char* p = dest; //next byte to be written
+  unsigned long long bits = 0; //bits not yet written
+  int nbits = 0; //number of bits in bits, always less than 8 between values
+
+  for(int b=0; b<count; b+=RICE_BLOCKSIZE){ //for each block
+    const int m = count - b < RICE_BLOCKSIZE? count - b: RICE_BLOCKSIZE; //values in block
+
+    //map the differences to unsigned values
+    for(int t=0; t<m; t++){
+      const int i = (b + t)/n, j = (b + t)%n; //row and column
+      const int d = (int)src[b + t] - PredictHeight(src, i, j, n); //difference
+      value[t] = d >= 0? 2*d: -2*d - 1;
+    } //for
+
+    //choose the Rice parameter that makes the block smallest
+    int k = 0; //Rice parameter
+    long long best = -1; //size of block with best Rice parameter so far
+    for(int kk=0; kk<=RICE_MAXK; kk++){
+      long long size = 0;
+      for(int t=0; t<m; t++){
+        const unsigned int q = value[t] >> kk;
+        size += q < RICE_ESCAPE? q + 1 + kk: RICE_ESCAPE + RICE_VALUEBITS;
+      } //for
+      if(best < 0 || size < best){
+        best = size; k = kk;
+      } //if
+    } //for
+
+    //write the Rice parameter
+    bits |= (unsigned long long)k << nbits;
+    nbits += RICE_KBITS;
+
+    //write the values
+    for(int t=0; t<m; t++){
+      const unsigned int q = value[t] >> k; //quotient
+
+      if(q < RICE_ESCAPE){ //q ones, a zero, and the low k bits
+        bits |= (unsigned long long)((1U << q) - 1) << nbits;
+        nbits += q + 1;
+        bits |= (unsigned long long)(value[t] & ((1U << k) - 1)) << nbits;
+        nbits += k;
+      } //if
+      else{ //escape and the whole value
+        bits |= (unsigned long long)((1U << RICE_ESCAPE) - 1) << nbits;
+        nbits += RICE_ESCAPE;
+        bits |= (unsigned long long)value[t] << nbits;
+        nbits += RICE_VALUEBITS;
+      } //else
+
+      for(; nbits>=8; nbits-=8){ //flush whole bytes
+        *p++ = (unsigned char)bits;
+        bits >>= 8;
+      } //for
+    } //for
+  } //for
+
+  if(nbits > 0) //flush the last partial byte
+    *p++ = (unsigned char)bits;
+
+  return p - dest;
+} //RiceEncodeTile
+
+/// Decompress a tile.
+/// \param src Compressed tile.
+/// \param size Size of compressed tile in bytes.
+/// \param n Tile size.
+/// \param dest Buffer for the n by n heights of the tile.
+/// \return true if it succeeds, false if the compressed tile is corrupt.
+
+bool RiceDecodeTile(const unsigned char* src, const unsigned long long size,
+  const int n, unsigned short* dest)
+{
+  const int count = n*n; //number of heights
+  unsigned long long pos = 0; //offset of next byte to be read
+  unsigned long long bits = 0; //bits read but not yet used
+  int nbits = 0; //number of bits in bits
+  int pred = 0; //predicted value of next height
+  int j = 0; //column of next height
+
+  for(int b=0; b<count; b+=RICE_BLOCKSIZE){ //for each block
+    const int m = count - b < RICE_BLOCKSIZE? count - b: RICE_BLOCKSIZE; //values in block
+    int k = 0; //Rice parameter
+    unsigned int mask = 0; //mask for the low k bits
+
+    for(int t=-1; t<m; t++){ //Rice parameter then values
+      //read enough bytes for the longest value, padding with zeros past the end
+      if(pos + 8 <= size){ //8 bytes at a time, little-endian
+        unsigned long long word;
+        memcpy(&word, src + pos, 8);
+        bits |= word << nbits;
+        pos += (63 - nbits) >> 3;
+        nbits |= 56;
+      } //if
+      else for(; nbits<=56; nbits+=8, pos++) //one byte at a time
+        bits |= (unsigned long long)(pos < size? src[pos]: 0) << nbits;
+
+      if(t < 0){ //read Rice parameter
+        k = (int)(bits & ((1U << RICE_KBITS) - 1));
+        bits >>= RICE_KBITS;
+        nbits -= RICE_KBITS;
+        if(k > RICE_MAXK)return false;
+        mask = (1U << k) - 1;
+        continue;
+      } //if
+
+      unsigned int value; //mapped difference
+      const unsigned int ones = (unsigned int)bits & ((1U << RICE_ESCAPE) - 1); //low bits
+
+      if(ones == (1U << RICE_ESCAPE) - 1){ //escaped
+        value = (unsigned int)(bits >> RICE_ESCAPE) & ((1U << RICE_VALUEBITS) - 1);
+        bits >>= RICE_ESCAPE + RICE_VALUEBITS;
+        nbits -= RICE_ESCAPE + RICE_VALUEBITS;
+      } //if
+      else{
+        const int q = CountTrailingZeros(~ones); //quotient
+        value = ((unsigned int)q << k) | ((unsigned int)(bits >> (q + 1)) & mask);
+        bits >>= q + 1 + k;
+        nbits -= q + 1 + k;
+      } //else
+
+      const int h = pred + (value&1? -(int)(value >> 1) - 1: (int)(value >> 1)); //height
+      if(h < 0 || h > 0xFFFF)return false;
+      dest[b + t] = (unsigned short)h;
+
+      if(++j < n)pred = h; //predict from the left
+      else{ //predict start of next row from above
+        j = 0; pred = dest[b + t + 1 - n];
+      } //else
+    } //for
+  } //for
+
+  //the bytes actually used must be exactly the compressed tile
+  return pos - nbits/8 == size;
+} //RiceDecodeTile
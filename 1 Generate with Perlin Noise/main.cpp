@@ -23,6 +23,47 @@
 /// mu (a number between 1.0 and 1.16-ish, try 1.002 if your imagination fails
 /// you), and an elevation cap in meters (somewhat tenuously related to the
 /// maximum height of the terrain, try 5000).
+///
+/// The command line option -format followed by one of asc, uint16, float32,
+/// packed, or compressed selects the output file format. The default is asc,
+/// an ASCII DEM file output.asc. The others are much faster to write: raw
+/// 16-bit or float heights in output.img with an ENVI header output.hdr, or
+/// the tiled packed DEM file format output.bin from Pack, with or without
+/// compressed tiles.
+///
+/// The rows of the cell are generated in bands by several threads, one per
+/// hardware thread by default, while the main thread saves the band before.
+/// The command line option -threads N sets the number of threads. The terrain is
+/// the same however many threads there are. By default the noise tables are
+/// made with rand() seeded with the random number seed, as in the paper, and
+/// -rng splitmix makes them with a seeded SplitMix64 generator instead.
+/// The noise is computed a point at a time, exactly as in the paper, unless
+/// -evaluate row is given, which computes each row with
+/// CPerlinNoise2D::generateRow. That is faster, and it is bitwise the same
+/// when built without -ffast-math. With -ffast-math, as in the makefile,
+/// the compiler may round the two differently, and a few heights in ten
+/// thousand come out 0.01 meters different.
+///
+/// The option -lattice N sets the lattice size, which is the period of the
+/// noise, to N, a power of 2. The default is 256, as in Perlin's code and the
+/// paper, which repeats visibly across a 4096x4096 cell. The option -benchmark
+/// generates noise in a single thread for a range of lattice sizes instead of
+/// saving a cell, and reports the time and, where the processor's performance
+/// counters can be read, the number of cache misses per sample.
+///
+/// The option -batch followed by the name of a manifest runs the jobs in it
+/// instead of prompting for anything. A manifest is a text file with one
+/// job per line, made of the seed, mu, elevation cap, the X and Y coordinates
+/// of the top left corner in units of 256 points, which must not be negative,
+/// the width and height, the number of octaves, and the name of the output
+/// file without extension, which must be different for each job, separated
+/// by commas, for example 9999, 1.02, 5000, 7777, 9999, 4096, 4096,
+/// 8, output for a cell like the one the program makes by default. The jobs
+/// are run at the same time by a pool of workers, one per hardware thread
+/// unless -jobs N says otherwise, each using one thread unless -threads N is
+/// given. A worker keeps its noise tables from one job to the next, and makes
+/// new ones only when the seed or mu changes. The time and throughput of each
+/// job are printed as it finishes.
 
 // Copyright Ian Parberry, May 2014.
 //
@@ -33,70 +74,365 @@
 // without any warranty.
 //
 // Created by Ian Parberry, May 2014.
-// Last updated May 29, 2014.
+// Last updated May 31, 2014.
 
 #include <stdio.h> //for printf()
 #include <stdlib.h> //for srand()
+#include <string.h> //for strcmp()
+
+#include <thread> //for std::thread
+#include <atomic> //for std::atomic
+#include <functional> //for std::ref
+#include <vector>
+#include <mutex> //for std::mutex
 
 #include "defines.h" //OS porting defines
 #include "perlin.h" //Perlin noise
+#include "DEMWriter.h" //output files
+#include "PerfCounter.h" //for benchmarking
+#include "Batch.h" //for batches of jobs
 
 
 const int CELLSIZE = 4096; ///< Number of vertices on side of square cell.
+const int BANDSIZE = 64; ///< Number of rows in a band.
+const int BENCHMARKROWS = 256; ///< Number of rows generated for each lattice size by -benchmark.
 
 int g_nNumOctaves = 8; ///< Number of octaves.
 float g_fAltitude = 5000.0f; ///< Altitude cap.
 float g_fMu = 1.02f; ///< Mu, the gradient magnitude exponent.
+DEMFormat g_eFormat = DEMFORMAT_ASC; ///< Output file format.
+int g_nNumThreads = 0; ///< Number of threads, 0 for one per hardware thread.
+bool g_bSplitMix = false; ///< Whether to make the noise tables with SplitMix64 instead of rand().
+bool g_bRowNoise = false; ///< Whether to compute noise a row at a time instead of a point at a time.
+int g_nLatticeSize = B; ///< Lattice size.
+bool g_bBenchmark = false; ///< Whether to benchmark instead of generating a cell.
+CPerlinNoise2D* g_pPerlinNoise = NULL; ///< Pointer to the Perlin noise generator.
+const char* g_szManifest = NULL; ///< Name of the batch manifest, NULL for none.
+int g_nNumWorkers = 0; ///< Number of batch workers, 0 for one per hardware thread.
+std::mutex g_mutexRand; ///< Mutex for seeding rand() and making noise tables with it.
+
+/// \brief Band of rows.
+///
+/// A band of rows of terrain heights shared out among threads a row at a time.
+
+struct BandJob{
+  const CPerlinNoise2D* noise; ///< Perlin noise generator.
+  unsigned int x; ///< X coordinate of corner of cell.
+  unsigned int y; ///< Y coordinate of corner of cell.
+  int width; ///< Number of heights in a row.
+  int octaves; ///< Number of octaves.
+  float altitude; ///< Altitude cap.
+  bool bRows; ///< Whether to compute noise a row at a time instead of a point at a time.
+  int i0; ///< First row of the band.
+  int rows; ///< Number of rows in the band.
+  float* heights; ///< The band of heights, width per row.
+  std::atomic<int> next; ///< Next row of the band to be generated.
+}; //BandJob
+
+/// \brief Generate rows of a band.
+///
+/// Generate rows of terrain heights until there are none left in the band.
+/// \param job The band.
+
+void GenerateRows(BandJob* job){
+  for(int i; (i = job->next++) < job->rows; ){
+    float* row = job->heights + (size_t)i*job->width;
+    const unsigned int x = job->x, y = job->y; //corner of cell
+    const int k = job->i0 + i; //row of cell
+
+    if(job->bRows){
+      job->noise->generateRow(x + k/256.0f, (float)y, 1/256.0f,
+        job->width, job->octaves, row); //Perlin noise
+      for(int j=0; j<job->width; j++)
+        row[j] = job->altitude*0.5f*(1.0f + row[j]); //height
+    } //if
+
+    else for(int j=0; j<job->width; j++){
+      float pnoise = job->noise->generate(x + k/256.0f, y + j/256.0f, job->octaves); //Perlin noise
+      row[j] = job->altitude*0.5f*(1.0f + pnoise); //height
+    } //for
+  } //for
+} //GenerateRows
+
+/// \brief Generate a band of rows.
+///
+/// Generate a band of rows of terrain heights using several threads, the
+/// calling thread being one of them.
+/// \param job The band.
+/// \param threads Number of threads.
+
+void GenerateBand(BandJob& job, const int threads){
+  job.next = 0;
+
+  std::vector<std::thread> thread;
+  for(int k=1; k<threads; k++)
+    thread.push_back(std::thread(GenerateRows, &job));
+  GenerateRows(&job);
+
+  for(int k=0; k<(int)thread.size(); k++)
+    thread[k].join();
+} //GenerateBand
 
-/// \brief Generate and save a cell of terrain elevations.
+/// \brief Generate and save terrain elevations.
 ///
-/// Generate and save a cell of noise as a DEM file. The output file
-/// will have a ".asc" file expension, which is standard for DEM files.
+/// Generate and save a rectangle of noise as a DEM file. The output file
+/// will have a ".asc" file expension, which is standard for DEM files,
+/// unless g_eFormat says otherwise. Each band of rows is generated by
+/// several threads while the band before it is being saved.
+/// \param noise Perlin noise generator.
 /// \param x X coordinate of corner of cell.
 /// \param y Y coordinate of corner of cell.
+/// \param width Number of heights in a row.
+/// \param height Number of rows.
+/// \param octaves Number of octaves.
+/// \param altitude Altitude cap.
+/// \param threads Number of threads, 0 for one per hardware thread.
 /// \param filename Name of DEM file for output, without extension.
+/// \param bProgress Whether to print progress and the outcome.
+/// \param bytes [out] Number of bytes saved.
+/// \return true if it was saved.
 
-void GenerateAndSave(const unsigned int x, const unsigned int y, const char* filename){  
-  FILE* output = fopen(filename, "wt");
-  if(output){
-    //header
-    fprintf(output, "nrows %d\n", CELLSIZE);
-    fprintf(output, "ncols %d\n", CELLSIZE);
-    fprintf(output, "xllcenter %0.6f\n", 0.0f);
-    fprintf(output, "yllcenter %0.6f\n", 0.0f);
-    fprintf(output, "cellsize 5.000000\n");
-    fprintf(output, "NODATA_value  -9999\n");
-
-    //minimum and maximum height to report to console
-    float maxht = -9999.9f;
-    float minht = 9999.9f;
-
-    //generate and save terrain heights
-    for(int i=0; i<CELLSIZE; i++){
-      for(int j=0; j<CELLSIZE; j++){   
-        float pnoise = PerlinNoise2D(x + i/256.0f, y + j/256.0f, g_nNumOctaves); //Perlin noise
-        float ht = g_fAltitude*0.5f*(1.0f + pnoise); //height
-        fprintf(output, "%0.2f ", ht); 
-        minht = min(minht, ht);
-        maxht = max(maxht, ht);
+bool GenerateAndSave(const CPerlinNoise2D* noise, const unsigned int x, const unsigned int y,
+  const int width, const int height, const int octaves, const float altitude,
+  int threads, const char* filename, const bool bProgress, long long& bytes)
+{  
+  bytes = 0;
+  CDEMWriter output;
+  if(!output.Open(filename, g_eFormat, width, height, 5.0)){
+    if(bProgress)printf("Save failed.\n");
+    return false;
+  } //if
+
+  //minimum and maximum height to report to console
+  float maxht = -9999.9f;
+  float minht = 9999.9f;
+
+  if(threads <= 0)threads = (int)std::thread::hardware_concurrency();
+  if(threads < 1)threads = 1;
+
+  //two bands, one being generated while the other is saved
+  BandJob band[2];
+  for(int k=0; k<2; k++){
+    band[k].noise = noise;
+    band[k].x = x; band[k].y = y;
+    band[k].width = width;
+    band[k].octaves = octaves;
+    band[k].altitude = altitude;
+    band[k].bRows = g_bRowNoise;
+    band[k].heights = new float [(size_t)BANDSIZE*width];
+  } //for
+
+  //generate and save terrain heights
+  std::thread generator;
+  for(int i0=0, k=0; i0<height; i0+=BANDSIZE, k^=1){
+    BandJob& cur = band[k]; //band to be saved
+
+    if(i0 == 0){ //first band, nothing to overlap with
+      cur.i0 = 0; cur.rows = min(BANDSIZE, height);
+      GenerateBand(cur, threads);
+    } //if
+    else generator.join(); //wait for this band
+
+    if(i0 + BANDSIZE < height){ //start on the next band
+      BandJob& nxt = band[k^1];
+      nxt.i0 = i0 + BANDSIZE; nxt.rows = min(BANDSIZE, height - nxt.i0);
+      generator = std::thread(GenerateBand, std::ref(nxt), threads);
+    } //if
+
+    for(int i=0; i<cur.rows; i++){
+      const float* row = cur.heights + (size_t)i*width;
+      for(int j=0; j<width; j++){   
+        minht = min(minht, row[j]);
+        maxht = max(maxht, row[j]);
       } //for
-      fprintf(output, "\n");
-      if(i%100 == 0)printf(".");
+      output.WriteRow(row);
+      if(bProgress && (i0 + i)%100 == 0)printf(".");
     } //for
+  } //for
+
+  for(int k=0; k<2; k++)
+    delete [] band[k].heights;
+
+  //report good things and close out
+  if(bProgress)printf("\nElevation Min = %0.2f, Max = %0.2f\n", minht, maxht);
+  const bool bSuccess = output.Close();
+  bytes = output.GetBytesWritten();
 
-    //report good things and close out
-    printf("\nElevation Min = %0.2f, Max = %0.2f\n", minht, maxht);
-    fclose(output);
+  if(bProgress){
+    if(bSuccess)printf("Saved %lld bytes to %s\n", bytes, output.GetFileName());
+    else printf("Save failed.\n");
   } //if
-  else printf("Save failed.\n");
+
+  return bSuccess;
 } //GenerateAndSave
 
+/// \brief Benchmark lattice sizes.
+///
+/// Time the generation of BENCHMARKROWS rows of a cell in the calling thread
+/// for lattice sizes from 256 up to 65536, and print the time and the number
+/// of cache misses per sample for each of them. The noise tables are made with
+/// SplitMix64, since rand() can't shuffle more than RAND_MAX + 1 corners.
+/// Each lattice size is run once to warm up the cache before it is timed.
+/// \param seed Random number seed.
+
+void Benchmark(const unsigned int seed){
+  CPerfCounter counter;
+  float* row = new float [CELLSIZE];
+  const double samples = (double)BENCHMARKROWS*CELLSIZE;
+
+  printf("Lattice size, ns/sample, cache misses/sample\n");
+
+  for(int n=256; n<=65536; n*=4){
+    CPerlinNoise2D noise(seed, g_fMu, n);
+    double elapsed = 0.0;
+    long long misses = -1;
+
+    for(int run=0; run<2; run++){ //warm up, then measure
+      counter.Start();
+      const double start = GetSeconds();
+      for(int i=0; i<BENCHMARKROWS; i++)
+        noise.generateRow(7777 + i/256.0f, 9999.0f, 1/256.0f, CELLSIZE, g_nNumOctaves, row);
+      elapsed = GetSeconds() - start;
+      misses = counter.Stop();
+    } //for
+
+    if(misses >= 0)
+      printf("%d, %0.2f, %0.4f\n", n, 1e9*elapsed/samples, misses/samples);
+    else printf("%d, %0.2f, unavailable\n", n, 1e9*elapsed/samples);
+  } //for
+
+  delete [] row;
+} //Benchmark
+
+/// \brief Perlin noise batch worker.
+///
+/// Runs batch jobs, keeping the Perlin noise generator from one job for the
+/// next if it has the same seed and mu. The row and column of the origin are
+/// the X and Y coordinates of the corner, in units of 256 points.
+
+class CPerlinBatchWorker: public CBatchWorker{
+  private:
+    CPerlinNoise2D* m_pNoise; ///< Perlin noise generator from the last job, NULL if none.
+    unsigned int m_nSeed; ///< Seed of the Perlin noise generator.
+    float m_fMu; ///< Mu of the Perlin noise generator.
+    int m_nNumThreads; ///< Number of threads for each job.
+
+  public:
+    CPerlinBatchWorker(const int threads); ///< Constructor.
+    ~CPerlinBatchWorker(); ///< Destructor.
+    bool Run(BatchJob& job); ///< Run a job.
+}; //CPerlinBatchWorker
+
+/// \param threads Number of threads for each job.
+
+CPerlinBatchWorker::CPerlinBatchWorker(const int threads):
+  m_pNoise(NULL), m_nSeed(0), m_fMu(0.0f), m_nNumThreads(threads){
+} //constructor
+
+CPerlinBatchWorker::~CPerlinBatchWorker(){
+  delete m_pNoise;
+} //destructor
+
+/// Generate and save the terrain for a batch job. Since rand() is shared
+/// by all threads, seeding it and making the noise tables with it is done
+/// under a mutex, which gives the same tables as the interactive program.
+/// \param job The job.
+/// \return true if it was saved.
+
+bool CPerlinBatchWorker::Run(BatchJob& job){
+  //get a generator with the right seed and mu
+  if(m_pNoise != NULL && (m_nSeed != job.nSeed || m_fMu != job.fParam)){
+    delete m_pNoise;
+    m_pNoise = NULL;
+  } //if
+
+  job.bReused = m_pNoise != NULL;
+
+  if(m_pNoise == NULL){
+    if(g_bSplitMix)
+      m_pNoise = new CPerlinNoise2D(job.nSeed, job.fParam, g_nLatticeSize);
+    else{
+      std::lock_guard<std::mutex> lock(g_mutexRand);
+      srand(job.nSeed); //seed the random number generator
+      m_pNoise = new CPerlinNoise2D(job.fParam, g_nLatticeSize);
+    } //else
+
+    m_nSeed = job.nSeed;
+    m_fMu = job.fParam;
+  } //if
+
+  return GenerateAndSave(m_pNoise, job.nRow, job.nCol, job.nWidth, job.nHeight, job.nOctaves,
+    job.fAltitude, m_nNumThreads, job.strOutput.c_str(), false, job.nBytes);
+} //Run
+
+/// \brief Run a batch.
+///
+/// Read the jobs in the manifest g_szManifest, check them, and run them
+/// with a pool of g_nNumWorkers workers. Each job is generated with
+/// g_nNumThreads threads, one if it hasn't been set, since the workers
+/// already keep the processor busy.
+/// \return true if every job succeeded.
+
+bool RunPerlinBatch(){
+  std::vector<BatchJob> manifest;
+  int nRejected = 0; //number of lines of the manifest that aren't jobs
+  if(!ReadBatchManifest(g_szManifest, manifest, nRejected)){
+    printf("Cannot open manifest %s\n", g_szManifest);
+    return false;
+  } //if
+
+  //check the jobs
+  std::vector<BatchJob> jobs;
+
+  for(int i=0; i<(int)manifest.size(); i++){
+    const BatchJob& job = manifest[i];
+    if(!(job.fParam >= 1.0f && job.fParam <= 1.16f))
+      printf("Ignoring job on line %d, mu must be between 1 and 1.16\n", job.nLine);
+    else if(!(job.fAltitude > 0.0f))
+      printf("Ignoring job on line %d, elevation cap must be greater than 0\n", job.nLine);
+    else if(job.nOctaves < 1)
+      printf("Ignoring job on line %d, number of octaves must be at least 1\n", job.nLine);
+    else if(job.nWidth <= 0 || job.nHeight <= 0)
+      printf("Ignoring job on line %d, bad size %dx%d\n", job.nLine, job.nWidth, job.nHeight);
+    else if(job.nRow < 0 || job.nCol < 0)
+      printf("Ignoring job on line %d, bad origin %d, %d\n", job.nLine, job.nRow, job.nCol);
+    else jobs.push_back(job);
+  } //for
+
+  //make the workers
+  int workers = g_nNumWorkers > 0? g_nNumWorkers: (int)std::thread::hardware_concurrency();
+  if(workers > (int)jobs.size())workers = (int)jobs.size();
+  if(workers < 1)workers = 1;
+  const int threads = g_nNumThreads > 0? g_nNumThreads: 1;
+
+  printf("Running %d jobs from %s with %d workers of %d threads.\n",
+    (int)jobs.size(), g_szManifest, workers, threads);
+
+  std::vector<CBatchWorker*> worker;
+  for(int k=0; k<workers; k++)
+    worker.push_back(new CPerlinBatchWorker(threads));
+
+  bool bOK = RunBatch(jobs, worker);
+
+  nRejected += (int)(manifest.size() - jobs.size());
+  if(nRejected > 0){
+    printf("Rejected %d line%s of %s\n", nRejected, nRejected > 1? "s": "", g_szManifest);
+    bOK = false;
+  } //if
+
+  for(int k=0; k<workers; k++)
+    delete worker[k];
+
+  return bOK;
+} //RunPerlinBatch
+
 /// \brief Main.
 ///
 /// Prompts the user for a random number seed, number of octaves,
 /// mu, and an elevation cap, saves a DEM file output.asc of
 /// terrain elevations generated using Perlin noise with an exponentially
-/// distributed gradient magnitude.
+/// distributed gradient magnitude, or runs the batch of jobs in a manifest
+/// without prompting if -batch is given.
 /// \param argc Argument count
 /// \param argv Arguments.
 /// \return 0 for success, 1 for failure.
@@ -105,6 +441,47 @@ int main(int argc, char *argv[]){
   printf("Perlin Noise Terrain Generator, Ian Parberry, 2014\n");
   printf("-------------------------------------------\n");
 
+  //parse command line
+  for(int i=1; i<argc; i++)
+    if(!strcmp(argv[i], "-format") && i+1 < argc){
+      if(!ParseDEMFormat(argv[++i], g_eFormat))
+        printf("Ignoring unknown format %s\n", argv[i]);
+    } //if
+    else if(!strcmp(argv[i], "-threads") && i+1 < argc)
+      g_nNumThreads = atoi(argv[++i]);
+    else if(!strcmp(argv[i], "-rng") && i+1 < argc){
+      if(!strcmp(argv[++i], "rand"))g_bSplitMix = false;
+      else if(!strcmp(argv[i], "splitmix"))g_bSplitMix = true;
+      else printf("Ignoring unknown random number generator %s\n", argv[i]);
+    } //else if
+    else if(!strcmp(argv[i], "-evaluate") && i+1 < argc){
+      if(!strcmp(argv[++i], "point"))g_bRowNoise = false;
+      else if(!strcmp(argv[i], "row"))g_bRowNoise = true;
+      else printf("Ignoring unknown evaluation %s\n", argv[i]);
+    } //else if
+    else if(!strcmp(argv[i], "-lattice") && i+1 < argc)
+      g_nLatticeSize = atoi(argv[++i]);
+    else if(!strcmp(argv[i], "-benchmark"))
+      g_bBenchmark = true;
+    else if(!strcmp(argv[i], "-batch") && i+1 < argc)
+      g_szManifest = argv[++i];
+    else if(!strcmp(argv[i], "-jobs") && i+1 < argc)
+      g_nNumWorkers = atoi(argv[++i]);
+    else printf("Ignoring unknown option %s\n", argv[i]);
+
+  if(g_nLatticeSize < 2 || (g_nLatticeSize & (g_nLatticeSize - 1))){
+    printf("Lattice size must be a power of 2\n");
+    return 1;
+  } //if
+
+  if(!g_bSplitMix && g_nLatticeSize - 1 > RAND_MAX){
+    printf("Lattice size must be at most %lld with rand(), use -rng splitmix\n", RAND_MAX + 1LL);
+    return 1;
+  } //if
+
+  if(g_szManifest != NULL)
+    return RunPerlinBatch()? 0: 1;
+
   //get random number seed
   int seed = 9999;
   printf("Random number seed: ");
@@ -136,9 +513,22 @@ int main(int argc, char *argv[]){
       printf("  Elevation cap must be greater than 0.\n");
   }while(g_fAltitude <= 0.0f); 
 
-  srand(seed); //seed the random number generator
-  initPerlin2D(); //initialize the Perlin noise ganaerator
-  GenerateAndSave(7777, 9999, "output.asc"); //generate noise cell and save as a DEM file.
+  if(g_bBenchmark)Benchmark((unsigned int)seed);
+
+  else{
+    //initialize the Perlin noise generator
+    if(g_bSplitMix)
+      g_pPerlinNoise = new CPerlinNoise2D((unsigned int)seed, g_fMu, g_nLatticeSize);
+    else{
+      srand(seed); //seed the random number generator
+      g_pPerlinNoise = new CPerlinNoise2D(g_fMu, g_nLatticeSize);
+    } //else
+
+    long long bytes = 0;
+    GenerateAndSave(g_pPerlinNoise, 7777, 9999, CELLSIZE, CELLSIZE, g_nNumOctaves,
+      g_fAltitude, g_nNumThreads, "output", true, bytes); //generate noise cell and save as a DEM file.
+    delete g_pPerlinNoise;
+  } //else
   
 #if defined(_MSC_VER) //Windows Visual Studio 
   //wait for user keystroke and exit
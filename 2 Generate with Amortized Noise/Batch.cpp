@@ -0,0 +1,207 @@
+/// \file Batch.cpp
+/// \brief Code for batches of terrain generation jobs.
+
+// Copyright Ian Parberry, May 2014.
+//
+// This file is made available under the GNU All-Permissive License.
+//
+// Copying and distribution of this file, with or without modification,
+// are permitted in any medium without royalty provided the copyright
+// notice and this notice are preserved.  This file is offered as-is,
+// without any warranty.
+
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+
+#include <algorithm>
+#include <map>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+#include "Batch.h"
+
+/// \brief Get time.
+///
+/// Get the wall clock time in seconds from some fixed point.
+/// \return Time in seconds.
+
+static double GetSeconds(){
+  return std::chrono::duration<double>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+} //GetSeconds
+
+/// \brief Batch queue.
+///
+/// The jobs of a batch in the order that they are handed out, and the
+/// index of the next one to be handed out.
+
+struct BatchQueue{
+  std::vector<BatchJob>* pJobs; ///< The jobs in manifest order.
+  std::vector<int> vOrder; ///< Indices of the jobs in the order they are run.
+  std::atomic<int> nNext; ///< Index into vOrder of the next job to run.
+  std::mutex mutex; ///< Mutex for the console.
+}; //BatchQueue
+
+/// \brief Job order.
+///
+/// Comparison for sorting jobs so that the ones with the same seed and
+/// shape parameter are next to each other, keeping to manifest order otherwise.
+
+struct BatchOrder{
+  const std::vector<BatchJob>& jobs; ///< The jobs.
+
+  BatchOrder(const std::vector<BatchJob>& v): jobs(v){}
+
+  bool operator()(const int a, const int b) const{
+    if(jobs[a].nSeed != jobs[b].nSeed)return jobs[a].nSeed < jobs[b].nSeed;
+    return jobs[a].fParam < jobs[b].fParam;
+  } //operator()
+}; //BatchOrder
+
+CBatchWorker::~CBatchWorker(){
+} //destructor
+
+/// Read jobs from a manifest and append them to a vector. Lines that
+/// can't be read as jobs, or whose output file name is the same as an
+/// earlier job's, are reported, skipped, and counted, so that the
+/// caller can fail the batch.
+/// \param filename Name of the manifest.
+/// \param jobs Vector that the jobs are appended to.
+/// \param nRejected [out] Number of lines that couldn't be read as jobs.
+/// \return true if the manifest could be opened.
+
+bool ReadBatchManifest(const char* filename, std::vector<BatchJob>& jobs, int& nRejected){
+  nRejected = 0;
+  FILE* input = fopen(filename, "rt");
+  if(input == NULL)return false;
+
+  char line[1024]; //one line of the manifest, truncated if longer
+  char output[1024]; //output file name
+  bool bHeader = true; //whether a header line is still allowed
+  std::map<std::string, int> outputs; //line of the job that has each output file name
+
+  for(int n=1; fgets(line, sizeof(line), input); n++){
+    const char* p = line;
+    while(isspace((unsigned char)*p))p++;
+    if(*p == '\0' || *p == '#')continue; //blank line or comment
+
+    if(bHeader && !isdigit((unsigned char)*p)){ //header line
+      bHeader = false;
+      continue;
+    } //if
+
+    bHeader = false;
+
+    BatchJob job;
+    job.nLine = n;
+    job.bSucceeded = job.bReused = false;
+    job.nBytes = 0;
+    job.fElapsed = 0.0f;
+
+    const int nFields = sscanf(p, "%u ,%f ,%f ,%d ,%d ,%d ,%d ,%d , %1023[^\n]",
+      &job.nSeed, &job.fParam, &job.fAltitude, &job.nRow, &job.nCol,
+      &job.nWidth, &job.nHeight, &job.nOctaves, output);
+
+    if(nFields < 9){
+      printf("Ignoring bad job on line %d of %s\n", n, filename);
+      nRejected++;
+      continue;
+    } //if
+
+    int len = (int)strlen(output);
+    while(len > 0 && isspace((unsigned char)output[len - 1]))
+      output[--len] = '\0';
+    job.strOutput = output;
+
+    std::map<std::string, int>::iterator i = outputs.find(job.strOutput);
+    if(i != outputs.end()){
+      printf("Ignoring job on line %d of %s, output %s is already used on line %d\n",
+        n, filename, output, i->second);
+      nRejected++;
+      continue;
+    } //if
+
+    outputs[job.strOutput] = n;
+    jobs.push_back(job);
+  } //for
+
+  fclose(input);
+  return true;
+} //ReadBatchManifest
+
+/// \brief Run jobs.
+///
+/// Run jobs from a batch queue until there are none left, and report on
+/// each one as it finishes.
+/// \param queue The batch queue.
+/// \param worker The worker that runs the jobs.
+
+static void RunJobs(BatchQueue* queue, CBatchWorker* worker){
+  const int nJobs = (int)queue->vOrder.size();
+
+  for(int k; (k = queue->nNext++) < nJobs; ){
+    BatchJob& job = (*queue->pJobs)[queue->vOrder[k]];
+
+    const double t = GetSeconds();
+    job.bSucceeded = worker->Run(job);
+    job.fElapsed = (float)(GetSeconds() - t);
+
+    const double points = (double)job.nWidth*job.nHeight;
+    const double seconds = std::max(job.fElapsed, 1e-6f);
+
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    if(job.bSucceeded)
+      printf("Line %d: %s, %dx%d in %0.2f seconds, %0.2f Mpoints/s, %0.2f MB/s, %s generator\n",
+        job.nLine, job.strOutput.c_str(), job.nWidth, job.nHeight, job.fElapsed,
+        points/seconds/1e6, job.nBytes/seconds/1e6, job.bReused? "reused": "new");
+    else printf("Line %d: %s failed\n", job.nLine, job.strOutput.c_str());
+  } //for
+} //RunJobs
+
+/// Run a batch of jobs, one worker thread per worker, the calling thread
+/// being the first of them. The results are recorded in the jobs.
+/// \param jobs The jobs.
+/// \param workers The workers.
+/// \return true if every job succeeded.
+
+bool RunBatch(std::vector<BatchJob>& jobs, std::vector<CBatchWorker*>& workers){
+  BatchQueue queue;
+  queue.pJobs = &jobs;
+  queue.nNext = 0;
+  for(int i=0; i<(int)jobs.size(); i++)
+    queue.vOrder.push_back(i);
+  std::stable_sort(queue.vOrder.begin(), queue.vOrder.end(), BatchOrder(jobs));
+
+  const double t = GetSeconds();
+
+  std::vector<std::thread> thread;
+  for(int k=1; k<(int)workers.size(); k++)
+    thread.push_back(std::thread(RunJobs, &queue, workers[k]));
+  if(!workers.empty())
+    RunJobs(&queue, workers[0]);
+
+  for(int k=0; k<(int)thread.size(); k++)
+    thread[k].join();
+
+  const double seconds = std::max(GetSeconds() - t, 1e-6);
+
+  //totals
+  int nSucceeded = 0;
+  double points = 0.0;
+  long long bytes = 0;
+
+  for(int i=0; i<(int)jobs.size(); i++)
+    if(jobs[i].bSucceeded){
+      nSucceeded++;
+      points += (double)jobs[i].nWidth*jobs[i].nHeight;
+      bytes += jobs[i].nBytes;
+    } //if
+
+  printf("Ran %d of %d jobs with %d workers in %0.2f seconds, %0.2f Mpoints/s, %0.2f MB/s\n",
+    nSucceeded, (int)jobs.size(), (int)workers.size(), seconds, points/seconds/1e6, bytes/seconds/1e6);
+
+  return nSucceeded == (int)jobs.size();
+} //RunBatch
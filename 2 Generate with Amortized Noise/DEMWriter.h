@@ -0,0 +1,82 @@
+/// \file DEMWriter.h
+/// \brief Header for the terrain output file writer.
+
+// Copyright Ian Parberry, May 2014.
+//
+// This file is made available under the GNU All-Permissive License.
+//
+// Copying and distribution of this file, with or without modification,
+// are permitted in any medium without royalty provided the copyright
+// notice and this notice are preserved.  This file is offered as-is,
+// without any warranty.
+
+#pragma once
+
+#include <stdio.h>
+
+#include "DEMFile.h"
+
+const int DEMWRITER_BUFSIZE = 1 << 20; ///< Size of output buffer in bytes.
+const float DEMWRITER_HEIGHTSCALE = 10.0f; ///< Heights are multiplied by this in 16-bit and packed files, as in Pack.
+
+/// \brief Terrain output file format.
+
+enum DEMFormat{
+  DEMFORMAT_ASC, ///< ESRI ASCII grid, the DEM file format read by Terragen.
+  DEMFORMAT_UINT16, ///< Raw unsigned 16-bit heights in decimeters with an ENVI .hdr file.
+  DEMFORMAT_FLOAT32, ///< Raw 32-bit float heights in meters with an ENVI .hdr file.
+  DEMFORMAT_PACKED, ///< The tiled packed DEM file format written by Pack.
+  DEMFORMAT_COMPRESSED, ///< The tiled packed DEM file format with compressed tiles.
+}; //DEMFormat
+
+bool ParseDEMFormat(const char* name, DEMFormat& format); ///< Get a format from its name.
+int FormatHeight(const float value, char* dest); ///< Format the way printf("%0.2f") does.
+
+/// Convert a height in meters to the 16-bit height stored in raw 16-bit and
+/// packed files, the way Pack does it.
+/// \param height Height in meters.
+/// \return Height in units of 1/DEMWRITER_HEIGHTSCALE meters, clamped to 16 bits.
+
+inline unsigned short PackHeight(const float height){
+  const float h = height*DEMWRITER_HEIGHTSCALE;
+  return h > 0.0f? (h < 65535.0f? (unsigned short)h: 65535): 0;
+} //PackHeight
+
+/// \brief Terrain output file writer.
+///
+/// Writes a square or rectangular array of terrain heights in meters to a file
+/// one row at a time from the top down, in any of the formats in DEMFormat.
+/// Output is buffered and written in large blocks. ASCII files are identical
+/// to those written by fprintf(output, "%0.2f ", height), only a lot faster.
+
+class CDEMWriter{
+  private:
+    DEMFormat m_eFormat; ///< Output format.
+    FILE* m_pFile; ///< Output file, unless packed.
+    CDEMFileWriter m_cPackedFile; ///< Output file if packed.
+    char* m_pBuffer; ///< Output buffer.
+    int m_nBufferBytes; ///< Number of bytes in output buffer.
+    unsigned short* m_pRow; ///< Row buffer for packed files.
+    int m_nWidth; ///< Number of heights in each row.
+    int m_nHeight; ///< Number of rows.
+    double m_dCellSize; ///< Distance between points in meters.
+    long long m_nBytesWritten; ///< Number of bytes written so far.
+    bool m_bFailed; ///< Whether a write has failed.
+    char m_szFileName[256]; ///< Name of output file.
+
+    void Write(const void* data, const int size); ///< Write to the buffer.
+    void Flush(); ///< Write out the buffer.
+    bool WriteENVIHeader(const char* filename); ///< Write an ENVI header file.
+
+  public:
+    CDEMWriter(); ///< Constructor.
+    ~CDEMWriter(); ///< Destructor.
+
+    bool Open(const char* basefilename, const DEMFormat format,
+      const int width, const int height, const double cellsize); ///< Create a file.
+    bool WriteRow(const float* row); ///< Write the next row of heights.
+    bool Close(); ///< Finish writing the file.
+
+    const char* GetFileName(); ///< Get the name of the output file.
+    long long GetBytesWritten(); ///< Get the number of bytes written.
+}; //CDEMWriter
@@ -17,3 +17,7 @@
 float UniformHash(unsigned int x, unsigned int max); ///< Uniformly distributed hash function.
 float ExpHash(unsigned int x, unsigned int max); ///< Exponentially distributed hash function.
 float ExpHash(unsigned int x, unsigned int y, unsigned int m, float omega); ///< Exponentially distributed hash function.
+
+float FastLog2(float x); ///< Fast approximate base 2 logarithm.
+float ExpHashFast(unsigned int x, unsigned int max); ///< Fast exponentially distributed hash function.
+float ExpHashFast(unsigned int x, unsigned int y, unsigned int m, float omega); ///< Fast exponentially distributed hash function.
@@ -0,0 +1,457 @@
+/// \file FixedAmortizedNoise2D.h
+/// \brief Header for the fixed size 2D amortized noise class CFixedAmortizedNoise2D.
+///
+/// CInfiniteAmortizedNoise2D works out the granularity and number of subcells
+/// of each octave as it goes, rebuilds the spline table for every octave,
+/// gets lattice gradients through virtual functions so that CTerrainGenerator
+/// can change their magnitudes, and computes every row of every subcell
+/// with a call through the noise kernel function pointer, which for the
+/// smallest octaves is a call for every 2 points. When the cell size and range
+/// of octaves are fixed, as they are in the generator program, all of that can
+/// be done at compile time instead. CFixedAmortizedNoise2D is a template
+/// that does exactly that and gives bitwise the same noise as the class that
+/// it is standing in for. Octaves are unrolled, the spline tables for all of
+/// them are made by the constructor, the gradient magnitude is a policy class
+/// that is compiled in, and subcells too small for the SIMD kernels are
+/// computed inline with loops whose lengths are known.
+
+// Copyright Ian Parberry, May 2014.
+//
+// This file is made available under the GNU All-Permissive License.
+//
+// Copying and distribution of this file, with or without modification,
+// are permitted in any medium without royalty provided the copyright
+// notice and this notice are preserved.  This file is offered as-is,
+// without any warranty.
+
+#pragma once
+
+#define _USE_MATH_DEFINES //for M_SQRT2
+#include <math.h> //for trig functions
+
+#include <vector>
+#include <thread> //for std::thread::hardware_concurrency
+#include <atomic> //for std::atomic
+
+#include "InfiniteAmortizedNoise2D.h"
+#include "ExponentialHash.h"
+#include "NoiseKernel.h"
+#include "NoiseCell.h"
+#include "Common.h"
+
+/// \brief Unit gradient magnitudes.
+///
+/// Gradient magnitude policy for plain amortized noise, the same as
+/// CInfiniteAmortizedNoise2D.
+
+struct PerlinMagnitude{
+  enum{NUMSEEDS = 1}; ///< Number of hashes per lattice corner, the first for the direction.
+
+  /// Get a gradient magnitude.
+  /// \return 1.
+
+  static float get(const unsigned int*, const int, const int, const float){
+    return 1.0f;
+  } //get
+}; //PerlinMagnitude
+
+/// \brief Exponentially distributed gradient magnitudes.
+///
+/// Gradient magnitude policy for CTerrainGenerator.
+
+struct ExpMagnitude{
+  enum{NUMSEEDS = 3}; ///< Number of hashes per lattice corner: direction, magnitude, and tail.
+
+  /// Get a gradient magnitude from the hashes of a batch of lattice corners.
+  /// \param b Hashes, m for each seed.
+  /// \param j Index of corner in batch.
+  /// \param m Number of corners in batch.
+  /// \param omega Tail multiplier.
+  /// \return Gradient magnitude.
+
+  static float get(const unsigned int* b, const int j, const int m, const float omega){
+    return ExpHash(b[m + j], b[2*m + j], 0xFFFFFFFF, omega);
+  } //get
+}; //ExpMagnitude
+
+/// \brief Fast exponentially distributed gradient magnitudes.
+///
+/// Gradient magnitude policy for CTerrainGenerator with setFastExpHash(true).
+
+struct ExpFastMagnitude{
+  enum{NUMSEEDS = 3}; ///< Number of hashes per lattice corner: direction, magnitude, and tail.
+
+  /// Get a gradient magnitude from the hashes of a batch of lattice corners.
+  /// \param b Hashes, m for each seed.
+  /// \param j Index of corner in batch.
+  /// \param m Number of corners in batch.
+  /// \param omega Tail multiplier.
+  /// \return Gradient magnitude.
+
+  static float get(const unsigned int* b, const int j, const int m, const float omega){
+    return ExpHashFast(b[m + j], b[2*m + j], 0xFFFFFFFF, omega);
+  } //get
+}; //ExpFastMagnitude
+
+/// \brief Base 2 logarithm at compile time.
+///
+/// Log2<n>::value is the base 2 logarithm of n, a power of 2.
+
+template<int n> struct Log2{
+  enum{value = 1 + Log2<n/2>::value}; ///< Logarithm.
+}; //Log2
+
+/// \brief Base 2 logarithm of 1.
+
+template<> struct Log2<1>{
+  enum{value = 0}; ///< Logarithm.
+}; //Log2
+
+/// \brief Octave tag, used to pick an octave's code at compile time.
+
+template<int K> struct OctaveTag{};
+
+/// \brief The fixed size amortized 2D noise class.
+///
+/// Amortized noise for cells of size N with octaves M0 through M1 of
+/// CInfiniteAmortizedNoise2D::generate, and gradient magnitudes from the
+/// policy class MAGNITUDE. With PerlinMagnitude the noise is the same as
+/// CInfiniteAmortizedNoise2D's and with ExpMagnitude or ExpFastMagnitude it is
+/// the same as CTerrainGenerator's with the same seed and omega.
+
+template<int N, int M0, int M1, class MAGNITUDE> class CFixedAmortizedNoise2D{
+  private:
+    enum{
+      FIRSTSIZE = N >> (M0 - 1), ///< Granularity of the first octave.
+      FIRSTR = 1 << (M0 - 1), ///< Number of subcells across in the first octave.
+      MAXEXTRA = Log2<FIRSTSIZE>::value, ///< Most octaves after the first before the granularity is 1.
+      EXTRA = M1 - M0 < MAXEXTRA? M1 - M0: MAXEXTRA, ///< Number of octaves after the first.
+    }; //enum
+
+    /// \brief One octave of subcells shared out among threads.
+
+    struct Job{
+      int x; ///< x coordinate of top left corner of cell in this octave.
+      int y; ///< y coordinate of top left corner of cell in this octave.
+      float scale; ///< Scale factor for this octave.
+      float** cell; ///< Cell to put generated noise into.
+      std::atomic<int> next; ///< Next row of lattice corners or subcells.
+    }; //Job
+
+    /// \brief Octave K of a job, handed to the worker pool.
+
+    template<int K> struct OctaveTask: CWorkerTask{
+      CFixedAmortizedNoise2D* pNoise; ///< Generator.
+      Job* pJob; ///< Job being generated.
+      bool bLattice; ///< Whether the lattice gradients are being computed, instead of the subcells.
+
+      /// Do the calling thread's share of the octave, using its own edge tables.
+      /// \param index Index of thread, 0 for the one that generates the cell.
+
+      void Run(const int index){
+        if(bLattice)pNoise->template fillLattice<K>(pJob);
+        else pNoise->template generateSubcells<K>(pJob, pNoise->tables[index]);
+      } //Run
+    }; //OctaveTask
+
+    std::vector<CEdgeTables*> tables; ///< Edge tables big enough for the first octave, one per thread.
+    float spline[2*FIRSTSIZE]; ///< Spline tables for all octaves, each after the one before.
+    std::vector<float> latticeX; ///< X coordinates of gradients at the lattice corners of the current octave.
+    std::vector<float> latticeY; ///< Y coordinates of gradients at the lattice corners of the current octave.
+    unsigned int seeds[3]; ///< Hash seeds for direction, magnitude, and tail.
+    float omega; ///< Tail multiplier.
+    int threads; ///< Number of threads used to generate a cell.
+    CWorkerPool pool; ///< The threads other than the calling one.
+    GradientMode gradientMode; ///< How gradient directions are computed.
+    std::vector<float> directionX; ///< X coordinates of the unit vectors for GRADIENT_TABLE.
+    std::vector<float> directionY; ///< Y coordinates of the unit vectors for GRADIENT_TABLE.
+
+    void getDirection(const unsigned int b, float& dx, float& dy); ///< Get a gradient direction from a hash.
+    void getGradientRow(const int x, const int y0, const int n, float* gx, float* gy); ///< Get the gradients at a row of lattice corners.
+    template<int K> void fillLattice(Job* job); ///< Compute rows of lattice gradients.
+    template<int K> void generateSubcells(Job* job, CEdgeTables* t); ///< Generate rows of subcells.
+    template<int K> void generateOctave(Job& job); ///< Generate all subcells of 1 octave.
+    template<int K> void generateOctaves(Job& job, OctaveTag<K>); ///< Generate octave K and the ones after it.
+    void generateOctaves(Job& job, OctaveTag<EXTRA + 1>); ///< Stop after the last octave.
+
+  public:
+    CFixedAmortizedNoise2D(const unsigned int s, const float tail=0.0f); ///< Constructor.
+    ~CFixedAmortizedNoise2D(); ///< Destructor.
+    void setThreads(const int n); ///< Set the number of threads.
+    void setGradientMode(const GradientMode mode); ///< Set how gradient directions are computed.
+    float generate(int x, int y, CNoiseCell& cell); ///< Generate a cell of 2D amortized noise.
+    static float getScale(); ///< Get the scale that generate returns.
+}; //CFixedAmortizedNoise2D
+
+/// The constructor sets the seeds the way CTerrainGenerator does, and makes
+/// the spline tables for all of the octaves the way
+/// CInfiniteAmortizedNoise2D::initSplineTable does.
+/// \param s Hash function seed.
+/// \param tail Value of omega, which is ignored with PerlinMagnitude.
+
+template<int N, int M0, int M1, class MAGNITUDE>
+CFixedAmortizedNoise2D<N, M0, M1, MAGNITUDE>::CFixedAmortizedNoise2D(const unsigned int s, const float tail):
+  omega(tail), threads(1), gradientMode(GRADIENT_TRIG)
+{
+  static_assert(FIRSTSIZE >= 2, "the first octave must have granularity at least 2");
+  static_assert(M0 <= M1, "the octaves must be in order");
+
+  seeds[0] = s;
+  seeds[1] = s + 9999;
+  seeds[2] = s + 314159;
+
+  //ExpHash has a static local that not all compilers initialize thread safely
+  ExpHash(0, 0, 0xFFFFFFFF, omega);
+
+  float* t = spline;
+  for(int n=FIRSTSIZE; n>=1; n/=2){
+    CInfiniteAmortizedNoise2D::fillSplineTable(t, n);
+    t += n;
+  } //for
+
+  tables.push_back(new CEdgeTables(FIRSTSIZE));
+} //constructor
+
+template<int N, int M0, int M1, class MAGNITUDE>
+CFixedAmortizedNoise2D<N, M0, M1, MAGNITUDE>::~CFixedAmortizedNoise2D(){
+  for(int i=0; i<(int)tables.size(); i++)
+    delete tables[i];
+} //destructor
+
+/// Set the number of threads used to generate a cell. Each thread gets its
+/// own edge tables, and the threads other than the calling one are kept in
+/// the worker pool until the number of threads changes.
+/// \param n Number of threads, 0 for one per hardware thread.
+
+template<int N, int M0, int M1, class MAGNITUDE>
+void CFixedAmortizedNoise2D<N, M0, M1, MAGNITUDE>::setThreads(const int n){
+  threads = n > 0? n: (int)std::thread::hardware_concurrency();
+  if(threads < 1)threads = 1;
+
+  while((int)tables.size() < threads)
+    tables.push_back(new CEdgeTables(FIRSTSIZE));
+
+  pool.Resize(threads - 1);
+} //setThreads
+
+/// Set how gradient directions are computed, the same as
+/// CInfiniteAmortizedNoise2D::setGradientMode.
+/// \param mode Gradient direction mode.
+
+template<int N, int M0, int M1, class MAGNITUDE>
+void CFixedAmortizedNoise2D<N, M0, M1, MAGNITUDE>::setGradientMode(const GradientMode mode){
+  gradientMode = mode;
+
+  if(mode == GRADIENT_TABLE && directionX.empty()){
+    directionX.resize(GRADIENT_TABLE_SIZE);
+    directionY.resize(GRADIENT_TABLE_SIZE);
+    for(int k=0; k<GRADIENT_TABLE_SIZE; k++){
+      const double theta = 2.0*3.14159265358979323846*k/GRADIENT_TABLE_SIZE;
+      directionX[k] = (float)cos(theta);
+      directionY[k] = (float)sin(theta);
+    } //for
+  } //if
+} //setGradientMode
+
+/// Get the direction of a gradient from the hash of its lattice corner.
+/// \param b Hash of the lattice corner.
+/// \param dx X coordinate of the unit vector in that direction.
+/// \param dy Y coordinate of the unit vector in that direction.
+
+template<int N, int M0, int M1, class MAGNITUDE>
+inline void CFixedAmortizedNoise2D<N, M0, M1, MAGNITUDE>::getDirection(const unsigned int b, float& dx, float& dy){
+  if(gradientMode == GRADIENT_TABLE){
+    const unsigned int k = b >> (32 - GRADIENT_TABLE_BITS); //top bits are best mixed
+    dx = directionX[k];
+    dy = directionY[k];
+  } //if
+  else{
+    dx = cosf((float)b);
+    dy = sinf((float)b);
+  } //else
+} //getDirection
+
+/// Get the gradients at a row of lattice corners, hashing a batch of corners
+/// at a time with the lattice hash kernels.
+/// \param x x coordinate of the lattice corners.
+/// \param y0 y coordinate of the first lattice corner.
+/// \param n Number of lattice corners.
+/// \param gx X coordinates of gradients.
+/// \param gy Y coordinates of gradients.
+
+template<int N, int M0, int M1, class MAGNITUDE>
+void CFixedAmortizedNoise2D<N, M0, M1, MAGNITUDE>::getGradientRow(const int x, const int y0, const int n, float* gx, float* gy){
+  unsigned int xs[LATTICE_BATCH], ys[LATTICE_BATCH], b[MAGNITUDE::NUMSEEDS*LATTICE_BATCH];
+
+  for(int j0=0; j0<n; j0+=LATTICE_BATCH){
+    const int m = n - j0 < LATTICE_BATCH? n - j0: LATTICE_BATCH; //corners in this batch
+    for(int j=0; j<m; j++){
+      xs[j] = x; ys[j] = y0 + j0 + j;
+    } //for
+
+    LatticeHashBatch(xs, ys, m, seeds, MAGNITUDE::NUMSEEDS, b);
+
+    for(int j=0; j<m; j++){
+      const float mag = MAGNITUDE::get(b, j, m, omega);
+      float dx, dy; //direction
+      getDirection(b[j], dx, dy);
+      gx[j0 + j] = mag * dx;
+      gy[j0 + j] = mag * dy;
+    } //for
+  } //for
+} //getGradientRow
+
+/// Compute rows of gradients at the lattice corners of octave K until there
+/// are none left.
+/// \param job Octave to be generated.
+
+template<int N, int M0, int M1, class MAGNITUDE>
+template<int K> void CFixedAmortizedNoise2D<N, M0, M1, MAGNITUDE>::fillLattice(Job* job){
+  const int size = (FIRSTR << K) + 1; //width and height of lattice
+
+  for(int i; (i = job->next++) < size; ){ //for each row of corners
+    const int k = i*size;
+    getGradientRow(job->x + i, job->y, size, &latticeX[k], &latticeY[k]);
+  } //for
+} //fillLattice
+
+/// Generate rows of subcells of octave K until there are none left. The edge
+/// tables are filled by CInfiniteAmortizedNoise2D::fillEdgeTables, except
+/// in the smallest octaves, whose tables have only one or two entries that
+/// come out the same however they are computed. Each row of noise is computed
+/// by the noise kernels if it is long enough for them to be worth calling,
+/// and inline otherwise, with the same floating point operations as
+/// CInfiniteAmortizedNoise2D::getNoise.
+/// \param job Octave to be generated.
+/// \param t Edge tables for this thread.
+
+template<int N, int M0, int M1, class MAGNITUDE>
+template<int K> void CFixedAmortizedNoise2D<N, M0, M1, MAGNITUDE>::generateSubcells(Job* job, CEdgeTables* t){
+  const int n = FIRSTSIZE >> K; //granularity
+  const int r = FIRSTR << K; //number of subcells across
+  const int size = r + 1; //width and height of lattice
+  const float* s = spline + 2*FIRSTSIZE - 2*n; //spline table for this octave
+  const float scale = job->scale;
+
+  for(int i0; (i0 = job->next++) < r; ) //for each row of subcells
+    for(int j0=0; j0<r; j0++){ //for each subcell in that row
+      //gradients at corner points
+      const int k00 = i0*size + j0;
+      const int k10 = k00 + size;
+      const float gx[4] = {latticeX[k00], latticeX[k00 + 1], latticeX[k10], latticeX[k10 + 1]};
+      const float gy[4] = {latticeY[k00], latticeY[k00 + 1], latticeY[k10], latticeY[k10 + 1]};
+
+      //fill inferred gradient tables, as FillUp and FillDn do it
+      if(n <= 2){
+        const float d[8] = {gx[0]/n, -gx[1]/n, gx[2]/n, -gx[3]/n, gy[0]/n, gy[1]/n, -gy[2]/n, -gy[3]/n};
+        t->uax[0] = 0.0f; t->ubx[0] = 0.0f; t->uay[0] = 0.0f; t->vay[0] = 0.0f;
+        t->vax[n-1] = d[1]; t->vbx[n-1] = d[3]; t->uby[n-1] = d[6]; t->vby[n-1] = d[7];
+
+        if(n == 2){
+          t->uax[1] = t->uax[0] + d[0]; t->ubx[1] = t->ubx[0] + d[2];
+          t->uay[1] = t->uay[0] + d[4]; t->vay[1] = t->vay[0] + d[5];
+          t->vax[0] = t->vax[1] + d[1]; t->vbx[0] = t->vbx[1] + d[3];
+          t->uby[0] = t->uby[1] + d[6]; t->vby[0] = t->vby[1] + d[7];
+        } //if
+      } //if
+      else CInfiniteAmortizedNoise2D::fillEdgeTables(gx, gy, n, *t);
+
+      //noise
+      float** cell = job->cell + i0*n;
+      NoiseRow row = {t->uax, t->vax, t->ubx, t->vbx, s, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+
+      for(int i=0; i<n; i++){
+        float* dest = cell[i] + j0*n;
+
+        if(n >= 8){ //kernel
+          row.uay = t->uay[i]; row.vay = t->vay[i];
+          row.uby = t->uby[i]; row.vby = t->vby[i];
+          row.si = s[i];
+          if(K == 0)GetNoiseRow(row, n, dest);
+          else AddNoiseRow(row, n, scale, dest);
+        } //if
+
+        else for(int j=0; j<n; j++){ //inline
+          float p = t->uax[j] + t->uay[i];
+          float q = t->vax[j] + t->vay[i];
+          const float a = lerp(s[j], p, q);
+          p = t->ubx[j] + t->uby[i];
+          q = t->vbx[j] + t->vby[i];
+          const float b = lerp(s[j], p, q);
+          const float noise = lerp(s[i], a, b);
+          if(K == 0)dest[j] = noise;
+          else dest[j] += scale * noise;
+        } //for
+      } //for
+    } //for
+} //generateSubcells
+
+/// Generate all of the subcells of octave K, sharing the rows of lattice
+/// corners and then the rows of subcells out among the threads of the worker
+/// pool, the calling thread being one of them.
+/// \param job Octave to be generated.
+
+template<int N, int M0, int M1, class MAGNITUDE>
+template<int K> void CFixedAmortizedNoise2D<N, M0, M1, MAGNITUDE>::generateOctave(Job& job){
+  const int r = FIRSTR << K; //number of subcells across
+  const int size = r + 1; //width and height of lattice
+  latticeX.resize(size*size);
+  latticeY.resize(size*size);
+
+  const int nThreads = threads < r? threads: r; //no more threads than rows of subcells
+  OctaveTask<K> task;
+  task.pNoise = this;
+  task.pJob = &job;
+
+  //lattice gradients
+  task.bLattice = true;
+  job.next = 0;
+  pool.Run(&task, nThreads);
+
+  //subcells
+  task.bLattice = false;
+  job.next = 0;
+  pool.Run(&task, nThreads);
+} //generateOctave
+
+/// Generate octave K and all of the octaves after it.
+/// \param job Octave to be generated, which is changed to the ones after it.
+
+template<int N, int M0, int M1, class MAGNITUDE>
+template<int K> void CFixedAmortizedNoise2D<N, M0, M1, MAGNITUDE>::generateOctaves(Job& job, OctaveTag<K>){
+  generateOctave<K>(job);
+  job.x += job.x; job.y += job.y; job.scale *= 0.5f; //rescale for next octave
+  generateOctaves(job, OctaveTag<K + 1>());
+} //generateOctaves
+
+/// Stop after the last octave.
+
+template<int N, int M0, int M1, class MAGNITUDE>
+void CFixedAmortizedNoise2D<N, M0, M1, MAGNITUDE>::generateOctaves(Job&, OctaveTag<EXTRA + 1>){
+} //generateOctaves
+
+/// Generate a cell of 1/f amortized noise with persistence 0.5 and lacunarity 2.0,
+/// the same as CInfiniteAmortizedNoise2D::generate(x, y, M0, M1, cell) does.
+/// \param x x coordinate of top left corner of cell.
+/// \param y y coordinate of top left corner of cell.
+/// \param cell Cell to put generated noise into, of size N.
+/// \return Multiply noise by this to get into the range -1..1
+
+template<int N, int M0, int M1, class MAGNITUDE>
+float CFixedAmortizedNoise2D<N, M0, M1, MAGNITUDE>::generate(int x, int y, CNoiseCell& cell){
+  if(cell.GetSize() != N)return 1.0f; //fail and bail - should not happen
+
+  Job job;
+  job.x = x; job.y = y; job.scale = 1.0f; job.cell = cell.GetRows();
+  generateOctaves(job, OctaveTag<0>());
+
+  return getScale();
+} //generate
+
+/// Get the scale that generate returns, which depends only on the octaves.
+/// \return Multiply noise by this to get into the range -1..1
+
+template<int N, int M0, int M1, class MAGNITUDE>
+float CFixedAmortizedNoise2D<N, M0, M1, MAGNITUDE>::getScale(){
+  return (float)M_SQRT2/(2.0f - 1.0f/(1 << EXTRA));
+} //getScale
@@ -2,8 +2,9 @@
 /// \brief Header file for the 2D amortized noise class CInfiniteAmortizedNoise2D.
 ///
 /// This version of InfiniteAmortizedNoise2D.h differs from the original by
-/// making everything that was private be protected, and making private functions
-/// initEdgeTables and h be virtual functions. These modifications were made
+/// making everything that was private be protected, and making private function
+/// h and functions getGradient and getGradientRow, which compute the gradients at
+/// lattice corners, be virtual functions. These modifications were made
 /// so that CTerrainGenerator can be derived from CInfiniteAmortizedNoise2D.
 
 // Copyright Ian Parberry, September 2013, 2014.
@@ -20,12 +21,23 @@
 
 #pragma once
 
-/// \brief The amortized 2D noise class.
+#include <vector>
+#include <unordered_map>
+#include <thread> //for std::thread
+#include <mutex> //for std::mutex
+#include <condition_variable> //for std::condition_variable
+
+#include "NoiseKernel.h"
+#include "NoiseCell.h"
+
+/// \brief Amortized noise edge tables.
 ///
-/// The 2D amortized noise class implements the 2D infinite amortized noise algorithm.
+/// The tables of inferred gradients along the edges of a subcell that
+/// initEdgeTables fills in and getNoise reads. Subcells can only be generated
+/// in parallel if each thread has its own edge tables.
 
-class CInfiniteAmortizedNoise2D{
-  protected: //Amortized noise stuff
+class CEdgeTables{
+  public:
     float *uax; ///< X coordinate of u used to compute a.
     float *vax; ///< X coordinate of v used to compute a.
     float *ubx; ///< X coordinate of u used to compute b.
@@ -34,23 +46,143 @@ class CInfiniteAmortizedNoise2D{
     float *vay; ///< Y coordinate of v used to compute a.
     float *uby; ///< Y coordinate of u used to compute b.
     float *vby; ///< Y coordinate of v used to compute b.
+
+    CEdgeTables(const unsigned int n); ///< Constructor.
+    ~CEdgeTables(); ///< Destructor.
+}; //CEdgeTables
+
+/// \brief Worker pool task.
+///
+/// Something to be done by several threads at once, each of which calls
+/// Run with its own index, 0 being the thread that hands out the task.
+
+class CWorkerTask{
+  public:
+    virtual ~CWorkerTask(); ///< Destructor.
+    virtual void Run(const int index) = 0; ///< Do this thread's share of the task.
+}; //CWorkerTask
+
+/// \brief Worker pool.
+///
+/// Worker threads that are started once and then kept, parked on a condition
+/// variable between tasks, so that the octaves of a cell and the cells after
+/// it don't pay for starting and joining threads. The thread that hands out
+/// a task does its share of it too, and waits for the workers to finish theirs.
+
+class CWorkerPool{
+  private:
+    std::vector<std::thread> m_vThreads; ///< Worker threads.
+    std::mutex m_mutex; ///< Protects everything below.
+    std::condition_variable m_cvStart; ///< Signalled when there is a task or it is time to stop.
+    std::condition_variable m_cvDone; ///< Signalled when the last worker finishes a task.
+    CWorkerTask* m_pTask; ///< Current task.
+    int m_nTaskThreads; ///< Number of threads doing the current task, including the caller.
+    int m_nBusy; ///< Number of workers that haven't finished the current task.
+    unsigned int m_nGeneration; ///< Number of tasks handed out so far.
+    bool m_bStop; ///< Whether the workers should stop.
+
+    void WorkerThread(const int index, unsigned int generation); ///< Do tasks until told to stop.
+    void Stop(); ///< Stop the worker threads.
+
+  public:
+    CWorkerPool(); ///< Constructor.
+    ~CWorkerPool(); ///< Destructor.
+    void Resize(const int n); ///< Set the number of worker threads.
+    int GetSize(); ///< Get the number of worker threads.
+    void Run(CWorkerTask* task, const int n); ///< Do a task in n threads.
+}; //CWorkerPool
+
+#define GRADIENT_TABLE_BITS 12 ///< Number of hash bits used to look up a gradient direction.
+#define GRADIENT_TABLE_SIZE (1 << GRADIENT_TABLE_BITS) ///< Number of gradient directions in the table.
+
+/// \brief Gradient direction mode.
+///
+/// How the direction of the gradient at a lattice corner is computed from
+/// the hash b of its coordinates. The paper uses cosf(b) and sinf(b), which
+/// is slow because b is huge. The table mode uses the top bits of b to pick one of
+/// GRADIENT_TABLE_SIZE evenly spaced unit vectors, which gives different,
+/// but statistically equivalent, noise.
+
+enum GradientMode{
+  GRADIENT_TRIG, ///< cosf(b) and sinf(b), as in the paper.
+  GRADIENT_TABLE ///< Unit vector looked up from the top bits of b.
+}; //GradientMode
+
+#define GRADIENT_CACHE_SIZE (1 << 18) ///< Most lattice gradients kept for point queries.
+
+/// \brief Gradient at a lattice corner.
+
+struct LatticeGradient{
+  float x; ///< X coordinate.
+  float y; ///< Y coordinate.
+}; //LatticeGradient
+
+struct OctaveJob; //one octave of subcells shared out among threads
+
+/// \brief The amortized 2D noise class.
+///
+/// The 2D amortized noise class implements the 2D infinite amortized noise algorithm.
+/// The subcells of each octave can be generated by several threads, each with
+/// its own edge tables, giving exactly the same noise as a single thread.
+/// The threads other than the calling one are kept in a worker pool from
+/// one octave and one cell to the next.
+/// Noise can also be had at any set of points of the infinite plane without
+/// generating a whole cell, which gives exactly the same values as the
+/// points of the cells that they are in.
+
+class CInfiniteAmortizedNoise2D{
+  protected: //Amortized noise stuff
+    CEdgeTables tables; ///< Edge tables for the calling thread.
+    std::vector<CEdgeTables*> threadTables; ///< Edge tables for the other threads.
+    CWorkerPool pool; ///< The other threads.
     float* spline; ///< Spline table.
+    std::vector<float> latticeX; ///< X coordinates of gradients at the lattice corners of the current octave.
+    std::vector<float> latticeY; ///< Y coordinates of gradients at the lattice corners of the current octave.
+    int latticeSize; ///< Width and height of the lattice, one more than the number of subcells across.
     unsigned int seed; ///< Hash seed.
+    unsigned int size; ///< Cell size, the largest granularity.
+    int threads; ///< Number of threads used to generate a cell.
+    GradientMode gradientMode; ///< How gradient directions are computed.
+    std::vector<float> directionX; ///< X coordinates of the unit vectors for GRADIENT_TABLE.
+    std::vector<float> directionY; ///< Y coordinates of the unit vectors for GRADIENT_TABLE.
+    std::unordered_map<unsigned long long, LatticeGradient> gradientCache; ///< Lattice gradients used by point queries.
 
     virtual unsigned int h(const unsigned int x, const unsigned int y); ///< 2D hash function.
 
-    void FillUp(float* t, const float s, const int n); ///< Fill amortized noise table bottom up.
-    void FillDn(float* t, const float s, const int n); ///< Fill amortized noise table top down.
+    static void FillUp(float* t, const float s, const int n); ///< Fill amortized noise table bottom up.
+    static void FillDn(float* t, const float s, const int n); ///< Fill amortized noise table top down.
 
-    virtual void initEdgeTables(const int x, const int y, const int n); ///< Initialize the amortized noise tables.
+    void getDirection(const unsigned int b, float& dx, float& dy); ///< Get a gradient direction from a hash.
+    virtual void getGradient(const int x, const int y, float& gx, float& gy); ///< Get the gradient at a lattice corner.
+    virtual void getGradientRow(const int x, const int y0, const int n, float* gx, float* gy); ///< Get the gradients at a row of lattice corners.
+    void getCachedGradient(const int x, const int y, float& gx, float& gy); ///< Get a lattice gradient from the cache.
+    void initEdgeTables(const int i0, const int j0, const int n, CEdgeTables& t); ///< Initialize the amortized noise tables.
     void initSplineTable(const int n); ///< Initialize the spline table.
 
     float getNoise(const int i, const int j);  ///< Get one point of amortized noise. 
-    void getNoise(const int n, const int i0, const int j0, float** cell);  ///< Get 1 octave of amortized noise into cell.
-    void addNoise(const int n, const int i0, const int j0, const float scale, float** cell);  ///< Add 1 octave of amortized noise into cell.
+    void initNoiseRow(const int i, const CEdgeTables& t, NoiseRow& row); ///< Initialize a noise row for the row kernels.
+    void getNoise(const int n, const int i0, const int j0, const CEdgeTables& t, float** cell);  ///< Get 1 octave of amortized noise into cell.
+    void addNoise(const int n, const int i0, const int j0, const float scale, const CEdgeTables& t, float** cell);  ///< Add 1 octave of amortized noise into cell.
+
+    void generateOctave(OctaveJob& job); ///< Generate all subcells of 1 octave.
+    void fillLattice(OctaveJob* job); ///< Compute rows of lattice gradients until there are none left.
+    void generateSubcells(OctaveJob* job, CEdgeTables* t); ///< Generate rows of subcells until there are none left.
+
+    friend struct OctaveJob;
 
   public:
+    static void fillEdgeTables(const float* gx, const float* gy, const int n, CEdgeTables& t); ///< Fill the edge tables from corner gradients.
+    static void fillSplineTable(float* t, const int n); ///< Fill a spline table.
+
     CInfiniteAmortizedNoise2D(const unsigned n, const unsigned int s); ///< Constructor.
     ~CInfiniteAmortizedNoise2D(); ///< Destructor.
+    void setThreads(const int n); ///< Set the number of threads.
+    void setGradientMode(const GradientMode mode); ///< Set how gradient directions are computed.
+    unsigned int getSeed(); ///< Get the hash seed.
     float generate(int x, int y, const int m0, const int m1, const int n, float** cell); ///< Generate a cell of 2D amortized noise.
+    float generate(const int x, const int y, const int m0, const int m1, CNoiseCell& cell); ///< Generate into a contiguous cell.
+    float getPoints(const int x, const int y, const int m0, const int m1, const int m2,
+      const int count, const int* i, const int* j, float* value); ///< Get noise at a set of points.
+    float getGrid(const int x, const int y, const int m0, const int m1, const int m2,
+      const int i0, const int j0, const int rows, const int cols, const int stride, float* value); ///< Get noise at a grid of points.
 }; //CInfiniteAmortizedNoise2D
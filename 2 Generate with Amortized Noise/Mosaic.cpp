@@ -0,0 +1,370 @@
+/// \file Mosaic.cpp
+/// \brief Code for the mosaic generator.
+
+// Copyright Ian Parberry, May 2014.
+//
+// This file is made available under the GNU All-Permissive License.
+//
+// Copying and distribution of this file, with or without modification,
+// are permitted in any medium without royalty provided the copyright
+// notice and this notice are preserved.  This file is offered as-is,
+// without any warranty.
+
+#include <stdio.h>
+#include <string.h>
+
+#include <deque>
+#include <vector>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+#include "Mosaic.h"
+#include "NoiseCell.h"
+#include "TerrainGenerator.h"
+
+const int MOSAIC_NUMBUFFERS = 2; ///< Number of cells in memory at once.
+
+/// \brief Get time.
+///
+/// Get the wall clock time in seconds from some fixed point.
+/// \return Time in seconds.
+
+static double GetSeconds(){
+  return std::chrono::duration<double>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+} //GetSeconds
+
+/// \brief A generated cell of a mosaic.
+
+struct MosaicCell{
+  CNoiseCell* pCell; ///< Noise.
+  int nRow; ///< Row of the mosaic that it is in, counting in cells.
+  int nCol; ///< Column of the mosaic that it is in, counting in cells.
+  float fScale; ///< Scale value to normalize the noise.
+}; //MosaicCell
+
+/// \brief Mosaic queue.
+///
+/// The queue between the producer thread that generates cells and the main
+/// thread that writes them. There is a fixed number of cells, which are
+/// either free for the producer to generate into or full and waiting to be
+/// written, so the producer waits when it gets too far ahead and memory
+/// stays bounded. Either side can abort, which wakes up the other.
+
+class CMosaicQueue{
+  private:
+    std::mutex m_mutex; ///< Mutex for everything.
+    std::condition_variable m_cvFree; ///< Signalled when a cell is freed.
+    std::condition_variable m_cvFull; ///< Signalled when a cell is filled.
+    std::vector<CNoiseCell*> m_vFree; ///< Cells free to be generated into.
+    std::deque<MosaicCell> m_dqFull; ///< Cells generated but not written yet, in order.
+    bool m_bDone; ///< Whether the producer has generated its last cell.
+    bool m_bAbort; ///< Whether to give up.
+
+  public:
+    CMosaicQueue(); ///< Constructor.
+
+    void AddFree(CNoiseCell* cell); ///< Give a cell back to the producer.
+    CNoiseCell* GetFree(); ///< Wait for a free cell.
+    void AddFull(const MosaicCell& cell); ///< Give a generated cell to the writer.
+    bool GetFull(MosaicCell& cell); ///< Wait for a generated cell.
+    void Finish(); ///< Say that there are no more cells coming.
+    void Abort(); ///< Give up.
+}; //CMosaicQueue
+
+/// The constructor makes an empty queue.
+
+CMosaicQueue::CMosaicQueue(): m_bDone(false), m_bAbort(false){
+} //constructor
+
+/// Put a cell on the free list.
+/// \param cell Pointer to the cell.
+
+void CMosaicQueue::AddFree(CNoiseCell* cell){
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_vFree.push_back(cell);
+  m_cvFree.notify_one();
+} //AddFree
+
+/// Wait until there is a free cell and take it.
+/// \return Pointer to the cell, NULL if aborting.
+
+CNoiseCell* CMosaicQueue::GetFree(){
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while(m_vFree.empty() && !m_bAbort)
+    m_cvFree.wait(lock);
+  if(m_bAbort)return NULL;
+
+  CNoiseCell* cell = m_vFree.back();
+  m_vFree.pop_back();
+  return cell;
+} //GetFree
+
+/// Put a generated cell on the end of the queue.
+/// \param cell The generated cell.
+
+void CMosaicQueue::AddFull(const MosaicCell& cell){
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_dqFull.push_back(cell);
+  m_cvFull.notify_one();
+} //AddFull
+
+/// Wait until there is a generated cell and take it off the front of the queue.
+/// \param cell [out] The generated cell.
+/// \return true if there is one, false if there are no more or aborting.
+
+bool CMosaicQueue::GetFull(MosaicCell& cell){
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while(m_dqFull.empty() && !m_bDone && !m_bAbort)
+    m_cvFull.wait(lock);
+  if(m_bAbort || m_dqFull.empty())return false;
+
+  cell = m_dqFull.front();
+  m_dqFull.pop_front();
+  return true;
+} //GetFull
+
+/// Tell the writer that the producer has generated its last cell.
+
+void CMosaicQueue::Finish(){
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_bDone = true;
+  m_cvFull.notify_all();
+} //Finish
+
+/// Give up, waking up anyone who is waiting.
+
+void CMosaicQueue::Abort(){
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_bAbort = true;
+  m_cvFree.notify_all();
+  m_cvFull.notify_all();
+} //Abort
+
+/// \brief Everything the producer thread needs to know.
+
+struct MosaicJob{
+  CTerrainGenerator* pGenerator; ///< Terrain generator.
+  CMosaicQueue* pQueue; ///< Queue to the writer.
+  int nRow; ///< Tile row index of the top left cell.
+  int nCol; ///< Tile column index of the top left cell.
+  int nNumRows; ///< Number of rows of cells.
+  int nNumCols; ///< Number of columns of cells.
+  int m0; ///< Largest octave.
+  int m1; ///< Smallest octave.
+  double dGenerate; ///< Time spent generating.
+  double dWait; ///< Time spent waiting for a free cell.
+  bool bFailed; ///< Whether generation failed.
+}; //MosaicJob
+
+/// \brief Producer thread.
+///
+/// Generate the cells of a mosaic in row-major order, each into a cell from
+/// the free list, and pass them on to the writer. The tile indices of each cell
+/// are adjusted for the tile size of the smallest octave, the same way the
+/// generator program does it for a single cell.
+/// \param job What to generate.
+
+static void ProducerThread(MosaicJob* job){
+  int scale = 1; //tile size of smallest octave
+  for(int i=1; i<job->m0; i++)
+    scale *= 2;
+
+  for(int r=0; r<job->nNumRows; r++)
+    for(int c=0; c<job->nNumCols; c++){
+      double t = GetSeconds();
+      CNoiseCell* cell = job->pQueue->GetFree();
+      job->dWait += GetSeconds() - t;
+      if(cell == NULL)return; //writer gave up
+
+      MosaicCell m;
+      m.pCell = cell;
+      m.nRow = r;
+      m.nCol = c;
+
+      t = GetSeconds();
+      try{
+        m.fScale = job->pGenerator->generate((job->nRow + r)*scale,
+          (job->nCol + c)*scale, job->m0, job->m1, *cell);
+      } //try
+      catch(...){
+        job->bFailed = true;
+        job->pQueue->Abort();
+        return;
+      } //catch
+      job->dGenerate += GetSeconds() - t;
+
+      job->pQueue->AddFull(m);
+    } //for
+
+  job->pQueue->Finish();
+} //ProducerThread
+
+/// \brief Write a cell of a mosaic.
+///
+/// Convert the noise in a generated cell to heights and write the tiles of
+/// the file that it covers.
+/// \param output Output file.
+/// \param header Header of the output file.
+/// \param m The generated cell.
+/// \param altitude Multiplier to convert noise to height.
+/// \param tile Buffer for the heights of one tile.
+/// \param rows Array of pointers to the rows of the tile buffer.
+/// \return Number of tiles written, -1 if writing fails.
+
+static int WriteCell(CDEMFileWriter& output, const DEMFileHeader& header,
+  MosaicCell& m, const float altitude, unsigned short* tile, unsigned short** rows)
+{
+  const int n = m.pCell->GetSize();
+  const int t = header.tilesize;
+  const int nTilesPerCell = n/t;
+  int count = 0; //number of tiles written
+
+  for(int a=0; a<nTilesPerCell; a++){ //for each row of tiles in the cell
+    const int ty = m.nRow*nTilesPerCell + a;
+    if(ty >= (int)header.tilesy)break;
+
+    for(int b=0; b<nTilesPerCell; b++){ //for each tile in the row
+      const int tx = m.nCol*nTilesPerCell + b;
+      if(tx >= (int)header.tilesx)break;
+
+      for(int i=0; i<t; i++){ //convert to heights
+        const float* src = m.pCell->GetRow(a*t + i) + b*t;
+        for(int j=0; j<t; j++)
+          tile[i*t + j] = PackHeight(altitude*(1.0f + src[j]*m.fScale)/2.0f);
+      } //for
+
+      if(!output.WriteTile(tx, ty, rows))return -1;
+      count++;
+    } //for
+  } //for
+
+  return count;
+} //WriteCell
+
+/// \brief Generate and save a mosaic.
+///
+/// Generate a rectangle of terrain made of cells of amortized noise, starting
+/// at the top left corner of a given cell, and save it as a packed DEM file.
+/// A producer thread generates the cells one after the other while the calling
+/// thread writes the ones that are done, with no more than two cells in memory
+/// at once. Heights are the same as the generator program saves for a single
+/// cell, so a mosaic the size of a cell is identical to it.
+/// \param generator Terrain generator, which is used only by the producer thread.
+/// \param pool Pool of noise cells.
+/// \param basefilename Name of output file, without extension.
+/// \param format Output format, which must be DEMFORMAT_PACKED or DEMFORMAT_COMPRESSED.
+/// \param nRow Tile row index of the top left cell.
+/// \param nCol Tile column index of the top left cell.
+/// \param width Width of the mosaic in points.
+/// \param height Height of the mosaic in points.
+/// \param m0 Largest octave.
+/// \param m1 Smallest octave.
+/// \param n Cell size, a multiple of the tile size.
+/// \param altitude Multiplier to convert noise to height.
+/// \param cellsize Distance between points in meters.
+/// \param stats [out] Statistics.
+/// \param bProgress Whether to print the size and a dot for every cell.
+/// \return true if it succeeds, false if it fails.
+
+bool GenerateMosaic(CTerrainGenerator* generator, CNoiseCellPool& pool,
+  const char* basefilename, const DEMFormat format, const int nRow, const int nCol,
+  const int width, const int height, const int m0, const int m1,
+  const int n, const float altitude, const double cellsize, MosaicStats& stats,
+  const bool bProgress)
+{
+  memset(&stats, 0, sizeof(stats));
+  if(format != DEMFORMAT_PACKED && format != DEMFORMAT_COMPRESSED)return false;
+  if(width <= 0 || height <= 0 || n%DEMFILE_TILESIZE != 0)return false;
+
+  const double dStart = GetSeconds();
+
+  //open output file
+  char filename[256];
+  sprintf(filename, "%.250s.bin", basefilename);
+  DEMFileHeader header;
+  InitDEMHeader(header, width, height, DEMFILE_TILESIZE, DEMWRITER_HEIGHTSCALE, 0, cellsize);
+  header.codec = format == DEMFORMAT_COMPRESSED? DEMCODEC_RICE: DEMCODEC_RAW;
+
+  CDEMFileWriter output;
+  if(!output.Open(filename, header))return false;
+
+  //set up queue and producer
+  CMosaicQueue queue;
+  CNoiseCell* cells[MOSAIC_NUMBUFFERS]; //the only cells there are
+  for(int i=0; i<MOSAIC_NUMBUFFERS; i++){
+    cells[i] = pool.Acquire(n);
+    queue.AddFree(cells[i]);
+  } //for
+
+  MosaicJob job;
+  job.pGenerator = generator;
+  job.pQueue = &queue;
+  job.nRow = nRow;
+  job.nCol = nCol;
+  job.nNumRows = (height + n - 1)/n;
+  job.nNumCols = (width + n - 1)/n;
+  job.m0 = m0;
+  job.m1 = m1;
+  job.dGenerate = job.dWait = 0.0;
+  job.bFailed = false;
+
+  if(bProgress)
+    printf("Generating %dx%d mosaic of %dx%d cells to %s\n",
+      width, height, job.nNumCols, job.nNumRows, filename);
+
+  std::thread producer(ProducerThread, &job);
+
+  //write cells as they are generated
+  const int t = header.tilesize;
+  std::vector<unsigned short> tile((size_t)t*t);
+  std::vector<unsigned short*> rows(t);
+  for(int i=0; i<t; i++)
+    rows[i] = &tile[(size_t)i*t];
+
+  bool bSuccess = true;
+  double dWrite = 0.0, dWait = 0.0;
+  MosaicCell m;
+
+  for(;;){
+    double d = GetSeconds();
+    if(!queue.GetFull(m))break;
+    dWait += GetSeconds() - d;
+
+    d = GetSeconds();
+    const int count = WriteCell(output, header, m, altitude, &tile[0], &rows[0]);
+    dWrite += GetSeconds() - d;
+
+    queue.AddFree(m.pCell);
+    if(count < 0){
+      bSuccess = false;
+      queue.Abort();
+      break;
+    } //if
+
+    stats.nCells++;
+    stats.nTiles += count;
+    if(bProgress)printf(".");
+  } //for
+  if(bProgress)printf("\n");
+
+  producer.join();
+
+  //give the cells back to the pool, whichever side had them
+  for(int i=0; i<MOSAIC_NUMBUFFERS; i++)
+    pool.Release(cells[i]);
+
+  if(job.bFailed)bSuccess = false;
+  if(!output.Close())bSuccess = false;
+
+  stats.nBytes = (long long)output.GetBytesWritten();
+  stats.fElapsed = (float)(GetSeconds() - dStart);
+  stats.fGenerate = (float)job.dGenerate;
+  stats.fWrite = (float)dWrite;
+  stats.fGeneratorWait = (float)job.dWait;
+  stats.fWriterWait = (float)dWait;
+
+  return bSuccess;
+} //GenerateMosaic
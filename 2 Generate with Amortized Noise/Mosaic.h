@@ -0,0 +1,49 @@
+/// \file Mosaic.h
+/// \brief Header for the mosaic generator.
+///
+/// The generator program saves a single cell of the infinite terrain, which
+/// is all that fits in memory if it is saved a row at a time. A mosaic is a
+/// rectangle of any width and height made of as many cells as it takes,
+/// starting at the top left corner of a given cell. Each cell is generated
+/// on its own and chopped into the tiles of a packed DEM file, which can be
+/// written in any order, so that no more than two cells are ever in memory
+/// however big the mosaic is. One of them is being generated by a producer
+/// thread while the other is being written by the main thread.
+
+// Copyright Ian Parberry, May 2014.
+//
+// This file is made available under the GNU All-Permissive License.
+//
+// Copying and distribution of this file, with or without modification,
+// are permitted in any medium without royalty provided the copyright
+// notice and this notice are preserved.  This file is offered as-is,
+// without any warranty.
+
+#pragma once
+
+#include "DEMWriter.h"
+
+class CTerrainGenerator;
+class CNoiseCellPool;
+
+/// \brief Mosaic statistics.
+///
+/// Times are wall clock times in seconds. The generate and write times
+/// overlap, so their sum can be more than the elapsed time.
+
+struct MosaicStats{
+  int nCells; ///< Number of cells generated.
+  int nTiles; ///< Number of tiles written.
+  long long nBytes; ///< Size of the output file in bytes.
+  float fElapsed; ///< Time from start to finish.
+  float fGenerate; ///< Time the producer spent generating cells.
+  float fWrite; ///< Time the main thread spent writing tiles.
+  float fGeneratorWait; ///< Time the producer spent waiting for a free cell.
+  float fWriterWait; ///< Time the main thread spent waiting for a generated cell.
+}; //MosaicStats
+
+bool GenerateMosaic(CTerrainGenerator* generator, CNoiseCellPool& pool,
+  const char* basefilename, const DEMFormat format, const int nRow, const int nCol,
+  const int width, const int height, const int m0, const int m1,
+  const int n, const float altitude, const double cellsize, MosaicStats& stats,
+  const bool bProgress); ///< Generate and save a mosaic.
@@ -0,0 +1,115 @@
+/// \file NoiseCell.cpp
+/// \brief Code for the noise cell CNoiseCell and its pool CNoiseCellPool.
+
+// Copyright Ian Parberry, May 2014.
+//
+// This file is made available under the GNU All-Permissive License.
+//
+// Copying and distribution of this file, with or without modification,
+// are permitted in any medium without royalty provided the copyright
+// notice and this notice are preserved.  This file is offered as-is,
+// without any warranty.
+
+#include <stddef.h>
+
+#include "NoiseCell.h"
+
+/// Allocate a cell. Rows are padded to a multiple of NOISECELL_ALIGN bytes
+/// so that every row is aligned.
+/// \param n Width and height.
+
+CNoiseCell::CNoiseCell(const int n): m_nSize(n){
+  const int align = NOISECELL_ALIGN/sizeof(float); //alignment in floats
+  m_nStride = (n + align - 1)/align*align;
+
+  m_pBlock = new char [(size_t)n*m_nStride*sizeof(float) + NOISECELL_ALIGN];
+  const size_t offset = (size_t)m_pBlock%NOISECELL_ALIGN;
+  m_pData = (float*)(m_pBlock + (offset? NOISECELL_ALIGN - offset: 0));
+
+  m_pRow = new float* [n];
+  for(int i=0; i<n; i++)
+    m_pRow[i] = m_pData + (size_t)i*m_nStride;
+} //constructor
+
+/// Deallocate the cell.
+
+CNoiseCell::~CNoiseCell(){
+  delete [] m_pRow;
+  delete [] m_pBlock;
+} //destructor
+
+/// Reader function for the start of the first row.
+/// \return Pointer to the first float of the cell.
+
+float* CNoiseCell::GetData(){
+  return m_pData;
+} //GetData
+
+/// Get the start of a row.
+/// \param i Row index.
+/// \return Pointer to the first float of row i.
+
+float* CNoiseCell::GetRow(const int i){
+  return m_pRow[i];
+} //GetRow
+
+/// Reader function for the table of row pointers.
+/// \return Array of pointers to the start of each row.
+
+float** CNoiseCell::GetRows(){
+  return m_pRow;
+} //GetRows
+
+/// Reader function for the size.
+/// \return Width and height of the cell.
+
+int CNoiseCell::GetSize(){
+  return m_nSize;
+} //GetSize
+
+/// Reader function for the stride.
+/// \return Number of floats from the start of one row to the start of the next.
+
+int CNoiseCell::GetStride(){
+  return m_nStride;
+} //GetStride
+
+/// The destructor deletes the released cells. Cells that are still acquired
+/// belong to their users.
+
+CNoiseCellPool::~CNoiseCellPool(){
+  Clear();
+} //destructor
+
+/// Get a cell, reusing a released one of the right size if there is one.
+/// The contents of the cell are whatever was left in it.
+/// \param n Width and height.
+/// \return Pointer to cell.
+
+CNoiseCell* CNoiseCellPool::Acquire(const int n){
+  for(size_t i=0; i<m_vFree.size(); i++)
+    if(m_vFree[i]->GetSize() == n){
+      CNoiseCell* cell = m_vFree[i];
+      m_vFree[i] = m_vFree.back();
+      m_vFree.pop_back();
+      return cell;
+    } //if
+
+  return new CNoiseCell(n);
+} //Acquire
+
+/// Give back a cell so that it can be reused.
+/// \param cell Pointer to a cell from Acquire.
+
+void CNoiseCellPool::Release(CNoiseCell* cell){
+  if(cell != NULL)
+    m_vFree.push_back(cell);
+} //Release
+
+/// Delete the released cells.
+
+void CNoiseCellPool::Clear(){
+  for(size_t i=0; i<m_vFree.size(); i++)
+    delete m_vFree[i];
+  m_vFree.clear();
+} //Clear
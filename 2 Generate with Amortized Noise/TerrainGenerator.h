@@ -27,10 +27,14 @@ class CTerrainGenerator: public CInfiniteAmortizedNoise2D{
     unsigned int seed1; ///< Hash seed for gradient magnitude.
     unsigned int seed2; ///< Hash seed for tail of gradient magnitude distribution.
     float omega; ///< Tail height multiplier.
+    bool fastExpHash; ///< Whether to use ExpHashFast for gradient magnitudes.
     
     unsigned int h(const unsigned int x, const unsigned int y, unsigned int seed); ///< 2D hash function.
-    void initEdgeTables(const int x, const int y, const int n); ///< Initialize the amortized noise tables.
+    void getGradient(const int x, const int y, float& gx, float& gy); ///< Get the gradient at a lattice corner.
+    void getGradientRow(const int x, const int y0, const int n, float* gx, float* gy); ///< Get the gradients at a row of lattice corners.
 
   public:
     CTerrainGenerator(const unsigned int n, const unsigned int s, float tail); ///< Constructor.
+    float getOmega(); ///< Get omega.
+    void setFastExpHash(const bool fast); ///< Choose the exponential hash function.
 }; //CTerrainGenerator
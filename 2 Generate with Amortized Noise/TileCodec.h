@@ -0,0 +1,29 @@
+/// \file TileCodec.h
+/// \brief Header for the compressed tile codec.
+///
+/// Tiles are compressed by replacing each height by its difference from
+/// the one before it in the same row (or, for the first height in a row, the
+/// one above it), mapping the signed differences to unsigned values, and Rice
+/// coding them in blocks of RICE_BLOCKSIZE values. Each block starts with a
+/// 5-bit Rice parameter chosen to minimize its size. Neighboring DEM samples
+/// differ by only a few decimeters, so most values take only a few bits.
+/// Values too large for their block, which happen at the edges of regions
+/// with no data, are escaped and written out in full.
+
+// Copyright Ian Parberry, May 2014.
+//
+// This file is made available under the GNU All-Permissive License.
+//
+// Copying and distribution of this file, with or without modification,
+// are permitted in any medium without royalty provided the copyright
+// notice and this notice are preserved.  This file is offered as-is,
+// without any warranty.
+
+#pragma once
+
+const int RICE_BLOCKSIZE = 32; ///< Number of values that share a Rice parameter.
+
+unsigned long long RiceTileBound(const int n); ///< Largest possible size of a compressed tile.
+unsigned long long RiceEncodeTile(const unsigned short* src, const int n, unsigned char* dest); ///< Compress a tile.
+bool RiceDecodeTile(const unsigned char* src, const unsigned long long size,
+  const int n, unsigned short* dest); ///< Decompress a tile.
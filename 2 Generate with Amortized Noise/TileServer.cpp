@@ -0,0 +1,238 @@
+/// \file TileServer.cpp
+/// \brief Code for the terrain tile server CTileServer.
+
+// Copyright Ian Parberry, May 2014.
+//
+// This file is made available under the GNU All-Permissive License.
+//
+// Copying and distribution of this file, with or without modification,
+// are permitted in any medium without royalty provided the copyright
+// notice and this notice are preserved.  This file is offered as-is,
+// without any warranty.
+
+#include <string.h>
+
+#include "TileServer.h"
+#include "TerrainGenerator.h"
+
+/// Tile keys are ordered by each of their fields in turn.
+/// \param k Tile key to compare to.
+/// \return true if this key comes before k.
+
+bool TileKey::operator<(const TileKey& k) const{
+  if(seed != k.seed)return seed < k.seed;
+  if(omega != k.omega)return omega < k.omega;
+  if(x != k.x)return x < k.x;
+  if(y != k.y)return y < k.y;
+  if(m0 != k.m0)return m0 < k.m0;
+  return m1 < k.m1;
+} //operator<
+
+/// Allocate a tile.
+/// \param key Which tile.
+/// \param n Width and height.
+
+CTile::CTile(const TileKey& key, const int n): m_sKey(key), m_cCell(n){
+} //constructor
+
+/// Get the number of bytes that the tile takes up in memory, which is what the
+/// cache budget counts.
+/// \return Size of the tile in bytes.
+
+size_t CTile::GetBytes(){
+  return (size_t)m_cCell.GetSize()*m_cCell.GetStride()*sizeof(float) + sizeof(CTile);
+} //GetBytes
+
+/// Start the worker threads.
+/// \param n Width and height of tiles, a power of 2.
+/// \param workers Number of worker threads, 0 for one per hardware thread.
+/// \param budget Maximum number of bytes of tiles to keep in the cache.
+
+CTileServer::CTileServer(const int n, const int workers, const size_t budget):
+  m_nTileSize(n), m_nCacheBudget(budget), m_bStop(false)
+{
+  memset(&m_sStats, 0, sizeof(m_sStats));
+
+  int nWorkers = workers > 0? workers: (int)std::thread::hardware_concurrency();
+  if(nWorkers < 1)nWorkers = 1;
+
+  for(int i=0; i<nWorkers; i++)
+    m_vWorkers.push_back(std::thread(&CTileServer::WorkerThread, this));
+} //constructor
+
+/// Stop the worker threads after they have generated the tiles that have
+/// already been asked for.
+
+CTileServer::~CTileServer(){
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_bStop = true;
+  }
+  m_cvWork.notify_all();
+
+  for(int i=0; i<(int)m_vWorkers.size(); i++)
+    m_vWorkers[i].join();
+} //destructor
+
+/// Ask for a tile. It comes from the cache if it is there, or else from the
+/// tile that is already being generated if somebody else asked for it first,
+/// or else it is queued for the worker threads.
+/// \param key Which tile.
+/// \return A future for the tile.
+
+TileFuture CTileServer::RequestTile(const TileKey& key){
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_sStats.nRequests++;
+
+  //cache hit
+  std::map<TileKey, CacheEntry>::iterator i = m_mapCache.find(key);
+  if(i != m_mapCache.end()){
+    m_sStats.nHits++;
+    m_listLRU.splice(m_listLRU.begin(), m_listLRU, i->second.iLRU); //most recently used
+    std::promise<TilePtr> promise;
+    promise.set_value(i->second.pTile);
+    return promise.get_future().share();
+  } //if
+
+  //already being generated
+  std::map<TileKey, TileFuture>::iterator j = m_mapInFlight.find(key);
+  if(j != m_mapInFlight.end()){
+    m_sStats.nJoined++;
+    return j->second;
+  } //if
+
+  //queue it for the workers
+  Job job;
+  job.sKey = key;
+  job.pPromise = std::make_shared<std::promise<TilePtr>>();
+  TileFuture future = job.pPromise->get_future().share();
+  m_mapInFlight[key] = future;
+  m_dqJobs.push_back(job);
+
+  lock.unlock();
+  m_cvWork.notify_one();
+  return future;
+} //RequestTile
+
+/// Ask for a tile and wait until it is ready.
+/// \param key Which tile.
+/// \return Pointer to the tile.
+
+TilePtr CTileServer::GetTile(const TileKey& key){
+  return RequestTile(key).get();
+} //GetTile
+
+/// Worker thread. Take jobs from the queue and generate them until told to
+/// stop. The generator is kept from one tile to the next unless the seed or
+/// omega changes, since there is no need to reallocate its tables.
+
+void CTileServer::WorkerThread(){
+  CTerrainGenerator* generator = NULL;
+
+  for(;;){
+    Job job;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      while(m_dqJobs.empty() && !m_bStop)
+        m_cvWork.wait(lock);
+      if(m_dqJobs.empty())break; //stopping and nothing left to do
+      job = m_dqJobs.front();
+      m_dqJobs.pop_front();
+    }
+
+    TilePtr tile;
+    try{
+      tile = Generate(job.sKey, generator);
+    } //try
+    catch(...){
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_mapInFlight.erase(job.sKey);
+      lock.unlock();
+      job.pPromise->set_exception(std::current_exception());
+      continue;
+    } //catch
+
+    Insert(job.sKey, tile);
+    job.pPromise->set_value(tile);
+  } //for
+
+  delete generator;
+} //WorkerThread
+
+/// Generate a tile in the calling thread. Tile (x, y) is generated the same way
+/// as the generator program generates it, scaled to the range -1 to 1.
+/// \param key Which tile.
+/// \param generator The calling thread's generator, which is replaced if it has the wrong seed or omega.
+/// \return Pointer to the tile.
+
+TilePtr CTileServer::Generate(const TileKey& key, CTerrainGenerator*& generator){
+  if(generator == NULL || generator->getSeed() != key.seed || generator->getOmega() != key.omega){
+    delete generator;
+    generator = NULL;
+    generator = new CTerrainGenerator(m_nTileSize, key.seed, key.omega);
+    generator->setThreads(1); //parallelism comes from the workers
+  } //if
+
+  //adjust for tile size of smallest octave
+  int x = key.x, y = key.y;
+  for(int i=1; i<key.m0; i++){
+    x *= 2; y *= 2;
+  } //for
+
+  TilePtr tile = std::make_shared<CTile>(key, m_nTileSize);
+  const float scale = generator->generate(y, x, key.m0, key.m1, tile->m_cCell);
+
+  for(int i=0; i<m_nTileSize; i++){
+    float* row = tile->m_cCell.GetRow(i);
+    for(int j=0; j<m_nTileSize; j++)
+      row[j] *= scale;
+  } //for
+
+  return tile;
+} //Generate
+
+/// Put a newly generated tile in the cache, dropping least recently used tiles
+/// to keep within the budget, and take it off the list of tiles being generated.
+/// A tile bigger than the whole budget isn't cached.
+/// \param key Which tile.
+/// \param tile Pointer to the tile.
+
+void CTileServer::Insert(const TileKey& key, TilePtr tile){
+  const size_t bytes = tile->GetBytes();
+
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_mapInFlight.erase(key);
+  m_sStats.nGenerated++;
+
+  if(bytes > m_nCacheBudget)return;
+
+  while(!m_listLRU.empty() && m_sStats.nCachedBytes + bytes > m_nCacheBudget){
+    std::map<TileKey, CacheEntry>::iterator i = m_mapCache.find(m_listLRU.back());
+    m_sStats.nCachedBytes -= i->second.pTile->GetBytes();
+    m_mapCache.erase(i);
+    m_listLRU.pop_back();
+    m_sStats.nEvicted++;
+  } //while
+
+  m_listLRU.push_front(key);
+  CacheEntry& entry = m_mapCache[key];
+  entry.pTile = tile;
+  entry.iLRU = m_listLRU.begin();
+  m_sStats.nCachedBytes += bytes;
+} //Insert
+
+/// Get the statistics.
+/// \return Numbers of requests, cache hits, and so forth so far.
+
+TileServerStats CTileServer::GetStats(){
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_sStats.nCachedTiles = m_mapCache.size();
+  return m_sStats;
+} //GetStats
+
+/// Reader function for the tile size.
+/// \return Width and height of tiles.
+
+int CTileServer::GetTileSize(){
+  return m_nTileSize;
+} //GetTileSize
@@ -0,0 +1,129 @@
+/// \file TileServer.h
+/// \brief Header for the terrain tile server CTileServer.
+///
+/// The amortized noise terrain is infinite, and programs such as game servers
+/// want tiles of it from all over the place, often the same ones over and
+/// over again. The tile server generates tiles on a pool of worker threads
+/// and keeps the most recently used ones in a cache limited to a number of
+/// bytes. A tile that is asked for while it is already being generated is
+/// not generated a second time; everyone who asked for it gets the same one.
+
+// Copyright Ian Parberry, May 2014.
+//
+// This file is made available under the GNU All-Permissive License.
+//
+// Copying and distribution of this file, with or without modification,
+// are permitted in any medium without royalty provided the copyright
+// notice and this notice are preserved.  This file is offered as-is,
+// without any warranty.
+
+#pragma once
+
+#include <map>
+#include <list>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+#include "NoiseCell.h"
+
+class CTerrainGenerator;
+
+/// \brief Tile key.
+///
+/// Everything that determines the contents of a tile. Tile (x, y) is in
+/// column x and row y of the infinite grid of tiles, and covers octaves
+/// m0 through m1 of the noise, as in the generator program.
+
+struct TileKey{
+  unsigned int seed; ///< Hash seed.
+  float omega; ///< Tail multiplier.
+  int x; ///< Tile column index.
+  int y; ///< Tile row index.
+  int m0; ///< Largest octave.
+  int m1; ///< Smallest octave.
+
+  bool operator<(const TileKey& k) const; ///< Ordering for maps.
+}; //TileKey
+
+/// \brief Terrain tile.
+///
+/// A generated tile of noise, in the range -1 to 1. Tiles are shared between
+/// the cache and everyone who asked for them, and must not be changed.
+
+class CTile{
+  public:
+    TileKey m_sKey; ///< Which tile.
+    CNoiseCell m_cCell; ///< Noise, scaled to the range -1 to 1.
+
+    CTile(const TileKey& key, const int n); ///< Constructor.
+    size_t GetBytes(); ///< Get the size of the tile in memory.
+}; //CTile
+
+typedef std::shared_ptr<CTile> TilePtr; ///< Shared pointer to a tile.
+typedef std::shared_future<TilePtr> TileFuture; ///< A tile that may not have been generated yet.
+
+/// \brief Tile server statistics.
+
+struct TileServerStats{
+  long long nRequests; ///< Number of tiles asked for.
+  long long nHits; ///< Number found in the cache.
+  long long nJoined; ///< Number that were already being generated.
+  long long nGenerated; ///< Number generated.
+  long long nEvicted; ///< Number dropped from the cache.
+  size_t nCachedTiles; ///< Number of tiles in the cache.
+  size_t nCachedBytes; ///< Number of bytes of tiles in the cache.
+}; //TileServerStats
+
+/// \brief Terrain tile server.
+///
+/// Hands out tiles of amortized noise terrain. RequestTile() returns at once
+/// with a future for the tile, and GetTile() waits for it. Each worker thread
+/// has its own generator, which it keeps for as long as the seed and omega
+/// stay the same.
+
+class CTileServer{
+  private:
+    /// \brief Cache entry.
+    struct CacheEntry{
+      TilePtr pTile; ///< The tile.
+      std::list<TileKey>::iterator iLRU; ///< Where it is in the LRU list.
+    }; //CacheEntry
+
+    /// \brief Tile waiting to be generated.
+    struct Job{
+      TileKey sKey; ///< Which tile.
+      std::shared_ptr<std::promise<TilePtr>> pPromise; ///< Where to put it.
+    }; //Job
+
+    int m_nTileSize; ///< Width and height of tiles.
+    size_t m_nCacheBudget; ///< Maximum number of bytes of tiles in the cache.
+
+    std::mutex m_mutex; ///< Protects everything below.
+    std::condition_variable m_cvWork; ///< Signalled when there is a job or it is time to stop.
+    std::map<TileKey, CacheEntry> m_mapCache; ///< Finished tiles.
+    std::list<TileKey> m_listLRU; ///< Cached tiles, most recently used first.
+    std::map<TileKey, TileFuture> m_mapInFlight; ///< Tiles that are waiting or being generated.
+    std::deque<Job> m_dqJobs; ///< Tiles waiting to be generated.
+    TileServerStats m_sStats; ///< Statistics.
+    bool m_bStop; ///< Whether the workers should stop.
+
+    std::vector<std::thread> m_vWorkers; ///< Worker threads.
+
+    void WorkerThread(); ///< Generate tiles until told to stop.
+    TilePtr Generate(const TileKey& key, CTerrainGenerator*& generator); ///< Generate a tile.
+    void Insert(const TileKey& key, TilePtr tile); ///< Put a tile in the cache.
+
+  public:
+    CTileServer(const int n, const int workers, const size_t budget); ///< Constructor.
+    ~CTileServer(); ///< Destructor.
+
+    TileFuture RequestTile(const TileKey& key); ///< Ask for a tile.
+    TilePtr GetTile(const TileKey& key); ///< Ask for a tile and wait for it.
+    TileServerStats GetStats(); ///< Get statistics.
+    int GetTileSize(); ///< Get the width and height of tiles.
+}; //CTileServer
@@ -0,0 +1,282 @@
+/// \file TileServerMain.cpp
+/// \brief Main for the terrain tile server.
+///
+/// The tile server is a long-running program that generates tiles of the
+/// infinite amortized noise terrain on request, so that a program that needs
+/// lots of tiles doesn't have to run the generator once per tile. It reads
+/// requests from standard input one per line, and answers each of them
+/// on standard output in the order that they were made:
+///
+///   tile seed omega x y m0 m1 [name]
+///     Save tile (x, y), in column x and row y, with hash seed seed, tail
+///     multiplier omega, and octaves m0 through m1, to a file called name
+///     with an extension that depends on the format, by default
+///     tile_seed_x_y. Tile (7777, 9999) with octaves 5 through 12 and tile
+///     size 4096 is the same as the generator program's output. The answer is
+///     "done filename seconds" or "failed filename".
+///
+///   stats
+///     Print the number of requests, cache hits, and so forth right away.
+///
+///   quit
+///     Stop after answering the outstanding requests, as does the end of input.
+///
+/// Tiles are generated by a pool of worker threads while earlier ones are
+/// being saved, and the most recently used tiles are kept in memory so that
+/// asking for one again doesn't generate it again. The command line options
+/// are -size N for the tile size, a power of 2, default 1024, -workers N for
+/// the number of worker threads, default one per hardware thread, -cache MB
+/// for the size of the tile cache, default 1024, -altitude meters for the
+/// elevation cap, default 5000, and -format as in the generator program,
+/// default float32.
+
+// Copyright Ian Parberry, May 2014.
+//
+// This file is made available under the GNU All-Permissive License.
+//
+// Copying and distribution of this file, with or without modification,
+// are permitted in any medium without royalty provided the copyright
+// notice and this notice are preserved.  This file is offered as-is,
+// without any warranty.
+
+#include <stdlib.h> //for atoi()
+#include <stdio.h> //for printf()
+#include <string.h> //for strcmp()
+
+#include <string>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+#include "defines.h" //OS porting defines
+
+#include "TileServer.h"
+#include "DEMWriter.h"
+
+/// \brief Request waiting to be answered.
+
+struct Request{
+  TileFuture future; ///< The tile.
+  std::string strName; ///< Base name of the output file.
+  int nStartTime; ///< When the request was made.
+}; //Request
+
+int g_nTileSize = 1024; ///< Width and height of tiles.
+int g_nNumWorkers = 0; ///< Number of worker threads, 0 for one per hardware thread.
+int g_nCacheSize = 1024; ///< Size of the tile cache in MB.
+float g_fAltitude = 5000.0f; ///< Elevation cap in meters.
+DEMFormat g_eFormat = DEMFORMAT_FLOAT32; ///< Output file format.
+
+std::deque<Request> g_dqRequests; ///< Requests waiting to be answered, oldest first.
+bool g_bDone = false; ///< Whether there will be no more requests.
+std::mutex g_mutex; ///< Protects the request queue and standard output.
+std::condition_variable g_cvRequest; ///< Signalled when there is a request or no more requests.
+
+/// \brief Get time.
+///
+/// Get the current time in milliseconds.
+/// \return Time in ms.
+
+int GetTime(){
+  #if defined(_MSC_VER) //Windows Visual Studio
+    return timeGetTime();
+  #else //other OS
+    struct timeval t;
+    gettimeofday(&t, NULL);
+    return t.tv_sec*1000 + t.tv_usec/1000;
+  #endif
+} //GetTime
+
+/// \brief Queue a request.
+///
+/// Put a request on the queue for the writer thread to answer.
+/// \param future The tile, or a null tile for a request that failed.
+/// \param name Base name of the output file.
+
+void QueueRequest(const TileFuture& future, const char* name){
+  Request request;
+  request.future = future;
+  request.strName = name;
+  request.nStartTime = GetTime();
+
+  std::unique_lock<std::mutex> lock(g_mutex);
+  g_dqRequests.push_back(request);
+  lock.unlock();
+  g_cvRequest.notify_one();
+} //QueueRequest
+
+/// \brief Queue a failed request.
+///
+/// Put a request that can't be done on the queue, so that it is answered
+/// in the right order.
+/// \param name What to say failed.
+
+void QueueFailure(const char* name){
+  std::promise<TilePtr> promise;
+  promise.set_value(TilePtr());
+  QueueRequest(promise.get_future().share(), name);
+} //QueueFailure
+
+/// \brief Check omega.
+///
+/// Check that a tail multiplier is a number from 0 to 1. NaN has to be
+/// turned away, since it would break the ordering of tile keys in the cache,
+/// and comparisons can't be trusted to catch it under -ffast-math, so the
+/// bits are checked the way FormatHeight does.
+/// \param omega Tail multiplier.
+/// \return true if it is a number from 0 to 1.
+
+bool IsOmega(const float omega){
+  unsigned int bits; //bits of omega
+  memcpy(&bits, &omega, sizeof(bits));
+  if(((bits >> 23) & 0xFF) == 0xFF)return false; //infinite or not a number
+  return omega >= 0.0f && omega <= 1.0f;
+} //IsOmega
+
+/// \brief Save a tile.
+///
+/// Save a tile as a DEM file, converting noise to height the same way as the
+/// generator program does.
+/// \param tile The tile.
+/// \param basefilename Name of DEM file for output, without extension.
+/// \param filename Buffer for at least 256 characters for the full file name.
+/// \return true if it succeeds, false if it fails.
+
+bool SaveTile(CTile& tile, const char* basefilename, char* filename){
+  CNoiseCell& cell = tile.m_cCell;
+  const int n = cell.GetSize();
+
+  CDEMWriter output;
+  if(!output.Open(basefilename, g_eFormat, n, n, 5.0)){
+    sprintf(filename, "%.250s", basefilename);
+    return false;
+  } //if
+  strcpy(filename, output.GetFileName());
+
+  float* row = new float [n]; //one row of heights
+  for(int i=0; i<n; i++){
+    const float* noise = cell.GetRow(i);
+    for(int j=0; j<n; j++)
+      row[j] = g_fAltitude * (1.0f + noise[j])/2.0f;
+    output.WriteRow(row);
+  } //for
+  delete [] row;
+
+  return output.Close();
+} //SaveTile
+
+/// \brief Writer thread.
+///
+/// Wait for each request's tile in turn, save it, and answer the request.
+
+void WriterThread(){
+  for(;;){
+    Request request;
+    {
+      std::unique_lock<std::mutex> lock(g_mutex);
+      while(g_dqRequests.empty() && !g_bDone)
+        g_cvRequest.wait(lock);
+      if(g_dqRequests.empty())break; //done
+      request = g_dqRequests.front();
+      g_dqRequests.pop_front();
+    }
+
+    char filename[256];
+    bool bOK = false;
+    try{
+      TilePtr tile = request.future.get();
+      if(tile)bOK = SaveTile(*tile, request.strName.c_str(), filename);
+      else sprintf(filename, "%.250s", request.strName.c_str());
+    } //try
+    catch(...){
+      sprintf(filename, "%.250s", request.strName.c_str());
+    } //catch
+
+    std::unique_lock<std::mutex> lock(g_mutex);
+    if(bOK)printf("done %s %0.3f\n", filename, (GetTime() - request.nStartTime)/1000.0f);
+    else printf("failed %s\n", filename);
+    fflush(stdout);
+  } //for
+} //WriterThread
+
+/// \brief Print statistics.
+/// \param server The tile server.
+
+void PrintStats(CTileServer& server){
+  const TileServerStats stats = server.GetStats();
+  std::unique_lock<std::mutex> lock(g_mutex);
+  printf("stats requests %lld hits %lld joined %lld generated %lld evicted %lld cached %d %0.1fMB\n",
+    stats.nRequests, stats.nHits, stats.nJoined, stats.nGenerated, stats.nEvicted,
+    (int)stats.nCachedTiles, stats.nCachedBytes/(1024.0f*1024.0f));
+  fflush(stdout);
+} //PrintStats
+
+/// \brief Main.
+///
+/// Parse the command line, start the tile server and writer thread, and
+/// read requests until there are no more.
+/// \param argc Argument count
+/// \param argv Arguments.
+/// \return 0 for success, 1 for failure.
+
+int main(int argc, char *argv[]){
+  //parse command line
+  for(int i=1; i<argc; i++)
+    if(!strcmp(argv[i], "-size") && i+1 < argc)
+      g_nTileSize = atoi(argv[++i]);
+    else if(!strcmp(argv[i], "-workers") && i+1 < argc)
+      g_nNumWorkers = atoi(argv[++i]);
+    else if(!strcmp(argv[i], "-cache") && i+1 < argc)
+      g_nCacheSize = atoi(argv[++i]);
+    else if(!strcmp(argv[i], "-altitude") && i+1 < argc)
+      g_fAltitude = (float)atof(argv[++i]);
+    else if(!strcmp(argv[i], "-format") && i+1 < argc){
+      if(!ParseDEMFormat(argv[++i], g_eFormat))
+        fprintf(stderr, "Ignoring unknown format %s\n", argv[i]);
+    } //else if
+    else fprintf(stderr, "Ignoring unknown option %s\n", argv[i]);
+
+  if(g_nTileSize < 2 || (g_nTileSize & (g_nTileSize - 1))){
+    fprintf(stderr, "Tile size must be a power of 2\n");
+    return 1;
+  } //if
+
+  CTileServer server(g_nTileSize, g_nNumWorkers, (size_t)g_nCacheSize << 20);
+  std::thread writer(WriterThread);
+
+  char line[1024];
+  while(fgets(line, sizeof(line), stdin)){
+    char command[32] = "";
+    if(sscanf(line, "%31s", command) != 1)continue; //blank line
+
+    if(!strcmp(command, "tile")){
+      TileKey key;
+      char name[256] = "";
+      if(sscanf(line, "%*s %u %f %d %d %d %d %255s",
+        &key.seed, &key.omega, &key.x, &key.y, &key.m0, &key.m1, name) < 6 ||
+        key.m0 < 1 || key.m1 < key.m0 || !IsOmega(key.omega))
+        QueueFailure("bad-request");
+
+      else{
+        if(name[0] == '\0')
+          sprintf(name, "tile_%u_%d_%d", key.seed, key.x, key.y);
+        QueueRequest(server.RequestTile(key), name);
+      } //else
+    } //if
+
+    else if(!strcmp(command, "stats"))PrintStats(server);
+    else if(!strcmp(command, "quit"))break;
+
+    else QueueFailure(command);
+  } //while
+
+  {
+    std::unique_lock<std::mutex> lock(g_mutex);
+    g_bDone = true;
+  }
+  g_cvRequest.notify_all();
+  writer.join();
+
+  return 0;
+} //main
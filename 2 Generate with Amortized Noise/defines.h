@@ -24,6 +24,7 @@
 #else//other OS
 
   #include <time.h>
+  #include <sys/time.h>
   #define MAX_PATH 256 ///< Maximum length of a path in Windows.
 
 #endif
@@ -26,6 +26,53 @@
 /// as any), the tail multiplier omega (a number between 0 and 1, try 0.3 
 /// if your imagination fails you), and an elevation cap in meters (somewhat 
 /// tenuously related to the maximum height of the terrain, try 4000).
+///
+/// The command line option -format followed by one of asc, uint16, float32,
+/// packed, or compressed selects the output file format. The default is asc,
+/// an ASCII DEM file output.asc. The others are much faster to write: raw
+/// 16-bit or float heights in output.img with an ENVI header output.hdr, or
+/// the tiled packed DEM file format output.bin from Pack, with or without
+/// compressed tiles.
+///
+/// The subcells of each octave are generated by several threads, one per
+/// hardware thread by default. The command line option -threads N sets the
+/// number of threads, and -threads 1 generates everything in the main thread.
+/// The noise is the same however many threads there are. The option -kernel
+/// followed by one of scalar, sse2, avx, or neon chooses the instructions
+/// used to compute each row of noise, which also doesn't change the noise.
+/// The option -selftest checks every kernel that the processor supports
+/// against the scalar one, bit for bit, and exits without generating anything.
+/// The option -gradient table picks gradient directions from a table of
+/// unit vectors instead of taking the cosine and sine of a hash, which is
+/// faster but gives different terrain from the paper. The default is
+/// -gradient trig. Similarly, -exphash fast computes gradient magnitudes
+/// without calling log, and the default is -exphash exact. The option
+/// -engine fixed generates the cell with a version of the generator that is
+/// compiled for this program's cell size and octaves, which is faster and
+/// gives exactly the same terrain as the default, -engine generic.
+///
+/// The option -mosaic W H generates a W by H rectangle of terrain instead
+/// of a single cell, starting at the top left corner of the usual cell and
+/// made of as many cells as it takes. Only two cells are ever in memory,
+/// one being generated while the other is written, so the rectangle can be
+/// as big as the disk allows. It is saved in the packed DEM file format,
+/// compressed if -format compressed is given.
+///
+/// The option -batch followed by the name of a manifest runs the jobs in it
+/// instead of prompting for anything. A manifest is a text file with one
+/// job per line, made of the seed, omega, elevation cap, the row and column
+/// of the cell at the top left corner, the width and height, the number of
+/// octaves, and the name of the output file without extension, which must
+/// be different for each job, separated by commas, for example
+/// 9999, 0.3, 4000, 9999, 7777, 4096, 4096, 8, output
+/// for what the program makes by default. Jobs the size of a cell are saved
+/// in the format given by -format, and others as mosaics. The jobs are run at
+/// the same time by a pool of workers, one per hardware thread unless
+/// -jobs N says otherwise, each using one thread unless -threads N is given.
+/// A worker keeps its generator, fixed engine, and noise cells from one job
+/// to the next, and makes a new generator and engine only when the seed or
+/// omega changes. The time
+/// and throughput of each job are printed as it finishes.
 
 // Copyright Ian Parberry, May 2014.
 //
@@ -36,22 +83,85 @@
 // without any warranty.
 //
 // Created by Ian Parberry, May 2014.
-// Last updated May 30, 2014.
+// Last updated May 31, 2014.
 
 #include "defines.h" //OS porting defines
 
 #include <stdlib.h> //for rand()
 #include <stdio.h> //for printf()
+#include <string.h> //for strcmp()
 
 #include "TerrainGenerator.h"
 #include "CPUtime.h"
+#include "DEMWriter.h"
+#include "NoiseKernel.h"
+#include "NoiseCell.h"
+#include "Mosaic.h"
+#include "FixedAmortizedNoise2D.h"
+#include "Batch.h"
+
+#include <thread> //for std::thread::hardware_concurrency
 
 CTerrainGenerator* g_pTerrainGenerator = NULL; ///< Pointer to the terrain generator. 
+DEMFormat g_eFormat = DEMFORMAT_ASC; ///< Output file format.
+CNoiseCellPool g_cCellPool; ///< Pool of noise cells.
+int g_nNumThreads = 0; ///< Number of threads, 0 for one per hardware thread.
+GradientMode g_eGradientMode = GRADIENT_TRIG; ///< How gradient directions are computed.
+bool g_bFastExpHash = false; ///< Whether to compute gradient magnitudes with ExpHashFast.
+bool g_bFixedEngine = false; ///< Whether to generate with CFixedAmortizedNoise2D.
+int g_nMosaicWidth = 0; ///< Width of mosaic, 0 for a single cell.
+int g_nMosaicHeight = 0; ///< Height of mosaic.
+const char* g_szManifest = NULL; ///< Name of the batch manifest, NULL for none.
+int g_nNumWorkers = 0; ///< Number of batch workers, 0 for one per hardware thread.
+bool g_bSelfTest = false; ///< Whether to check the noise kernels instead of generating.
+
+const int CELLSIZE = 4096; ///< Width and height of a cell.
+const int LARGESTOCTAVE = 5; ///< Largest octave of batch jobs.
+const int SMALLESTOCTAVE = 13; ///< Smallest octave that a cell can have, one point per subcell.
+
+/// \brief Get time.
+/// 
+/// Get the current time in milliseconds.
+/// \return Time in ms.
+
+int GetTime(){
+  #if defined(_MSC_VER) //Windows Visual Studio 
+    return timeGetTime();
+  #else //other OS
+    struct timeval t;
+    gettimeofday(&t, NULL);
+    return t.tv_sec*1000 + t.tv_usec/1000;
+  #endif
+} //GetTime
+
+/// \brief Write a cell of terrain elevations.
+///
+/// Convert a cell of noise to heights and write it a row at a time to
+/// an open DEM writer.
+/// \param output DEM writer.
+/// \param cell Pointer to 2D array of elevations.
+/// \param n Width and height of array.
+/// \param scale Scale value to normalize amortized noise.
+/// \param altitude Multiplier to convert noise to height.
+/// \param bProgress Whether to print a dot every 100 rows.
+
+void WriteHeights(CDEMWriter& output, float** cell, const int n, const float scale,
+                  const float altitude, const bool bProgress){
+  float* row = new float [n]; //one row of heights
+  for(int i=0; i<n; i++){
+    for(int j=0; j<n; j++)
+      row[j] = altitude * (1.0f + cell[i][j] * scale)/2.0f;
+    output.WriteRow(row);
+    if(bProgress && i%100 == 0)printf(".");
+  } //for
+  delete [] row;
+} //WriteHeights
 
 /// \brief Save a cell of terrain elevations.
 ///
 /// Save a cell of noise as a DEM file. The output file
-/// will have a ".asc" file expension, which is standard for DEM files.
+/// will have a ".asc" file expension, which is standard for DEM files,
+/// unless g_eFormat says otherwise.
 /// \param cell Pointer to 2D array of elevations.
 /// \param n Width and height of array.
 /// \param scale Scale value to normalize amortized noise.
@@ -60,57 +170,168 @@ CTerrainGenerator* g_pTerrainGenerator = NULL; ///< Pointer to the terrain gener
 
 void SaveDEMFile(float** cell, const int n, const float scale, 
                  const float altitude, const char* basefilename){
-  char filename[MAX_PATH];
-  sprintf(filename, "%s.asc", basefilename); 
-  printf("Saving to %dx%d DEM file %s\n", n, n, filename);
-
-  FILE* output = fopen(filename, "wt");
-
-  if(output){
-    fprintf(output, "nrows %d\n", n);
-    fprintf(output, "ncols %d\n", n);
-    fprintf(output, "xllcenter %0.6f\n", 0.0f);
-    fprintf(output, "yllcenter %0.6f\n", 0.0f);
-    fprintf(output, "cellsize 5.000000\n");
-    fprintf(output, "NODATA_value  -9999\n");
-
-    for(int i=0; i<n; i++){
-      for(int j=0; j<n; j++)
-        fprintf(output, "%0.2f ", altitude * (1.0f + cell[i][j] * scale)/2.0f);
-      fprintf(output, "\n");
-      if(i%100 == 0)printf(".");
-    } //for
+  CDEMWriter output;
+
+  if(output.Open(basefilename, g_eFormat, n, n, 5.0)){
+    printf("Saving to %dx%d DEM file %s\n", n, n, output.GetFileName());
+    int t = CPUTimeInMilliseconds();
+
+    WriteHeights(output, cell, n, scale, altitude, true);
     printf("\n");
 
-    fclose(output);
+    t = CPUTimeInMilliseconds() - t;
+    if(output.Close())
+      printf("Saved %lld bytes in %0.2f seconds CPU time.\n", output.GetBytesWritten(), t/1000.0f);
+    else printf("Save failed.\n");
   } //if
+  else printf("Save failed.\n");
 } //SaveDEMFile
 
+/// \brief Fixed engine.
+///
+/// The instance of CFixedAmortizedNoise2D that stands in for an infinite
+/// amortized noise generator, with the same seed, omega, and settings, which
+/// gives the same noise. It is made the first time that it is needed and then
+/// kept, with its spline tables and worker threads, until it is asked to
+/// stand in for a generator with a different seed or omega.
+
+class CFixedEngine{
+  private:
+    typedef CFixedAmortizedNoise2D<4096, 5, 12, ExpMagnitude> CExactEngine; ///< Engine using ExpHash.
+    typedef CFixedAmortizedNoise2D<4096, 5, 12, ExpFastMagnitude> CFastEngine; ///< Engine using ExpHashFast.
+
+    CExactEngine* m_pExact; ///< Engine using ExpHash, NULL if none.
+    CFastEngine* m_pFast; ///< Engine using ExpHashFast, NULL if none.
+    unsigned int m_nSeed; ///< Hash seed of the engines.
+    float m_fOmega; ///< Omega of the engines.
+
+    template<class ENGINE> float GenerateWith(ENGINE*& engine, CTerrainGenerator* generator,
+      CNoiseCell& cell, const int x, const int y, const int threads); ///< Generate with one of the engines.
+
+  public:
+    CFixedEngine(); ///< Constructor.
+    ~CFixedEngine(); ///< Destructor.
+    float Generate(CTerrainGenerator* generator, CNoiseCell& cell,
+      const int x, const int y, const int threads); ///< Generate a cell.
+}; //CFixedEngine
+
+CFixedEngine::CFixedEngine(): m_pExact(NULL), m_pFast(NULL), m_nSeed(0), m_fOmega(0.0f){
+} //constructor
+
+CFixedEngine::~CFixedEngine(){
+  delete m_pExact;
+  delete m_pFast;
+} //destructor
+
+/// Generate a cell of noise with one of the engines, making it first if need be.
+/// \param engine The engine, NULL if it hasn't been made yet.
+/// \param generator Infinite amortized noise generator that it stands in for.
+/// \param cell Noise cell in which to store the noise.
+/// \param x Tile column index.
+/// \param y Tile row index.
+/// \param threads Number of threads, 0 for one per hardware thread.
+/// \return Multiply noise by this to get into the range -1..1
+
+template<class ENGINE> float CFixedEngine::GenerateWith(ENGINE*& engine, CTerrainGenerator* generator,
+  CNoiseCell& cell, const int x, const int y, const int threads)
+{
+  if(engine == NULL){
+    engine = new ENGINE(generator->getSeed(), generator->getOmega());
+    engine->setGradientMode(g_eGradientMode);
+  } //if
+
+  engine->setThreads(threads); //does nothing unless the number changes
+  return engine->generate(y, x, cell);
+} //GenerateWith
+
+/// Generate a cell of 2D amortized noise the same as an infinite amortized
+/// noise generator would, keeping the engine for the next cell.
+/// \param generator Infinite amortized noise generator.
+/// \param cell Noise cell in which to store the noise.
+/// \param x Tile column index.
+/// \param y Tile row index.
+/// \param threads Number of threads, 0 for one per hardware thread.
+/// \return Multiply noise by this to get into the range -1..1
+
+float CFixedEngine::Generate(CTerrainGenerator* generator, CNoiseCell& cell,
+  const int x, const int y, const int threads)
+{
+  if(m_nSeed != generator->getSeed() || m_fOmega != generator->getOmega()){
+    delete m_pExact; m_pExact = NULL;
+    delete m_pFast; m_pFast = NULL;
+    m_nSeed = generator->getSeed();
+    m_fOmega = generator->getOmega();
+  } //if
+
+  if(g_bFastExpHash)return GenerateWith(m_pFast, generator, cell, x, y, threads);
+  else return GenerateWith(m_pExact, generator, cell, x, y, threads);
+} //Generate
+
+/// \brief Whether to use the fixed engine.
+///
+/// The fixed engine is used if it has been asked for and is compiled for
+/// the cell size and octaves.
+/// \param n Cell size.
+/// \param m0 Largest octave.
+/// \param m1 Smallest octave.
+/// \return true if the fixed engine is to be used.
+
+bool UseFixedEngine(const int n, const int m0, const int m1){
+  return g_bFixedEngine && n == 4096 && m0 == 5 && m1 == 12;
+} //UseFixedEngine
+
+/// \brief Generate a cell of amortized noise quietly.
+///
+/// Generate a cell of 2D amortized noise using an infinite amortized noise
+/// generator, or the fixed engine if UseFixedEngine says so.
+/// \param generator Infinite amortized noise generator.
+/// \param engine Fixed engine, kept from one call to the next.
+/// \param cell Noise cell in which to store the noise.
+/// \param x Tile column index.
+/// \param y Tile row index.
+/// \param m0 Largest octave.
+/// \param m1 Smallest octave.
+/// \param threads Number of threads for the fixed engine, 0 for one per hardware thread.
+/// \return Multiply noise by this to get into the range -1..1
+
+float GenerateCell(CTerrainGenerator* generator, CFixedEngine& engine, CNoiseCell& cell,
+                   const int x, const int y, const int m0, const int m1, const int threads)
+{
+  if(!UseFixedEngine(cell.GetSize(), m0, m1))
+    return generator->generate(y, x, m0, m1, cell);
+  else return engine.Generate(generator, cell, x, y, threads);
+} //GenerateCell
+
 /// \brief Generate a cell of amortized noise.
 ///
-/// Generate a cell of 2D amortized noise using the infinite amortized noise generator.
-/// \param cell Pointer to array in which to store the noise.
+/// Generate a cell of 2D amortized noise using the infinite amortized noise generator,
+/// or the fixed engine if it has been asked for and is compiled for this cell size and octaves.
+/// \param cell Noise cell in which to store the noise.
 /// \param x Tile column index.
 /// \param y Tile row index.
 /// \param m0 Largest octave.
 /// \param m1 Smallest octave.
-/// \param n Cell size.
 
-float Generate2DNoise(float** cell, const int x, const int y, const int m0, const int m1, const int n){ 
-  printf("Generating %d octaves of 2D noise.\n", m1 - m0 + 1);
+float Generate2DNoise(CNoiseCell& cell, const int x, const int y, const int m0, const int m1){ 
+  const int n = cell.GetSize();
+  printf("Generating %d octaves of 2D noise using the %s kernel%s.\n", m1 - m0 + 1,
+    GetNoiseKernelName(), UseFixedEngine(n, m0, m1)? " and the fixed engine": "");
   int t = CPUTimeInMilliseconds();
-  float scale = g_pTerrainGenerator->generate(y, x, m0, m1, n, cell);
+  int nStartTime = GetTime();
+  CFixedEngine engine; //fixed engine for this cell only
+  const float scale = GenerateCell(g_pTerrainGenerator, engine, cell, x, y, m0, m1, g_nNumThreads);
   t = CPUTimeInMilliseconds() - t;
-  printf("Generated %d points in %0.2f seconds CPU time.\n", n*n, t/1000.0f);
+  printf("Generated %d points in %0.2f seconds (%0.2f seconds CPU time).\n",
+    n*n, (GetTime() - nStartTime)/1000.0f, t/1000.0f);
   return scale;
 } //Generate2DNoise
 
 /// \brief Generate and save a cell of amortized noise.
 ///
 /// Generate a cell of amortized noise and save it as a DEM file. This function
-/// allocates memory for the cell, creates an infinite amortized noise generator,
-/// uses it to generate the noise, saves it as a DEM file,
-/// deallocates the generator and cell memory and returns.
+/// gets a cell from the cell pool, uses the infinite amortized noise generator
+/// to generate the noise, saves it as a DEM file,
+/// gives the cell back to the pool and returns.
 /// \param nRow Tile row index.
 /// \param nCol Tile column index.
 /// \param m0 Largest octave.
@@ -126,28 +347,212 @@ void GenerateAndSave2DNoise(int nRow, int nCol, const int m0, const int m1,
     nCol *= 2; nRow *= 2;
   } //for
 
-  //allocate space to store noise cells
-  float** cell = new float* [n];
-  for(int i=0; i<n; i++)
-    cell[i] = new float [n]; 
+  //get a noise cell from the pool
+  CNoiseCell* cell = g_cCellPool.Acquire(n);
 
   //generate and save noise
-  float scale = Generate2DNoise(cell, nCol, nRow, m0, m1, n);
-  SaveDEMFile(cell, n, scale, altitude, "output");
+  float scale = Generate2DNoise(*cell, nCol, nRow, m0, m1);
+  SaveDEMFile(cell->GetRows(), n, scale, altitude, "output");
 
-  //deallocate noise cell space
-  for(int i=0; i<n; i++)
-    delete [] cell[i];
-  delete [] cell;
+  //give the noise cell back for reuse
+  g_cCellPool.Release(cell);
 
 } //GenerateAndSave2DNoise
 
+/// \brief Generate and save a mosaic of amortized noise.
+///
+/// Generate a rectangle of amortized noise made of cells and save it as a
+/// packed DEM file, starting at the top left corner of the given cell.
+/// \param nRow Tile row index.
+/// \param nCol Tile column index.
+/// \param m0 Largest octave.
+/// \param m1 Smallest octave.
+/// \param altitude Multiplier to convert noise to height.
+/// \param n Cell size.
+
+void GenerateAndSaveMosaic(const int nRow, const int nCol, const int m0, const int m1,
+                           const float altitude, const int n){
+  DEMFormat format = g_eFormat;
+  if(format != DEMFORMAT_PACKED && format != DEMFORMAT_COMPRESSED){
+    printf("Mosaics are saved in packed format\n");
+    format = DEMFORMAT_PACKED;
+  } //if
+
+  printf("Generating %d octaves of 2D noise using the %s kernel.\n", m1 - m0 + 1, GetNoiseKernelName());
+  MosaicStats stats;
+
+  if(GenerateMosaic(g_pTerrainGenerator, g_cCellPool, "output", format, nRow, nCol,
+    g_nMosaicWidth, g_nMosaicHeight, m0, m1, n, altitude, 5.0, stats, true))
+  {
+    printf("Saved %d cells in %d tiles, %lld bytes in %0.2f seconds.\n",
+      stats.nCells, stats.nTiles, stats.nBytes, stats.fElapsed);
+    printf("Generating %0.2f seconds, waiting %0.2f seconds.\n", stats.fGenerate, stats.fGeneratorWait);
+    printf("Writing %0.2f seconds, waiting %0.2f seconds.\n", stats.fWrite, stats.fWriterWait);
+  } //if
+  else printf("Save failed.\n");
+} //GenerateAndSaveMosaic
+
+/// \brief Amortized noise batch worker.
+///
+/// Runs batch jobs, keeping the terrain generator and the fixed engine from
+/// one job for the next if it has the same seed and omega, and keeping the
+/// noise cells. A job the
+/// size of a cell is saved in the format given by g_eFormat, and any other size
+/// as a mosaic in the packed DEM file format. The mu column of the manifest is
+/// omega, and the octaves start at LARGESTOCTAVE.
+
+class CAmortizedBatchWorker: public CBatchWorker{
+  private:
+    CTerrainGenerator* m_pGenerator; ///< Terrain generator from the last job, NULL if none.
+    CNoiseCellPool m_cCellPool; ///< Pool of noise cells.
+    CFixedEngine m_cFixedEngine; ///< Fixed engine, kept along with the generator.
+    int m_nNumThreads; ///< Number of threads for each job.
+
+  public:
+    CAmortizedBatchWorker(const int threads); ///< Constructor.
+    ~CAmortizedBatchWorker(); ///< Destructor.
+    bool Run(BatchJob& job); ///< Run a job.
+}; //CAmortizedBatchWorker
+
+/// \param threads Number of threads for each job.
+
+CAmortizedBatchWorker::CAmortizedBatchWorker(const int threads):
+  m_pGenerator(NULL), m_nNumThreads(threads){
+} //constructor
+
+CAmortizedBatchWorker::~CAmortizedBatchWorker(){
+  delete m_pGenerator;
+} //destructor
+
+/// Generate and save the terrain for a batch job.
+/// \param job The job.
+/// \return true if it was saved.
+
+bool CAmortizedBatchWorker::Run(BatchJob& job){
+  const int m0 = LARGESTOCTAVE;
+  const int m1 = m0 + job.nOctaves - 1;
+
+  //get a generator with the right seed and omega
+  if(m_pGenerator != NULL && (m_pGenerator->getSeed() != job.nSeed ||
+    m_pGenerator->getOmega() != job.fParam))
+  {
+    delete m_pGenerator;
+    m_pGenerator = NULL;
+  } //if
+
+  job.bReused = m_pGenerator != NULL;
+
+  if(m_pGenerator == NULL){
+    m_pGenerator = new CTerrainGenerator(CELLSIZE, job.nSeed, job.fParam);
+    m_pGenerator->setThreads(m_nNumThreads);
+    m_pGenerator->setGradientMode(g_eGradientMode);
+    m_pGenerator->setFastExpHash(g_bFastExpHash);
+  } //if
+
+  //a mosaic if it isn't the size of a cell
+  if(job.nWidth != CELLSIZE || job.nHeight != CELLSIZE){
+    const DEMFormat format = g_eFormat == DEMFORMAT_COMPRESSED? DEMFORMAT_COMPRESSED: DEMFORMAT_PACKED;
+    MosaicStats stats;
+    const bool bOK = GenerateMosaic(m_pGenerator, m_cCellPool, job.strOutput.c_str(), format,
+      job.nRow, job.nCol, job.nWidth, job.nHeight, m0, m1, CELLSIZE, job.fAltitude, 5.0, stats, false);
+    job.nBytes = stats.nBytes;
+    return bOK;
+  } //if
+
+  //adjust for tile size of smallest octave
+  int nRow = job.nRow, nCol = job.nCol;
+  for(int i=1; i<m0; i++){ 
+    nCol *= 2; nRow *= 2;
+  } //for
+
+  CDEMWriter output;
+  if(!output.Open(job.strOutput.c_str(), g_eFormat, CELLSIZE, CELLSIZE, 5.0))
+    return false;
+
+  CNoiseCell* cell = m_cCellPool.Acquire(CELLSIZE);
+  const float scale = GenerateCell(m_pGenerator, m_cFixedEngine, *cell, nCol, nRow, m0, m1, m_nNumThreads);
+  WriteHeights(output, cell->GetRows(), CELLSIZE, scale, job.fAltitude, false);
+  m_cCellPool.Release(cell);
+
+  const bool bOK = output.Close();
+  job.nBytes = output.GetBytesWritten();
+  return bOK;
+} //Run
+
+/// \brief Run a batch.
+///
+/// Read the jobs in the manifest g_szManifest, check them, and run them
+/// with a pool of g_nNumWorkers workers. Each job is generated with
+/// g_nNumThreads threads, one if it hasn't been set, since the workers
+/// already keep the processor busy.
+/// \return true if every job succeeded.
+
+bool RunAmortizedBatch(){
+  std::vector<BatchJob> manifest;
+  int nRejected = 0; //number of lines of the manifest that aren't jobs
+  if(!ReadBatchManifest(g_szManifest, manifest, nRejected)){
+    printf("Cannot open manifest %s\n", g_szManifest);
+    return false;
+  } //if
+
+  //check the jobs
+  std::vector<BatchJob> jobs;
+  bool bMosaic = false; //whether there are mosaics
+
+  for(int i=0; i<(int)manifest.size(); i++){
+    const BatchJob& job = manifest[i];
+    if(!(job.fParam >= 0.0f && job.fParam <= 1.0f))
+      printf("Ignoring job on line %d, omega must be between 0 and 1\n", job.nLine);
+    else if(!(job.fAltitude > 0.0f))
+      printf("Ignoring job on line %d, elevation cap must be greater than 0\n", job.nLine);
+    else if(job.nOctaves < 1 || LARGESTOCTAVE + job.nOctaves - 1 > SMALLESTOCTAVE)
+      printf("Ignoring job on line %d, number of octaves must be between 1 and %d\n",
+        job.nLine, SMALLESTOCTAVE - LARGESTOCTAVE + 1);
+    else if(job.nWidth <= 0 || job.nHeight <= 0)
+      printf("Ignoring job on line %d, bad size %dx%d\n", job.nLine, job.nWidth, job.nHeight);
+    else{
+      jobs.push_back(job);
+      bMosaic = bMosaic || job.nWidth != CELLSIZE || job.nHeight != CELLSIZE;
+    } //else
+  } //for
+
+  if(bMosaic && g_eFormat != DEMFORMAT_PACKED && g_eFormat != DEMFORMAT_COMPRESSED)
+    printf("Mosaics are saved in packed format\n");
+
+  //make the workers
+  int workers = g_nNumWorkers > 0? g_nNumWorkers: (int)std::thread::hardware_concurrency();
+  if(workers > (int)jobs.size())workers = (int)jobs.size();
+  if(workers < 1)workers = 1;
+  const int threads = g_nNumThreads > 0? g_nNumThreads: 1;
+
+  printf("Running %d jobs from %s with %d workers of %d threads using the %s kernel.\n",
+    (int)jobs.size(), g_szManifest, workers, threads, GetNoiseKernelName());
+
+  std::vector<CBatchWorker*> worker;
+  for(int k=0; k<workers; k++)
+    worker.push_back(new CAmortizedBatchWorker(threads));
+
+  bool bOK = RunBatch(jobs, worker);
+
+  nRejected += (int)(manifest.size() - jobs.size());
+  if(nRejected > 0){
+    printf("Rejected %d line%s of %s\n", nRejected, nRejected > 1? "s": "", g_szManifest);
+    bOK = false;
+  } //if
+
+  for(int k=0; k<workers; k++)
+    delete worker[k];
+
+  return bOK;
+} //RunAmortizedBatch
+
 /// \brief Main.
 ///
 /// Prompts the user for a random number seed, a tail multiplier and
 /// an altitude cap and then generates and saves a 4096x4096 cell of terrain 
 /// elevations generated using 8 octaves of amortized noise with an 
-/// exponentially distributed gradient magnitude.
+/// exponentially distributed gradient magnitude, or runs the batch of jobs
+/// in a manifest without prompting if -batch is given.
 /// \param argc Argument count
 /// \param argv Arguments.
 /// \return 0 for success, 1 for failure.
@@ -156,6 +561,58 @@ int main(int argc, char *argv[]){
   printf("Amortized Noise Terrain Generator, Ian Parberry, 2014\n");
   printf("--------------------------------------------------------------\n\n");
 
+  //parse command line
+  for(int i=1; i<argc; i++)
+    if(!strcmp(argv[i], "-format") && i+1 < argc){
+      if(!ParseDEMFormat(argv[++i], g_eFormat))
+        printf("Ignoring unknown format %s\n", argv[i]);
+    } //if
+    else if(!strcmp(argv[i], "-threads") && i+1 < argc)
+      g_nNumThreads = atoi(argv[++i]);
+    else if(!strcmp(argv[i], "-kernel") && i+1 < argc){
+      NoiseKernel kernel;
+      if(!ParseNoiseKernel(argv[++i], kernel))
+        printf("Ignoring unknown kernel %s\n", argv[i]);
+      else if(!SelectNoiseKernel(kernel))
+        printf("Kernel %s is not supported on this processor\n", argv[i]);
+    } //else if
+    else if(!strcmp(argv[i], "-selftest"))
+      g_bSelfTest = true;
+    else if(!strcmp(argv[i], "-gradient") && i+1 < argc){
+      if(!strcmp(argv[++i], "trig"))g_eGradientMode = GRADIENT_TRIG;
+      else if(!strcmp(argv[i], "table"))g_eGradientMode = GRADIENT_TABLE;
+      else printf("Ignoring unknown gradient mode %s\n", argv[i]);
+    } //else if
+    else if(!strcmp(argv[i], "-exphash") && i+1 < argc){
+      if(!strcmp(argv[++i], "exact"))g_bFastExpHash = false;
+      else if(!strcmp(argv[i], "fast"))g_bFastExpHash = true;
+      else printf("Ignoring unknown exponential hash %s\n", argv[i]);
+    } //else if
+    else if(!strcmp(argv[i], "-engine") && i+1 < argc){
+      if(!strcmp(argv[++i], "generic"))g_bFixedEngine = false;
+      else if(!strcmp(argv[i], "fixed"))g_bFixedEngine = true;
+      else printf("Ignoring unknown engine %s\n", argv[i]);
+    } //else if
+    else if(!strcmp(argv[i], "-mosaic") && i+2 < argc){
+      g_nMosaicWidth = atoi(argv[++i]);
+      g_nMosaicHeight = atoi(argv[++i]);
+      if(g_nMosaicWidth <= 0 || g_nMosaicHeight <= 0){
+        printf("Ignoring bad mosaic size %dx%d\n", g_nMosaicWidth, g_nMosaicHeight);
+        g_nMosaicWidth = g_nMosaicHeight = 0;
+      } //if
+    } //else if
+    else if(!strcmp(argv[i], "-batch") && i+1 < argc)
+      g_szManifest = argv[++i];
+    else if(!strcmp(argv[i], "-jobs") && i+1 < argc)
+      g_nNumWorkers = atoi(argv[++i]);
+    else printf("Ignoring unknown option %s\n", argv[i]);
+
+  if(g_bSelfTest)
+    return CheckNoiseKernels()? 0: 1;
+
+  if(g_szManifest != NULL)
+    return RunAmortizedBatch()? 0: 1;
+
   unsigned int seed = 1;
   printf("Hash seed:\n> "); scanf("%d", &seed);
 
@@ -179,9 +636,13 @@ int main(int argc, char *argv[]){
       printf("  Elevation cap must be greater than 0.\n");
   }while(altitude <= 0.0f); 
 
-  const int cellsize = 4096;
-  g_pTerrainGenerator = new CTerrainGenerator(cellsize, seed, omega);
-  GenerateAndSave2DNoise(9999, 7777, 5, 12, altitude, cellsize);
+  g_pTerrainGenerator = new CTerrainGenerator(CELLSIZE, seed, omega);
+  g_pTerrainGenerator->setThreads(g_nNumThreads);
+  g_pTerrainGenerator->setGradientMode(g_eGradientMode);
+  g_pTerrainGenerator->setFastExpHash(g_bFastExpHash);
+  if(g_nMosaicWidth > 0)
+    GenerateAndSaveMosaic(9999, 7777, LARGESTOCTAVE, 12, altitude, CELLSIZE);
+  else GenerateAndSave2DNoise(9999, 7777, LARGESTOCTAVE, 12, altitude, CELLSIZE);
   delete g_pTerrainGenerator;
 
 #if defined(_MSC_VER) //Windows Visual Studio 
@@ -0,0 +1,143 @@
+/// \file ExponentialHash.cpp
+/// \brief Code for generating an exponentially distributed hash function.
+
+// Copyright Ian Parberry, May 2014.
+//
+// This file is made available under the GNU All-Permissive License.
+// Copying and distribution of this file, with or without modification,
+// are permitted in any medium without royalty provided the copyright
+// notice and this notice are preserved.  This file is offered as-is,
+// without any warranty.
+//
+// Created by Ian Parberry, May 2014.
+// Last updated May 31, 2014.
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+#include "ExponentialHash.h"
+#include "defines.h"
+
+using namespace std;
+
+#define clip(x,a,b) min(max(x, a), b) ///< Clip x to [a,b].
+
+#define LOG2_TABLE_BITS 8 ///< Number of mantissa bits used to index the log table.
+#define LOG2_TABLE_SIZE (1 << LOG2_TABLE_BITS) ///< Number of intervals in the log table.
+
+/// \brief Table of base 2 logarithms.
+///
+/// Base 2 logarithms of LOG2_TABLE_SIZE + 1 evenly spaced points from 1 to 2,
+/// for FastLog2, and the constants that ExpHashFast needs when the largest
+/// hash value is 0xFFFFFFFF, which it almost always is. There is one global
+/// instance, which is made before main() is called so that no thread ever
+/// sees it half made.
+
+static class CLog2Table{
+  public:
+    float m_fLog2[LOG2_TABLE_SIZE + 1]; ///< Log table.
+    float m_fScale; ///< ExpHashFast scale for max = 0xFFFFFFFF.
+    float m_fRecip; ///< Reciprocal of 0xFFFFFFFF + 2 for UniformHash.
+
+    /// Fill in the table.
+    CLog2Table(){
+      for(int i=0; i<=LOG2_TABLE_SIZE; i++)
+        m_fLog2[i] = (float)(log(1.0 + (double)i/LOG2_TABLE_SIZE)/log(2.0));
+      m_fRecip = 1.0f/((float)0xFFFFFFFF + 2.0f);
+      m_fScale = 1.0f/FastLog2(0.5f*((float)0xFFFFFFFF + 2.0f));
+    } //constructor
+} g_cLog2Table; //CLog2Table
+
+/// \brief Uniform hash.
+///
+/// Hash an unsigned integer uniformly into the range (0, 1).
+/// \param x Value to be hashed.
+/// \param max Largest possible value of x.
+/// \return A uniformly distributed hash value > 0 and < 1.
+
+float UniformHash(unsigned int x, unsigned int max){
+  return ((float)x + 1.0f)/((float)max + 2.0f);
+} //UniformHash
+
+/// \brief Exponential hash.
+///
+/// Hash an unsigned integer into the range (0, 1) with an exponential distribution.
+/// \param x Value to be hashed.
+/// \param max Largest possible value of x.
+/// \return An exponentially distributed hash value > 0 and < 1.
+
+float ExpHash(unsigned int x, unsigned int max){ 
+  static const float scale = 1/log(0.5f*((float)max + 2.0f));
+  return -scale * log(0.5f*(float)x + 1.0f) + 1.0f; 
+} //ExpHash
+
+
+/// \brief Exponential hash with control of exponent and tail of distribution.
+///
+/// Hash an unsigned integer into the range (0, 1) with an exponential distribution
+/// giving some control over the base of the exponent and the height of the
+/// tail of the distribution.
+/// \param x Value to be hashed.
+/// \param y Second value to be hashed to select distribution.
+/// \param m Largest possible value of x.
+/// \param omega The tail multiplier, which controls how low the tails of the distribution can be.
+/// \return An exponentially distributed random number > 0 and < 1.
+
+float ExpHash(unsigned int x, unsigned int y, unsigned int m, float omega){  
+  omega = clip(omega, 0.0f, 1.0f); 
+  return (UniformHash(y, m) < omega)? UniformHash(x, m): ExpHash(x, m);
+} //ExpHash
+
+/// \brief Fast base 2 logarithm.
+///
+/// Approximate log2(x) by taking the exponent from the bits of x and
+/// interpolating the logarithm of the mantissa linearly between entries of
+/// a table. The error of the interpolation is at most 2.8e-6, and the result
+/// is rounded to float.
+/// \param x A normalized positive float.
+/// \return Approximately log2(x).
+
+float FastLog2(float x){
+  unsigned int bits;
+  memcpy(&bits, &x, sizeof(bits));
+
+  const int exponent = (int)(bits >> 23) - 127;
+  const unsigned int mantissa = bits & 0x7FFFFF;
+  const unsigned int i = mantissa >> (23 - LOG2_TABLE_BITS); //table index
+  const float t = (float)(mantissa & ((1 << (23 - LOG2_TABLE_BITS)) - 1))*(1.0f/(1 << (23 - LOG2_TABLE_BITS)));
+
+  const float* table = g_cLog2Table.m_fLog2;
+  return (float)exponent + (table[i] + t*(table[i + 1] - table[i]));
+} //FastLog2
+
+/// \brief Fast exponential hash.
+///
+/// The same as ExpHash(x, max), but using FastLog2 instead of log. It has the
+/// same distribution, and differs from ExpHash(x, max) by less than 1e-6 when
+/// max is 0xFFFFFFFF, in which case it needs no division either.
+/// \param x Value to be hashed.
+/// \param max Largest possible value of x.
+/// \return An exponentially distributed hash value > 0 and < 1.
+
+float ExpHashFast(unsigned int x, unsigned int max){ 
+  const float scale = max == 0xFFFFFFFF? g_cLog2Table.m_fScale: 1.0f/FastLog2(0.5f*((float)max + 2.0f));
+  return 1.0f - scale*FastLog2(0.5f*(float)x + 1.0f);
+} //ExpHashFast
+
+/// \brief Fast exponential hash with control of exponent and tail of distribution.
+///
+/// The same as ExpHash(x, y, m, omega), but multiplying by a reciprocal instead of
+/// dividing twice, and using ExpHashFast.
+/// \param x Value to be hashed.
+/// \param y Second value to be hashed to select distribution.
+/// \param m Largest possible value of x.
+/// \param omega The tail multiplier, which controls how low the tails of the distribution can be.
+/// \return An exponentially distributed random number > 0 and < 1.
+
+float ExpHashFast(unsigned int x, unsigned int y, unsigned int m, float omega){  
+  omega = clip(omega, 0.0f, 1.0f); 
+  const float r = m == 0xFFFFFFFF? g_cLog2Table.m_fRecip: 1.0f/((float)m + 2.0f); //for UniformHash
+  return ((float)y + 1.0f)*r < omega? ((float)x + 1.0f)*r: ExpHashFast(x, m);
+} //ExpHashFast
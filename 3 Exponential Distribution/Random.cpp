@@ -56,3 +56,92 @@ float ExpRand(float omega){
   omega = clip(omega, 0.0f, 1.0f); 
   return (UniformRand() < omega)? UniformRand(): ExpRand();
 } //ExpRand
+
+/// The destructor does nothing, but it has to be virtual.
+
+CRandomGenerator::~CRandomGenerator(){
+} //destructor
+
+/// Set the largest value that Next returns and the scale that ExpRand uses for it.
+/// \param max Largest value.
+
+void CRandomGenerator::SetMax(const unsigned int max){
+  m_nMax = max;
+  m_fExpScale = 1/log(0.5f*((float)max + 2.0f));
+} //SetMax
+
+/// Get the largest value that Next returns.
+/// \return Largest value.
+
+unsigned int CRandomGenerator::GetMax(){
+  return m_nMax;
+} //GetMax
+
+/// Generate a uniformly distributed pseudorandom floating point number
+/// between 0 and 1, the same way UniformRand does.
+/// \return A uniformly distributed random number > 0 and < 1.
+
+float CRandomGenerator::UniformRand(){
+  return ((float)Next() + 1)/((float)m_nMax + 2.0f);
+} //UniformRand
+
+/// Generate an exponentially distributed pseudorandom floating point number
+/// between 0 and 1, the same way ExpRand does.
+/// \return An exponentially distributed random number > 0 and < 1.
+
+float CRandomGenerator::ExpRand(){ 
+  return -m_fExpScale * log(0.5f*(float)Next() + 1.0f) + 1.0f; 
+} //ExpRand
+
+/// Generate an exponentially distributed pseudorandom floating point number
+/// between 0 and 1 with the tail of the distribution artificially lifted up,
+/// the same way ExpRand does.
+/// \param omega The tail multiplier, which controls how low the tails of the distribution can be.
+/// \return An exponentially distributed random number > 0 and < 1.
+
+float CRandomGenerator::ExpRand(float omega){  
+  omega = clip(omega, 0.0f, 1.0f); 
+  return (UniformRand() < omega)? UniformRand(): ExpRand();
+} //ExpRand
+
+/// The constructor sets the largest value to RAND_MAX.
+
+CStdlibRandom::CStdlibRandom(){
+  SetMax(RAND_MAX);
+} //constructor
+
+/// Get the next value from rand().
+/// \return A pseudorandom number from 0 to RAND_MAX.
+
+unsigned int CStdlibRandom::Next(){
+  return (unsigned int)rand();
+} //Next
+
+/// The SplitMix64 finalizer, which scrambles the bits of a 64-bit number.
+/// \param z Value to be scrambled.
+/// \return Scrambled value.
+
+static unsigned long long Mix64(unsigned long long z){
+  z = (z ^ (z >> 30))*0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27))*0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+} //Mix64
+
+const unsigned long long GOLDEN64 = 0x9E3779B97F4A7C15ULL; ///< 2^64 divided by the golden ratio.
+
+/// The constructor starts a stream.
+/// \param seed Random number seed.
+/// \param stream Stream number.
+
+CCounterRandom::CCounterRandom(const unsigned int seed, const unsigned long long stream){
+  SetMax(0xFFFFFFFF);
+  m_nState = Mix64(Mix64(seed) + stream*GOLDEN64);
+} //constructor
+
+/// Get the next value of the stream.
+/// \return A pseudorandom number from 0 to 0xFFFFFFFF.
+
+unsigned int CCounterRandom::Next(){
+  m_nState += GOLDEN64;
+  return (unsigned int)(Mix64(m_nState) >> 32);
+} //Next
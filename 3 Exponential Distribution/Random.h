@@ -17,3 +17,61 @@
 float UniformRand();
 float ExpRand(); 
 float ExpRand(float omega);
+
+/// \brief Random number generator.
+///
+/// The interface to a generator of uniformly distributed unsigned integers from
+/// 0 to some maximum, from which uniformly and exponentially distributed floats
+/// are made in exactly the same way that UniformRand and ExpRand make them from
+/// rand(). Like ExpHash, the base of the exponent depends on the maximum, so a
+/// generator with a maximum of 0xFFFFFFFF gives the same distribution as the
+/// exponential hash functions that the terrain generator uses.
+
+class CRandomGenerator{
+  protected:
+    unsigned int m_nMax; ///< Largest value that Next returns.
+    float m_fExpScale; ///< Scale used by ExpRand.
+
+    void SetMax(const unsigned int max); ///< Set the largest value.
+
+  public:
+    virtual ~CRandomGenerator(); ///< Destructor.
+
+    virtual unsigned int Next() = 0; ///< Next value.
+    unsigned int GetMax(); ///< Largest value.
+
+    float UniformRand(); ///< Uniformly distributed random number.
+    float ExpRand(); ///< Exponentially distributed random number.
+    float ExpRand(float omega); ///< Exponentially distributed random number with lifted tail.
+}; //CRandomGenerator
+
+/// \brief Random number generator using rand().
+///
+/// The generator that UniformRand and ExpRand use, seeded with srand(). It
+/// gives only RAND_MAX + 1 different values, which can be as few as 32768,
+/// and there is only one of it, so it can only be used by one thread.
+
+class CStdlibRandom: public CRandomGenerator{
+  public:
+    CStdlibRandom(); ///< Constructor.
+    unsigned int Next(); ///< Next value.
+}; //CStdlibRandom
+
+/// \brief Counter-based random number generator.
+///
+/// Value i of a stream is the top 32 bits of the SplitMix64 finalizer of a
+/// key plus i times the golden ratio, where the key is a hash of the seed and
+/// the stream number. Since value i can be computed without computing the values
+/// before it, a block of samples can be given a stream of its own and generated by
+/// any thread in any order without changing the results. Each stream starts at a
+/// pseudorandom point of the same sequence of 2^64 values, so streams of less
+/// than a few billion values each almost certainly don't overlap.
+
+class CCounterRandom: public CRandomGenerator{
+  private:
+    unsigned long long m_nState; ///< Key plus golden ratio times number of values so far.
+
+  public:
+    CCounterRandom(const unsigned int seed, const unsigned long long stream); ///< Constructor.
+    unsigned int Next(); ///< Next value.
+}; //CCounterRandom
@@ -13,6 +13,34 @@
 ///
 /// The program will prompt you for the tail multiplier omega (a number 
 /// between 0 and 1). It saves the results in a text file distribution.txt.
+///
+/// The command line option -hash also measures the distributions of the
+/// exponential hash functions that the terrain generator uses, ExpHash and
+/// ExpHashFast, on the same hash values, and appends them to distribution.txt.
+/// It reports the largest difference between the two functions and a
+/// chi-square statistic comparing their frequency distributions, which
+/// shows whether the fast one preserves the distribution.
+///
+/// By default the random numbers come from rand(), which gives the same
+/// results as it always has but is slow, can only be used by one thread, and
+/// has as few as 32768 different values. The command line option -rng counter
+/// uses a counter-based generator instead, which splits the samples into
+/// blocks that each get a stream of their own, so that they can be shared out
+/// among threads without changing the results. Its values are 32 bits,
+/// so the exponential part of ExpRand then has the same base as ExpHash has
+/// in the terrain generator. The hash functions get their inputs from the same
+/// streams. The option -threads followed by the
+/// number of threads, or 0 for one per hardware thread, sets how many threads
+/// that is, and -samples followed by a number, which may be something like 1e10,
+/// sets how many samples are taken for each distribution instead of 10 million.
+///
+/// The option -sweep followed by a first omega, a last omega, and a number of
+/// steps measures the distribution for that many evenly spaced values of omega
+/// in one pass instead of prompting for omega. Each sample takes the same three
+/// random numbers, one to choose between the uniform and exponential parts and one
+/// for each part, and adds the result to the distribution of every omega at once,
+/// so that it is as fast as measuring one of them. The distributions are
+/// saved to distribution.txt one after the other in order of increasing omega.
 
 // Copyright Ian Parberry, May 2014.
 //
@@ -27,75 +55,585 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <thread> //for std::thread
+#include <atomic> //for std::atomic
+#include <vector> //for std::vector
+#include <algorithm> //for std::upper_bound
 
 #include "Random.h"
+#include "ExponentialHash.h"
 #include "defines.h"
 
 const int GRANULARITY = 100; ///< Granularity at which to measure the distribution.
-const int REPEATS = 10000000; ///< Number of times we repeat the experiment.
+const int REPEATS = 10000000; ///< Default number of times we repeat the experiment.
+const long long BLOCKSIZE = 1 << 20; ///< Number of samples in a block with its own random number stream.
+
+/// \brief Frequency distribution.
+///
+/// A frequency distribution measured by an experiment, together with the
+/// interesting things reported about it.
+
+struct Distribution{
+  long long nCount[GRANULARITY]; ///< Experimental frequency distribution.
+  long long nMissedSmall; ///< How many experiments were too small (should be 0).
+  long long nMissedLarge; ///< How many experiments were too large (should be 0).
+  float fMin; ///< Smallest value found (ideally close to 0).
+  float fMax;  ///< Largest value found (ideally close to 1).
+}; //Distribution
+
+/// \brief Omega sweep counts.
+///
+/// The counts for an omega sweep. For each sample, p is the number of omegas
+/// no larger than the random number that chooses between the uniform and
+/// exponential parts, so the omegas from p on take the uniform part and the
+/// ones before p take the exponential part. Rather than adding to the count of
+/// one bin for every omega, we add to the differences between the counts of
+/// consecutive omegas, which can be summed at the end. Bin 0 is for samples
+/// that are too small and bin GRANULARITY + 1 for samples that are too large.
+
+struct SweepCounts{
+  std::vector<long long> nDiff; ///< Count differences, omegas + 1 of them for each of GRANULARITY + 2 bins.
+  std::vector<float> fMinUniform; ///< Smallest uniform part of samples for each p.
+  std::vector<float> fMaxUniform; ///< Largest uniform part of samples for each p.
+  std::vector<float> fMinExp; ///< Smallest exponential part of samples for each p.
+  std::vector<float> fMaxExp; ///< Largest exponential part of samples for each p.
+}; //SweepCounts
+
+long long g_nNumSamples = REPEATS; ///< Number of times we repeat the experiment.
+unsigned int g_nSeed = 1; ///< Random number seed.
+bool g_bCounterRandom = false; ///< Whether to use the counter-based generator instead of rand().
+int g_nNumThreads = 1; ///< Number of worker threads.
+std::atomic<long long> g_nNextBlock; ///< Next block of samples to be claimed by a worker thread.
+std::vector<float> g_vOmega; ///< Tail multipliers for an omega sweep, in increasing order.
+
+typedef float (*Sampler)(CRandomGenerator& rng, float omega); ///< Function that returns a random sample.
+typedef void (*SweepSampler)(CRandomGenerator& rng, float& u, float& v, float& e); ///< Function that returns the parts of a random sample.
+
+/// \brief Scramble an unsigned int.
+///
+/// Scramble the bits of an unsigned int using the MurmurHash3 finalizer,
+/// which gives the hash functions uniformly distributed inputs like the
+/// corner hashes in the terrain generator.
+/// \param x Value to be scrambled.
+/// \return Scrambled value.
+
+unsigned int Scramble(unsigned int x){
+  x ^= x >> 16; x *= 0x85ebca6b;
+  x ^= x >> 13; x *= 0xc2b2ae35;
+  x ^= x >> 16;
+  return x;
+} //Scramble
+
+/// \brief Scrambled counter generator.
+///
+/// The generator that the hash functions get their inputs from when the
+/// counter-based generator isn't being used. Value i is Scramble(i).
+
+class CScrambleRandom: public CRandomGenerator{
+  private:
+    unsigned int m_nCount; ///< Number of values so far.
+
+  public:
+    /// The constructor starts from 0.
+    CScrambleRandom(): m_nCount(0){
+      SetMax(0xFFFFFFFF);
+    } //constructor
+
+    /// Get the next value.
+    /// \return Scramble of the number of values so far.
+    unsigned int Next(){
+      return Scramble(m_nCount++);
+    } //Next
+}; //CScrambleRandom
+
+/// \brief Sample ExpRand.
+/// \param rng Random number generator.
+/// \param omega The tail multiplier.
+/// \return Exponentially distributed random number with lifted tail.
+
+float ExpRandSample(CRandomGenerator& rng, float omega){
+  return rng.ExpRand(omega);
+} //ExpRandSample
+
+/// \brief Sample ExpHash.
+/// \param rng Random number generator, whose largest value must be 0xFFFFFFFF.
+/// \param omega The tail multiplier.
+/// \return ExpHash of the next pair of random values.
+
+float ExpHashSample(CRandomGenerator& rng, float omega){
+  const unsigned int x = rng.Next();
+  const unsigned int y = rng.Next();
+  return ExpHash(x, y, 0xFFFFFFFF, omega);
+} //ExpHashSample
+
+/// \brief Sample ExpHashFast.
+/// \param rng Random number generator, whose largest value must be 0xFFFFFFFF.
+/// \param omega The tail multiplier.
+/// \return ExpHashFast of the next pair of random values.
+
+float ExpHashFastSample(CRandomGenerator& rng, float omega){
+  const unsigned int x = rng.Next();
+  const unsigned int y = rng.Next();
+  return ExpHashFast(x, y, 0xFFFFFFFF, omega);
+} //ExpHashFastSample
+
+/// \brief Sample the parts of ExpRand.
+///
+/// Get the three random numbers that ExpRand(omega) chooses between, so that
+/// ExpRand(omega) would be v if u < omega and e otherwise.
+/// \param rng Random number generator.
+/// \param u Uniform random number that chooses the part.
+/// \param v Uniform part.
+/// \param e Exponential part.
+
+void ExpRandSweep(CRandomGenerator& rng, float& u, float& v, float& e){
+  u = rng.UniformRand();
+  v = rng.UniformRand();
+  e = rng.ExpRand();
+} //ExpRandSweep
+
+/// \brief Sample the parts of ExpHash.
+///
+/// Get the three numbers that ExpHash(x, y, 0xFFFFFFFF, omega) chooses between
+/// for the next pair of random values, so that it would be v if u < omega and
+/// e otherwise.
+/// \param rng Random number generator, whose largest value must be 0xFFFFFFFF.
+/// \param u Uniform hash that chooses the part.
+/// \param v Uniform part.
+/// \param e Exponential part.
 
-int g_nDistribution[GRANULARITY]; ///< Experimental frequency distribution.
-int g_nMissedSmall; ///< How many experiments were too small (should be 0).
-int g_nMissedLarge; ///< How many experiments were too large (should be 0).
-float g_fMin; ///< Smallest value found (ideally close to 0).
-float g_fMax;  ///< Largest value found (ideally close to 1).
+void ExpHashSweep(CRandomGenerator& rng, float& u, float& v, float& e){
+  const unsigned int x = rng.Next();
+  const unsigned int y = rng.Next();
+  u = UniformHash(y, 0xFFFFFFFF);
+  v = UniformHash(x, 0xFFFFFFFF);
+  e = ExpHash(x, 0xFFFFFFFF);
+} //ExpHashSweep
 
-/// \brief Reset the measured distribution.
+/// \brief Sample the parts of ExpHashFast.
+///
+/// The same as ExpHashSweep, but for ExpHashFast, which multiplies by a
+/// reciprocal instead of calling UniformHash.
+/// \param rng Random number generator, whose largest value must be 0xFFFFFFFF.
+/// \param u Uniform hash that chooses the part.
+/// \param v Uniform part.
+/// \param e Exponential part.
+
+void ExpHashFastSweep(CRandomGenerator& rng, float& u, float& v, float& e){
+  static const float r = 1.0f/((float)0xFFFFFFFF + 2.0f);
+  const unsigned int x = rng.Next();
+  const unsigned int y = rng.Next();
+  u = ((float)y + 1.0f)*r;
+  v = ((float)x + 1.0f)*r;
+  e = ExpHashFast(x, 0xFFFFFFFF);
+} //ExpHashFastSweep
+
+/// \brief Reset a measured distribution.
 /// 
 /// Reset all the statistics to zero. Call this before you start measuring.
+/// \param d Distribution to be reset.
 
-void ResetDistribution(){
-  g_fMax = -999999.0f; g_fMin = 999999.0f;
-  g_nMissedSmall = g_nMissedLarge = 0;
+void ResetDistribution(Distribution& d){
+  d.fMax = -999999.0f; d.fMin = 999999.0f;
+  d.nMissedSmall = d.nMissedLarge = 0;
   for(int j=0; j<GRANULARITY; j++)
-    g_nDistribution[j] = 0;
+    d.nCount[j] = 0;
 } //ResetDistribution
 
+/// \brief Add a sample to a distribution.
+/// \param d Distribution to be added to.
+/// \param fSample Random sample.
+
+inline void AddSample(Distribution& d, float fSample){
+  d.fMin = min(d.fMin, fSample); d.fMax = max(d.fMax, fSample);
+  int sample = (int)(fSample*(GRANULARITY-1)); //discrete sample
+  if(sample < 0)d.nMissedSmall++; //too small (should never happen)
+  else if(sample >= GRANULARITY)d.nMissedLarge++; //too large (should never happen)
+  else d.nCount[sample]++; //just right
+} //AddSample
+
+/// \brief Merge distributions.
+/// \param dest Distribution to merge into.
+/// \param src Distribution to be merged.
+
+void MergeDistribution(Distribution& dest, const Distribution& src){
+  dest.fMin = min(dest.fMin, src.fMin); dest.fMax = max(dest.fMax, src.fMax);
+  dest.nMissedSmall += src.nMissedSmall;
+  dest.nMissedLarge += src.nMissedLarge;
+  for(int j=0; j<GRANULARITY; j++)
+    dest.nCount[j] += src.nCount[j];
+} //MergeDistribution
+
+/// \brief Experiment thread.
+///
+/// Claim blocks of samples until there are none left and add them to a
+/// distribution. Each block gets a random number stream of its own, so
+/// the result doesn't depend on which thread claims which block.
+/// \param omega The tail multiplier.
+/// \param sample Function that returns a random sample.
+/// \param d Distribution for this thread, which must have been reset.
+
+void ExperimentThread(float omega, Sampler sample, Distribution* d){
+  const long long nNumBlocks = (g_nNumSamples + BLOCKSIZE - 1)/BLOCKSIZE; //number of blocks
+
+  for(long long b=g_nNextBlock++; b<nNumBlocks; b=g_nNextBlock++){ //for each block claimed
+    CCounterRandom rng(g_nSeed, b);
+    const long long n = min(BLOCKSIZE, g_nNumSamples - b*BLOCKSIZE); //samples in block
+    for(long long i=0; i<n; i++)
+      AddSample(*d, sample(rng, omega));
+  } //for
+} //ExperimentThread
+
 /// \brief Run an experiment.
 ///
-/// Run an experiment to measure the frequency distribution.
+/// Run an experiment to measure the frequency distribution. If the
+/// counter-based generator isn't being used, the samples are taken one
+/// after the other from a generator given by the caller. Otherwise they are
+/// shared out among g_nNumThreads threads.
 /// \param omega The tail multiplier, which controls how low the tails of the distribution can be.
-/// \param n Number of times to repeat the experiment.
-
-void RunExperiment(float omega, int n){
-  ResetDistribution();
-  for(int i=0; i<n; i++){ //run the experiment n times
-    float fSample = ExpRand(omega); //random sample
-    g_fMin = min(g_fMin, fSample); g_fMax = max(g_fMax, fSample);
-    int sample = (int)(fSample*(GRANULARITY-1)); //discrete sample
-    if(sample < 0)g_nMissedSmall++; //too small (should never happen)
-    else if(sample >= GRANULARITY)g_nMissedLarge++; //too large (should never happen)
-    else g_nDistribution[sample]++; //just right
-  } //for
+/// \param sample Function that returns a random sample.
+/// \param rng Random number generator to use if the counter-based one isn't being used.
+/// \param d Distribution to put the result into.
+
+void RunExperiment(float omega, Sampler sample, CRandomGenerator& rng, Distribution& d){
+  ResetDistribution(d);
+
+  if(!g_bCounterRandom){ //one after the other
+    for(long long i=0; i<g_nNumSamples; i++) //run the experiment n times
+      AddSample(d, sample(rng, omega));
+    return;
+  } //if
+
+  std::vector<Distribution> dist(g_nNumThreads); //one per thread
+  for(int t=0; t<g_nNumThreads; t++)
+    ResetDistribution(dist[t]);
+  g_nNextBlock = 0;
+
+  if(g_nNumThreads == 1) //do it in this thread
+    ExperimentThread(omega, sample, &dist[0]);
+  else{ //start threads and wait for them to finish
+    std::vector<std::thread> thread;
+    for(int t=0; t<g_nNumThreads; t++)
+      thread.push_back(std::thread(ExperimentThread, omega, sample, &dist[t]));
+    for(int t=0; t<g_nNumThreads; t++)
+      thread[t].join();
+  } //else
+
+  for(int t=0; t<g_nNumThreads; t++)
+    MergeDistribution(d, dist[t]);
 } //RunExperiment
 
+/// \brief Reset omega sweep counts.
+/// \param s Sweep counts to be reset for the omegas in g_vOmega.
+
+void ResetSweep(SweepCounts& s){
+  const int m = (int)g_vOmega.size(); //number of omegas
+  s.nDiff.assign((GRANULARITY + 2)*(m + 1), 0);
+  s.fMinUniform.assign(m + 1, 999999.0f);
+  s.fMaxUniform.assign(m + 1, -999999.0f);
+  s.fMinExp.assign(m + 1, 999999.0f);
+  s.fMaxExp.assign(m + 1, -999999.0f);
+} //ResetSweep
+
+/// \brief Get the sweep bin of a sample.
+/// \param fSample Random sample.
+/// \return 0 if too small, GRANULARITY + 1 if too large, otherwise 1 more than its bin.
+
+inline int SweepBin(float fSample){
+  const int sample = (int)(fSample*(GRANULARITY-1)); //discrete sample
+  return sample < 0? 0: sample >= GRANULARITY? GRANULARITY + 1: sample + 1;
+} //SweepBin
+
+/// \brief Add the parts of a sample to omega sweep counts.
+/// \param s Sweep counts to be added to.
+/// \param u Uniform random number that chooses the part.
+/// \param v Uniform part.
+/// \param e Exponential part.
+
+inline void AddSweepSample(SweepCounts& s, float u, float v, float e){
+  const int m = (int)g_vOmega.size(); //number of omegas
+  const int p = (int)(std::upper_bound(g_vOmega.begin(), g_vOmega.end(), u) - g_vOmega.begin()); //omegas <= u
+
+  long long* diff = &s.nDiff[0];
+  const int be = SweepBin(e)*(m + 1); //start of exponential part's bin
+  diff[be]++; diff[be + p]--; //omegas before p
+  diff[SweepBin(v)*(m + 1) + p]++; //omegas from p on
+
+  s.fMinUniform[p] = min(s.fMinUniform[p], v); s.fMaxUniform[p] = max(s.fMaxUniform[p], v);
+  s.fMinExp[p] = min(s.fMinExp[p], e); s.fMaxExp[p] = max(s.fMaxExp[p], e);
+} //AddSweepSample
+
+/// \brief Merge omega sweep counts.
+/// \param dest Sweep counts to merge into.
+/// \param src Sweep counts to be merged.
+
+void MergeSweep(SweepCounts& dest, const SweepCounts& src){
+  for(size_t i=0; i<dest.nDiff.size(); i++)
+    dest.nDiff[i] += src.nDiff[i];
+
+  for(size_t p=0; p<dest.fMinUniform.size(); p++){
+    dest.fMinUniform[p] = min(dest.fMinUniform[p], src.fMinUniform[p]);
+    dest.fMaxUniform[p] = max(dest.fMaxUniform[p], src.fMaxUniform[p]);
+    dest.fMinExp[p] = min(dest.fMinExp[p], src.fMinExp[p]);
+    dest.fMaxExp[p] = max(dest.fMaxExp[p], src.fMaxExp[p]);
+  } //for
+} //MergeSweep
+
+/// \brief Get the distributions from omega sweep counts.
+///
+/// Sum the count differences to get the distribution for each omega. The
+/// samples for omega i took the uniform part if their p was at most i and the
+/// exponential part otherwise, which gives the smallest and largest values.
+/// \param s Sweep counts.
+/// \param d Distributions to put the result into, one for each omega.
+
+void GetSweepDistributions(const SweepCounts& s, std::vector<Distribution>& d){
+  const int m = (int)g_vOmega.size(); //number of omegas
+  d.resize(m);
+
+  //smallest and largest exponential parts for p after each omega
+  std::vector<float> fMinExp(m + 1, 999999.0f), fMaxExp(m + 1, -999999.0f);
+  for(int p=m-1; p>=0; p--){
+    fMinExp[p] = min(fMinExp[p + 1], s.fMinExp[p + 1]);
+    fMaxExp[p] = max(fMaxExp[p + 1], s.fMaxExp[p + 1]);
+  } //for
+
+  long long count[GRANULARITY + 2] = {0}; //count in each bin for current omega
+  float fMinUniform = 999999.0f, fMaxUniform = -999999.0f; //for p up to current omega
+
+  for(int i=0; i<m; i++){ //for each omega
+    for(int b=0; b<GRANULARITY + 2; b++)
+      count[b] += s.nDiff[b*(m + 1) + i];
+    fMinUniform = min(fMinUniform, s.fMinUniform[i]);
+    fMaxUniform = max(fMaxUniform, s.fMaxUniform[i]);
+
+    d[i].nMissedSmall = count[0];
+    d[i].nMissedLarge = count[GRANULARITY + 1];
+    for(int j=0; j<GRANULARITY; j++)
+      d[i].nCount[j] = count[j + 1];
+    d[i].fMin = min(fMinUniform, fMinExp[i]);
+    d[i].fMax = max(fMaxUniform, fMaxExp[i]);
+  } //for each omega
+} //GetSweepDistributions
+
+/// \brief Omega sweep thread.
+///
+/// The same as ExperimentThread, but for an omega sweep.
+/// \param sample Function that returns the parts of a random sample.
+/// \param s Sweep counts for this thread, which must have been reset.
+
+void SweepThread(SweepSampler sample, SweepCounts* s){
+  const long long nNumBlocks = (g_nNumSamples + BLOCKSIZE - 1)/BLOCKSIZE; //number of blocks
+  float u, v, e; //parts of sample
+
+  for(long long b=g_nNextBlock++; b<nNumBlocks; b=g_nNextBlock++){ //for each block claimed
+    CCounterRandom rng(g_nSeed, b);
+    const long long n = min(BLOCKSIZE, g_nNumSamples - b*BLOCKSIZE); //samples in block
+    for(long long i=0; i<n; i++){
+      sample(rng, u, v, e);
+      AddSweepSample(*s, u, v, e);
+    } //for
+  } //for
+} //SweepThread
+
+/// \brief Run an omega sweep.
+///
+/// Run an experiment to measure the frequency distributions for all of the
+/// omegas in g_vOmega at once, in the same way as RunExperiment.
+/// \param sample Function that returns the parts of a random sample.
+/// \param rng Random number generator to use if the counter-based one isn't being used.
+/// \param d Distributions to put the result into, one for each omega.
+
+void RunSweep(SweepSampler sample, CRandomGenerator& rng, std::vector<Distribution>& d){
+  std::vector<SweepCounts> counts(g_bCounterRandom? g_nNumThreads: 1); //one per thread
+  for(size_t t=0; t<counts.size(); t++)
+    ResetSweep(counts[t]);
+
+  if(!g_bCounterRandom){ //one after the other
+    float u, v, e; //parts of sample
+    for(long long i=0; i<g_nNumSamples; i++){
+      sample(rng, u, v, e);
+      AddSweepSample(counts[0], u, v, e);
+    } //for
+  } //if
+
+  else{
+    g_nNextBlock = 0;
+    if(g_nNumThreads == 1) //do it in this thread
+      SweepThread(sample, &counts[0]);
+    else{ //start threads and wait for them to finish
+      std::vector<std::thread> thread;
+      for(int t=0; t<g_nNumThreads; t++)
+        thread.push_back(std::thread(SweepThread, sample, &counts[t]));
+      for(int t=0; t<g_nNumThreads; t++)
+        thread[t].join();
+    } //else
+
+    for(int t=1; t<g_nNumThreads; t++)
+      MergeSweep(counts[0], counts[t]);
+  } //else
+
+  GetSweepDistributions(counts[0], d);
+} //RunSweep
+
 /// \brief Save.
 ///
-/// Save the frequency distribution.
+/// Save a frequency distribution.
 /// \param filehandle File handle opened for writing.
+/// \param d Distribution.
 
-void SaveDistribution(FILE* filehandle){
+void SaveDistribution(FILE* filehandle, const Distribution& d){
   if(filehandle){     
     for(int i=0; i<GRANULARITY; i++)
-      fprintf(filehandle, "%0.4f\n", (float)g_nDistribution[i]/REPEATS);
+      fprintf(filehandle, "%0.4f\n", (float)((double)d.nCount[i]/g_nNumSamples));
     fprintf(filehandle, "\n");
   } //if
 } //SaveDistribution
 
-/// \brief Check the frequency distribution and report to console.
+/// \brief Check a frequency distribution and report to console.
 /// 
-/// Check the frequency distribution and report interesting things to console.
+/// Check a frequency distribution and report interesting things to console.
+/// \param d Distribution.
 
-void CheckDistribution(){
-  if(g_nMissedSmall + g_nMissedLarge > 0)
-    printf("Missed %d small, %d large\n", g_nMissedSmall, g_nMissedLarge);
-  printf("%d experiments, Min = %0.4f, Max = %0.4f\n", REPEATS, g_fMin, g_fMax);
-  int sum = 0;
+void CheckDistribution(const Distribution& d){
+  if(d.nMissedSmall + d.nMissedLarge > 0)
+    printf("Missed %lld small, %lld large\n", d.nMissedSmall, d.nMissedLarge);
+  printf("%lld experiments, Min = %0.4f, Max = %0.4f\n", g_nNumSamples, d.fMin, d.fMax);
+  long long sum = 0;
   for(int i=0; i<GRANULARITY; i++)
-    sum += g_nDistribution[i];
-  printf("%d successes out of %d\n", sum, REPEATS);
+    sum += d.nCount[i];
+  printf("%lld successes out of %lld\n", sum, g_nNumSamples);
 } //CheckDistribution
 
+/// \brief Report the largest difference between ExpHash and ExpHashFast.
+///
+/// Report the largest difference between ExpHash and ExpHashFast on the
+/// same hash values, at most REPEATS of them.
+/// \param omega The tail multiplier.
+/// \param rng Random number generator, whose largest value must be 0xFFFFFFFF.
+
+void CompareHashValues(float omega, CRandomGenerator& rng){
+  float fMaxError = 0.0f;
+  const long long n = min(g_nNumSamples, (long long)REPEATS); //number of samples
+  for(long long i=0; i<n; i++){
+    const unsigned int x = rng.Next();
+    const unsigned int y = rng.Next();
+    const float e = fabs(ExpHash(x, y, 0xFFFFFFFF, omega) - ExpHashFast(x, y, 0xFFFFFFFF, omega));
+    fMaxError = max(fMaxError, e);
+  } //for
+  printf("Largest difference between ExpHash and ExpHashFast = %g\n", fMaxError);
+} //CompareHashValues
+
+/// \brief Compare the distribution of ExpHashFast to that of ExpHash.
+///
+/// Compare the frequency distribution of ExpHashFast to that of ExpHash,
+/// using the chi-square statistic for two histograms. If the
+/// distributions are the same then it should be no more than about the number
+/// of degrees of freedom, and it is almost certainly no more than that
+/// plus 3 standard deviations.
+/// \param exact Distribution of ExpHash.
+/// \param fast Distribution of ExpHashFast.
+
+void CompareHashes(const Distribution& exact, const Distribution& fast){
+  double chisquare = 0.0;
+  int df = -1; //degrees of freedom
+  for(int i=0; i<GRANULARITY; i++){
+    const double a = (double)exact.nCount[i], b = (double)fast.nCount[i];
+    if(a + b > 0){
+      chisquare += (a - b)*(a - b)/(a + b);
+      df++;
+    } //if
+  } //for
+
+  const double limit = df + 3.0*sqrt(2.0*df);
+  printf("Chi-square = %0.2f with %d degrees of freedom, so the distribution is %s\n",
+    chisquare, df, chisquare <= limit? "preserved": "NOT preserved");
+} //CompareHashes
+
+/// \brief Measure the distributions for one omega.
+///
+/// Measure and save the distribution of ExpRand, and optionally those of
+/// ExpHash and ExpHashFast and how they compare.
+/// \param omega The tail multiplier.
+/// \param bHash Whether to measure the hash functions too.
+/// \param filehandle File handle opened for writing.
+
+void MeasureDistributions(float omega, bool bHash, FILE* filehandle){
+  Distribution* d = new Distribution; //current distribution
+  Distribution* exact = new Distribution; //distribution of ExpHash
+
+  CStdlibRandom stdrng;
+  RunExperiment(omega, ExpRandSample, stdrng, *d);
+  SaveDistribution(filehandle, *d);
+  CheckDistribution(*d);
+
+  if(bHash){
+    printf("\nExpHash:\n");
+    CScrambleRandom hashrng;
+    RunExperiment(omega, ExpHashSample, hashrng, *exact);
+    SaveDistribution(filehandle, *exact);
+    CheckDistribution(*exact);
+
+    printf("\nExpHashFast:\n");
+    CScrambleRandom fasthashrng;
+    RunExperiment(omega, ExpHashFastSample, fasthashrng, *d);
+    SaveDistribution(filehandle, *d);
+    CheckDistribution(*d);
+
+    if(g_bCounterRandom){
+      CCounterRandom comparerng(g_nSeed, 0);
+      CompareHashValues(omega, comparerng);
+    } //if
+    else{
+      CScrambleRandom comparerng;
+      CompareHashValues(omega, comparerng);
+    } //else
+
+    CompareHashes(*exact, *d);
+  } //if
+
+  delete d;
+  delete exact;
+} //MeasureDistributions
+
+/// \brief Measure the distributions for an omega sweep.
+///
+/// The same as MeasureDistributions, but for all of the omegas in g_vOmega.
+/// \param bHash Whether to measure the hash functions too.
+/// \param filehandle File handle opened for writing.
+
+void MeasureSweep(bool bHash, FILE* filehandle){
+  std::vector<Distribution> d, exact; //distributions for each omega
+
+  CStdlibRandom stdrng;
+  RunSweep(ExpRandSweep, stdrng, d);
+  for(size_t i=0; i<g_vOmega.size(); i++){
+    printf("Omega = %0.4f: ", g_vOmega[i]);
+    SaveDistribution(filehandle, d[i]);
+    CheckDistribution(d[i]);
+  } //for
+
+  if(bHash){
+    CScrambleRandom hashrng;
+    RunSweep(ExpHashSweep, hashrng, exact);
+    CScrambleRandom fasthashrng;
+    RunSweep(ExpHashFastSweep, fasthashrng, d);
+
+    printf("\nExpHash and ExpHashFast:\n");
+    for(size_t i=0; i<g_vOmega.size(); i++){
+      SaveDistribution(filehandle, exact[i]);
+      printf("Omega = %0.4f: ", g_vOmega[i]);
+      CompareHashes(exact[i], d[i]);
+    } //for
+
+    for(size_t i=0; i<g_vOmega.size(); i++)
+      SaveDistribution(filehandle, d[i]);
+  } //if
+} //MeasureSweep
+
 /// \brief Main.
 ///
 /// Prompts the user for a random number seed and a tail multiplier,
@@ -109,14 +647,60 @@ int main(int argc, char *argv[]){
   printf("Exponentially Distributed Random Numbers, Ian Parberry, 2014\n");
   printf("-------------------------------------------------------------\n");
 
+  //parse command line
+  bool bHash = false; //whether to measure the hash functions too
+  float fSweep0 = 0.0f, fSweep1 = 1.0f; //first and last omega of sweep
+  int nSweepSteps = 0; //number of omegas in sweep, 0 for no sweep
+
+  for(int i=1; i<argc; i++)
+    if(!strcmp(argv[i], "-hash"))bHash = true;
+    else if(!strcmp(argv[i], "-rng") && i+1 < argc){
+      i++;
+      if(!strcmp(argv[i], "counter"))g_bCounterRandom = true;
+      else if(!strcmp(argv[i], "rand"))g_bCounterRandom = false;
+      else printf("Ignoring unknown generator %s\n", argv[i]);
+    } //else if
+    else if(!strcmp(argv[i], "-threads") && i+1 < argc)
+      g_nNumThreads = atoi(argv[++i]);
+    else if(!strcmp(argv[i], "-samples") && i+1 < argc){
+      const long long n = (long long)atof(argv[++i]);
+      g_nNumSamples = n < 1? 1: n;
+    } //else if
+    else if(!strcmp(argv[i], "-sweep") && i+3 < argc){
+      fSweep0 = (float)atof(argv[++i]);
+      fSweep1 = (float)atof(argv[++i]);
+      nSweepSteps = atoi(argv[++i]);
+    } //else if
+    else printf("Ignoring unknown option %s\n", argv[i]);
+
+  if(g_nNumThreads <= 0) //one per hardware thread
+    g_nNumThreads = max((int)std::thread::hardware_concurrency(), 1);
+  if(g_nNumThreads > 1 && !g_bCounterRandom){
+    printf("rand() can only be used by one thread, use -rng counter for more.\n");
+    g_nNumThreads = 1;
+  } //if
+
+  //make the omegas for a sweep
+  if(nSweepSteps > 0){
+    const float a = max(min(fSweep0, fSweep1), 0.0f); //smallest omega
+    const float b = min(max(fSweep0, fSweep1), 1.0f); //largest omega
+    for(int i=0; i<nSweepSteps; i++)
+      g_vOmega.push_back(nSweepSteps == 1? a: a + (b - a)*(float)i/(float)(nSweepSteps - 1));
+  } //if
+
   unsigned int seed = 1;
   printf("Enter a hash seed for the pseudorandom number generator.\n");
   printf("Hash seed: "); scanf("%d", &seed);
   srand(seed); //seed the random number generator.
+  g_nSeed = seed;
+
+  if(g_bCounterRandom)
+    printf("Using the counter-based generator with %d thread%s.\n",
+      g_nNumThreads, g_nNumThreads > 1? "s": "");
 
-  //get omega
+  //get omega, unless there is a sweep
   float omega = 0.5f;
-  do{
+  if(g_vOmega.empty())do{
     printf("Enter a value between 0 and 1 for omega, the tail multiplier.\n");
     printf("Omega: ");
     scanf("%f", &omega);
@@ -131,9 +715,9 @@ int main(int argc, char *argv[]){
 
   if(distributionfile){
     //do the actual work
-    RunExperiment(omega, REPEATS);
-    SaveDistribution(distributionfile);
-    CheckDistribution();
+    if(g_vOmega.empty())
+      MeasureDistributions(omega, bHash, distributionfile);
+    else MeasureSweep(bHash, distributionfile);
 
     //clean up and exit
     fclose(distributionfile);
@@ -0,0 +1,279 @@
+/// \file AscFile.cpp
+/// \brief Code for the ASCII DEM file reader.
+
+// Copyright Ian Parberry, May 2014.
+//
+// This file is made available under the GNU All-Permissive License.
+//
+// Copying and distribution of this file, with or without modification,
+// are permitted in any medium without royalty provided the copyright
+// notice and this notice are preserved.  This file is offered as-is,
+// without any warranty.
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "AscFile.h"
+
+/// Powers of ten that are exactly representable as doubles.
+
+static const double g_dPowerOf10[23] = {
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+}; //g_dPowerOf10
+
+/// Parse a decimal number such as "-1234.5678" into a float. The digits are
+/// accumulated into an integer and divided by a power of ten in double
+/// precision, which is correctly rounded since both are exact. Rounding that
+/// to a float is then correct too unless it lands exactly halfway between
+/// two floats. That case, numbers with too many digits, and numbers with
+/// exponents are handed over to strtof(), so the result is always the same
+/// as fscanf() would give.
+/// \param p Pointer to the first character of the number, which is moved
+///   past it. If it isn't a number then it is moved past the next white space.
+/// \param value The number parsed.
+/// \return true if it succeeds, false if it isn't a number.
+
+bool ParseFloat(const char*& p, float& value){
+  const char* start = p; //start of number
+  const bool neg = *p == '-'; //whether it is negative
+  if(neg || *p == '+')p++;
+
+  unsigned long long m = 0; //digits
+  int ndigits = 0; //number of digits
+  int e = 0; //number of digits after the decimal point
+
+  for(unsigned int d; (d = (unsigned int)(*p - '0')) < 10; p++, ndigits++)
+    m = 10*m + d;
+
+  if(*p == '.')
+    for(p++; (unsigned int)(*p - '0') < 10; p++, ndigits++, e++)
+      m = 10*m + (*p - '0');
+
+  if(ndigits > 0 && (unsigned char)*p <= ' ' && ndigits <= 15 && e <= 22){ //fast path
+    const double x = (double)m/g_dPowerOf10[e];
+    unsigned long long bits; //bits of x
+    memcpy(&bits, &x, sizeof(bits));
+
+    if((bits & 0x1FFFFFFFULL) != 0x10000000ULL){ //not halfway between floats
+      value = neg? -(float)x: (float)x;
+      return true;
+    } //if
+  } //if
+
+  //slow path
+  char* end;
+  value = strtof(start, &end);
+  if(end > start && (unsigned char)*end <= ' '){
+    p = end;
+    return true;
+  } //if
+
+  for(p=start; (unsigned char)*p > ' '; p++); //skip junk
+  return false;
+} //ParseFloat
+
+/// The constructor doesn't do much, that's what Open() is for.
+
+CAscFile::CAscFile():
+  m_pFile(NULL), m_pBuffer(NULL), m_bOwnBuffer(false), m_pNext(NULL), m_pEnd(NULL), m_bEOF(true),
+  m_nCols(0), m_nRows(0), m_dXll(0.0), m_dYll(0.0), m_dCellSize(0.0), m_fNoData(-9999.0f)
+{
+} //constructor
+
+/// The destructor closes the file if it is still open.
+
+CAscFile::~CAscFile(){
+  Close();
+} //destructor
+
+/// Open an ASCII DEM file and read its header.
+/// \param filename Name of file.
+/// \return true if it succeeds, false if it can't be opened or has a bad header.
+
+bool CAscFile::Open(const char* filename){
+  Close();
+
+  m_pFile = fopen(filename, "rb");
+  if(m_pFile == NULL)return false;
+
+  m_pBuffer = new char [ASCFILE_BLOCKSIZE + 1];
+  m_bOwnBuffer = true;
+  m_pNext = m_pEnd = m_pBuffer;
+  *m_pEnd = '\0';
+  m_bEOF = false;
+
+  if(ReadHeader())return true;
+
+  Close();
+  return false;
+} //Open
+
+/// Open an ASCII DEM file that has already been read into memory and read
+/// its header. The data must stay there until the file is closed.
+/// \param data The contents of the file followed by a nul.
+/// \param size Size of the file in bytes, not counting the nul.
+/// \return true if it succeeds, false if it has a bad header.
+
+bool CAscFile::Open(char* data, const size_t size){
+  Close();
+
+  m_pBuffer = m_pEnd = data;
+  m_pEnd += size;
+  m_pNext = m_pBuffer;
+  m_bOwnBuffer = false;
+  m_bEOF = true;
+
+  if(ReadHeader())return true;
+
+  Close();
+  return false;
+} //Open
+
+/// Close the file.
+
+void CAscFile::Close(){
+  if(m_pFile != NULL)
+    fclose(m_pFile);
+  m_pFile = NULL;
+
+  if(m_bOwnBuffer)
+    delete [] m_pBuffer;
+  m_pBuffer = m_pEnd = NULL;
+  m_bOwnBuffer = false;
+  m_pNext = NULL;
+  m_bEOF = true;
+} //Close
+
+/// Make sure that the buffer holds at least a whole token by moving what is
+/// left to the front and reading the next block of the file after it.
+
+void CAscFile::Refill(){
+  if(m_bEOF || m_pEnd - m_pNext >= ASCFILE_MAXTOKEN)return;
+
+  const size_t left = m_pEnd - m_pNext; //bytes left in buffer
+  memmove(m_pBuffer, m_pNext, left);
+  const size_t count = fread(m_pBuffer + left, 1, ASCFILE_BLOCKSIZE - left, m_pFile);
+  m_bEOF = count < ASCFILE_BLOCKSIZE - left;
+
+  m_pNext = m_pBuffer;
+  m_pEnd = m_pBuffer + left + count;
+  *m_pEnd = '\0';
+} //Refill
+
+/// Skip over white space to the start of the next token, refilling the
+/// buffer as necessary so that it holds the whole token.
+
+void CAscFile::SkipWhiteSpace(){
+  for(;;){
+    while(m_pNext < m_pEnd && (unsigned char)*m_pNext <= ' ')
+      m_pNext++;
+    if(m_bEOF || m_pEnd - m_pNext >= ASCFILE_MAXTOKEN)return;
+    Refill();
+  } //for
+} //SkipWhiteSpace
+
+/// Read the keyword and value lines at the start of the file, which end at
+/// the first line that starts with a number.
+/// \return true if the header gives the number of rows and columns.
+
+bool CAscFile::ReadHeader(){
+  m_nCols = m_nRows = 0;
+  m_dXll = m_dYll = 0.0;
+  m_dCellSize = 0.0;
+  m_fNoData = -9999.0f;
+
+  bool bXCenter = false, bYCenter = false; //whether the center of a point was given
+
+  for(SkipWhiteSpace(); isalpha((unsigned char)*m_pNext); SkipWhiteSpace()){
+    char key[32]; //keyword in lower case
+    int n = 0;
+    for(; (unsigned char)*m_pNext > ' '; m_pNext++)
+      if(n < (int)sizeof(key) - 1)
+        key[n++] = (char)tolower((unsigned char)*m_pNext);
+    key[n] = '\0';
+
+    SkipWhiteSpace();
+    char* end;
+    const double value = strtod(m_pNext, &end);
+    if(end == m_pNext)return false;
+    m_pNext = end;
+
+    if(!strcmp(key, "ncols"))m_nCols = (int)value;
+    else if(!strcmp(key, "nrows"))m_nRows = (int)value;
+    else if(!strcmp(key, "xllcorner"))m_dXll = value;
+    else if(!strcmp(key, "yllcorner"))m_dYll = value;
+    else if(!strcmp(key, "xllcenter")){m_dXll = value; bXCenter = true;}
+    else if(!strcmp(key, "yllcenter")){m_dYll = value; bYCenter = true;}
+    else if(!strcmp(key, "cellsize"))m_dCellSize = value;
+    else if(!strcmp(key, "nodata_value"))m_fNoData = (float)value;
+  } //for
+
+  //move from the center of the bottom left point to its corner
+  if(bXCenter)m_dXll -= m_dCellSize/2.0;
+  if(bYCenter)m_dYll -= m_dCellSize/2.0;
+
+  return m_nCols > 0 && m_nRows > 0;
+} //ReadHeader
+
+/// Read the next row of heights. Malformed numbers are read as the
+/// nodata value.
+/// \param row Buffer for GetNumCols() heights.
+/// \return Number of heights read, which is less than GetNumCols() if the file ends first.
+
+int CAscFile::ReadRow(float* row){
+  if(m_pNext == NULL)return 0;
+
+  for(int j=0; j<m_nCols; j++){
+    SkipWhiteSpace();
+    if(m_pNext >= m_pEnd)return j; //end of file
+
+    if(!ParseFloat(m_pNext, row[j]))
+      row[j] = m_fNoData;
+  } //for
+
+  return m_nCols;
+} //ReadRow
+
+/// Reader function for the number of columns.
+/// \return Number of points in each row.
+
+int CAscFile::GetNumCols(){
+  return m_nCols;
+} //GetNumCols
+
+/// Reader function for the number of rows.
+/// \return Number of rows.
+
+int CAscFile::GetNumRows(){
+  return m_nRows;
+} //GetNumRows
+
+/// Reader function for the easting of the bottom left corner.
+/// \return UTM easting of the bottom left corner.
+
+double CAscFile::GetXll(){
+  return m_dXll;
+} //GetXll
+
+/// Reader function for the northing of the bottom left corner.
+/// \return UTM northing of the bottom left corner.
+
+double CAscFile::GetYll(){
+  return m_dYll;
+} //GetYll
+
+/// Reader function for the distance between points.
+/// \return Distance between points.
+
+double CAscFile::GetCellSize(){
+  return m_dCellSize;
+} //GetCellSize
+
+/// Reader function for the nodata value.
+/// \return Value of points with no data.
+
+float CAscFile::GetNoData(){
+  return m_fNoData;
+} //GetNoData
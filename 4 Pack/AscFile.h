@@ -0,0 +1,72 @@
+/// \file AscFile.h
+/// \brief Header for the ASCII DEM file reader.
+///
+/// DEM files from the UARGRC are in the ESRI ASCII grid format, a header of
+/// keyword and value lines such as "ncols 4000" and "NODATA_value -9999"
+/// followed by the heights as decimal numbers separated by white space,
+/// one row per line from the top down. Reading them with fscanf() is very
+/// slow, so this reader reads the file in large blocks and parses the numbers
+/// itself.
+
+// Copyright Ian Parberry, May 2014.
+//
+// This file is made available under the GNU All-Permissive License.
+//
+// Copying and distribution of this file, with or without modification,
+// are permitted in any medium without royalty provided the copyright
+// notice and this notice are preserved.  This file is offered as-is,
+// without any warranty.
+
+#pragma once
+
+#include <stdio.h>
+
+const int ASCFILE_BLOCKSIZE = 1 << 20; ///< Number of bytes read from the file at a time.
+const int ASCFILE_MAXTOKEN = 64; ///< Longest number that can be parsed.
+
+/// \brief ASCII DEM file reader.
+///
+/// Reads the header of an ESRI ASCII grid file when it is opened, and then
+/// the heights a row at a time. The file can either be read a block at a
+/// time or all be in memory already. Numbers are converted to exactly the same
+/// floats that fscanf() would give.
+
+class CAscFile{
+  private:
+    FILE* m_pFile; ///< Input file.
+    char* m_pBuffer; ///< Block buffer, with a nul after the data.
+    bool m_bOwnBuffer; ///< Whether m_pBuffer was allocated by this reader.
+    const char* m_pNext; ///< Next character to be parsed.
+    char* m_pEnd; ///< End of data in block buffer.
+    bool m_bEOF; ///< Whether the end of the file has been read into the buffer.
+
+    int m_nCols; ///< Number of points in each row.
+    int m_nRows; ///< Number of rows.
+    double m_dXll; ///< UTM easting of the bottom left corner.
+    double m_dYll; ///< UTM northing of the bottom left corner.
+    double m_dCellSize; ///< Distance between points.
+    float m_fNoData; ///< Value of points with no data.
+
+    void Refill(); ///< Make sure that the buffer holds a whole token.
+    void SkipWhiteSpace(); ///< Skip to the next token.
+    bool ReadHeader(); ///< Read the header.
+
+  public:
+    CAscFile(); ///< Constructor.
+    ~CAscFile(); ///< Destructor.
+
+    bool Open(const char* filename); ///< Open a file and read its header.
+    bool Open(char* data, const size_t size); ///< Open a file in memory and read its header.
+    void Close(); ///< Close the file.
+
+    int ReadRow(float* row); ///< Read the next row of heights.
+
+    int GetNumCols(); ///< Get the number of points in each row.
+    int GetNumRows(); ///< Get the number of rows.
+    double GetXll(); ///< Get the easting of the bottom left corner.
+    double GetYll(); ///< Get the northing of the bottom left corner.
+    double GetCellSize(); ///< Get the distance between points.
+    float GetNoData(); ///< Get the value of points with no data.
+}; //CAscFile
+
+bool ParseFloat(const char*& p, float& value); ///< Parse a decimal number.
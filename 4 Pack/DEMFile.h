@@ -0,0 +1,114 @@
+/// \file DEMFile.h
+/// \brief Header for the tiled packed DEM file format.
+///
+/// A packed DEM file starts with a DEMFileHeader, which is followed by an
+/// index with one DEMTileIndex per tile, and then by the tiles themselves.
+/// The height array is cut into square tiles of DEMFileHeader::tilesize points
+/// on a side, stored in row-major order of tiles. Each tile is stored in
+/// row-major order of points. Tiles on the right and bottom edges are padded
+/// out to full size with the nodata value, so every tile is the same size
+/// once decoded. The index records where each tile starts in the file and
+/// how many bytes it takes up, so tiles can be read in any order.
+/// Heights are stored as unsigned shorts equal to the height in meters
+/// multiplied by the scale factor. All values are little-endian.
+
+// Copyright Ian Parberry, May 2014.
+//
+// This file is made available under the GNU All-Permissive License.
+//
+// Copying and distribution of this file, with or without modification,
+// are permitted in any medium without royalty provided the copyright
+// notice and this notice are preserved.  This file is offered as-is,
+// without any warranty.
+
+#pragma once
+
+#include <stdio.h>
+
+const char DEMFILE_MAGIC[8] = {'T', 'O', 'B', 'L', 'E', 'R', 'D', 'M'}; ///< First 8 bytes of a packed DEM file.
+const unsigned int DEMFILE_VERSION = 1; ///< Current version of the packed DEM file format.
+const unsigned int DEMFILE_TILESIZE = 256; ///< Default number of points on one side of a tile.
+
+/// \brief Tile codec.
+///
+/// The way in which the tiles of a packed DEM file are encoded. Whatever the
+/// codec, a tile whose size in the index is DEMTileBytes() is stored raw.
+
+enum DEMCodec{
+  DEMCODEC_RAW = 0, ///< Raw unsigned shorts.
+  DEMCODEC_RICE = 1, ///< Row deltas Rice coded as described in TileCodec.h, or raw if that is no smaller.
+}; //DEMCodec
+
+/// \brief Packed DEM file header.
+///
+/// The header at the start of a packed DEM file.
+
+struct DEMFileHeader{
+  char magic[8]; ///< Must be DEMFILE_MAGIC.
+  unsigned int version; ///< File format version.
+  unsigned int headersize; ///< Size of this header in bytes.
+  unsigned int width; ///< Number of points in each row.
+  unsigned int height; ///< Number of rows.
+  unsigned int tilesize; ///< Number of points on one side of a tile.
+  unsigned int tilesx; ///< Number of tiles across.
+  unsigned int tilesy; ///< Number of tiles down.
+  unsigned int codec; ///< Tile codec, one of DEMCodec.
+  float scale; ///< Heights in meters are multiplied by this before being stored.
+  unsigned short nodata; ///< Value stored for points with no data.
+  unsigned short reserved; ///< Unused, set to 0.
+  double cellsize; ///< Distance between points in meters.
+  double xorigin; ///< UTM easting of the top left corner, or 0 if unknown.
+  double yorigin; ///< UTM northing of the top left corner, or 0 if unknown.
+}; //DEMFileHeader
+
+/// \brief Packed DEM tile index entry.
+///
+/// Where a tile is in a packed DEM file.
+
+struct DEMTileIndex{
+  unsigned long long offset; ///< Offset of tile from start of file in bytes.
+  unsigned long long size; ///< Size of encoded tile in bytes.
+}; //DEMTileIndex
+
+void InitDEMHeader(DEMFileHeader& header, const int width, const int height,
+  const int tilesize, const float scale, const unsigned short nodata, const double cellsize); ///< Initialize a header.
+bool IsDEMHeaderValid(const DEMFileHeader& header); ///< Check a header.
+long long DEMTileBytes(const DEMFileHeader& header); ///< Size of a decoded tile in bytes.
+bool DecodeDEMTile(const DEMFileHeader& header, const unsigned char* src, 
+  const unsigned long long size, unsigned short* dest); ///< Decode a tile.
+
+/// \brief Packed DEM file writer.
+///
+/// Writes a packed DEM file one tile at a time in any order, one row of tiles
+/// at a time, or one row of heights at a time from the top down. The header and a
+/// placeholder index are written when the file is opened and the real index
+/// is written over the placeholder when it is closed.
+
+class CDEMFileWriter{
+  private:
+    FILE* m_pFile; ///< Output file.
+    DEMFileHeader m_sHeader; ///< File header.
+    DEMTileIndex* m_pIndex; ///< Tile index.
+    unsigned long long m_nOffset; ///< Offset of next tile in file.
+    unsigned short* m_pTile; ///< Buffer for one tile.
+    unsigned char* m_pBuffer; ///< Buffer for one encoded tile.
+    unsigned short* m_pStrip; ///< Buffer for the rows of one row of tiles, for WriteRow().
+    int m_nStripRows; ///< Number of rows in m_pStrip.
+    int m_nNextTileRow; ///< Next row of tiles to be written by WriteRow().
+    bool m_bFailed; ///< Whether a write has failed.
+
+    void FillTile(const unsigned short* const* rows, const int j0, const int tx, const int ty); ///< Copy a tile into m_pTile.
+    bool WriteTile(const int tx, const int ty); ///< Encode and write the tile in m_pTile.
+
+  public:
+    CDEMFileWriter(); ///< Constructor.
+    ~CDEMFileWriter(); ///< Destructor.
+
+    bool Open(const char* filename, const DEMFileHeader& header); ///< Create a file.
+    bool WriteTile(const int tx, const int ty, const unsigned short* const* rows); ///< Write a tile.
+    bool WriteTileRow(const int ty, const unsigned short* const* rows); ///< Write a row of tiles.
+    bool WriteRow(const unsigned short* row); ///< Write the next row of heights.
+    bool Close(); ///< Write the index and close the file.
+
+    unsigned long long GetBytesWritten(); ///< Get the number of bytes written.
+}; //CDEMFileWriter
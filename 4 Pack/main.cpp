@@ -29,6 +29,33 @@
 /// If you are thinking about trying it out on a single file before going
 /// Whole Hog, just uncomment out the \#define TESTRUN and provide a file
 /// named filelisttestrun.txt with the name of a single DEM file in it.
+///
+/// The DEM files are read by a pipeline of threads. A reader thread reads
+/// files into memory ahead of time while parser threads, one per hardware thread
+/// by default, parse them into the grid. The command line options -threads N,
+/// -readers N, and -queue N set the number of parser threads, the number of
+/// reader threads, and how many files can wait in memory to be parsed.
+/// The option -threads 1 reads the files one at a time without a pipeline.
+///
+/// The command line option -stream makes it read one row of DEM files at a
+/// time and append it to UtahDEMData.bin before reading the next, so that
+/// it needs only enough memory for one row of files instead of the whole
+/// array.
+///
+/// UtahDEMData.bin is written in the tiled packed DEM file format described
+/// in DEMFile.h, which records the size of the array, the height scale factor,
+/// the nodata value, and where the tiles are. The command line option -raw
+/// makes it write the original headerless row-major array of unsigned shorts
+/// instead. The command line option -compress makes it compress the tiles
+/// using the codec in TileCodec.h, which typically makes the file several
+/// times smaller. The Analyzer decompresses them on the fly.
+///
+/// While it runs, the throughput of each stage (reading, parsing, and
+/// writing), the percentage of bad points, and the progress and estimated
+/// time remaining are printed to stderr every 10 seconds. The command line
+/// option -progress followed by a number of seconds changes how often, 0
+/// meaning only at the end, and -log followed by a file name appends them to a
+/// tab-separated log file too. See Instrument.h for how to compile this out.
 
 // Copyright Ian Parberry, May 2014.
 //
@@ -42,8 +69,21 @@
 // Last updated May 31, 2014.
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <thread> //for std::thread
+#include <atomic> //for std::atomic
+#include <mutex> //for std::mutex
+#include <condition_variable> //for std::condition_variable
+#include <deque> //for std::deque
+#include <vector> //for std::vector
+#include <string> //for std::string
 
 #include "defines.h"
+#include "DEMFile.h"
+#include "AscFile.h"
+#include "Instrument.h"
 
 //#define TESTRUN //undefine for real run, define for a small single-file test
 
@@ -57,11 +97,54 @@
 
 const int CELLSIZE = 4000; ///< Number of points on one side of a DEM file.
 const int ARRAYSIZE = CELLSIZE*GRIDSIZE; ///< Number of points on one side of the whole array of heights.
+const float HEIGHTSCALE = 10.0f; ///< Heights are multiplied by this before being packed.
+const unsigned short NODATA = 0; ///< Packed value of points with bad data.
 
 long long g_nPointCount = 0LL; ///< Number of points processed.
 long long g_nBadPointCount = 0LL;  ///< Number of points with bad data processed.
 
 unsigned short** g_nHeight; ///< Buffer for packed height data.
+int g_nNumBufferRows = ARRAYSIZE; ///< Number of rows in g_nHeight.
+int g_nFirstRow = 0; ///< Row of the whole array that is in g_nHeight[0].
+
+double g_dCellSize = 5.0; ///< Distance between points in meters, from the first DEM file.
+double g_dXOrigin = 0.0; ///< UTM easting of top left corner, from the first DEM file.
+double g_dYOrigin = 0.0; ///< UTM northing of top left corner, from the first DEM file.
+
+/// \brief A DEM file read into memory.
+///
+/// A DEM file that has been read by a reader thread and is waiting to be parsed.
+
+struct LoadedFile{
+  int index; ///< Position in the file list.
+  char* data; ///< Contents of file followed by a nul, or NULL if it couldn't be read.
+  size_t size; ///< Size of file in bytes.
+}; //LoadedFile
+
+std::vector<std::string> g_strFileName; ///< Names of DEM files, in row-major order of their cells.
+int g_nNumThreads = 0; ///< Number of parser threads, 0 for one per hardware thread.
+int g_nNumReaders = 1; ///< Number of reader threads.
+int g_nQueueSize = 4; ///< Largest number of files read but not being parsed yet.
+std::atomic<int> g_nNextRead(0); ///< Index of next file to be read.
+int g_nLastRead = 0; ///< Index of the file after the last one to be read.
+std::deque<LoadedFile> g_qLoadedFiles; ///< Files read but not being parsed yet.
+int g_nNumReadersDone = 0; ///< Number of reader threads that have finished.
+std::mutex g_mQueue; ///< Mutex for the loaded file queue.
+std::condition_variable g_cvNotFull; ///< Signalled when the queue is not full.
+std::condition_variable g_cvNotEmpty; ///< Signalled when the queue is not empty or the readers are done.
+
+/// \brief Instrumentation counters.
+///
+/// The stages of the packer that are instrumented, as numbers of
+/// instrumentation counters.
+
+enum PackStage{
+  STAGE_READ, ///< Bytes of DEM files read into memory.
+  STAGE_PARSE, ///< Points parsed.
+  STAGE_BAD, ///< Points with bad data.
+  STAGE_FILES, ///< DEM files done.
+  STAGE_WRITE ///< Bytes of height data written.
+}; //PackStage
 
   
 
@@ -80,6 +163,59 @@ int GetTime(){
   #endif
 } //GetTime
 
+/// \brief Parse height data.
+///
+/// Parse the height data from a single DEM file and put it into the correct place
+/// in g_pHeight,  which it assumes points to a buffer of the right size.
+/// Points that have the file's nodata value or are not above sea level
+/// are recorded as bad. Only the cells in rows that g_pHeight currently holds
+/// can be read. This touches no globals other than the cell of g_pHeight
+/// and, for the top left file, the origin, so files can be parsed in parallel.
+/// \param row Y coordinate of cell.
+/// \param col X coordinate of cell.
+/// \param filename Name of DEM file, for messages.
+/// \param input DEM file, opened but nothing read past the header.
+/// \param nPoints Number of points processed is added to this.
+/// \param nBadPoints Number of points with bad data is added to this.
+
+void ParseHeightData(int row, int col, const char* filename, CAscFile& input,
+  long long& nPoints, long long& nBadPoints)
+{ 
+  INSTRUMENT_TIME_COUNT(STAGE_PARSE, nPoints);
+  INSTRUMENT_TIME_COUNT(STAGE_BAD, nBadPoints);
+
+  row *= CELLSIZE; col *= CELLSIZE;
+  unsigned short** height = g_nHeight + row - g_nFirstRow; //first row of cell in g_nHeight
+  const int nrows = input.GetNumRows(), ncols = input.GetNumCols();
+  if(nrows != CELLSIZE || ncols != CELLSIZE)
+    printf(" %s is %dx%d instead of %dx%d ", filename, ncols, nrows, CELLSIZE, CELLSIZE);
+
+  //note where the top left file is
+  if(row == 0 && col == 0){
+    g_dCellSize = input.GetCellSize();
+    g_dXOrigin = input.GetXll();
+    g_dYOrigin = input.GetYll() + nrows*input.GetCellSize();
+  } //if
+
+  //get data, padding with bad points if the file is too small
+  const float nodata = input.GetNoData();
+  float* h = new float [ncols];
+  for(int i=0; i<CELLSIZE; i++){
+    int n = i < nrows? input.ReadRow(h): 0; //number of points read
+    if(n > CELLSIZE)n = CELLSIZE;
+    for(int j=0; j<CELLSIZE; j++){
+      if(j < n && h[j] > 0.0f && h[j] != nodata)
+        height[i][col + j] = (unsigned short)(h[j] * HEIGHTSCALE);
+      else{
+        height[i][col + j] = NODATA;
+        nBadPoints++;
+      } //else
+      nPoints++;
+    } //for
+  } //for
+  delete [] h;
+} //ParseHeightData
+
 /// \brief Read height data.
 ///
 /// Read the height data from a single DEM file and put it into the correct place
@@ -89,31 +225,10 @@ int GetTime(){
 /// \param filename Name of DEM file to be read.
 /// \return true if it succeeds, false if it fails
 
-bool ReadHeightData(int row, int col, char* filename){ 
-  row *= CELLSIZE; col *= CELLSIZE;
-  FILE* input = fopen(filename, "rt");
-  if(input){
-    char buffer[256];
-    float fFoobar; //A place to dump the trash.
-
-    //skip over header
-    for(int i=0; i<6; i++)
-     fscanf(input, "%s %f\n", buffer, &fFoobar);
-
-    //get data
-    float h;
-    for(int i=0; i<CELLSIZE; i++)
-      for(int j=0; j<CELLSIZE; j++){
-        fscanf(input, "%f", &h);
-        if(h > 0.0f)
-          g_nHeight[row + i][col + j] = (unsigned short)(h * 10.0f);
-        else{
-          g_nHeight[row + i][col + j] = 0;
-          g_nBadPointCount++;
-        } //else
-        g_nPointCount++;
-      } //for
-    fclose(input);
+bool ReadHeightData(int row, int col, const char* filename){ 
+  CAscFile input;
+  if(input.Open(filename)){
+    ParseHeightData(row, col, filename, input, g_nPointCount, g_nBadPointCount);
     return true;
   } //if
   else{
@@ -122,6 +237,262 @@ bool ReadHeightData(int row, int col, char* filename){
   } //else
 } //ReadHeightData
 
+/// \brief Load a file.
+///
+/// Read the whole of a file into memory.
+/// \param filename Name of file.
+/// \param size Size of file in bytes.
+/// \return File contents followed by a nul, to be deleted by the caller, or NULL if it fails.
+
+char* LoadFile(const char* filename, size_t& size){
+  FILE* input = fopen(filename, "rb");
+  if(input == NULL)return NULL;
+
+  char* data = NULL;
+  if(fseek(input, 0, SEEK_END) == 0){
+    const long n = ftell(input); //DEM files are well under 2GB
+    if(n >= 0 && fseek(input, 0, SEEK_SET) == 0){
+      size = (size_t)n;
+      data = new char [size + 1];
+      if(fread(data, 1, size, input) == size)
+        data[size] = '\0';
+      else{
+        delete [] data;
+        data = NULL;
+      } //else
+    } //if
+  } //if
+
+  fclose(input);
+  return data;
+} //LoadFile
+
+/// \brief Reader thread.
+///
+/// Claim the next file in the list, read it into memory, and put it on the
+/// queue for the parser threads, waiting while the queue is full.
+
+void ReaderThread(){
+  for(int k=g_nNextRead++; k<g_nLastRead; k=g_nNextRead++){ //for each file claimed
+    LoadedFile file;
+    file.index = k;
+    file.size = 0;
+    {
+      INSTRUMENT_TIME(STAGE_READ);
+      file.data = LoadFile(g_strFileName[k].c_str(), file.size);
+    }
+    INSTRUMENT_ADD(STAGE_READ, (long long)file.size);
+
+    std::unique_lock<std::mutex> lock(g_mQueue);
+    while((int)g_qLoadedFiles.size() >= g_nQueueSize)
+      g_cvNotFull.wait(lock);
+    g_qLoadedFiles.push_back(file);
+    g_cvNotEmpty.notify_one();
+  } //for
+
+  std::lock_guard<std::mutex> lock(g_mQueue);
+  g_nNumReadersDone++;
+  g_cvNotEmpty.notify_all();
+} //ReaderThread
+
+/// \brief Parser thread.
+///
+/// Take files off the queue and parse them into their cell of the grid
+/// until the readers are done and the queue is empty.
+/// \param nPoints Number of points processed by this thread.
+/// \param nBadPoints Number of points with bad data processed by this thread.
+
+void ParserThread(long long* nPoints, long long* nBadPoints){
+  for(;;){ 
+    LoadedFile file;
+    {
+      std::unique_lock<std::mutex> lock(g_mQueue);
+      while(g_qLoadedFiles.empty() && g_nNumReadersDone < g_nNumReaders)
+        g_cvNotEmpty.wait(lock);
+      if(g_qLoadedFiles.empty())break; //all done
+      file = g_qLoadedFiles.front();
+      g_qLoadedFiles.pop_front();
+      g_cvNotFull.notify_one();
+    } //lock
+
+    const char* filename = g_strFileName[file.index].c_str();
+    CAscFile input;
+    if(file.data != NULL && input.Open(file.data, file.size))
+      ParseHeightData(file.index/GRIDSIZE, file.index%GRIDSIZE, filename, input, *nPoints, *nBadPoints);
+    else printf(" FAILED\n");
+    input.Close();
+
+    delete [] file.data;
+    INSTRUMENT_ADD(STAGE_FILES, 1);
+    printf(".");
+  } //for
+} //ParserThread
+
+/// \brief Read height data in parallel.
+///
+/// Read some of the files in g_strFileName into the grid using a pipeline of reader
+/// threads that read files into memory ahead of time and parser threads that
+/// parse them. At most g_nQueueSize files wait between the two, so at most
+/// that many plus one per parser are in memory at any time. Each parser counts
+/// its own points, and these are added to g_nPointCount and g_nBadPointCount
+/// once they are done.
+/// \param nNumParsers Number of parser threads.
+/// \param first Index of first file to be read.
+/// \param last Index of the file after the last one to be read.
+
+void ReadHeightDataPipelined(const int nNumParsers, const int first, const int last){
+  std::vector<std::thread> thread;
+  std::vector<long long> nPoints(nNumParsers, 0LL), nBadPoints(nNumParsers, 0LL);
+
+  g_nNextRead = first;
+  g_nLastRead = last;
+  g_nNumReadersDone = 0;
+
+  for(int t=0; t<g_nNumReaders; t++)
+    thread.push_back(std::thread(ReaderThread));
+  for(int t=0; t<nNumParsers; t++)
+    thread.push_back(std::thread(ParserThread, &nPoints[t], &nBadPoints[t]));
+  for(int t=0; t<(int)thread.size(); t++)
+    thread[t].join();
+
+  for(int t=0; t<nNumParsers; t++){
+    g_nPointCount += nPoints[t];
+    g_nBadPointCount += nBadPoints[t];
+  } //for
+} //ReadHeightDataPipelined
+
+/// \brief Read height files.
+///
+/// Read some of the files in g_strFileName into the grid, using the pipeline
+/// if there is more than one thread.
+/// \param first Index of first file to be read.
+/// \param last Index of the file after the last one to be read.
+
+void ReadHeightFiles(const int first, const int last){
+  if(g_nNumThreads > 1) //pipelined
+    ReadHeightDataPipelined(g_nNumThreads, first, last);
+  else for(int k=first; k<last; k++){ //one file at a time
+    ReadHeightData(k/GRIDSIZE, k%GRIDSIZE, g_strFileName[k].c_str());
+    INSTRUMENT_ADD(STAGE_FILES, 1);
+    printf(".");
+  } //for
+} //ReadHeightFiles
+
+/// \brief Write raw height data.
+///
+/// Write the height buffer to UtahDEMData.bin as a headerless row-major array.
+/// \return Number of bytes written, or -1 if the file could not be created.
+
+long long WriteRawHeightData(){
+  FILE* outputfile = fopen("UtahDEMData.bin", "wbS");
+  if(outputfile == NULL)return -1LL;
+
+  INSTRUMENT_TIME(STAGE_WRITE);
+  size_t count = 0;
+  const long long llRecordSize = (size_t)ARRAYSIZE*sizeof(unsigned short);
+  for(int i=0; i<ARRAYSIZE; i++){
+    count += fwrite(g_nHeight[i], llRecordSize, 1, outputfile);
+    INSTRUMENT_ADD(STAGE_WRITE, llRecordSize);
+  } //for
+  fclose(outputfile);
+
+  return count*llRecordSize;
+} //WriteRawHeightData
+
+/// \brief Initialize tiled header.
+///
+/// Initialize the header for UtahDEMData.bin in the tiled packed DEM file format.
+/// The top left file must have been read first so that the origin is known.
+/// \param header Header to be initialized.
+/// \param bCompress true to compress the tiles.
+
+void InitTiledHeader(DEMFileHeader& header, const bool bCompress){
+  InitDEMHeader(header, ARRAYSIZE, ARRAYSIZE, DEMFILE_TILESIZE, HEIGHTSCALE, NODATA, g_dCellSize);
+  header.xorigin = g_dXOrigin;
+  header.yorigin = g_dYOrigin;
+  header.codec = bCompress? DEMCODEC_RICE: DEMCODEC_RAW;
+} //InitTiledHeader
+
+/// \brief Write tiled height data.
+///
+/// Write the height buffer to UtahDEMData.bin in the tiled packed DEM file format.
+/// \param bCompress true to compress the tiles.
+/// \return Number of bytes written, or -1 if it fails.
+
+long long WriteTiledHeightData(const bool bCompress){
+  DEMFileHeader header;
+  InitTiledHeader(header, bCompress);
+
+  CDEMFileWriter writer;
+  if(!writer.Open("UtahDEMData.bin", header))return -1LL;
+
+  INSTRUMENT_TIME(STAGE_WRITE);
+  bool ok = true;
+  for(int ty=0; ty<(int)header.tilesy && ok; ty++){
+    ok = writer.WriteTileRow(ty, g_nHeight + ty*header.tilesize);
+    INSTRUMENT_ADD(STAGE_WRITE, (long long)header.tilesize*ARRAYSIZE*sizeof(unsigned short));
+  } //for
+  const long long count = writer.GetBytesWritten();
+
+  return writer.Close() && ok? count: -1LL;
+} //WriteTiledHeightData
+
+/// \brief Stream height data.
+///
+/// Read the DEM files one row of files at a time into a height buffer that
+/// holds only CELLSIZE rows, appending each one to UtahDEMData.bin before the
+/// next is read. The output is the same as reading the whole array and then
+/// writing it, but only needs memory for one row of files.
+/// \param bRaw true to write headerless raw data, false for the tiled format.
+/// \param bCompress true to compress the tiles.
+/// \return Number of bytes written, or -1 if it fails.
+
+long long StreamHeightData(const bool bRaw, const bool bCompress){
+  FILE* outputfile = NULL; //output file for raw data
+  CDEMFileWriter writer; //output file for tiled data
+  const long long llRecordSize = (size_t)ARRAYSIZE*sizeof(unsigned short);
+  long long count = 0; //number of bytes written
+  bool ok = true;
+
+  for(int i=0; i<GRIDSIZE && ok; i++){ //for each row of files
+    g_nFirstRow = i*CELLSIZE;
+    ReadHeightFiles(i*GRIDSIZE, (i + 1)*GRIDSIZE);
+
+    if(i == 0){ //the origin is known now, so create the output file
+      if(bRaw){
+        outputfile = fopen("UtahDEMData.bin", "wbS");
+        ok = outputfile != NULL;
+      } //if
+      else{
+        DEMFileHeader header;
+        InitTiledHeader(header, bCompress);
+        ok = writer.Open("UtahDEMData.bin", header);
+      } //else
+    } //if
+
+    INSTRUMENT_TIME(STAGE_WRITE);
+    for(int r=0; r<CELLSIZE && ok; r++){ //append the rows
+      if(bRaw){
+        ok = fwrite(g_nHeight[r], llRecordSize, 1, outputfile) == 1;
+        count += llRecordSize;
+      } //if
+      else ok = writer.WriteRow(g_nHeight[r]);
+      INSTRUMENT_ADD(STAGE_WRITE, llRecordSize);
+    } //for
+  } //for
+
+  if(bRaw){
+    if(outputfile != NULL)
+      ok = fclose(outputfile) == 0 && ok;
+  } //if
+  else{
+    count = writer.GetBytesWritten();
+    ok = writer.Close() && ok;
+  } //else
+
+  return ok? count: -1LL;
+} //StreamHeightData
+
 /// \brief Main.
 ///
 /// Does initialization, allocates memory, reads the list of file names,
@@ -133,14 +504,59 @@ bool ReadHeightData(int row, int col, char* filename){
 
 int main(int argc, char *argv[]){ 
   int nStartTime;
+  bool bRaw = false; //true to write headerless raw data
+  bool bCompress = false; //true to compress tiles
+  bool bStream = false; //true to read and write one row of files at a time
+  double dProgressInterval = 10.0; //seconds between progress reports
+  const char* strLogFileName = NULL; //name of instrumentation log file
+
+  //parse command line
+  for(int i=1; i<argc; i++)
+    if(!strcmp(argv[i], "-raw"))
+      bRaw = true;
+    else if(!strcmp(argv[i], "-compress"))
+      bCompress = true;
+    else if(!strcmp(argv[i], "-stream"))
+      bStream = true;
+    else if(!strcmp(argv[i], "-threads") && i+1 < argc)
+      g_nNumThreads = atoi(argv[++i]);
+    else if(!strcmp(argv[i], "-readers") && i+1 < argc)
+      g_nNumReaders = atoi(argv[++i]);
+    else if(!strcmp(argv[i], "-queue") && i+1 < argc)
+      g_nQueueSize = atoi(argv[++i]);
+    else if(!strcmp(argv[i], "-progress") && i+1 < argc)
+      dProgressInterval = atof(argv[++i]);
+    else if(!strcmp(argv[i], "-log") && i+1 < argc)
+      strLogFileName = argv[++i];
+    else printf("Ignoring unknown option %s\n", argv[i]);
+
+  if(g_nNumThreads <= 0) //one per hardware thread
+    g_nNumThreads = (int)std::thread::hardware_concurrency();
+  if(g_nNumThreads <= 0)g_nNumThreads = 1;
+  if(g_nNumReaders <= 0)g_nNumReaders = 1;
+  if(g_nQueueSize <= 0)g_nQueueSize = 1;
+
+#ifdef INSTRUMENT
+  g_cInstrument.SetCounter(STAGE_READ, "read", "MB", 1e-6);
+  g_cInstrument.SetCounter(STAGE_PARSE, "parse", "Mpoints", 1e-6);
+  g_cInstrument.SetPercent(STAGE_BAD, "bad", STAGE_PARSE);
+  g_cInstrument.SetCounter(STAGE_FILES, "files", "files", 1.0, COUNTER_PERIODIC|COUNTER_PROGRESS);
+  g_cInstrument.SetCounter(STAGE_WRITE, "write", "MB", 1e-6);
+  g_cInstrument.SetTotal(GRIDSIZE*GRIDSIZE);
+  g_cInstrument.Start(dProgressInterval, strLogFileName);
+#else
+  if(dProgressInterval != 10.0 || strLogFileName != NULL)
+    printf("Instrumentation is compiled out, ignoring -progress and -log\n");
+#endif
 
   //grab memory for the grid
   nStartTime = GetTime();
   printf("Allocating memory...\n");
-  g_nHeight = new unsigned short* [ARRAYSIZE];
-  for(int i=0; i<ARRAYSIZE; i++)
+  g_nNumBufferRows = bStream? CELLSIZE: ARRAYSIZE;
+  g_nHeight = new unsigned short* [g_nNumBufferRows];
+  for(int i=0; i<g_nNumBufferRows; i++)
     g_nHeight[i] = new unsigned short [ARRAYSIZE];
-  printf("  %lld bytes allocated in %0.2f seconds.\n", (long long)ARRAYSIZE*ARRAYSIZE*sizeof(unsigned short),
+  printf("  %lld bytes allocated in %0.2f seconds.\n", (long long)g_nNumBufferRows*ARRAYSIZE*sizeof(unsigned short),
     (float)(GetTime() - nStartTime)/1000.0f);
 
   //read height files
@@ -150,38 +566,56 @@ int main(int argc, char *argv[]){
   FILE* filenamefile = fopen(filenamefilename, "rt");
   if(filenamefile){
     printf("Opened %s\n", filenamefilename);
-    for(int i=0; i<GRIDSIZE; i++)
-      for(int j=0; j<GRIDSIZE; j++){
-        char filename[256];
-        fscanf(filenamefile, "%s", filename);
-        ReadHeightData(i, j, filename);
-        printf(".");
-      } //for
+    for(int i=0; i<GRIDSIZE*GRIDSIZE; i++){
+      char filename[256] = "";
+      fscanf(filenamefile, "%255s", filename);
+      g_strFileName.push_back(filename);
+    } //for
     fclose(filenamefile);
-    printf("\n");
-    printf("  Height data read in %0.2f seconds.\n", (float)(GetTime() - nStartTime)/1000.0f);
-    printf("  Read %lld points, %lld of which were bad.\n", g_nPointCount, g_nBadPointCount);
-
-    //output the packed data
-    FILE* outputfile = fopen("UtahDEMData.bin", "wbS");
-    printf("Writing height data...");
-    if(outputfile){
-      size_t count = 0;
-      const long long llRecordSize = (size_t)ARRAYSIZE*sizeof(unsigned short);
+
+    if(g_nNumThreads > 1)
+      printf("Using %d reader and %d parser threads\n", g_nNumReaders, g_nNumThreads);
+
+    long long count = 0; //number of bytes written
+
+    if(bStream){ //read and write one row of files at a time
+      printf("Streaming %s height data one row of files at a time\n", 
+        bRaw? "raw": bCompress? "compressed tiled": "tiled");
+      count = StreamHeightData(bRaw, bCompress);
+      printf("\n");
+      printf("  Read %lld points, %lld of which were bad.\n", g_nPointCount, g_nBadPointCount);
+    } //if
+
+    else{ //read it all then write it all
+      ReadHeightFiles(0, GRIDSIZE*GRIDSIZE);
+      printf("\n");
+      printf("  Height data read in %0.2f seconds.\n", (float)(GetTime() - nStartTime)/1000.0f);
+      printf("  Read %lld points, %lld of which were bad.\n", g_nPointCount, g_nBadPointCount);
+
+      //output the packed data
+      printf("Writing %s height data...", bRaw? "raw": bCompress? "compressed tiled": "tiled");
       nStartTime = GetTime();
-      for(int i=0; i<ARRAYSIZE; i++)
-        count += fwrite(g_nHeight[i], llRecordSize, 1, outputfile);
-      printf("  %lld bytes written in %0.2f seconds.\n", count*llRecordSize, (float)(GetTime() - nStartTime)/1000.0f);
-      fclose(outputfile);
+      count = bRaw? WriteRawHeightData(): WriteTiledHeightData(bCompress);
+    } //else
+
+    if(count >= 0){
+      printf("  %lld bytes written in %0.2f seconds.\n", count, (float)(GetTime() - nStartTime)/1000.0f);
+      if(bCompress)
+        printf("  Compressed to %0.1f%% of the raw size.\n", 
+          100.0*count/((double)ARRAYSIZE*ARRAYSIZE*sizeof(unsigned short)));
     } //if
     else printf("  Write failed.\n");
   } //if
   else printf("  Failed to read file list %s.\n", filenamefilename);
 
+#ifdef INSTRUMENT
+  g_cInstrument.Stop();
+#endif
+
   //recover grid memory
   printf("Deallocating memory...\n");
   nStartTime = GetTime();
-  for(int i=0; i<ARRAYSIZE; i++)
+  for(int i=0; i<g_nNumBufferRows; i++)
     delete [] g_nHeight[i];
   delete [] g_nHeight;
   printf("  Memory deallocated in %0.2f seconds.\n", (float)(GetTime() - nStartTime)/1000.0f);
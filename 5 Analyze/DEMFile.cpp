@@ -0,0 +1,289 @@
+/// \file DEMFile.cpp
+/// \brief Code for the tiled packed DEM file format.
+
+// Copyright Ian Parberry, May 2014.
+//
+// This file is made available under the GNU All-Permissive License.
+//
+// Copying and distribution of this file, with or without modification,
+// are permitted in any medium without royalty provided the copyright
+// notice and this notice are preserved.  This file is offered as-is,
+// without any warranty.
+
+#include <string.h>
+
+#include "DEMFile.h"
+#include "TileCodec.h"
+
+/// Initialize a header for a packed DEM file.
+/// \param header Header to be initialized.
+/// \param width Number of points in each row.
+/// \param height Number of rows.
+/// \param tilesize Number of points on one side of a tile.
+/// \param scale Heights in meters are multiplied by this before being stored.
+/// \param nodata Value stored for points with no data.
+/// \param cellsize Distance between points in meters.
+
+void InitDEMHeader(DEMFileHeader& header, const int width, const int height,
+  const int tilesize, const float scale, const unsigned short nodata, const double cellsize)
+{
+  memset(&header, 0, sizeof(DEMFileHeader));
+  memcpy(header.magic, DEMFILE_MAGIC, sizeof(header.magic));
+  header.version = DEMFILE_VERSION;
+  header.headersize = sizeof(DEMFileHeader);
+  header.width = width;
+  header.height = height;
+  header.tilesize = tilesize;
+  header.tilesx = (width + tilesize - 1)/tilesize;
+  header.tilesy = (height + tilesize - 1)/tilesize;
+  header.codec = DEMCODEC_RAW;
+  header.scale = scale;
+  header.nodata = nodata;
+  header.cellsize = cellsize;
+  header.xorigin = header.yorigin = 0.0;
+} //InitDEMHeader
+
+/// Check that a header is one that we know how to read.
+/// \param header Header to be checked.
+/// \return true if the header is valid.
+
+bool IsDEMHeaderValid(const DEMFileHeader& header){
+  return memcmp(header.magic, DEMFILE_MAGIC, sizeof(header.magic)) == 0 &&
+    header.version == DEMFILE_VERSION && header.headersize == sizeof(DEMFileHeader) &&
+    header.width > 0 && header.height > 0 && header.tilesize > 0 &&
+    header.tilesx == (header.width + header.tilesize - 1)/header.tilesize &&
+    header.tilesy == (header.height + header.tilesize - 1)/header.tilesize &&
+    (header.codec == DEMCODEC_RAW || header.codec == DEMCODEC_RICE) && header.scale > 0.0f;
+} //IsDEMHeaderValid
+
+/// Get the size of a tile once it has been decoded.
+/// \param header File header.
+/// \return Size of a decoded tile in bytes.
+
+long long DEMTileBytes(const DEMFileHeader& header){
+  return (long long)header.tilesize*header.tilesize*sizeof(unsigned short);
+} //DEMTileBytes
+
+/// Decode a tile.
+/// \param header File header.
+/// \param src Encoded tile.
+/// \param size Size of encoded tile in bytes.
+/// \param dest Buffer of DEMTileBytes(header) bytes for the decoded tile.
+/// \return true if it succeeds, false if the encoded tile is corrupt.
+
+bool DecodeDEMTile(const DEMFileHeader& header, const unsigned char* src, 
+  const unsigned long long size, unsigned short* dest)
+{
+  if(size == (unsigned long long)DEMTileBytes(header)){ //stored raw
+    memcpy(dest, src, (size_t)size);
+    return true;
+  } //if
+
+  if(header.codec == DEMCODEC_RICE)
+    return RiceDecodeTile(src, size, header.tilesize, dest);
+
+  return false;
+} //DecodeDEMTile
+
+/// The constructor doesn't do much, that's what Open() is for.
+
+CDEMFileWriter::CDEMFileWriter(): 
+  m_pFile(NULL), m_pIndex(NULL), m_nOffset(0), m_pTile(NULL), m_pBuffer(NULL), 
+  m_pStrip(NULL), m_nStripRows(0), m_nNextTileRow(0), m_bFailed(false)
+{
+  memset(&m_sHeader, 0, sizeof(DEMFileHeader));
+} //constructor
+
+/// The destructor closes the file if it is still open.
+
+CDEMFileWriter::~CDEMFileWriter(){
+  Close();
+} //destructor
+
+/// Create a packed DEM file and write its header and a placeholder index.
+/// \param filename Name of file to be created.
+/// \param header File header.
+/// \return true if it succeeds, false if it fails.
+
+bool CDEMFileWriter::Open(const char* filename, const DEMFileHeader& header){
+  Close();
+  if(!IsDEMHeaderValid(header))return false;
+
+  m_pFile = fopen(filename, "wb");
+  if(m_pFile == NULL)return false;
+
+  m_sHeader = header;
+  const int nNumTiles = header.tilesx*header.tilesy;
+  m_pIndex = new DEMTileIndex [nNumTiles];
+  memset(m_pIndex, 0, nNumTiles*sizeof(DEMTileIndex));
+  m_pTile = new unsigned short [header.tilesize*header.tilesize];
+  if(header.codec == DEMCODEC_RICE)
+    m_pBuffer = new unsigned char [(size_t)RiceTileBound(header.tilesize)];
+  m_nStripRows = m_nNextTileRow = 0;
+  m_bFailed = false;
+
+  m_bFailed |= fwrite(&m_sHeader, sizeof(DEMFileHeader), 1, m_pFile) != 1;
+  m_bFailed |= fwrite(m_pIndex, sizeof(DEMTileIndex), nNumTiles, m_pFile) != (size_t)nNumTiles;
+  m_nOffset = sizeof(DEMFileHeader) + nNumTiles*sizeof(DEMTileIndex);
+
+  return !m_bFailed;
+} //Open
+
+/// Encode the tile in m_pTile, write it out, and record it in the index.
+/// If encoding doesn't make it any smaller then it is written raw.
+/// \param tx Tile column.
+/// \param ty Tile row.
+/// \return true if it succeeds, false if it fails.
+
+bool CDEMFileWriter::WriteTile(const int tx, const int ty){
+  const size_t rawsize = (size_t)DEMTileBytes(m_sHeader);
+  const void* data = m_pTile; //data to be written
+  size_t size = rawsize; //size of data to be written
+
+  if(m_sHeader.codec == DEMCODEC_RICE){
+    const size_t encsize = (size_t)RiceEncodeTile(m_pTile, m_sHeader.tilesize, m_pBuffer);
+    if(encsize < rawsize){
+      data = m_pBuffer; size = encsize;
+    } //if
+  } //if
+
+  m_bFailed |= fwrite(data, size, 1, m_pFile) != 1;
+
+  DEMTileIndex& entry = m_pIndex[ty*m_sHeader.tilesx + tx];
+  entry.offset = m_nOffset;
+  entry.size = size;
+  m_nOffset += size;
+
+  return !m_bFailed;
+} //WriteTile
+
+/// Copy a tile into m_pTile, padding it out to full size with the nodata value
+/// if it is on the right or bottom edge.
+/// \param rows Array of pointers to the rows of heights that the tile covers.
+///   Only as many as are in the file are needed for the bottom row of tiles.
+/// \param j0 Index of the first column of the tile in each row.
+/// \param tx Tile column.
+/// \param ty Tile row.
+
+void CDEMFileWriter::FillTile(const unsigned short* const* rows, const int j0, const int tx, const int ty){
+  const int n = m_sHeader.tilesize; //tile size
+  const int nNumRows = //number of rows in this row of tiles
+    ty < (int)m_sHeader.tilesy - 1? n: m_sHeader.height - ty*n;
+  const int nNumCols = //number of columns in this column of tiles
+    tx < (int)m_sHeader.tilesx - 1? n: m_sHeader.width - tx*n;
+
+  for(int i=0; i<n; i++){ //for each row of the tile
+    unsigned short* dest = m_pTile + i*n;
+    int j = 0;
+
+    if(i < nNumRows){ //inside the array
+      memcpy(dest, rows[i] + j0, nNumCols*sizeof(unsigned short));
+      j = nNumCols;
+    } //if
+
+    for(; j<n; j++) //pad to full size
+      dest[j] = m_sHeader.nodata;
+  } //for
+} //FillTile
+
+/// Write a tile. Tiles can be written in any order, but each should be written
+/// only once. These calls shouldn't be mixed with calls to WriteRow().
+/// \param tx Tile column.
+/// \param ty Tile row.
+/// \param rows Array of pointers to the first point of each of the tilesize
+///   rows of heights that the tile covers, of which only as many points as
+///   are in the file are needed for tiles on the right and bottom edges.
+/// \return true if it succeeds, false if it fails.
+
+bool CDEMFileWriter::WriteTile(const int tx, const int ty, const unsigned short* const* rows){
+  if(m_pFile == NULL || tx < 0 || tx >= (int)m_sHeader.tilesx ||
+    ty < 0 || ty >= (int)m_sHeader.tilesy)return false;
+
+  FillTile(rows, 0, tx, ty);
+  return WriteTile(tx, ty);
+} //WriteTile
+
+/// Write a row of tiles. Rows of tiles can be written in any order.
+/// \param ty Tile row.
+/// \param rows Array of pointers to the tilesize rows of heights that this
+///   row of tiles covers, each width points long. Only as many as are in
+///   the file are needed for the bottom row of tiles.
+/// \return true if it succeeds, false if it fails.
+
+bool CDEMFileWriter::WriteTileRow(const int ty, const unsigned short* const* rows){
+  if(m_pFile == NULL || ty < 0 || ty >= (int)m_sHeader.tilesy)return false;
+
+  for(int tx=0; tx<(int)m_sHeader.tilesx; tx++){ //for each tile in the row
+    FillTile(rows, tx*m_sHeader.tilesize, tx, ty);
+    if(!WriteTile(tx, ty))return false;
+  } //for
+
+  return true;
+} //WriteTileRow
+
+/// Write the next row of heights. The rows are collected until there are
+/// enough to make a row of tiles, which is then written. These calls shouldn't
+/// be mixed with calls to WriteTileRow().
+/// \param row A row of width heights.
+/// \return true if it succeeds, false if it fails.
+
+bool CDEMFileWriter::WriteRow(const unsigned short* row){
+  if(m_pFile == NULL || m_nNextTileRow >= (int)m_sHeader.tilesy)return false;
+
+  const int n = m_sHeader.tilesize; //tile size
+  const int w = m_sHeader.width; //row length
+  if(m_pStrip == NULL)
+    m_pStrip = new unsigned short [(size_t)n*w];
+
+  memcpy(m_pStrip + (size_t)m_nStripRows*w, row, w*sizeof(unsigned short));
+  m_nStripRows++;
+
+  //write the row of tiles once it is complete
+  const int ty = m_nNextTileRow; //tile row
+  const int nNumRows = //number of rows in this row of tiles
+    ty < (int)m_sHeader.tilesy - 1? n: m_sHeader.height - ty*n;
+
+  if(m_nStripRows < nNumRows)return true;
+
+  const unsigned short** rows = new const unsigned short* [n];
+  for(int i=0; i<n; i++)
+    rows[i] = m_pStrip + (size_t)i*w;
+  const bool ok = WriteTileRow(ty, rows);
+  delete [] rows;
+
+  m_nStripRows = 0;
+  m_nNextTileRow++;
+  return ok;
+} //WriteRow
+
+/// Write the index over the placeholder and close the file.
+/// \return true if the whole file was written successfully.
+
+bool CDEMFileWriter::Close(){
+  if(m_pFile != NULL){
+    if(m_pStrip != NULL && m_nNextTileRow < (int)m_sHeader.tilesy)
+      m_bFailed = true; //rows written by WriteRow() are missing
+    const int nNumTiles = m_sHeader.tilesx*m_sHeader.tilesy;
+    for(int i=0; i<nNumTiles; i++)
+      if(m_pIndex[i].size == 0)
+        m_bFailed = true; //tile was never written
+    m_bFailed |= fseek(m_pFile, sizeof(DEMFileHeader), SEEK_SET) != 0;
+    m_bFailed |= fwrite(m_pIndex, sizeof(DEMTileIndex), nNumTiles, m_pFile) != (size_t)nNumTiles;
+    m_bFailed |= fclose(m_pFile) != 0;
+    m_pFile = NULL;
+  } //if
+
+  delete [] m_pIndex; m_pIndex = NULL;
+  delete [] m_pTile; m_pTile = NULL;
+  delete [] m_pBuffer; m_pBuffer = NULL;
+  delete [] m_pStrip; m_pStrip = NULL;
+
+  return !m_bFailed;
+} //Close
+
+/// Reader function for the number of bytes written.
+/// \return Number of bytes written to the file so far, including header and index.
+
+unsigned long long CDEMFileWriter::GetBytesWritten(){
+  return m_nOffset;
+} //GetBytesWritten
@@ -0,0 +1,129 @@
+/// \file GradientKernel.cpp
+/// \brief Code for the gradient recording kernel.
+
+// Copyright Ian Parberry, May 2014.
+//
+// This file is made available under the GNU All-Permissive License.
+//
+// Copying and distribution of this file, with or without modification,
+// are permitted in any medium without royalty provided the copyright
+// notice and this notice are preserved.  This file is offered as-is,
+// without any warranty.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "GradientKernel.h"
+
+#ifdef USE_SSE2
+  #include <emmintrin.h>
+#endif
+
+#include "SlopeStats.h"
+
+const int NUMSUBHISTOGRAMS = 4; ///< Number of interleaved sub-histograms, a power of 2.
+const int CHUNKVECTORS = 4096; ///< Vectors per chunk, small enough that the 16-bit counts and 32-bit sums in the lanes can't overflow.
+
+/// Record the gradients between points a[j] and b[j] for 0 <= j < n.
+/// The gradient is recorded if neither point is the no data value and the
+/// absolute height difference is less than the limit for the octave, exactly
+/// as if each one had been recorded in turn.
+/// \param stats Statistics to record the gradients in.
+/// \param k The octave from which the gradients are recorded.
+/// \param a First run of heights.
+/// \param b Second run of heights.
+/// \param n Number of points in each run.
+/// \param nodata Height of points with no data.
+/// \param limit Smallest height difference whose gradient is too large to sample, at least 1.
+/// \param bin Distribution bin for each height difference below the limit,
+///   GRANULARITY for out of range.
+
+void RecordGradients(SlopeStats& stats, const int k, const unsigned short* a, const unsigned short* b,
+  const int n, const unsigned short nodata, const int limit, const unsigned char* bin)
+{
+  if(n <= 0)return;
+
+  long long hist[NUMSUBHISTOGRAMS][GRANULARITY + 1]; //sub-histograms, the last bin for out of range
+  memset(hist, 0, sizeof(hist));
+  long long count = 0LL, sum = 0LL; //number and sum of height differences recorded
+  int maxdiff = -1; //largest height difference recorded
+  int j = 0; //current point
+
+#ifdef USE_SSE2
+  const __m128i vnodata = _mm_set1_epi16((short)nodata);
+  const __m128i vlimit = _mm_set1_epi16((short)min(limit - 1, 0xFFFF)); //largest good difference
+  const __m128i vsign = _mm_set1_epi16((short)0x8000); //to compare unsigned as signed
+  const __m128i vzero = _mm_setzero_si128();
+
+  CACHE_ALIGN unsigned short lane[8]; //height differences in the lanes of a vector
+
+  while(j + 8 <= n){ //for each chunk
+    const int end = j + 8*min((n - j)/8, CHUNKVECTORS); //end of whole vectors in chunk
+    __m128i vcount = vzero; //number of good differences in each 16-bit lane
+    __m128i vsum = vzero; //sum of good differences in each 32-bit lane
+    __m128i vmax = vsign; //largest good difference in each 16-bit lane, offset by 0x8000
+
+    for(; j<end; j+=8){ //for each vector of 8 points
+      const __m128i va = _mm_loadu_si128((const __m128i*)(a + j));
+      const __m128i vb = _mm_loadu_si128((const __m128i*)(b + j));
+
+      //absolute difference, and mask of lanes with data and a small enough difference
+      __m128i dh = _mm_or_si128(_mm_subs_epu16(va, vb), _mm_subs_epu16(vb, va));
+      const __m128i bad = _mm_or_si128(_mm_cmpeq_epi16(va, vnodata), _mm_cmpeq_epi16(vb, vnodata));
+      const __m128i good = _mm_andnot_si128(bad, _mm_cmpeq_epi16(_mm_subs_epu16(dh, vlimit), vzero));
+      dh = _mm_and_si128(dh, good); //bad lanes have difference 0
+
+      vcount = _mm_sub_epi16(vcount, good); //good lanes are -1
+      vsum = _mm_add_epi32(vsum, _mm_add_epi32(_mm_unpacklo_epi16(dh, vzero), _mm_unpackhi_epi16(dh, vzero)));
+      vmax = _mm_max_epi16(vmax, _mm_xor_si128(dh, vsign));
+
+      //add to distribution, bad lanes adding 0 to the bin for difference 0
+      _mm_store_si128((__m128i*)lane, dh);
+      const int mask = _mm_movemask_epi8(good); //2 bits per lane
+
+      for(int l=0; l<8; l++)
+        hist[l&(NUMSUBHISTOGRAMS - 1)][bin[lane[l]]] += (mask >> 2*l) & 1;
+    } //for each vector
+
+    //fold the lanes into the totals
+    unsigned short c[8], m[8];
+    unsigned int s[4];
+    _mm_storeu_si128((__m128i*)c, vcount);
+    _mm_storeu_si128((__m128i*)m, _mm_xor_si128(vmax, vsign));
+    _mm_storeu_si128((__m128i*)s, vsum);
+
+    long long chunkcount = 0LL; //number of good differences in chunk
+    int chunkmax = 0; //largest good difference in chunk, 0 if there are none
+    for(int l=0; l<8; l++){
+      chunkcount += c[l];
+      chunkmax = max(chunkmax, (int)m[l]);
+    } //for
+
+    if(chunkcount > 0LL)maxdiff = max(maxdiff, chunkmax);
+    count += chunkcount;
+    for(int l=0; l<4; l++)
+      sum += s[l];
+  } //for each chunk
+#endif
+
+  //the points left over
+  for(; j<n; j++){
+    const int dh = abs((int)a[j] - (int)b[j]);
+    const int good = (int)(a[j] != nodata) & (int)(b[j] != nodata) & (int)(dh < limit);
+    const int d = dh & -good; //0 if bad
+
+    count += good;
+    sum += d;
+    maxdiff = max(maxdiff, d | (good - 1)); //-1 if bad
+    hist[j&(NUMSUBHISTOGRAMS - 1)][bin[d]] += good;
+  } //for
+
+  //add to the statistics
+  stats.nPointCount[k] += count;
+  stats.nSumDiff[k] += sum;
+  stats.nMaxDiff[k] = max(stats.nMaxDiff[k], maxdiff);
+
+  for(int i=0; i<GRANULARITY; i++)
+    for(int h=0; h<NUMSUBHISTOGRAMS; h++)
+      stats.nDistribution[k][i] += hist[h][i];
+} //RecordGradients
@@ -0,0 +1,34 @@
+/// \file GradientKernel.h
+/// \brief Header for the gradient recording kernel.
+///
+/// The kernel records the gradients between corresponding points of two runs
+/// of packed heights, which are either a run of a row and the same run shifted
+/// a stride to the right, or a run of a row and the same run of the row a
+/// stride below it. Since the statistics are exact integers or maxima, the
+/// order in which gradients are recorded doesn't change the results, so
+/// the kernel is free to process 8 points at a time with SSE2, masking off
+/// points with no data or too large a gradient instead of branching on them.
+/// Distribution bins are counted in several interleaved sub-histograms, so that
+/// consecutive gradients that land in the same bin don't have to wait for each
+/// other's increments to get through the store buffer. Comment out the
+/// define of USE_SSE2 to use plain C++ for everything.
+
+// Copyright Ian Parberry, May 2014.
+//
+// This file is made available under the GNU All-Permissive License.
+//
+// Copying and distribution of this file, with or without modification,
+// are permitted in any medium without royalty provided the copyright
+// notice and this notice are preserved.  This file is offered as-is,
+// without any warranty.
+
+#pragma once
+
+#if defined(__SSE2__) || defined(_M_X64) //SSE2 is always there on 64-bit targets
+  #define USE_SSE2 ///< Use SSE2 intrinsics.
+#endif
+
+struct SlopeStats;
+
+void RecordGradients(SlopeStats& stats, const int k, const unsigned short* a, const unsigned short* b,
+  const int n, const unsigned short nodata, const int limit, const unsigned char* bin); ///< Record gradients.
@@ -0,0 +1,315 @@
+/// \file HeightData.cpp
+/// \brief Code for the packed height data class CHeightData.
+
+// Copyright Ian Parberry, May 2014.
+//
+// This file is made available under the GNU All-Permissive License.
+//
+// Copying and distribution of this file, with or without modification,
+// are permitted in any medium without royalty provided the copyright
+// notice and this notice are preserved.  This file is offered as-is,
+// without any warranty.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "HeightData.h"
+
+/// The constructor doesn't open anything, that's what Open() is for.
+
+CHeightData::CHeightData(): m_pBuffer(NULL), m_pFile(NULL), m_nFileSize(0LL),
+  m_bTiled(false), m_pIndex(NULL), m_pBand(NULL), m_nNumLoaded(0), 
+  m_nMaxLoaded(1), m_nTick(0LL), m_nNumBadTiles(0)
+{
+  memset(&m_sHeader, 0, sizeof(DEMFileHeader));
+} //constructor
+
+/// The destructor closes the file if it is still open.
+
+CHeightData::~CHeightData(){
+  Close();
+} //destructor
+
+/// Open a packed height data file. If it starts with a valid packed DEM file
+/// header then it is tiled, otherwise it is assumed to be a headerless
+/// row-major array of unsigned shorts described by the raw header.
+/// \param filename Name of file.
+/// \param bRead true to read the whole file into memory, false to map it.
+/// \param raw Header describing a raw file.
+/// \return true if it succeeds, false if it fails.
+
+bool CHeightData::Open(const char* filename, const bool bRead, const DEMFileHeader& raw){
+  Close();
+
+  if(bRead){ //read the whole file into memory
+    FILE* datafile = fopen(filename, "rb");
+    if(datafile == NULL)return false;
+    
+  #if defined(_MSC_VER) //Windows Visual Studio 
+    _fseeki64(datafile, 0, SEEK_END); m_nFileSize = _ftelli64(datafile);
+  #else //other OS
+    fseeko(datafile, 0, SEEK_END); m_nFileSize = ftello(datafile);
+  #endif
+    rewind(datafile);
+
+    m_pBuffer = m_nFileSize > 0? (unsigned char*)malloc((size_t)m_nFileSize): NULL;
+    bool ok = m_pBuffer != NULL && fread(m_pBuffer, (size_t)m_nFileSize, 1, datafile) == 1;
+    fclose(datafile);
+    if(!ok){Close(); return false;}
+    m_pFile = m_pBuffer;
+  } //if
+
+  else{ //map it
+    if(!m_cMappedFile.Open(filename))return false;
+    m_pFile = m_cMappedFile.GetData();
+    m_nFileSize = m_cMappedFile.GetSize();
+  } //else
+
+  //work out what kind of file it is
+  if(m_nFileSize >= (long long)sizeof(DEMFileHeader)){
+    memcpy(&m_sHeader, m_pFile, sizeof(DEMFileHeader));
+    m_bTiled = IsDEMHeaderValid(m_sHeader);
+  } //if
+
+  if(m_bTiled){ //check the index
+    const int nNumTiles = m_sHeader.tilesx*m_sHeader.tilesy;
+    const long long nIndexEnd = sizeof(DEMFileHeader) + nNumTiles*(long long)sizeof(DEMTileIndex);
+    if(nIndexEnd > m_nFileSize){Close(); return false;}
+    m_pIndex = (const DEMTileIndex*)(m_pFile + sizeof(DEMFileHeader));
+
+    m_pBand = new Band [m_sHeader.tilesy];
+    for(int b=0; b<(int)m_sHeader.tilesy; b++){
+      m_pBand[b].pData = NULL;
+      m_pBand[b].nRefCount = 0;
+      m_pBand[b].nLastUse = 0LL;
+      m_pBand[b].bLoading = false;
+    } //for
+  } //if
+
+  else{ //raw
+    m_sHeader = raw;
+    if(m_nFileSize < (long long)((unsigned long long)raw.width*raw.height*sizeof(unsigned short))){
+      Close(); return false;
+    } //if
+    if(!bRead)m_cMappedFile.AdviseSequential();
+  } //else
+
+  return true;
+} //Open
+
+/// Close the file and empty the band cache.
+
+void CHeightData::Close(){
+  if(m_pBand != NULL){
+    for(int b=0; b<(int)m_sHeader.tilesy; b++)
+      delete [] m_pBand[b].pData;
+    delete [] m_pBand;
+    m_pBand = NULL;
+  } //if
+
+  m_cMappedFile.Close();
+  if(m_pBuffer != NULL){
+    free(m_pBuffer); m_pBuffer = NULL;
+  } //if
+
+  m_pFile = NULL; m_pIndex = NULL;
+  m_nFileSize = 0LL;
+  m_bTiled = false;
+  m_nNumLoaded = 0;
+  m_nNumBadTiles = 0;
+  memset(&m_sHeader, 0, sizeof(DEMFileHeader));
+} //Close
+
+/// Set the amount of memory to be used for caching decoded bands of a tiled
+/// file. At least one band is always kept, and more than this may be used if
+/// more bands are acquired at once than fit into the cache.
+/// \param bytes Size of band cache in bytes.
+
+void CHeightData::SetCacheSize(const long long bytes){
+  const long long nBandBytes = 
+    (long long)m_sHeader.tilesize*m_sHeader.width*sizeof(unsigned short);
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_nMaxLoaded = nBandBytes > 0? (int)(bytes/nBandBytes): 1;
+  if(m_nMaxLoaded < 1)m_nMaxLoaded = 1;
+  Evict();
+} //SetCacheSize
+
+/// Decode a row of tiles into a band of rows. Corrupt or missing tiles are
+/// counted and treated as having no data.
+/// \param b Band number, which is the same as tile row.
+/// \param dest Buffer for tilesize rows of width heights.
+
+void CHeightData::LoadBand(const int b, unsigned short* dest){
+  const int n = m_sHeader.tilesize; //tile size
+  const int w = m_sHeader.width; //row width
+  unsigned short* tile = new unsigned short [n*n];
+  int nNumBad = 0;
+
+  for(int tx=0; tx<(int)m_sHeader.tilesx; tx++){ //for each tile in the band
+    const DEMTileIndex& entry = m_pIndex[b*m_sHeader.tilesx + tx];
+    const unsigned long long size = (unsigned long long)m_nFileSize; //file size
+    const bool ok = entry.offset <= size && entry.size <= size - entry.offset &&
+      DecodeDEMTile(m_sHeader, m_pFile + entry.offset, entry.size, tile);
+
+    if(!ok){ //corrupt or missing
+      nNumBad++;
+      for(int i=0; i<n*n; i++)
+        tile[i] = m_sHeader.nodata;
+    } //if
+
+    const int j0 = tx*n; //first column of tile
+    const int nNumCols = j0 + n <= w? n: w - j0; //columns of tile inside array
+    for(int i=0; i<n; i++)
+      memcpy(dest + (long long)i*w + j0, tile + i*n, nNumCols*sizeof(unsigned short));
+  } //for
+
+  delete [] tile;
+
+  if(nNumBad > 0){
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_nNumBadTiles += nNumBad;
+  } //if
+} //LoadBand
+
+/// Evict least recently used bands that aren't in use until the cache is 
+/// no bigger than it should be. The caller must hold the mutex.
+
+void CHeightData::Evict(){
+  if(m_pBand == NULL)return;
+
+  while(m_nNumLoaded > m_nMaxLoaded){
+    int nVictim = -1; //least recently used band not in use
+
+    for(int b=0; b<(int)m_sHeader.tilesy; b++)
+      if(m_pBand[b].pData != NULL && m_pBand[b].nRefCount == 0 &&
+        (nVictim < 0 || m_pBand[b].nLastUse < m_pBand[nVictim].nLastUse))
+        nVictim = b;
+
+    if(nVictim < 0)return; //everything is in use
+
+    delete [] m_pBand[nVictim].pData;
+    m_pBand[nVictim].pData = NULL;
+    m_nNumLoaded--;
+  } //while
+} //Evict
+
+/// Clip a range of rows to the array.
+/// \param i0 First row of range.
+/// \param i1 One past the last row of range.
+/// \return true if what remains of the range is not empty.
+
+bool CHeightData::Clip(int& i0, int& i1){
+  if(i0 < 0)i0 = 0;
+  if(i1 > (int)m_sHeader.height)i1 = m_sHeader.height;
+  return i0 < i1;
+} //Clip
+
+/// Make a range of rows available through GetRow() until it is released.
+/// Rows of a tiled file that aren't in the cache are decoded, which may mean
+/// waiting for another thread that is already decoding them.
+/// \param i0 First row of range.
+/// \param i1 One past the last row of range.
+
+void CHeightData::Acquire(int i0, int i1){
+  if(!m_bTiled || !Clip(i0, i1))return;
+
+  const int n = m_sHeader.tilesize;
+  const long long nBandSize = (long long)n*m_sHeader.width; //heights in a band
+
+  for(int b=i0/n; b<=(i1 - 1)/n; b++){ //for each band in range
+    std::unique_lock<std::mutex> lock(m_mutex);
+    Band& band = m_pBand[b];
+    band.nRefCount++;
+
+    if(band.pData == NULL && !band.bLoading){ //we get to decode it
+      band.bLoading = true;
+      lock.unlock();
+      unsigned short* p = new unsigned short [nBandSize];
+      LoadBand(b, p);
+      lock.lock();
+      band.pData = p;
+      band.bLoading = false;
+      m_nNumLoaded++;
+      Evict();
+      m_cvLoaded.notify_all();
+    } //if
+
+    while(band.pData == NULL) //someone else is decoding it
+      m_cvLoaded.wait(lock);
+  } //for
+} //Acquire
+
+/// Say that a range of rows that was acquired is no longer being used.
+/// \param i0 First row of range.
+/// \param i1 One past the last row of range.
+
+void CHeightData::Release(int i0, int i1){
+  if(!m_bTiled || !Clip(i0, i1))return;
+
+  const int n = m_sHeader.tilesize;
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  for(int b=i0/n; b<=(i1 - 1)/n; b++){ //for each band in range
+    m_pBand[b].nRefCount--;
+    m_pBand[b].nLastUse = m_nTick++;
+  } //for
+
+  Evict();
+} //Release
+
+/// Tell the operating system that a range of rows of a raw file will be
+/// needed soon.
+/// \param i0 First row of range.
+/// \param i1 One past the last row of range.
+
+void CHeightData::Prefetch(int i0, int i1){
+  if(m_bTiled || !Clip(i0, i1))return;
+  const long long nRowBytes = (long long)m_sHeader.width*sizeof(unsigned short);
+  m_cMappedFile.Prefetch(i0*nRowBytes, (i1 - i0)*nRowBytes);
+} //Prefetch
+
+/// Tell the operating system that a range of rows of a raw file won't be
+/// needed again, so that their pages can be dropped from this process.
+/// \param i0 First row of range.
+/// \param i1 One past the last row of range.
+
+void CHeightData::Discard(int i0, int i1){
+  if(m_bTiled || !Clip(i0, i1))return;
+  const long long nRowBytes = (long long)m_sHeader.width*sizeof(unsigned short);
+  m_cMappedFile.Release(i0*nRowBytes, (i1 - i0)*nRowBytes);
+} //Discard
+
+/// Get a pointer to a row. The row must have been acquired and not yet released.
+/// \param i Row number.
+/// \return Pointer to the first of width heights in row i.
+
+const unsigned short* CHeightData::GetRow(const int i){
+  if(!m_bTiled)
+    return (const unsigned short*)m_pFile + (long long)i*m_sHeader.width;
+
+  const int n = m_sHeader.tilesize;
+  return m_pBand[i/n].pData + (long long)(i%n)*m_sHeader.width;
+} //GetRow
+
+/// Reader function for the file header.
+/// \return The file header, or the raw header if the file is not tiled.
+
+const DEMFileHeader& CHeightData::GetHeader(){
+  return m_sHeader;
+} //GetHeader
+
+/// Reader function for whether the file is tiled.
+/// \return true if the file is in the tiled packed DEM file format.
+
+bool CHeightData::IsTiled(){
+  return m_bTiled;
+} //IsTiled
+
+/// Reader function for the number of corrupt tiles.
+/// \return Number of corrupt or missing tiles found so far.
+
+int CHeightData::GetNumBadTiles(){
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_nNumBadTiles;
+} //GetNumBadTiles
@@ -0,0 +1,84 @@
+/// \file HeightData.h
+/// \brief Header for the packed height data class CHeightData.
+
+// Copyright Ian Parberry, May 2014.
+//
+// This file is made available under the GNU All-Permissive License.
+//
+// Copying and distribution of this file, with or without modification,
+// are permitted in any medium without royalty provided the copyright
+// notice and this notice are preserved.  This file is offered as-is,
+// without any warranty.
+
+#pragma once
+
+#include <mutex> //for std::mutex
+#include <condition_variable> //for std::condition_variable
+
+#include "MappedFile.h"
+#include "DEMFile.h"
+
+/// \brief Packed height data.
+///
+/// Gives access to the rows of a packed height data file, which may be either
+/// in the tiled packed DEM file format from DEMFile.h or a headerless row-major
+/// array of unsigned shorts. The file is memory mapped unless it is asked to 
+/// read it instead. Rows of a raw file are accessed directly from
+/// the file. Rows of a tiled file are decoded a row of tiles (a band) at a time
+/// into a cache of bands. Bands that are no longer in use are evicted least 
+/// recently used first when the cache gets too big. Rows must be acquired
+/// before they are used and released afterwards. Any number of threads can
+/// do that at the same time.
+
+class CHeightData{
+  private:
+    /// \brief A band of rows decoded from a row of tiles.
+
+    struct Band{
+      unsigned short* pData; ///< Decoded rows, or NULL if not loaded.
+      int nRefCount; ///< Number of outstanding acquisitions.
+      long long nLastUse; ///< Tick at which it was last released.
+      bool bLoading; ///< Whether some thread is decoding it.
+    }; //Band
+
+    CMappedFile m_cMappedFile; ///< The file, if mapped.
+    unsigned char* m_pBuffer; ///< The file, if read.
+    const unsigned char* m_pFile; ///< Start of the file, however it got into memory.
+    long long m_nFileSize; ///< Size of the file in bytes.
+
+    DEMFileHeader m_sHeader; ///< File header, made up for raw files.
+    bool m_bTiled; ///< Whether the file is tiled.
+    const DEMTileIndex* m_pIndex; ///< Tile index of a tiled file.
+
+    Band* m_pBand; ///< Band cache, one entry per row of tiles.
+    int m_nNumLoaded; ///< Number of bands currently in the cache.
+    int m_nMaxLoaded; ///< Number of bands allowed in the cache before evicting.
+    long long m_nTick; ///< Counts releases, to find least recently used bands.
+    int m_nNumBadTiles; ///< Number of corrupt tiles found.
+
+    std::mutex m_mutex; ///< Protects the band cache.
+    std::condition_variable m_cvLoaded; ///< Signalled when a band has been decoded.
+
+    void LoadBand(const int b, unsigned short* dest); ///< Decode a band.
+    void Evict(); ///< Evict unused bands until the cache is small enough.
+    bool Clip(int& i0, int& i1); ///< Clip a range of rows.
+
+  public:
+    CHeightData(); ///< Constructor.
+    ~CHeightData(); ///< Destructor.
+
+    bool Open(const char* filename, const bool bRead, const DEMFileHeader& raw); ///< Open a file.
+    void Close(); ///< Close the file.
+    void SetCacheSize(const long long bytes); ///< Set the size of the band cache.
+
+    void Acquire(int i0, int i1); ///< Make a range of rows available.
+    void Release(int i0, int i1); ///< Say that a range of rows is no longer being used.
+    void Prefetch(int i0, int i1); ///< Hint that a range of rows will be needed soon.
+    void Discard(int i0, int i1); ///< Hint that a range of rows won't be needed again.
+
+    const unsigned short* GetRow(const int i); ///< Get an acquired row.
+
+    const DEMFileHeader& GetHeader(); ///< Get the file header.
+    bool IsTiled(); ///< Whether the file is tiled.
+    int GetNumBadTiles(); ///< Get the number of corrupt tiles found.
+}; //CHeightData
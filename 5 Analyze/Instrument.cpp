@@ -0,0 +1,381 @@
+/// \file Instrument.cpp
+/// \brief Code for the instrumentation counters.
+
+// Copyright Ian Parberry, May 2014.
+//
+// This file is made available under the GNU All-Permissive License.
+//
+// Copying and distribution of this file, with or without modification,
+// are permitted in any medium without royalty provided the copyright
+// notice and this notice are preserved.  This file is offered as-is,
+// without any warranty.
+
+#include "Instrument.h"
+
+#ifdef INSTRUMENT
+
+#include <string.h> //for strncpy()
+
+#include <thread> //for std::thread
+#include <mutex> //for std::mutex
+#include <condition_variable> //for std::condition_variable
+#include <chrono> //for std::chrono::milliseconds
+
+#if defined(_MSC_VER) //Windows Visual Studio
+  #include <windows.h> //for QueryPerformanceCounter()
+  #pragma warning(disable : 4996) //disable annoying security warnings for stdio functions
+#else //other OS
+  #include <time.h> //for clock_gettime()
+#endif
+
+CInstrument g_cInstrument; ///< The instrumentation counters.
+
+static std::thread g_threadReporter; ///< Reporter thread.
+static std::mutex g_mReporter; ///< Mutex for g_bReporterDone.
+static std::condition_variable g_cvReporter; ///< Signalled when the reporter should stop.
+static bool g_bReporterDone = false; ///< Whether the reporter should stop.
+static bool g_bReporterRunning = false; ///< Whether the reporter thread was started.
+
+/// The constructor marks all counters as unused.
+
+CInstrument::CInstrument(): m_nTotal(0), m_nNumCounters(0),
+  m_dStartTime(0.0), m_dLastTime(0.0), m_pLog(NULL)
+{
+  for(int i=0; i<INSTRUMENT_MAXCOUNTERS; i++){
+    m_nCount[i] = 0LL;
+    m_nTime[i] = 0LL;
+    m_strName[i][0] = '\0';
+    m_strUnit[i] = "";
+    m_dScale[i] = 1.0;
+    m_nFlags[i] = 0;
+    m_nPercentOf[i] = -1;
+    m_nSumFirst[i] = -1;
+    m_nSumCount[i] = 0;
+    m_nLastCount[i] = 0LL;
+  } //for
+} //constructor
+
+/// Get the current time from a monotonic clock, which unlike the time of
+/// day never jumps backwards.
+/// \return Time in nanoseconds from some arbitrary starting point.
+
+long long CInstrument::GetNanoseconds(){
+  #if defined(_MSC_VER) //Windows Visual Studio
+    LARGE_INTEGER count, frequency;
+    QueryPerformanceCounter(&count);
+    QueryPerformanceFrequency(&frequency);
+    return (long long)(count.QuadPart*(1e9/(double)frequency.QuadPart));
+  #else //other OS
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec*1000000000LL + t.tv_nsec;
+  #endif
+} //GetNanoseconds
+
+/// Describe a counter. This must be done before Start().
+/// \param i Counter number.
+/// \param name Name of counter, at most 31 characters.
+/// \param unit Name of the unit of work, which must outlast the counter.
+/// \param scale Multiply counts by this to get units, for example 1e-6 for megabytes.
+/// \param flags Combination of CounterFlags.
+
+void CInstrument::SetCounter(const int i, const char* name, const char* unit,
+  const double scale, const int flags)
+{
+  if(i < 0 || i >= INSTRUMENT_MAXCOUNTERS)return;
+
+  strncpy(m_strName[i], name, sizeof(m_strName[i]) - 1);
+  m_strName[i][sizeof(m_strName[i]) - 1] = '\0';
+  m_strUnit[i] = unit;
+  m_dScale[i] = scale;
+  m_nFlags[i] = flags;
+
+  if(i >= m_nNumCounters)
+    m_nNumCounters = i + 1;
+} //SetCounter
+
+/// Make a counter be reported as a percentage of another one, for example
+/// bad points as a percentage of points read. It is added to as usual.
+/// \param i Counter number.
+/// \param name Name of counter.
+/// \param of Counter that it is a percentage of.
+
+void CInstrument::SetPercent(const int i, const char* name, const int of){
+  SetCounter(i, name, "%", 1.0, COUNTER_PERIODIC);
+  if(i >= 0 && i < INSTRUMENT_MAXCOUNTERS)
+    m_nPercentOf[i] = of;
+} //SetPercent
+
+/// Make a counter be the sum of a range of other counters, for example the
+/// gradients recorded in all octaves. It should not be added to.
+/// \param i Counter number.
+/// \param name Name of counter.
+/// \param unit Name of the unit of work.
+/// \param first First counter in the range.
+/// \param n Number of counters in the range.
+
+void CInstrument::SetSum(const int i, const char* name, const char* unit, const int first, const int n){
+  SetCounter(i, name, unit, m_dScale[first], COUNTER_PERIODIC|COUNTER_TIMED);
+  if(i >= 0 && i < INSTRUMENT_MAXCOUNTERS){
+    m_nSumFirst[i] = first;
+    m_nSumCount[i] = n;
+  } //if
+} //SetSum
+
+/// Set the amount of work that the counter with the COUNTER_PROGRESS flag
+/// will have counted when the program is finished, for the progress and
+/// estimated time remaining.
+/// \param total Amount of work, in counts.
+
+void CInstrument::SetTotal(const long long total){
+  m_nTotal = total;
+} //SetTotal
+
+/// Add work to a counter.
+/// \param i Counter number.
+/// \param n Amount of work.
+
+void CInstrument::Add(const int i, const long long n){
+  m_nCount[i].fetch_add(n, std::memory_order_relaxed);
+} //Add
+
+/// Add work and the time that it took to a counter.
+/// \param i Counter number.
+/// \param n Amount of work.
+/// \param ns Time in nanoseconds.
+
+void CInstrument::AddTime(const int i, const long long n, const long long ns){
+  if(n != 0)m_nCount[i].fetch_add(n, std::memory_order_relaxed);
+  m_nTime[i].fetch_add(ns, std::memory_order_relaxed);
+} //AddTime
+
+/// Get the value of a counter, which for a sum is the sum of the counters
+/// that it is the sum of.
+/// \param i Counter number.
+/// \return Amount of work counted.
+
+long long CInstrument::GetCount(const int i){
+  if(m_nSumFirst[i] < 0)
+    return m_nCount[i].load(std::memory_order_relaxed);
+
+  long long n = 0LL;
+  for(int j=0; j<m_nSumCount[i]; j++)
+    n += m_nCount[m_nSumFirst[i] + j].load(std::memory_order_relaxed);
+  return n;
+} //GetCount
+
+/// Get the time spent on the work in a counter, added up over all threads.
+/// \param i Counter number.
+/// \return Time in nanoseconds.
+
+long long CInstrument::GetTime(const int i){
+  if(m_nSumFirst[i] < 0)
+    return m_nTime[i].load(std::memory_order_relaxed);
+
+  long long n = 0LL;
+  for(int j=0; j<m_nSumCount[i]; j++)
+    n += m_nTime[m_nSumFirst[i] + j].load(std::memory_order_relaxed);
+  return n;
+} //GetTime
+
+/// Print a counter's value and its rate, or its percentage.
+/// \param output File to print to.
+/// \param i Counter number.
+/// \param count Amount of work.
+/// \param seconds Time that the work took.
+
+void CInstrument::PrintValue(FILE* output, const int i, const long long count, const double seconds){
+  if(m_nPercentOf[i] >= 0){ //percentage
+    const long long of = GetCount(m_nPercentOf[i]);
+    fprintf(output, "%s %0.2f%%", m_strName[i], of > 0? 100.0*count/(double)of: 0.0);
+  } //if
+  else fprintf(output, "%s %0.2f %s/s", m_strName[i],
+    seconds > 0.0? count*m_dScale[i]/seconds: 0.0, m_strUnit[i]);
+} //PrintValue
+
+/// \brief Reporter thread.
+///
+/// Report every interval seconds until told to stop.
+/// \param interval Time between reports in seconds.
+
+static void ReporterThread(const double interval){
+  std::unique_lock<std::mutex> lock(g_mReporter);
+  while(!g_bReporterDone)
+    if(!g_cvReporter.wait_for(lock, std::chrono::milliseconds((long long)(1000.0*interval)),
+      []{return g_bReporterDone;}))
+    {
+      lock.unlock();
+      g_cInstrument.Report();
+      lock.lock();
+    } //if
+} //ReporterThread
+
+/// Start the clock, write the header of the log file, and start a thread
+/// that reports progress periodically.
+/// \param interval Time between reports in seconds, 0 for no periodic reports.
+/// \param logfilename Name of a tab-separated log file to report to as well, or NULL for none.
+
+void CInstrument::Start(const double interval, const char* logfilename){
+  m_dStartTime = m_dLastTime = GetNanoseconds()/1e9;
+  for(int i=0; i<m_nNumCounters; i++)
+    m_nLastCount[i] = GetCount(i);
+
+  if(logfilename != NULL){
+    m_pLog = fopen(logfilename, "wt");
+    if(m_pLog == NULL)
+      fprintf(stderr, "Failed to create log file %s\n", logfilename);
+  } //if
+
+  if(m_pLog != NULL){
+    fprintf(m_pLog, "seconds");
+    for(int i=0; i<m_nNumCounters; i++)
+      if(m_strName[i][0]){
+        fprintf(m_pLog, "\t%s", m_strName[i]);
+        if(m_nPercentOf[i] < 0)
+          fprintf(m_pLog, "\t%s_per_s", m_strName[i]);
+        if(m_nFlags[i] & COUNTER_TIMED)
+          fprintf(m_pLog, "\t%s_busy_s", m_strName[i]);
+      } //if
+    if(m_nTotal > 0)fprintf(m_pLog, "\tprogress\teta_s");
+    fprintf(m_pLog, "\n");
+  } //if
+
+  if(interval > 0.0){
+    g_bReporterDone = false;
+    g_threadReporter = std::thread(ReporterThread, interval);
+    g_bReporterRunning = true;
+  } //if
+} //Start
+
+/// Print the rate of each periodic counter since the last report, and the
+/// progress and estimated time remaining, to stderr. Append the values of all
+/// counters since the start to the log file, if there is one.
+
+void CInstrument::Report(){
+  const double now = GetNanoseconds()/1e9;
+  const double elapsed = now - m_dStartTime;
+  const double seconds = now - m_dLastTime;
+  double progress = -1.0; //fraction of work done, or negative if unknown
+
+  fprintf(stderr, "[%8.1fs]", elapsed);
+
+  for(int i=0; i<m_nNumCounters; i++)
+    if(m_strName[i][0]){
+      const long long count = GetCount(i);
+
+      if(m_nFlags[i] & COUNTER_PERIODIC){
+        fprintf(stderr, " | ");
+        if(m_nPercentOf[i] >= 0)PrintValue(stderr, i, count, seconds);
+        else PrintValue(stderr, i, count - m_nLastCount[i], seconds);
+      } //if
+
+      if((m_nFlags[i] & COUNTER_PROGRESS) && m_nTotal > 0)
+        progress = count/(double)m_nTotal;
+      m_nLastCount[i] = count;
+    } //if
+
+  if(progress > 0.0){
+    const int eta = (int)(elapsed*(1.0 - progress)/progress + 0.5);
+    fprintf(stderr, " | %0.1f%% ETA %d:%02d:%02d", 100.0*progress, eta/3600, (eta/60)%60, eta%60);
+  } //if
+
+  fprintf(stderr, "\n");
+  m_dLastTime = now;
+
+  if(m_pLog != NULL){
+    fprintf(m_pLog, "%0.3f", elapsed);
+    for(int i=0; i<m_nNumCounters; i++)
+      if(m_strName[i][0]){
+        const long long count = GetCount(i);
+        if(m_nPercentOf[i] >= 0){
+          const long long of = GetCount(m_nPercentOf[i]);
+          fprintf(m_pLog, "\t%0.4f", of > 0? 100.0*count/(double)of: 0.0);
+        } //if
+        else fprintf(m_pLog, "\t%0.6g\t%0.6g", count*m_dScale[i],
+          elapsed > 0.0? count*m_dScale[i]/elapsed: 0.0);
+        if(m_nFlags[i] & COUNTER_TIMED)
+          fprintf(m_pLog, "\t%0.3f", GetTime(i)/1e9);
+      } //if
+    if(m_nTotal > 0)
+      fprintf(m_pLog, "\t%0.4f\t%0.1f", progress < 0.0? 0.0: progress,
+        progress > 0.0? elapsed*(1.0 - progress)/progress: -1.0);
+    fprintf(m_pLog, "\n");
+    fflush(m_pLog);
+  } //if
+} //Report
+
+/// Stop the reporter thread, make a last report, and print a summary of
+/// each counter to stderr. The summary gives the total amount of work, its
+/// rate over the whole run, and for timed counters the time spent on it added
+/// up over all threads, its share of the time spent on all timed counters,
+/// and its rate per busy second. A stage with a large share of the time is
+/// the bottleneck.
+
+void CInstrument::Stop(){
+  if(g_bReporterRunning){
+    {
+      std::lock_guard<std::mutex> lock(g_mReporter);
+      g_bReporterDone = true;
+    }
+    g_cvReporter.notify_all();
+    g_threadReporter.join();
+    g_bReporterRunning = false;
+  } //if
+
+  Report();
+
+  const double elapsed = GetNanoseconds()/1e9 - m_dStartTime;
+  long long nTotalTime = 0LL; //time spent on all timed counters that aren't sums
+  for(int i=0; i<m_nNumCounters; i++)
+    if(m_strName[i][0] && (m_nFlags[i] & COUNTER_TIMED) && m_nSumFirst[i] < 0)
+      nTotalTime += GetTime(i);
+
+  fprintf(stderr, "Instrumentation summary for %0.1f seconds:\n", elapsed);
+  for(int i=0; i<m_nNumCounters; i++)
+    if(m_strName[i][0]){
+      const long long count = GetCount(i);
+      fprintf(stderr, "  ");
+
+      if(m_nPercentOf[i] >= 0)PrintValue(stderr, i, count, elapsed);
+      else{
+        fprintf(stderr, "%s %0.6g %s, %0.2f %s/s", m_strName[i], count*m_dScale[i], m_strUnit[i],
+          elapsed > 0.0? count*m_dScale[i]/elapsed: 0.0, m_strUnit[i]);
+      } //else
+
+      if(m_nFlags[i] & COUNTER_TIMED){
+        const double busy = GetTime(i)/1e9;
+        fprintf(stderr, ", busy %0.2fs", busy);
+        if(nTotalTime > 0 && m_nSumFirst[i] < 0)
+          fprintf(stderr, " (%0.1f%%)", 100.0*GetTime(i)/(double)nTotalTime);
+        if(busy > 0.0)
+          fprintf(stderr, ", %0.2f %s per busy second", count*m_dScale[i]/busy, m_strUnit[i]);
+      } //if
+
+      fprintf(stderr, "\n");
+    } //if
+
+  if(m_pLog != NULL){
+    fclose(m_pLog);
+    m_pLog = NULL;
+  } //if
+} //Stop
+
+/// The constructor starts the clock.
+/// \param counter Counter to add to.
+/// \param count Count to watch, or NULL for none.
+
+CStageTimer::CStageTimer(const int counter, const long long* count):
+  m_nCounter(counter), m_nStartTime(CInstrument::GetNanoseconds()),
+  m_pCount(count), m_nStartCount(count? *count: 0LL)
+{
+} //constructor
+
+/// The destructor adds the time since construction, and how much the watched
+/// count went up, to the counter.
+
+CStageTimer::~CStageTimer(){
+  g_cInstrument.AddTime(m_nCounter, m_pCount? *m_pCount - m_nStartCount: 0LL,
+    CInstrument::GetNanoseconds() - m_nStartTime);
+} //destructor
+
+#endif
@@ -0,0 +1,135 @@
+/// \file Instrument.h
+/// \brief Header for the instrumentation counters.
+///
+/// Instrumentation counters let a long-running program report how fast each
+/// stage is going while it runs. Each counter adds up an amount of work, such
+/// as bytes read or points parsed, and the time spent doing it, from any
+/// number of threads. A reporter thread prints the throughput of each stage,
+/// progress, and an estimate of the time remaining to stderr every so often,
+/// and can also append them to a tab-separated log file. At the end it prints
+/// a summary of the whole run, which shows which stage is the bottleneck.
+///
+/// The counters are only ever touched through the INSTRUMENT_ macros below.
+/// Comment out the \#define INSTRUMENT to compile them out completely.
+
+// Copyright Ian Parberry, May 2014.
+//
+// This file is made available under the GNU All-Permissive License.
+//
+// Copying and distribution of this file, with or without modification,
+// are permitted in any medium without royalty provided the copyright
+// notice and this notice are preserved.  This file is offered as-is,
+// without any warranty.
+
+#pragma once
+
+#define INSTRUMENT ///< Comment this out to compile out the instrumentation.
+
+#ifdef INSTRUMENT
+
+#include <stdio.h> //for FILE
+#include <atomic> //for std::atomic
+
+const int INSTRUMENT_MAXCOUNTERS = 32; ///< Largest number of counters.
+
+/// \brief Counter flags.
+///
+/// Flags that say how a counter is reported.
+
+enum CounterFlags{
+  COUNTER_PERIODIC = 1, ///< Report periodically as well as at the end.
+  COUNTER_PROGRESS = 2, ///< Progress and time remaining are measured by this counter.
+  COUNTER_TIMED = 4 ///< Report time, share of time, and throughput per busy second.
+}; //CounterFlags
+
+/// \brief Instrumentation counters.
+///
+/// A set of counters that can be added to from any thread, and a reporter
+/// thread that prints them. A counter can be the percentage of another
+/// counter, for example bad points as a percentage of all points, or the
+/// sum of a range of other counters, for example gradients recorded in all
+/// octaves.
+
+class CInstrument{
+  private:
+    std::atomic<long long> m_nCount[INSTRUMENT_MAXCOUNTERS]; ///< Amount of work done.
+    std::atomic<long long> m_nTime[INSTRUMENT_MAXCOUNTERS]; ///< Time spent in nanoseconds, added up over threads.
+    char m_strName[INSTRUMENT_MAXCOUNTERS][32]; ///< Name of counter, empty if unused.
+    const char* m_strUnit[INSTRUMENT_MAXCOUNTERS]; ///< Name of unit of work.
+    double m_dScale[INSTRUMENT_MAXCOUNTERS]; ///< Multiply count by this to get units.
+    int m_nFlags[INSTRUMENT_MAXCOUNTERS]; ///< Combination of CounterFlags.
+    int m_nPercentOf[INSTRUMENT_MAXCOUNTERS]; ///< Counter that this is a percentage of, or -1.
+    int m_nSumFirst[INSTRUMENT_MAXCOUNTERS]; ///< First counter that this is the sum of, or -1.
+    int m_nSumCount[INSTRUMENT_MAXCOUNTERS]; ///< Number of counters that this is the sum of.
+    long long m_nTotal; ///< Amount of work for the progress counter to reach when finished.
+    int m_nNumCounters; ///< One more than the largest counter used.
+
+    double m_dStartTime; ///< Time that the reporter started.
+    double m_dLastTime; ///< Time of the last report.
+    long long m_nLastCount[INSTRUMENT_MAXCOUNTERS]; ///< Value of each counter at the last report.
+    FILE* m_pLog; ///< Log file, or NULL for none.
+
+    long long GetCount(const int i); ///< Get a counter's value.
+    long long GetTime(const int i); ///< Get a counter's time.
+    void PrintValue(FILE* output, const int i, const long long count, const double seconds); ///< Print a counter.
+
+    CInstrument(const CInstrument&); ///< Not copyable.
+    CInstrument& operator=(const CInstrument&); ///< Not copyable.
+
+  public:
+    CInstrument(); ///< Constructor.
+
+    void SetCounter(const int i, const char* name, const char* unit,
+      const double scale=1.0, const int flags=COUNTER_PERIODIC|COUNTER_TIMED); ///< Describe a counter.
+    void SetPercent(const int i, const char* name, const int of); ///< Make a counter a percentage of another.
+    void SetSum(const int i, const char* name, const char* unit, const int first, const int n); ///< Make a counter a sum of others.
+    void SetTotal(const long long total); ///< Set the amount of work for the progress counter.
+
+    void Add(const int i, const long long n); ///< Add work to a counter.
+    void AddTime(const int i, const long long n, const long long ns); ///< Add work and time to a counter.
+
+    void Start(const double interval, const char* logfilename); ///< Start reporting.
+    void Report(); ///< Report progress now.
+    void Stop(); ///< Stop reporting and print a summary.
+
+    static long long GetNanoseconds(); ///< Get the time from a monotonic clock.
+}; //CInstrument
+
+extern CInstrument g_cInstrument; ///< The instrumentation counters.
+
+/// \brief Stage timer.
+///
+/// A stage timer adds the time from when it is constructed to when it is
+/// destroyed to a counter. If it is given a count to watch, it also adds how
+/// much that count went up in the meantime, which saves the caller from
+/// having to keep a copy of it.
+
+class CStageTimer{
+  private:
+    int m_nCounter; ///< Counter to add to.
+    long long m_nStartTime; ///< Time at construction in nanoseconds.
+    const long long* m_pCount; ///< Count being watched, or NULL.
+    long long m_nStartCount; ///< Value of the watched count at construction.
+
+    CStageTimer(const CStageTimer&); ///< Not copyable.
+    CStageTimer& operator=(const CStageTimer&); ///< Not copyable.
+
+  public:
+    CStageTimer(const int counter, const long long* count=NULL); ///< Constructor.
+    ~CStageTimer(); ///< Destructor.
+}; //CStageTimer
+
+#define INSTRUMENT_JOIN2(a, b) a##b ///< Paste tokens.
+#define INSTRUMENT_JOIN(a, b) INSTRUMENT_JOIN2(a, b) ///< Paste tokens after expanding them.
+
+#define INSTRUMENT_ADD(i, n) g_cInstrument.Add(i, n) ///< Add work to a counter.
+#define INSTRUMENT_TIME(i) CStageTimer INSTRUMENT_JOIN(stagetimer, __LINE__)(i) ///< Time the rest of the block.
+#define INSTRUMENT_TIME_COUNT(i, count) CStageTimer INSTRUMENT_JOIN(stagetimer, __LINE__)(i, &(count)) ///< Time the rest of the block and watch a count.
+
+#else //compiled out
+
+#define INSTRUMENT_ADD(i, n)
+#define INSTRUMENT_TIME(i)
+#define INSTRUMENT_TIME_COUNT(i, count)
+
+#endif
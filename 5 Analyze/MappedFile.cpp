@@ -0,0 +1,182 @@
+/// \file MappedFile.cpp
+/// \brief Code for the memory mapped file class CMappedFile.
+
+// Copyright Ian Parberry, May 2014.
+//
+// This file is made available under the GNU All-Permissive License.
+//
+// Copying and distribution of this file, with or without modification,
+// are permitted in any medium without royalty provided the copyright
+// notice and this notice are preserved.  This file is offered as-is,
+// without any warranty.
+
+#include <stdio.h> //for NULL
+
+#include "MappedFile.h"
+
+#if defined(_MSC_VER) //Windows Visual Studio 
+  #include <windows.h>
+#else //other OS
+  #include <sys/mman.h> //for mmap()
+  #include <sys/stat.h> //for fstat()
+  #include <fcntl.h> //for open() and posix_fadvise()
+  #include <unistd.h> //for close() and sysconf()
+#endif
+
+/// The constructor doesn't map anything, that's what Open() is for.
+
+CMappedFile::CMappedFile(): m_pData(NULL), m_nSize(0LL), m_nPageSize(4096LL){
+#if defined(_MSC_VER) //Windows Visual Studio 
+  m_hFile = m_hMapping = NULL;
+  SYSTEM_INFO si;
+  GetSystemInfo(&si);
+  m_nPageSize = si.dwPageSize;
+#else //other OS
+  m_nPageSize = sysconf(_SC_PAGESIZE);
+#endif
+} //constructor
+
+/// The destructor unmaps the file if it is still mapped.
+
+CMappedFile::~CMappedFile(){
+  Close();
+} //destructor
+
+/// Map an entire file into memory for reading.
+/// \param filename Name of the file to be mapped.
+/// \return true if it succeeds, false if it fails.
+
+bool CMappedFile::Open(const char* filename){
+  Close();
+
+#if defined(_MSC_VER) //Windows Visual Studio 
+  HANDLE hFile = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL,
+    OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+  if(hFile == INVALID_HANDLE_VALUE)return false;
+
+  LARGE_INTEGER size;
+  if(!GetFileSizeEx(hFile, &size) || size.QuadPart == 0){
+    CloseHandle(hFile); return false;
+  } //if
+
+  HANDLE hMapping = CreateFileMappingA(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+  if(hMapping == NULL){
+    CloseHandle(hFile); return false;
+  } //if
+
+  void* p = MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+  if(p == NULL){
+    CloseHandle(hMapping); CloseHandle(hFile); return false;
+  } //if
+
+  m_hFile = hFile;
+  m_hMapping = hMapping;
+  m_nSize = size.QuadPart;
+
+#else //other OS
+  int fd = open(filename, O_RDONLY);
+  if(fd < 0)return false;
+
+  struct stat st;
+  if(fstat(fd, &st) != 0 || st.st_size == 0){
+    close(fd); return false;
+  } //if
+
+  void* p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd); //the mapping keeps its own reference to the file
+  if(p == MAP_FAILED)return false;
+
+  m_nSize = st.st_size;
+#endif
+
+  m_pData = (unsigned char*)p;
+  return true;
+} //Open
+
+/// Unmap the file, if there is one mapped.
+
+void CMappedFile::Close(){
+  if(m_pData == NULL)return;
+
+#if defined(_MSC_VER) //Windows Visual Studio 
+  UnmapViewOfFile(m_pData);
+  CloseHandle((HANDLE)m_hMapping);
+  CloseHandle((HANDLE)m_hFile);
+  m_hFile = m_hMapping = NULL;
+#else //other OS
+  munmap(m_pData, (size_t)m_nSize);
+#endif
+
+  m_pData = NULL;
+  m_nSize = 0LL;
+} //Close
+
+/// Clip a range of bytes to the file and round it out to page boundaries.
+/// \param offset Offset of the start of the range, rounded down.
+/// \param len Length of the range, rounded up.
+/// \return true if what remains of the range is not empty.
+
+bool CMappedFile::Range(long long& offset, long long& len){
+  if(m_pData == NULL || offset >= m_nSize || len <= 0)return false;
+  if(offset < 0){len += offset; offset = 0;}
+  if(offset + len > m_nSize)len = m_nSize - offset;
+
+  const long long start = offset - offset%m_nPageSize;
+  len += offset - start;
+  offset = start;
+  return len > 0;
+} //Range
+
+/// Tell the operating system that the file will be read mostly from front
+/// to back, so that it reads ahead aggressively and doesn't bother keeping
+/// pages that have already been used. Under Windows this was done
+/// when the file was opened.
+
+void CMappedFile::AdviseSequential(){
+#if !defined(_MSC_VER) //not Windows Visual Studio 
+  if(m_pData != NULL)
+    madvise(m_pData, (size_t)m_nSize, MADV_SEQUENTIAL);
+#endif
+} //AdviseSequential
+
+/// Tell the operating system that a range of the file will be needed soon,
+/// so that it can start reading it in the background.
+/// \param offset Offset of the start of the range in bytes.
+/// \param len Length of the range in bytes.
+
+void CMappedFile::Prefetch(long long offset, long long len){
+  if(!Range(offset, len))return;
+#if !defined(_MSC_VER) //not Windows Visual Studio 
+  madvise(m_pData + offset, (size_t)len, MADV_WILLNEED);
+#endif
+} //Prefetch
+
+/// Tell the operating system that a range of the file won't be needed again
+/// soon, so that its pages can be dropped from this process. The pages stay in
+/// the page cache and will be faulted back in if they are ever touched again,
+/// so this is always safe.
+/// \param offset Offset of the start of the range in bytes.
+/// \param len Length of the range in bytes.
+
+void CMappedFile::Release(long long offset, long long len){
+  if(!Range(offset, len))return;
+#if defined(_MSC_VER) //Windows Visual Studio 
+  VirtualUnlock(m_pData + offset, (SIZE_T)len); //removes the pages from the working set
+#else //other OS
+  madvise(m_pData + offset, (size_t)len, MADV_DONTNEED);
+#endif
+} //Release
+
+/// Reader function for the mapped data.
+/// \return Pointer to the first byte of the file, or NULL if none is mapped.
+
+const unsigned char* CMappedFile::GetData(){
+  return m_pData;
+} //GetData
+
+/// Reader function for the size of the mapped data.
+/// \return Size of the file in bytes.
+
+long long CMappedFile::GetSize(){
+  return m_nSize;
+} //GetSize
@@ -0,0 +1,49 @@
+/// \file MappedFile.h
+/// \brief Header for the memory mapped file class CMappedFile.
+
+// Copyright Ian Parberry, May 2014.
+//
+// This file is made available under the GNU All-Permissive License.
+//
+// Copying and distribution of this file, with or without modification,
+// are permitted in any medium without royalty provided the copyright
+// notice and this notice are preserved.  This file is offered as-is,
+// without any warranty.
+
+#pragma once
+
+/// \brief A read-only memory mapped file.
+///
+/// Maps a whole file into the address space using mmap() under Unix or
+/// MapViewOfFile() under Windows. Pages are read from disk on demand as they
+/// are touched, so there's no waiting for the whole file to be read before work
+/// starts, and the pages live in the operating system's page cache where they
+/// can be shared with any other process that maps the same file.
+
+class CMappedFile{
+  private:
+    unsigned char* m_pData; ///< Pointer to the start of the mapped file.
+    long long m_nSize; ///< Size of the mapped file in bytes.
+    long long m_nPageSize; ///< Size of a virtual memory page in bytes.
+
+  #if defined(_MSC_VER) //Windows Visual Studio 
+    void* m_hFile; ///< File handle.
+    void* m_hMapping; ///< File mapping handle.
+  #endif
+
+    bool Range(long long& offset, long long& len); ///< Round a range out to page boundaries.
+
+  public:
+    CMappedFile(); ///< Constructor.
+    ~CMappedFile(); ///< Destructor.
+
+    bool Open(const char* filename); ///< Map a file.
+    void Close(); ///< Unmap the file.
+
+    void AdviseSequential(); ///< Hint that the file will be read mostly sequentially.
+    void Prefetch(long long offset, long long len); ///< Hint that a range will be needed soon.
+    void Release(long long offset, long long len); ///< Hint that a range won't be needed again soon.
+
+    const unsigned char* GetData(); ///< Get pointer to the mapped data.
+    long long GetSize(); ///< Get size of the mapped data.
+}; //CMappedFile
@@ -0,0 +1,174 @@
+/// \file Pyramid.cpp
+/// \brief Code for the height pyramid class CHeightPyramid.
+
+// Copyright Ian Parberry, May 2014.
+//
+// This file is made available under the GNU All-Permissive License.
+//
+// Copying and distribution of this file, with or without modification,
+// are permitted in any medium without royalty provided the copyright
+// notice and this notice are preserved.  This file is offered as-is,
+// without any warranty.
+
+#include <string.h>
+
+#include "Pyramid.h"
+
+/// The constructor makes an empty pyramid.
+
+CHeightPyramid::CHeightPyramid(): m_nNoData(0), m_eReduction(PYRAMID_MEAN), m_nNumRows(0){
+} //constructor
+
+/// Set the size of level 0 and allocate the levels above it, throwing away
+/// anything that was there before.
+/// \param width Number of points in each row of level 0.
+/// \param height Number of rows of level 0.
+/// \param levels Number of levels including level 0.
+/// \param nodata Height of points with no data.
+/// \param reduction How a point is made from the ones below it.
+
+void CHeightPyramid::Init(const int width, const int height, const int levels,
+  const unsigned short nodata, const PyramidReduction reduction)
+{
+  m_nNoData = nodata;
+  m_eReduction = reduction;
+  m_nNumRows = 0;
+  m_vPending.resize(width);
+
+  m_vLevel.clear();
+  m_vLevel.resize(levels);
+  int w = width, h = height;
+
+  for(int k=0; k<levels; k++){
+    m_vLevel[k].nWidth = w;
+    m_vLevel[k].nHeight = h;
+    if(k > 0)m_vLevel[k].vHeight.resize((size_t)w*h, nodata);
+    w = (w + 1)/2; h = (h + 1)/2;
+  } //for
+} //Init
+
+/// Make a point of the next level up from a 2x2 block of points. The block
+/// is columns j and j + 1 of rows a and b, where b may be NULL and column
+/// j + 1 may be off the right edge, in which case those points count as having
+/// no data. The mean of points with data is rounded to the nearest integer,
+/// and is moved off the no data value if it happens to land on it.
+/// \param a Upper row.
+/// \param b Lower row, or NULL if there is none.
+/// \param j Left column.
+/// \param width Number of points in a row.
+/// \return Height of point.
+
+unsigned short CHeightPyramid::Reduce(const unsigned short* a, const unsigned short* b,
+  const int j, const int width)
+{
+  const unsigned short nodata = m_nNoData;
+  if(m_eReduction == PYRAMID_SAMPLE)return a[j];
+
+  unsigned int sum = 0, n = 0; //sum and number of points with data
+
+  if(a[j] != nodata){sum += a[j]; n++;}
+  if(j + 1 < width && a[j + 1] != nodata){sum += a[j + 1]; n++;}
+
+  if(b != NULL){
+    if(b[j] != nodata){sum += b[j]; n++;}
+    if(j + 1 < width && b[j + 1] != nodata){sum += b[j + 1]; n++;}
+  } //if
+
+  if(n == 0)return nodata;
+
+  unsigned short h = (unsigned short)((sum + n/2)/n);
+  if(h == nodata)h = nodata > 0? nodata - 1: nodata + 1;
+  return h;
+} //Reduce
+
+/// Make a row of the next level up from two rows.
+/// \param a Upper row.
+/// \param b Lower row, or NULL if there is none.
+/// \param width Number of points in a row.
+/// \param dest Row of the next level up, (width + 1)/2 points.
+
+void CHeightPyramid::ReduceRows(const unsigned short* a, const unsigned short* b,
+  const int width, unsigned short* dest)
+{
+  for(int j=0; j<width; j+=2)
+    dest[j/2] = Reduce(a, b, j, width);
+} //ReduceRows
+
+/// Add the next row of level 0. Rows must be added in order from the top.
+/// Each odd row is reduced with the even row above it into a row of level 1.
+/// \param row Row of level 0.
+
+void CHeightPyramid::AddRow(const unsigned short* row){
+  if(m_vLevel.size() < 2 || m_nNumRows >= m_vLevel[0].nHeight)return;
+  const int width = m_vLevel[0].nWidth;
+
+  if(m_nNumRows%2 == 0) //even row, wait for the odd one
+    memcpy(&m_vPending[0], row, width*sizeof(unsigned short));
+  else ReduceRows(&m_vPending[0], row, width,
+    &m_vLevel[1].vHeight[(size_t)(m_nNumRows/2)*m_vLevel[1].nWidth]);
+
+  m_nNumRows++;
+} //AddRow
+
+/// Finish level 1 once all of the rows of level 0 have been added, and build
+/// the rest of the levels from it.
+
+void CHeightPyramid::Finish(){
+  if(m_vLevel.size() < 2)return;
+
+  if(m_nNumRows%2 == 1) //odd number of rows, reduce the last one on its own
+    ReduceRows(&m_vPending[0], NULL, m_vLevel[0].nWidth,
+      &m_vLevel[1].vHeight[(size_t)(m_nNumRows/2)*m_vLevel[1].nWidth]);
+
+  for(int k=2; k<(int)m_vLevel.size(); k++){
+    const Level& src = m_vLevel[k - 1];
+    Level& dest = m_vLevel[k];
+
+    for(int i=0; i<dest.nHeight; i++)
+      ReduceRows(&src.vHeight[(size_t)(2*i)*src.nWidth],
+        2*i + 1 < src.nHeight? &src.vHeight[(size_t)(2*i + 1)*src.nWidth]: NULL,
+        src.nWidth, &dest.vHeight[(size_t)i*dest.nWidth]);
+  } //for
+} //Finish
+
+/// Get the number of levels.
+/// \return Number of levels including level 0.
+
+int CHeightPyramid::GetNumLevels(){
+  return (int)m_vLevel.size();
+} //GetNumLevels
+
+/// Get the width of a level.
+/// \param k Level number.
+/// \return Number of points in each row of level k.
+
+int CHeightPyramid::GetWidth(const int k){
+  return m_vLevel[k].nWidth;
+} //GetWidth
+
+/// Get the height of a level.
+/// \param k Level number.
+/// \return Number of rows of level k.
+
+int CHeightPyramid::GetHeight(const int k){
+  return m_vLevel[k].nHeight;
+} //GetHeight
+
+/// Get a row of a level above level 0.
+/// \param k Level number, at least 1.
+/// \param i Row number.
+/// \return Pointer to the first of GetWidth(k) heights in row i of level k.
+
+const unsigned short* CHeightPyramid::GetRow(const int k, const int i){
+  return &m_vLevel[k].vHeight[(size_t)i*m_vLevel[k].nWidth];
+} //GetRow
+
+/// Get the memory used by the levels above level 0.
+/// \return Size in bytes.
+
+long long CHeightPyramid::GetBytes(){
+  long long n = 0LL;
+  for(int k=1; k<(int)m_vLevel.size(); k++)
+    n += (long long)m_vLevel[k].vHeight.size()*sizeof(unsigned short);
+  return n;
+} //GetBytes
@@ -0,0 +1,68 @@
+/// \file Pyramid.h
+/// \brief Header for the height pyramid class CHeightPyramid.
+
+// Copyright Ian Parberry, May 2014.
+//
+// This file is made available under the GNU All-Permissive License.
+//
+// Copying and distribution of this file, with or without modification,
+// are permitted in any medium without royalty provided the copyright
+// notice and this notice are preserved.  This file is offered as-is,
+// without any warranty.
+
+#pragma once
+
+#include <vector>
+
+/// \brief Pyramid reduction.
+///
+/// How each point of a level of a height pyramid is made from the 2x2 block
+/// of points below it.
+
+enum PyramidReduction{
+  PYRAMID_MEAN, ///< Mean of the points with data, no data if none have any.
+  PYRAMID_SAMPLE ///< Top left point, as it is.
+}; //PyramidReduction
+
+/// \brief Height pyramid.
+///
+/// A mipmap pyramid of a rectangle of height data. Level 0 is the height data
+/// itself, which is not kept. Each level after that is half the width and
+/// height of the one before, rounded up, and is kept in memory, so together
+/// they take up a third of the memory of level 0. Adjacent points of level k
+/// are 2^k points of level 0 apart. Level 1 is built a row of level 0 at a time
+/// as the height data is swept, and the rest are built from level 1 at the end.
+
+class CHeightPyramid{
+  private:
+    /// \brief A level of the pyramid.
+
+    struct Level{
+      int nWidth; ///< Number of points in each row.
+      int nHeight; ///< Number of rows.
+      std::vector<unsigned short> vHeight; ///< Heights in row-major order.
+    }; //Level
+
+    std::vector<Level> m_vLevel; ///< Levels, of which level 0 is empty.
+    unsigned short m_nNoData; ///< Height of points with no data.
+    PyramidReduction m_eReduction; ///< How a point is made from the ones below it.
+    std::vector<unsigned short> m_vPending; ///< Even row of level 0 waiting for the odd one.
+    int m_nNumRows; ///< Number of rows of level 0 added so far.
+
+    unsigned short Reduce(const unsigned short* a, const unsigned short* b, const int j, const int width); ///< Make a point.
+    void ReduceRows(const unsigned short* a, const unsigned short* b, const int width, unsigned short* dest); ///< Make a row.
+
+  public:
+    CHeightPyramid(); ///< Constructor.
+
+    void Init(const int width, const int height, const int levels,
+      const unsigned short nodata, const PyramidReduction reduction); ///< Set the size.
+    void AddRow(const unsigned short* row); ///< Add the next row of level 0.
+    void Finish(); ///< Build the higher levels.
+
+    int GetNumLevels(); ///< Get the number of levels.
+    int GetWidth(const int k); ///< Get the width of a level.
+    int GetHeight(const int k); ///< Get the height of a level.
+    const unsigned short* GetRow(const int k, const int i); ///< Get a row of a level.
+    long long GetBytes(); ///< Get the memory used.
+}; //CHeightPyramid
@@ -0,0 +1,171 @@
+/// \file SlopeStats.cpp
+/// \brief Code for gradient statistics and partial result files.
+
+// Copyright Ian Parberry, May 2014.
+//
+// This file is made available under the GNU All-Permissive License.
+//
+// Copying and distribution of this file, with or without modification,
+// are permitted in any medium without royalty provided the copyright
+// notice and this notice are preserved.  This file is offered as-is,
+// without any warranty.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "SlopeStats.h"
+
+/// Allocate an array of gradient statistics aligned to a cache line, which
+/// new can't be relied on to do for an over-aligned type before C++17. The
+/// block that was really allocated is remembered just before the array.
+/// \param n Number of statistics.
+/// \return Pointer to the first of them, not reset.
+
+SlopeStats* NewSlopeStats(const int n){
+  const size_t align = 64; //cache line size, as in CACHE_ALIGN
+  unsigned char* block = new unsigned char[n*sizeof(SlopeStats) + align + sizeof(unsigned char*)];
+  unsigned char* p = (unsigned char*)(((size_t)block + sizeof(unsigned char*) + align - 1) & ~(align - 1));
+  ((unsigned char**)p)[-1] = block;
+  return (SlopeStats*)p;
+} //NewSlopeStats
+
+/// Free gradient statistics allocated by NewSlopeStats.
+/// \param stats Pointer returned by NewSlopeStats, or NULL.
+
+void DeleteSlopeStats(SlopeStats* stats){
+  if(stats != NULL)
+    delete [] ((unsigned char**)stats)[-1];
+} //DeleteSlopeStats
+
+/// Reset gradient statistics to their initial values.
+/// \param stats Statistics to be reset.
+
+void ResetSlopeStats(SlopeStats& stats){
+  for(int k=0; k<NUMOCTAVES; k++){
+    stats.nMaxDiff[k] = -1;
+    stats.nSumDiff[k] = 0LL;
+    stats.nPointCount[k] = 0LL;
+
+    for(int i=0; i<GRANULARITY; i++)
+      stats.nDistribution[k][i] = 0LL;
+  } //for
+} //ResetSlopeStats
+
+/// Add one set of gradient statistics into another. Since the accumulators
+/// are exact integers or maxima, the result does not depend on the order
+/// in which statistics are merged.
+/// \param dest Statistics to merge into.
+/// \param src Statistics to be merged.
+
+void MergeSlopeStats(SlopeStats& dest, const SlopeStats& src){
+  for(int k=0; k<NUMOCTAVES; k++){
+    dest.nMaxDiff[k] = max(dest.nMaxDiff[k], src.nMaxDiff[k]);
+    dest.nSumDiff[k] += src.nSumDiff[k];
+    dest.nPointCount[k] += src.nPointCount[k];
+
+    for(int i=0; i<GRANULARITY; i++)
+      dest.nDistribution[k][i] += src.nDistribution[k][i];
+  } //for
+} //MergeSlopeStats
+
+/// Initialize the header of a partial result file for a rectangle of
+/// the height data of which nothing has been processed yet.
+/// \param header Header to be initialized.
+/// \param dem Header of the height data.
+/// \param row0 First row of the rectangle.
+/// \param row1 One past the last row of the rectangle.
+/// \param col0 First column of the rectangle.
+/// \param col1 One past the last column of the rectangle.
+/// \param bMultiPass true if the octaves are processed one at a time.
+
+void InitPartialHeader(PartialHeader& header, const DEMFileHeader& dem,
+  const int row0, const int row1, const int col0, const int col1, const bool bMultiPass)
+{
+  memset(&header, 0, sizeof(PartialHeader));
+  memcpy(header.magic, PARTIAL_MAGIC, sizeof(header.magic));
+  header.version = PARTIAL_VERSION;
+  header.headersize = sizeof(PartialHeader);
+  header.numoctaves = NUMOCTAVES;
+  header.granularity = GRANULARITY;
+  header.width = dem.width;
+  header.height = dem.height;
+  header.scale = dem.scale;
+  header.multipass = bMultiPass? 1: 0;
+  header.cellsize = dem.cellsize;
+  header.row0 = row0;
+  header.row1 = row1;
+  header.col0 = col0;
+  header.col1 = col1;
+  header.nextrow = row0;
+  header.octave = 0;
+  header.complete = 0;
+} //InitPartialHeader
+
+/// Check whether two partial results came from height data of the same size,
+/// scale, and point spacing, so that they can be merged.
+/// \param a Header of one partial result.
+/// \param b Header of the other.
+/// \return true if they came from the same height data.
+
+bool IsSameHeightData(const PartialHeader& a, const PartialHeader& b){
+  return a.width == b.width && a.height == b.height &&
+    a.scale == b.scale && a.cellsize == b.cellsize;
+} //IsSameHeightData
+
+/// Save a partial result. It is written to a temporary file that is then
+/// renamed, so that if the program dies while saving a checkpoint, the
+/// previous checkpoint is still there.
+/// \param filename Name of partial result file.
+/// \param header Partial result file header.
+/// \param stats Statistics.
+/// \return true if it succeeds, false if it fails.
+
+bool SavePartialResult(const char* filename, const PartialHeader& header, const SlopeStats& stats){
+  char tempname[1024];
+  sprintf(tempname, "%.1000s.tmp", filename);
+
+  FILE* output = fopen(tempname, "wb");
+  if(output == NULL)return false;
+
+  bool ok = fwrite(&header, sizeof(PartialHeader), 1, output) == 1 &&
+    fwrite(stats.nMaxDiff, sizeof(stats.nMaxDiff), 1, output) == 1 &&
+    fwrite(stats.nSumDiff, sizeof(stats.nSumDiff), 1, output) == 1 &&
+    fwrite(stats.nPointCount, sizeof(stats.nPointCount), 1, output) == 1 &&
+    fwrite(stats.nDistribution, sizeof(stats.nDistribution), 1, output) == 1;
+  ok = fclose(output) == 0 && ok;
+
+  if(ok){ //replace the old file
+    remove(filename); //rename won't replace a file under Windows
+    ok = rename(tempname, filename) == 0;
+  } //if
+  else remove(tempname);
+
+  return ok;
+} //SavePartialResult
+
+/// Load a partial result, checking that the header is one that we know how
+/// to read.
+/// \param filename Name of partial result file.
+/// \param header Partial result file header.
+/// \param stats Statistics.
+/// \return true if it succeeds, false if it fails.
+
+bool LoadPartialResult(const char* filename, PartialHeader& header, SlopeStats& stats){
+  FILE* input = fopen(filename, "rb");
+  if(input == NULL)return false;
+
+  bool ok = fread(&header, sizeof(PartialHeader), 1, input) == 1 &&
+    memcmp(header.magic, PARTIAL_MAGIC, sizeof(header.magic)) == 0 &&
+    header.version == PARTIAL_VERSION && header.headersize == sizeof(PartialHeader) &&
+    header.numoctaves == NUMOCTAVES && header.granularity == GRANULARITY &&
+    header.row0 <= header.nextrow && header.nextrow <= header.row1 &&
+    header.col0 <= header.col1 && header.octave >= 0 && header.octave <= NUMOCTAVES;
+
+  ok = ok && fread(stats.nMaxDiff, sizeof(stats.nMaxDiff), 1, input) == 1 &&
+    fread(stats.nSumDiff, sizeof(stats.nSumDiff), 1, input) == 1 &&
+    fread(stats.nPointCount, sizeof(stats.nPointCount), 1, input) == 1 &&
+    fread(stats.nDistribution, sizeof(stats.nDistribution), 1, input) == 1;
+
+  fclose(input);
+  return ok;
+} //LoadPartialResult
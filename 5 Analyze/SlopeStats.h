@@ -0,0 +1,95 @@
+/// \file SlopeStats.h
+/// \brief Header for gradient statistics and partial result files.
+///
+/// The gradient statistics gathered by the analyzer are all exact integers
+/// or maxima, so statistics gathered from different parts of the height
+/// array, in any order, can be merged into exactly the statistics for the
+/// whole. A partial result file holds the statistics for a rectangle of the
+/// height array, possibly only partly processed, together with enough of a
+/// description of the height data to check that files being merged or resumed
+/// came from the same data. It is used both for checkpoints, so that a run
+/// that dies can be resumed, and for the results of separate regions that
+/// are to be merged into one output.txt.
+///
+/// A partial result file starts with a PartialHeader, followed by the
+/// statistics in the order of the fields of SlopeStats, for NUMOCTAVES octaves
+/// and GRANULARITY bins. All values are little-endian.
+
+// Copyright Ian Parberry, May 2014.
+//
+// This file is made available under the GNU All-Permissive License.
+//
+// Copying and distribution of this file, with or without modification,
+// are permitted in any medium without royalty provided the copyright
+// notice and this notice are preserved.  This file is offered as-is,
+// without any warranty.
+
+#pragma once
+
+#include "defines.h"
+#include "DEMFile.h"
+
+const int NUMOCTAVES = 16;  ///< Number of octaves.
+const int GRANULARITY = 50; ///< Granularity of distribution.
+
+const char PARTIAL_MAGIC[8] = {'T', 'O', 'B', 'L', 'E', 'R', 'P', 'R'}; ///< First 8 bytes of a partial result file.
+const unsigned int PARTIAL_VERSION = 1; ///< Current version of the partial result file format.
+
+/// \brief Gradient statistics.
+///
+/// Accumulators for the gradient statistics of every octave. Each worker thread
+/// gets its own copy, aligned to a cache line so that no two threads ever write
+/// to the same line. Instead of the maximum and a floating point sum of slopes,
+/// which would depend on the order in which the gradients are added, we keep
+/// the largest and the exact sum of the absolute height differences, from which
+/// the slopes can be recovered at the end. This makes the reduction independent
+/// of the number of threads.
+
+struct CACHE_ALIGN SlopeStats{
+  int nMaxDiff[NUMOCTAVES]; ///< Largest absolute height difference in each octave.
+  long long nSumDiff[NUMOCTAVES]; ///< Sum of absolute height differences in each octave.
+  long long nPointCount[NUMOCTAVES]; ///< Number of samples.
+  long long nDistribution[NUMOCTAVES][GRANULARITY]; ///< Gradient distribution for each octave.
+}; //SlopeStats
+
+/// \brief Partial result file header.
+///
+/// The header at the start of a partial result file. Gradients are recorded
+/// from each point of the rectangle to points to its right and below it,
+/// which may be outside it, so that rectangles that tile the height array
+/// record every gradient exactly once between them. In a single pass, rows
+/// row0 up to but not including nextrow have been processed in all octaves.
+/// In multiple passes, octaves before octave have been processed in all rows and
+/// octave octave has been processed in rows row0 up to but not including nextrow.
+
+struct PartialHeader{
+  char magic[8]; ///< Must be PARTIAL_MAGIC.
+  unsigned int version; ///< File format version.
+  unsigned int headersize; ///< Size of this header in bytes.
+  unsigned int numoctaves; ///< Number of octaves, must be NUMOCTAVES.
+  unsigned int granularity; ///< Number of distribution bins, must be GRANULARITY.
+  unsigned int width; ///< Number of points in each row of the height data.
+  unsigned int height; ///< Number of rows of the height data.
+  float scale; ///< Height scale factor of the height data.
+  unsigned int multipass; ///< 1 if processed one octave at a time, 0 if in a single pass.
+  double cellsize; ///< Distance between points of the height data in meters.
+  int row0; ///< First row of the rectangle.
+  int row1; ///< One past the last row of the rectangle.
+  int col0; ///< First column of the rectangle.
+  int col1; ///< One past the last column of the rectangle.
+  int nextrow; ///< First row not yet processed.
+  int octave; ///< Octave being processed by multiple passes, 0 for a single pass.
+  unsigned int complete; ///< 1 if the whole rectangle has been processed.
+  unsigned int reserved; ///< Unused, set to 0.
+}; //PartialHeader
+
+SlopeStats* NewSlopeStats(const int n=1); ///< Allocate aligned statistics.
+void DeleteSlopeStats(SlopeStats* stats); ///< Free statistics from NewSlopeStats.
+void ResetSlopeStats(SlopeStats& stats); ///< Reset statistics.
+void MergeSlopeStats(SlopeStats& dest, const SlopeStats& src); ///< Merge statistics.
+
+void InitPartialHeader(PartialHeader& header, const DEMFileHeader& dem,
+  const int row0, const int row1, const int col0, const int col1, const bool bMultiPass); ///< Initialize a header.
+bool IsSameHeightData(const PartialHeader& a, const PartialHeader& b); ///< Whether two partial results came from the same data.
+bool SavePartialResult(const char* filename, const PartialHeader& header, const SlopeStats& stats); ///< Save a partial result.
+bool LoadPartialResult(const char* filename, PartialHeader& header, SlopeStats& stats); ///< Load a partial result.
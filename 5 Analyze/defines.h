@@ -23,8 +23,12 @@
   #include <conio.h> //for _getch()
   #pragma warning(disable : 4996) //disable annoying security warnings for stdio functions
 
+  #define CACHE_ALIGN __declspec(align(64)) ///< Align to a cache line.
+
 #else//other OS
 
   #include <time.h>
 
+  #define CACHE_ALIGN __attribute__((aligned(64))) ///< Align to a cache line.
+
 #endif
@@ -15,6 +15,9 @@
 /// This program reads a packed elevation data file called UtahDEMData.bin
 /// and records various interesting statistics in a tab-separated
 /// text file called output.txt.
+/// UtahDEMData.bin may be either in the tiled format written by Pack,
+/// whose header says how big the array is and how the heights are
+/// scaled, or the older headerless format written by Pack -raw.
 /// It must be compiled for a 64-bit target because
 /// it uses a quite large array to store the data. Don't execute it
 /// unless you have at least 16GB of RAM (preferably 32GB). A solid
@@ -29,6 +32,39 @@
 /// as good as mine. This program does report various interesting things
 /// to the console so you can reassure yourself that it is actually
 /// working and not just hanging around hogging system resources.
+///
+/// While it runs, the rate at which points are scanned and gradients are recorded,
+/// the time spent acquiring height data, the percentage of bad points, and
+/// the progress and estimated time remaining are printed to stderr every 10
+/// seconds, followed at the end by how long each octave took. The command line
+/// option -progress followed by a number of seconds changes how often, 0
+/// meaning only at the end, and -log followed by a file name appends them to a
+/// tab-separated log file too. See Instrument.h for how to compile this out.
+///
+/// The command line option -partial followed by a file name makes it save a
+/// checkpoint of the statistics gathered so far to that file every few
+/// thousand rows, and in multiple passes after each octave too. If the file
+/// is already there, it carries on from where that checkpoint left off
+/// instead of starting again. At the end the file holds the finished
+/// statistics. The option -rows followed by a first row and one past a
+/// last row restricts the analysis to those rows, so that different regions can
+/// be analyzed on different computers, and -merge followed by the names of the
+/// partial result files for the regions merges them into one output.txt
+/// exactly the same as analyzing the whole lot at once. See SlopeStats.h for
+/// the partial result file format. The option -roi followed by a first row,
+/// first column, and one past a last row and last column restricts it to a
+/// rectangle instead, and -utm followed by the easting and northing of two
+/// opposite corners does the same in UTM coordinates if the height data says
+/// where its top left corner is.
+///
+/// The option -pyramid followed by mean or sample builds a height pyramid
+/// of the rectangle being analyzed while it records the gradients for the first
+/// octave, and then records those for octave k from level k of the pyramid,
+/// so that the higher octaves take next to no time. Each point of level k
+/// stands for a 2^k by 2^k block of points, so octave k has about 4^-k as many
+/// samples as it does without the pyramid, and with mean reduction the terrain
+/// is smoothed too. It is meant for quick looks at the distribution of
+/// sub-regions, not for the final results. See Pyramid.h for details.
 
 // Copyright Ian Parberry, May 2014.
 //
@@ -44,127 +80,643 @@
 #include <stdio.h>  //for printf()
 #include <stdlib.h>  //for malloc() and free()
 #include <math.h> //for abs()
+#include <string.h> //for strcmp()
+
+#include <thread> //for std::thread
+#include <atomic> //for std::atomic
+#include <vector> //for std::vector
+#include <mutex> //for std::mutex
+#include <condition_variable> //for std::condition_variable
+#include <chrono> //for std::chrono::steady_clock
 
 #include "defines.h" //OS porting defines
 #include "CPUtime.h" //measure CPU time
+#include "HeightData.h" //packed height data
+#include "Instrument.h" //instrumentation counters
+#include "SlopeStats.h" //gradient statistics and partial result files
+#include "Pyramid.h" //height pyramid
+#include "GradientKernel.h" //gradient recording kernel
   
 const int GRIDSIZE = 20; ///< Number of DEM files on one side of square grid.
 
 const int CELLSIZE = 4000; ///< Number of points on one side of a DEM file.
-const unsigned int ARRAYSIZE = CELLSIZE*GRIDSIZE; ///< Number of points on one side of the whole array of heights.
+const unsigned int ARRAYSIZE = CELLSIZE*GRIDSIZE; ///< Number of points on one side of the whole array of heights in a raw file.
+const float HEIGHTSCALE = 10.0f; ///< Heights in a raw file are multiplied by this.
+const double POINTSPACING = 5.0; ///< Distance between points in a raw file in meters.
 
-const int NUMOCTAVES = 16;  ///< Number of octaves.
 const int MIDOCTAVE = 9; ///< First octave at which width is greater than height.
 
-const int GRANULARITY = 50; ///< Granularity of distribution.
 const double MAXGRADIENT = 1.0; ///< Maximum gradient sampled.
 
 const double GRADIENT_DELTA = (double)MAXGRADIENT/GRANULARITY; ///< Small change in gradient.
 const double GRADIENT_DELTA_INV = 1.0/GRADIENT_DELTA; ///< Inverse of GRADIENT_DELTA.
 
+const int BANDSIZE = 64; ///< Number of rows in a band processed by the single-pass engine.
+const int CHECKPOINTBANDS = 64; ///< Number of bands processed between checkpoints.
+
 double g_dMaxSlope[NUMOCTAVES]; ///< Maximum slope in each octave.
 double g_dSumSlope[NUMOCTAVES]; ///< Sum of slopes in each octave, for computing averages.
 long long g_nPointCount[NUMOCTAVES]; ///< Number of samples.
 long long g_nDistribution[NUMOCTAVES][GRANULARITY]; ///< Gradient distribution for each octave.
 
-unsigned char* g_pHeightBuffer = NULL; ///< Buffer for packed height data.
-unsigned short* g_nHeight; ///< Swizzle to access height data by word instead of by byte.
-const long long g_nBufSize = 
-  (long long)ARRAYSIZE * (long long)ARRAYSIZE * (long long)sizeof(short); ///< Size of height buffer.
+int g_nOctaveScale[NUMOCTAVES]; ///< Distance between sample points in each octave, in grid points.
+int g_nOctaveMult[NUMOCTAVES]; ///< Multiplier to adjust for octaves longer than they are high.
+double g_dOctaveDivisor[NUMOCTAVES]; ///< Divisor that converts a height difference to a gradient.
+int g_nGradientLimit[NUMOCTAVES]; ///< Smallest height difference whose gradient is too large to sample.
+unsigned char* g_pGradientBin[NUMOCTAVES]; ///< Distribution bin for each height difference below the limit.
+
+CHeightData g_cHeightData; ///< Packed height data.
+long long g_nCacheSize = 2048LL << 20; ///< Size of band cache for tiled height data in bytes.
+int g_nNumRows = ARRAYSIZE; ///< Number of rows of heights.
+int g_nNumCols = ARRAYSIZE; ///< Number of heights in each row.
+unsigned short g_nNoData = 0; ///< Packed height of points with no data.
+
+int g_nStartTime; ///< Wall clock time that computation began.
+int g_nStartCPUTime; ///< CPU time that computation began, added up over threads.
+
+int g_nNumThreads = 1; ///< Number of worker threads.
+std::atomic<int> g_nNextBand; ///< Next band of rows to be claimed by a worker thread.
+int g_nEndBand = 0; ///< One past the last band to be claimed before the next checkpoint.
+
+int g_nFirstRow = 0; ///< First row to be processed.
+int g_nLastRow = ARRAYSIZE; ///< One past the last row to be processed.
+int g_nFirstCol = 0; ///< First column to be processed.
+int g_nLastCol = ARRAYSIZE; ///< One past the last column to be processed.
+const char* g_strPartialFileName = NULL; ///< Name of partial result file for checkpoints, or NULL for none.
+PartialHeader g_sPartialHeader; ///< Header of the partial result file.
+
+/// \brief Instrumentation counters.
+///
+/// The stages of the analyzer that are instrumented, as numbers of
+/// instrumentation counters. There is one counter per octave starting at
+/// STAGE_OCTAVE.
+
+enum AnalyzeStage{
+  STAGE_ACQUIRE, ///< Bands of rows of height data acquired.
+  STAGE_SCAN, ///< Points scanned.
+  STAGE_BAD, ///< Points with no data.
+  STAGE_ROWS, ///< Rows done, in all passes.
+  STAGE_GRADIENTS, ///< Gradients recorded in all octaves.
+  STAGE_OCTAVE ///< Gradients recorded in the first octave.
+}; //AnalyzeStage
+
+/// \brief Get time.
+///
+/// Get the current wall clock time in milliseconds from a monotonic clock.
+/// \return Time in ms.
 
-int g_nStartTime; ///< Time that computation began.
+int GetTime(){
+  return (int)std::chrono::duration_cast<std::chrono::milliseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+} //GetTime
 
-/// \brief Read height data.
+/// \brief Open height data.
 ///
-/// Read the height data from a packed file UtahDEMData.bin into g_pHeightBuffer,
-/// which it assumes points to a buffer of the right size. This data will be
-/// accessed automagically through g_nHeight.
+/// Open the packed file UtahDEMData.bin, which may either be tiled or a
+/// headerless array of ARRAYSIZE by ARRAYSIZE heights. By default it is memory
+/// mapped, so nothing is actually read here. Pages of the file are read on
+/// demand as the analysis touches them.
+/// \param bRead true to read the whole file into memory instead of mapping it.
 /// \return true if it succeeds, false if it fails
 
-bool ReadHeightData(){  
-  FILE* datafile;
-  datafile = fopen("UtahDEMData.bin", "rb");
-  
-  if(datafile){ //success
-    size_t count = fread(g_pHeightBuffer, g_nBufSize, 1, datafile);
-    printf("  %llud bytes read", count * g_nBufSize);
-    fclose(datafile);
-    return true; //success
-  } //if
-  else return false; //fail
-} //ReadHeightData
+bool OpenHeightData(const bool bRead){  
+  DEMFileHeader raw; //description of a raw file
+  InitDEMHeader(raw, ARRAYSIZE, ARRAYSIZE, DEMFILE_TILESIZE, HEIGHTSCALE, 0, POINTSPACING);
+
+  if(!g_cHeightData.Open("UtahDEMData.bin", bRead, raw))
+    return false; //fail
 
-/// \brief Record statistics for a gradient. 
+  const DEMFileHeader& header = g_cHeightData.GetHeader();
+  g_nNumRows = header.height;
+  g_nNumCols = header.width;
+  g_nNoData = header.nodata;
+  g_cHeightData.SetCacheSize(g_nCacheSize);
+
+  if(g_cHeightData.IsTiled())
+    printf("  %dx%d tiled heights in %dx%d tiles", 
+      g_nNumCols, g_nNumRows, header.tilesize, header.tilesize);
+  else printf("  %dx%d raw heights", g_nNumCols, g_nNumRows);
+  return true; //success
+} //OpenHeightData
+
+/// \brief Reduce statistics.
 ///
-/// Add the new gradient to the octave statistics we are gathering.
-/// \param g A new gradient.
-/// \param k The octave from which the gradient was recorded.
-
-void RecordGradient(double g, int k){
-  if(g < MAXGRADIENT){ //gradient is good
-    g_nPointCount[k]++; //one more slope
-    g_dMaxSlope[k] = max(g_dMaxSlope[k], g); //compare to maximum
-    g_dSumSlope[k] += g; //add to sum
-
-    //add to distribution
-    int n = (int)(g*GRADIENT_DELTA_INV + 0.5f);
-    if(n>=0 && n<GRANULARITY)
-      g_nDistribution[k][n]++;
-  } //if
-} //RecordGradient
+/// Merge per-thread statistics into one set of statistics.
+/// All of the accumulators are either exact integers or maxima, so the result
+/// is the same regardless of the order in which the threads finished.
+/// \param stats Array of statistics, one per thread.
+/// \param n Number of entries in stats.
+/// \param total Statistics to put the result into.
+
+void ReduceSlopeStats(const SlopeStats* stats, const int n, SlopeStats& total){
+  ResetSlopeStats(total);
+  for(int t=0; t<n; t++) //for each thread, in order
+    MergeSlopeStats(total, stats[t]);
+} //ReduceSlopeStats
+
+/// \brief Set the global statistics.
+///
+/// Convert statistics into the globals that SaveSlopeStats uses.
+/// The octave table must have been initialized.
+/// \param stats Statistics for all of the height data.
+
+void SetSlopeGlobals(const SlopeStats& stats){
+  for(int k=0; k<NUMOCTAVES; k++){
+    for(int i=0; i<GRANULARITY; i++)
+      g_nDistribution[k][i] = stats.nDistribution[k][i];
+
+    g_dMaxSlope[k] = stats.nMaxDiff[k] < 0? -9999: g_nOctaveMult[k]*(double)stats.nMaxDiff[k]/g_dOctaveDivisor[k];
+    g_dSumSlope[k] = g_nOctaveMult[k]*(double)stats.nSumDiff[k]/g_dOctaveDivisor[k];
+    g_nPointCount[k] = stats.nPointCount[k];
+  } //for
+} //SetSlopeGlobals
 
-/// \brief Get the height.
+/// \brief Save a checkpoint.
 ///
-/// Get the elevation at a given point.
-/// \param x X coordinate of point.
-/// \param y Y coordinate of point.
-/// \return Elevation at (x, y).
+/// Save the statistics gathered so far to the partial result file, if there
+/// is one, noting how far the analysis has got.
+/// \param stats Statistics gathered so far, including those from any earlier checkpoint.
+/// \param nextrow First row not yet processed.
+/// \param octave Octave being processed by multiple passes, 0 for a single pass.
 
-double ht(int x, int y){
-  return (double)g_nHeight[x*ARRAYSIZE + y];
-}; //ht
+void SaveCheckpoint(const SlopeStats& stats, const int nextrow, const int octave){
+  if(g_strPartialFileName == NULL)return;
 
-/// \brief Process the slope data.
+  g_sPartialHeader.nextrow = nextrow;
+  g_sPartialHeader.octave = octave;
+  g_sPartialHeader.complete = g_sPartialHeader.multipass?
+    octave >= NUMOCTAVES: nextrow >= g_sPartialHeader.row1;
+
+  if(!SavePartialResult(g_strPartialFileName, g_sPartialHeader, stats))
+    printf("\n  Failed to save checkpoint %s.\n", g_strPartialFileName);
+} //SaveCheckpoint
+
+/// \brief Get a row of heights.
+///
+/// Get a pointer to the start of a row of the height array. The row
+/// must have been acquired from g_cHeightData.
+/// \param i Row number.
+/// \return Pointer to the first of g_nNumCols heights in row i.
+
+const unsigned short* HeightRow(int i){
+  return g_cHeightData.GetRow(i);
+} //HeightRow
+
+/// \brief Process the slopes between two rows.
+///
+/// Process the slopes from each point of part of a row to the points a
+/// stride to its right and below it. The points to its right may be
+/// outside that part of the row. The edges are dealt with here by
+/// shortening the runs handed to the gradient kernel, so that the kernel
+/// doesn't have to check for them.
+/// \param row0 Current row.
+/// \param row1 Row a stride below it, or NULL if there is none.
+/// \param j0 First column to be processed.
+/// \param j1 One past the last column to be processed.
+/// \param width Number of points in each row.
+/// \param scale Stride.
+/// \param k The octave number.
+/// \param stats Statistics to record the gradients in.
+
+void ProcessSlopePairs(const unsigned short* row0, const unsigned short* row1,
+  const int j0, const int j1, const int width, const int scale, const int k, SlopeStats& stats)
+{
+  const unsigned short nodata = g_nNoData; //packed height of missing points
+  const int jr = min(j1, width - scale); //one past the last point with one a stride to its right
+
+  if(row1 != NULL) //if not at right edge
+    RecordGradients(stats, k, row0 + j0, row1 + j0, j1 - j0, nodata, g_nGradientLimit[k], g_pGradientBin[k]);
+
+  if(jr > j0) //if not all at bottom edge
+    RecordGradients(stats, k, row0 + j0, row0 + j0 + scale, jr - j0, nodata, g_nGradientLimit[k], g_pGradientBin[k]);
+} //ProcessSlopePairs
+
+/// \brief Process the slope data for a row in one octave.
 ///
-/// Process all of the slopes for a given octave.
+/// Process the slopes from each point of a row between columns g_nFirstCol
+/// and g_nLastCol to the points a stride of 2^k to its right and below it.
+/// \param i Row number.
 /// \param k The octave number.
+/// \param stats Statistics to record the gradients in.
 
-void ProcessSlopeData(int k){
-  int m = 1; //to adjust for octaves longer than they are high.
-  int scale=1; //octave scale
-  double length = 5.0; //distance between sample points
-  int nStartTime = CPUTimeInMilliseconds();
+void ProcessSlopeRow(const int i, const int k, SlopeStats& stats){
+  INSTRUMENT_TIME_COUNT(STAGE_OCTAVE + k, stats.nPointCount[k]);
+  const int scale = g_nOctaveScale[k]; //octave scale
+  const unsigned short* row1 = //row scale to the right, if any
+    i + scale < g_nNumRows? HeightRow(i + scale): NULL;
 
-  //set scale and length for this octave.
-  for(int i=0; i<k; i++){
-    scale *= 2; length *= 2.0;
+  ProcessSlopePairs(HeightRow(i), row1, g_nFirstCol, g_nLastCol, g_nNumCols, scale, k, stats);
+} //ProcessSlopeRow
+
+#ifdef INSTRUMENT
+
+/// \brief Count bad points.
+///
+/// Count the points in a row of the height array between columns g_nFirstCol
+/// and g_nLastCol that have no data, for the instrumentation. The row must have
+/// been acquired from g_cHeightData.
+/// \param i Row number.
+/// \return Number of points in row i with no data.
+
+int CountBadPoints(const int i){
+  const unsigned short* row = HeightRow(i);
+  int n = 0;
+  for(int j=g_nFirstCol; j<g_nLastCol; j++)
+    n += row[j] == g_nNoData;
+  return n;
+} //CountBadPoints
+
+#endif
+
+/// \brief Initialize the octave table.
+///
+/// Compute the scale, multiplier, and divisor for each octave once so that
+/// the single-pass engine doesn't have to recompute them for every row.
+/// This depends on the point spacing and height scale of the height data.
+/// Since heights are integers, so are height differences, so we also tabulate
+/// which distribution bin each possible height difference falls into. Computing
+/// this once means that every engine bins a given gradient in exactly the same
+/// way, however the compiler chooses to optimize the arithmetic.
+/// \param cellsize Distance between points in meters.
+/// \param heightscale Heights in meters are multiplied by this.
+
+void InitOctaveTable(const double cellsize, const float heightscale){
+  for(int k=0; k<NUMOCTAVES; k++){
+    int m = 1; //to adjust for octaves longer than they are high.
+    int scale=1; //octave scale
+    double length = cellsize; //distance between sample points
+
+    //set scale and length for this octave.
+    for(int i=0; i<k; i++){
+      scale *= 2; length *= 2.0;
+    } //for
+
+    //adjust multiplier for long octaves.
+    for(int i=MIDOCTAVE; i<k; i++)
+      m *= 2;
+
+    g_nOctaveScale[k] = scale;
+    g_nOctaveMult[k] = m;
+    g_dOctaveDivisor[k] = heightscale*length;
+
+    //find the smallest height difference that gives too large a gradient
+    const double d = g_dOctaveDivisor[k]; //divisor
+    int limit = 0;
+    while(m*(double)limit/d < MAXGRADIENT)
+      limit++;
+    g_nGradientLimit[k] = limit;
+
+    //tabulate distribution bins, using GRANULARITY for out of range
+    g_pGradientBin[k] = new unsigned char [limit];
+    for(int dh=0; dh<limit; dh++){
+      int n = (int)((m*(double)dh/d)*GRADIENT_DELTA_INV + 0.5f);
+      g_pGradientBin[k][dh] = (unsigned char)(n >= 0 && n < GRANULARITY? n: GRANULARITY);
+    } //for
   } //for
+} //InitOctaveTable
 
-  //adjust multiplier for long octaves.
-  for(int i=MIDOCTAVE; i<k; i++)
-    m *= 2;
-    
-  //record gradients at each point
-  const double d = 10.0*length; //divisor
-  for(int i=0; i<ARRAYSIZE; i++) //for each row 
-    for(int j=0; j<ARRAYSIZE; j++){ //for each point
-      if(g_nHeight[i*ARRAYSIZE + j] > 0){ //current point has good data
-        double h0 = ht(i, j); //ht at current point
-        if(i+scale < ARRAYSIZE){ //if not at right edge
-          double h1 = ht(i+scale, j); //height at next point to the right
-          if(h1 > 0) //if the data value there is good
-            RecordGradient(m*fabs(h0 - h1)/d, k); //record the gradient
-        } //if not at right edge
-
-        if(j+scale < ARRAYSIZE){ //if not at bottom edge
-          double h2 = ht(i, j + scale); //height at next point down
-          if(h2 > 0) //if the data value there is good
-            RecordGradient(m*fabs(h0 - h2)/d, k); //record the gradient
-        } //if not at bottom edge
-      } //if current point has good data
-    } //for each point
+/// \brief Free the octave table.
+///
+/// Deallocate the memory used by the distribution bin tables.
+
+void FreeOctaveTable(){
+  for(int k=0; k<NUMOCTAVES; k++){
+    delete [] g_pGradientBin[k];
+    g_pGradientBin[k] = NULL;
+  } //for
+} //FreeOctaveTable
+
+/// \brief Process the slope data.
+///
+/// Process all of the slopes for a given octave in rows first up to
+/// g_nLastRow, saving a checkpoint every CHECKPOINTBANDS bands.
+/// \param k The octave number.
+/// \param stats Statistics to record the gradients in.
+/// \param first First row to be processed.
+
+void ProcessSlopeData(int k, SlopeStats& stats, const int first){
+  const int scale = g_nOctaveScale[k]; //octave scale
+  int nNumBands = 0; //number of bands processed
+
+  for(int i0=first; i0<g_nLastRow; i0+=BANDSIZE){ //for each band of rows
+    const int i1 = min(i0 + BANDSIZE, g_nLastRow);
+    {
+      INSTRUMENT_TIME(STAGE_ACQUIRE);
+      g_cHeightData.Acquire(i0, i1);
+      g_cHeightData.Acquire(i0 + scale, i1 + scale);
+    }
+    INSTRUMENT_ADD(STAGE_ACQUIRE, 1);
+
+    for(int i=i0; i<i1; i++){ //for each row
+      if(k == 0){ //count points in the first pass only
+        INSTRUMENT_ADD(STAGE_SCAN, g_nLastCol - g_nFirstCol);
+        INSTRUMENT_ADD(STAGE_BAD, CountBadPoints(i));
+      } //if
+      ProcessSlopeRow(i, k, stats);
+      INSTRUMENT_ADD(STAGE_ROWS, 1);
+    } //for
+
+    g_cHeightData.Release(i0, i1);
+    g_cHeightData.Release(i0 + scale, i1 + scale);
+
+    if(++nNumBands%CHECKPOINTBANDS == 0 && i1 < g_nLastRow)
+      SaveCheckpoint(stats, i1, k);
+  } //for each band of rows
 } //ProcessSlopeData
 
+/// \brief Process the slope data for a band of rows in all octaves.
+///
+/// This is the single-pass engine. Each row of the band is read once and
+/// the gradients for every octave are recorded while it is still in cache,
+/// so the only other rows touched are the ones a stride of 2^k below it.
+/// Taken over the whole grid these form a rolling window of the rows needed
+/// for the largest stride, which is all that has to be acquired from the
+/// height data. Within each octave the gradients are recorded
+/// in exactly the same order as ProcessSlopeData, so the results are identical.
+/// \param i0 First row of the band.
+/// \param i1 One past the last row of the band.
+/// \param stats Statistics to record the gradients in.
+
+void ProcessSlopeBand(const int i0, const int i1, SlopeStats& stats){
+  //acquire the rows of the band and the rows they are compared with
+  {
+    INSTRUMENT_TIME(STAGE_ACQUIRE);
+    g_cHeightData.Acquire(i0, i1);
+    for(int k=0; k<NUMOCTAVES; k++)
+      g_cHeightData.Acquire(i0 + g_nOctaveScale[k], i1 + g_nOctaveScale[k]);
+  }
+  INSTRUMENT_ADD(STAGE_ACQUIRE, 1);
+
+  for(int i=i0; i<i1; i++){ //for each row in the band
+    INSTRUMENT_ADD(STAGE_SCAN, g_nLastCol - g_nFirstCol);
+    INSTRUMENT_ADD(STAGE_BAD, CountBadPoints(i));
+    for(int k=0; k<NUMOCTAVES; k++) //for each octave
+      ProcessSlopeRow(i, k, stats);
+    INSTRUMENT_ADD(STAGE_ROWS, 1);
+  } //for
+
+  //release them
+  g_cHeightData.Release(i0, i1);
+  for(int k=0; k<NUMOCTAVES; k++)
+    g_cHeightData.Release(i0 + g_nOctaveScale[k], i1 + g_nOctaveScale[k]);
+} //ProcessSlopeBand
+
+/// \brief Slope processing thread.
+///
+/// Claim bands of rows one at a time until there are none left before
+/// g_nEndBand and process them in all octaves. Bands are numbered from
+/// g_nFirstRow. Progress is reported by whichever thread claims the
+/// first band of each tenth of the rows.
+/// \param stats Statistics for this thread.
+
+void ProcessSlopeThread(SlopeStats* stats){
+  const int nNumRows = g_nLastRow - g_nFirstRow; //number of rows to be processed
+
+  for(int b=g_nNextBand++; b<g_nEndBand; b=g_nNextBand++){ //for each band claimed
+    const int r = b*BANDSIZE; //first row of band, counting from g_nFirstRow
+    const int i0 = g_nFirstRow + r; //first row of band
+    if(b == 0 || (10LL*r)/nNumRows > (10LL*(r - BANDSIZE))/nNumRows)
+      printf("%d%% ", (int)(100LL*r/nNumRows)); //report progress
+
+    //read ahead the next bands and drop the ones that are done with
+    g_cHeightData.Prefetch(i0 + g_nNumThreads*BANDSIZE, i0 + 2*g_nNumThreads*BANDSIZE);
+    if(b >= 2*g_nNumThreads)
+      g_cHeightData.Discard(i0 - 2*g_nNumThreads*BANDSIZE, i0 - (2*g_nNumThreads - 1)*BANDSIZE);
+
+    ProcessSlopeBand(i0, min(i0 + BANDSIZE, g_nLastRow), *stats);
+  } //for each band claimed
+} //ProcessSlopeThread
+
+/// \brief Process the slope data for all octaves in a single pass.
+///
+/// Sweep the height array once, a band of rows at a time, instead of once
+/// per octave. The bands are shared out among g_nNumThreads worker threads,
+/// each of which has its own statistics. These are combined at the end.
+/// If there is a partial result file, the threads stop every CHECKPOINTBANDS
+/// bands while the statistics so far are combined and saved.
+/// \param total Statistics from any earlier checkpoint, replaced by the result.
+/// \param first First row to be processed, which starts a band unless it is g_nLastRow.
+
+void ProcessSlopeDataSinglePass(SlopeStats& total, const int first){
+  //per-thread statistics, each on its own cache lines, plus one for the earlier checkpoint
+  SlopeStats* stats = NewSlopeStats(g_nNumThreads + 1);
+
+  for(int t=0; t<g_nNumThreads; t++)
+    ResetSlopeStats(stats[t]);
+  stats[g_nNumThreads] = total;
+
+  const int nNumBands = (g_nLastRow - g_nFirstRow + BANDSIZE - 1)/BANDSIZE; //number of bands
+  const int nSegment = g_strPartialFileName? CHECKPOINTBANDS: nNumBands; //bands between checkpoints
+
+  const int nFirstBand = (first - g_nFirstRow + BANDSIZE - 1)/BANDSIZE; //first band not yet processed
+
+  for(int b0=nFirstBand; b0<nNumBands; b0+=nSegment){ //for each segment
+    g_nNextBand = b0;
+    g_nEndBand = min(b0 + nSegment, nNumBands);
+
+    if(g_nNumThreads == 1) //do it in this thread
+      ProcessSlopeThread(stats); 
+
+    else{ //start the workers and wait for them
+      std::vector<std::thread> workers;
+      for(int t=0; t<g_nNumThreads; t++)
+        workers.push_back(std::thread(ProcessSlopeThread, stats + t));
+      for(int t=0; t<g_nNumThreads; t++)
+        workers[t].join();
+    } //else
+
+    if(g_strPartialFileName){
+      ReduceSlopeStats(stats, g_nNumThreads + 1, total);
+      SaveCheckpoint(total, min(g_nFirstRow + g_nEndBand*BANDSIZE, g_nLastRow), 0);
+    } //if
+  } //for each segment
+
+  ReduceSlopeStats(stats, g_nNumThreads + 1, total);
+  DeleteSlopeStats(stats);
+} //ProcessSlopeDataSinglePass
+
+/// \brief Process the slope data one octave at a time.
+///
+/// Sweep the height array once per octave in a single thread, saving a
+/// checkpoint after each octave.
+/// \param stats Statistics from any earlier checkpoint, added to.
+/// \param octave First octave to be processed.
+/// \param first First row of that octave to be processed, which must start a band.
+
+void ProcessSlopeDataMultiPass(SlopeStats& stats, const int octave, const int first){
+  for(int k=octave; k<NUMOCTAVES; k++){
+    printf("%d ", k+1);
+    ProcessSlopeData(k, stats, k == octave? first: g_nFirstRow);
+    SaveCheckpoint(stats, g_nFirstRow, k + 1);
+  } //for
+} //ProcessSlopeDataMultiPass
+
+/// \brief Process the slope data using a height pyramid.
+///
+/// Sweep the rectangle being processed once in a single thread, recording
+/// the gradients for octave 0 and building a height pyramid of it on the way.
+/// Octave k is then processed at a stride of 1 in level k of the pyramid,
+/// which has a quarter of the points of level k - 1, so the higher octaves
+/// take almost no time. Since the points of level k are reduced from blocks
+/// of points of the height data rather than being sampled from it, the
+/// statistics for octaves after the first are an approximation to the
+/// ones that the other engines compute.
+/// \param stats Statistics to record the gradients in.
+/// \param reduction How each point of the pyramid is made from the ones below it.
+
+void ProcessSlopeDataPyramid(SlopeStats& stats, const PyramidReduction reduction){
+  CHeightPyramid pyramid;
+  pyramid.Init(g_nLastCol - g_nFirstCol, g_nLastRow - g_nFirstRow, NUMOCTAVES, g_nNoData, reduction);
+
+  //octave 0 from the height data, building the pyramid as we go
+  printf("1 ");
+  for(int i0=g_nFirstRow; i0<g_nLastRow; i0+=BANDSIZE){ //for each band of rows
+    const int i1 = min(i0 + BANDSIZE, g_nLastRow);
+    {
+      INSTRUMENT_TIME(STAGE_ACQUIRE);
+      g_cHeightData.Acquire(i0, i1);
+      g_cHeightData.Acquire(i0 + 1, i1 + 1);
+    }
+    INSTRUMENT_ADD(STAGE_ACQUIRE, 1);
+
+    for(int i=i0; i<i1; i++){ //for each row
+      INSTRUMENT_ADD(STAGE_SCAN, g_nLastCol - g_nFirstCol);
+      INSTRUMENT_ADD(STAGE_BAD, CountBadPoints(i));
+      ProcessSlopeRow(i, 0, stats);
+      pyramid.AddRow(HeightRow(i) + g_nFirstCol);
+      INSTRUMENT_ADD(STAGE_ROWS, 1);
+    } //for
+
+    g_cHeightData.Release(i0, i1);
+    g_cHeightData.Release(i0 + 1, i1 + 1);
+  } //for each band of rows
+
+  pyramid.Finish();
+
+  //the other octaves from the levels of the pyramid
+  for(int k=1; k<NUMOCTAVES; k++){ //for each octave
+    printf("%d ", k+1);
+    const int w = pyramid.GetWidth(k); //width of level k
+    const int h = pyramid.GetHeight(k); //height of level k
+
+    for(int i=0; i<h; i++){ //for each row of level k
+      INSTRUMENT_TIME_COUNT(STAGE_OCTAVE + k, stats.nPointCount[k]);
+      ProcessSlopePairs(pyramid.GetRow(k, i), i + 1 < h? pyramid.GetRow(k, i + 1): NULL,
+        0, w, w, 1, k, stats);
+    } //for
+  } //for each octave
+
+  printf("\n  Pyramid used %0.1f MB.", (double)pyramid.GetBytes()/(1 << 20));
+} //ProcessSlopeDataPyramid
+
+/// \brief Resume from a checkpoint.
+///
+/// If the partial result file is there, check that it is for the same height
+/// data, rows, and engine, and if so load the statistics gathered so far.
+/// Otherwise start a new one.
+/// \param stats Statistics to load into.
+/// \return false if there is a partial result file that can't be resumed.
+
+bool ResumeCheckpoint(SlopeStats& stats){
+  ResetSlopeStats(stats);
+  if(g_strPartialFileName == NULL)return true;
+
+  FILE* input = fopen(g_strPartialFileName, "rb");
+  if(input == NULL)return true; //nothing to resume
+  fclose(input);
+
+  PartialHeader header;
+  SlopeStats* saved = NewSlopeStats();
+  bool ok = LoadPartialResult(g_strPartialFileName, header, *saved);
+
+  if(!ok)
+    printf("  Partial result file %s is corrupt.\n", g_strPartialFileName);
+
+  else if(!IsSameHeightData(header, g_sPartialHeader) ||
+    header.row0 != g_sPartialHeader.row0 || header.row1 != g_sPartialHeader.row1 ||
+    header.col0 != g_sPartialHeader.col0 || header.col1 != g_sPartialHeader.col1 ||
+    header.multipass != g_sPartialHeader.multipass ||
+    ((header.nextrow - header.row0)%BANDSIZE != 0 && header.nextrow != header.row1))
+  {
+    printf("  Partial result file %s is for different height data, rows, or engine.\n", g_strPartialFileName);
+    ok = false;
+  } //else if
+
+  else{
+    g_sPartialHeader = header;
+    stats = *saved;
+    if(header.complete)
+      printf("  Partial result file %s is already complete.\n", g_strPartialFileName);
+    else if(header.multipass)
+      printf("  Resuming from %s at octave %d row %d.\n", g_strPartialFileName, header.octave + 1, header.nextrow);
+    else printf("  Resuming from %s at row %d.\n", g_strPartialFileName, header.nextrow);
+  } //else
+
+  DeleteSlopeStats(saved);
+  return ok;
+} //ResumeCheckpoint
+
+/// \brief Merge partial results.
+///
+/// Merge complete partial result files for regions of the same height data
+/// that don't overlap into the global statistics.
+/// \param filename Names of partial result files.
+/// \return true if it succeeds, false if it fails.
+
+bool MergePartialResults(const std::vector<const char*>& filename){
+  std::vector<PartialHeader> header(filename.size());
+  SlopeStats* stats = NewSlopeStats();
+  SlopeStats* total = NewSlopeStats();
+  ResetSlopeStats(*total);
+  long long nArea = 0LL; //number of points covered
+  bool ok = !filename.empty();
+
+  for(int i=0; i<(int)filename.size() && ok; i++){
+    const PartialHeader& h = header[i];
+
+    if(!LoadPartialResult(filename[i], header[i], *stats)){
+      printf("  Failed to read partial result file %s.\n", filename[i]);
+      ok = false;
+    } //if
+
+    else if(!h.complete){
+      printf("  Partial result file %s is not complete.\n", filename[i]);
+      ok = false;
+    } //else if
+
+    else if(!IsSameHeightData(h, header[0])){
+      printf("  Partial result file %s is for different height data from %s.\n", filename[i], filename[0]);
+      ok = false;
+    } //else if
+
+    else{
+      for(int j=0; j<i && ok; j++) //check for overlap
+        if(h.row0 < header[j].row1 && header[j].row0 < h.row1 && h.col0 < header[j].col1 && header[j].col0 < h.col1){
+          printf("  Partial result files %s and %s overlap.\n", filename[j], filename[i]);
+          ok = false;
+        } //if
+
+      if(ok){
+        printf("  %s: rows %d to %d, columns %d to %d\n", filename[i], h.row0, h.row1 - 1, h.col0, h.col1 - 1);
+        MergeSlopeStats(*total, *stats);
+        nArea += (long long)(h.row1 - h.row0)*(h.col1 - h.col0);
+      } //if
+    } //else
+  } //for
+
+  if(ok){
+    printf("  Merged %d partial results covering %0.2f%% of the %dx%d height data.\n", (int)filename.size(),
+      100.0*nArea/((double)header[0].width*header[0].height), header[0].width, header[0].height);
+    InitOctaveTable(header[0].cellsize, header[0].scale);
+    SetSlopeGlobals(*total);
+    FreeOctaveTable();
+  } //if
+
+  DeleteSlopeStats(stats);
+  DeleteSlopeStats(total);
+  return ok;
+} //MergePartialResults
+
 /// \brief Save slope statistics.
 ///
 /// Save the gradient statistics to a tab-separated text file output.txt.
@@ -214,12 +766,80 @@ void SaveSlopeStats(){
 /// Does initialization, allocates a honking big block of memory (so you'd better
 /// compile this in 64 bit mode, and hopefully you have at least 16GB RAM
 /// onboard), reads the data, performs the analysis, saves the results,
-/// deallocates the memory and shuts down.
+/// deallocates the memory and shuts down. By default all octaves are
+/// processed in a single pass over the data. The command line option
+/// -multipass makes it process the octaves one at a time in separate passes instead.
+/// The packed data is memory mapped rather than read, unless the command line
+/// option -read is given. If it is tiled, bands of tiles are decoded on demand
+/// into a cache whose size in megabytes can be set with the command line option
+/// -cache.
+/// The single pass can be spread over several threads with the command line
+/// option -threads followed by the number of threads, or 0 for one per hardware
+/// thread. The results are the same for any number of threads. The height
+/// pyramid is always processed in one pass in one thread.
 /// \param argc Argument count
 /// \param argv Arguments.
 /// \return 0 for success, 1 for failure.
 
 int main(int argc, char *argv[]){ 
+  bool bMultiPass = false; //true to process octaves in separate passes
+  bool bRead = false; //true to read the data instead of mapping it
+  double dProgressInterval = 10.0; //seconds between progress reports
+  const char* strLogFileName = NULL; //name of instrumentation log file
+  int nFirstRow = 0, nLastRow = -1; //rows to be processed, -1 for all of them
+  int nFirstCol = 0, nLastCol = -1; //columns to be processed, -1 for all of them
+  bool bUTM = false; //true if the region of interest is in UTM coordinates
+  double dUTM[4]; //eastings and northings of opposite corners of the region of interest
+  bool bPyramid = false; //true to use a height pyramid
+  PyramidReduction eReduction = PYRAMID_MEAN; //how the pyramid is reduced
+  std::vector<const char*> vMergeFiles; //partial result files to be merged
+
+  //parse command line
+  for(int i=1; i<argc; i++)
+    if(!strcmp(argv[i], "-multipass"))
+      bMultiPass = true;
+    else if(!strcmp(argv[i], "-read"))
+      bRead = true;
+    else if(!strcmp(argv[i], "-cache") && i+1 < argc)
+      g_nCacheSize = atoll(argv[++i]) << 20;
+    else if(!strcmp(argv[i], "-threads") && i+1 < argc)
+      g_nNumThreads = atoi(argv[++i]);
+    else if(!strcmp(argv[i], "-progress") && i+1 < argc)
+      dProgressInterval = atof(argv[++i]);
+    else if(!strcmp(argv[i], "-log") && i+1 < argc)
+      strLogFileName = argv[++i];
+    else if(!strcmp(argv[i], "-partial") && i+1 < argc)
+      g_strPartialFileName = argv[++i];
+    else if(!strcmp(argv[i], "-rows") && i+2 < argc){
+      nFirstRow = atoi(argv[++i]);
+      nLastRow = atoi(argv[++i]);
+    } //else if
+    else if(!strcmp(argv[i], "-roi") && i+4 < argc){
+      nFirstRow = atoi(argv[++i]);
+      nFirstCol = atoi(argv[++i]);
+      nLastRow = atoi(argv[++i]);
+      nLastCol = atoi(argv[++i]);
+      bUTM = false;
+    } //else if
+    else if(!strcmp(argv[i], "-utm") && i+4 < argc){
+      for(int j=0; j<4; j++)
+        dUTM[j] = atof(argv[++i]);
+      bUTM = true;
+    } //else if
+    else if(!strcmp(argv[i], "-pyramid")){
+      bPyramid = true;
+      if(i+1 < argc && !strcmp(argv[i+1], "mean"))
+        eReduction = PYRAMID_MEAN, i++;
+      else if(i+1 < argc && !strcmp(argv[i+1], "sample"))
+        eReduction = PYRAMID_SAMPLE, i++;
+    } //else if
+    else if(!strcmp(argv[i], "-merge"))
+      while(i+1 < argc && argv[i+1][0] != '-')
+        vMergeFiles.push_back(argv[++i]);
+    else printf("Ignoring unknown option %s\n", argv[i]);
+
+  if(g_nNumThreads <= 0) //one per hardware thread
+    g_nNumThreads = max((int)std::thread::hardware_concurrency(), 1);
 
   //initialize stats
   for(int k=0; k<NUMOCTAVES; k++){ 
@@ -231,32 +851,131 @@ int main(int argc, char *argv[]){
       g_nDistribution[k][i] = 0LL;
   } //for
 
-  //grab memory for the grid
-  printf("Allocating memory.\n");
-  g_pHeightBuffer = (unsigned char*)malloc(g_nBufSize);
-  g_nHeight = (unsigned short*)g_pHeightBuffer;
-
-  //read height files
-  printf("Reading height data.\n");
-  g_nStartTime = CPUTimeInMilliseconds();
-  if(ReadHeightData()){ //process the height data
-    printf(" in %0.2f seconds.\n", (float)(CPUTimeInMilliseconds() - g_nStartTime)/1000.0f);    
-    printf("Processing height data.\n");
-    g_nStartTime = CPUTimeInMilliseconds();
-    printf("  ");
-    for(int k=0; k<NUMOCTAVES; k++){
-      printf("%d ", k+1);
-      ProcessSlopeData(k);
-    } //for
-    printf("\nHeight data processed in %0.2f seconds.\n", (float)(CPUTimeInMilliseconds() - g_nStartTime)/1000.0f);
-    SaveSlopeStats();
+  //merge partial results instead of processing height data
+  if(!vMergeFiles.empty()){
+    printf("Merging partial results.\n");
+    if(MergePartialResults(vMergeFiles))
+      SaveSlopeStats();
+    else printf("Merge failed\n");
   } //if
-  else printf("Read fail\n");
 
-  //recover grid memory
-  printf("Deallocating memory...\n");
-  if(g_pHeightBuffer)
-    free(g_pHeightBuffer);
+  else{ //process height data
+    //map or read height files, falling back to reading if mapping fails
+    printf("%s height data.\n", bRead? "Reading": "Mapping");
+    g_nStartTime = GetTime();
+    g_nStartCPUTime = CPUTimeInMilliseconds();
+    bool bSuccess = OpenHeightData(bRead);
+    if(!bSuccess && !bRead){
+      printf("Mapping failed, reading height data instead.\n");
+      bSuccess = OpenHeightData(true);
+    } //if
+
+    if(bSuccess){ //choose the rows and columns
+      printf(" in %0.2f seconds (%0.2f seconds CPU time).\n", (GetTime() - g_nStartTime)/1000.0f,
+        (CPUTimeInMilliseconds() - g_nStartCPUTime)/1000.0f);
+      const DEMFileHeader& header = g_cHeightData.GetHeader();
+
+      if(bUTM){ //convert from UTM to grid coordinates
+        if(header.xorigin == 0.0 && header.yorigin == 0.0){
+          printf("  The height data has no UTM origin, so -utm can't be used.\n");
+          bSuccess = false;
+        } //if
+        else{
+          nFirstCol = (int)floor((min(dUTM[0], dUTM[2]) - header.xorigin)/header.cellsize);
+          nLastCol = (int)ceil((max(dUTM[0], dUTM[2]) - header.xorigin)/header.cellsize);
+          nFirstRow = (int)floor((header.yorigin - max(dUTM[1], dUTM[3]))/header.cellsize);
+          nLastRow = (int)ceil((header.yorigin - min(dUTM[1], dUTM[3]))/header.cellsize);
+          if(nFirstRow < 0 && nLastRow < 0)nLastRow = 0; //not a -1 for all rows
+          if(nFirstCol < 0 && nLastCol < 0)nLastCol = 0; //not a -1 for all columns
+        } //else
+      } //if
+
+      g_nFirstRow = max(nFirstRow, 0);
+      g_nLastRow = nLastRow < 0? g_nNumRows: min(nLastRow, g_nNumRows);
+      g_nFirstCol = max(nFirstCol, 0);
+      g_nLastCol = nLastCol < 0? g_nNumCols: min(nLastCol, g_nNumCols);
+
+      if(bSuccess && (g_nFirstRow >= g_nLastRow || g_nFirstCol >= g_nLastCol)){
+        printf("No rows to process.\n");
+        bSuccess = false;
+      } //if
+      else if(bSuccess && (g_nFirstCol > 0 || g_nLastCol < g_nNumCols))
+        printf("  Processing rows %d to %d, columns %d to %d.\n",
+          g_nFirstRow, g_nLastRow - 1, g_nFirstCol, g_nLastCol - 1);
+      else if(bSuccess && (g_nFirstRow > 0 || g_nLastRow < g_nNumRows))
+        printf("  Processing rows %d to %d.\n", g_nFirstRow, g_nLastRow - 1);
+    } //if
+
+    if(bSuccess && bPyramid && (bMultiPass || g_strPartialFileName != NULL || g_nNumThreads > 1)){
+      printf("  The pyramid is processed in one pass in one thread without checkpoints.\n");
+      bMultiPass = false;
+      g_strPartialFileName = NULL;
+      g_nNumThreads = 1;
+    } //if
+
+    SlopeStats* total = NewSlopeStats(); //statistics for all of the rows being processed
+
+    if(bSuccess){ //carry on from any earlier checkpoint
+      InitPartialHeader(g_sPartialHeader, g_cHeightData.GetHeader(),
+        g_nFirstRow, g_nLastRow, g_nFirstCol, g_nLastCol, bMultiPass);
+      bSuccess = ResumeCheckpoint(*total);
+    } //if
+
+    if(bSuccess){ //process the height data
+      printf("Processing height data using %d thread%s.\n", 
+        g_nNumThreads, g_nNumThreads > 1? "s": "");
+      g_nStartTime = GetTime();
+      g_nStartCPUTime = CPUTimeInMilliseconds();
+      InitOctaveTable(g_cHeightData.GetHeader().cellsize, g_cHeightData.GetHeader().scale);
+      const int first = g_sPartialHeader.nextrow; //first row to be processed
+      const int octave = g_sPartialHeader.octave; //first octave to be processed
+
+#ifdef INSTRUMENT
+      g_cInstrument.SetCounter(STAGE_ACQUIRE, "acquire", "bands");
+      g_cInstrument.SetCounter(STAGE_SCAN, "scan", "Mpoints", 1e-6, COUNTER_PERIODIC);
+      g_cInstrument.SetPercent(STAGE_BAD, "bad", STAGE_SCAN);
+      g_cInstrument.SetCounter(STAGE_ROWS, "rows", "rows", 1.0, COUNTER_PROGRESS);
+      for(int k=0; k<NUMOCTAVES; k++){
+        char name[32];
+        sprintf(name, "octave%d", k + 1);
+        g_cInstrument.SetCounter(STAGE_OCTAVE + k, name, "Mgradients", 1e-6, COUNTER_TIMED);
+      } //for
+      g_cInstrument.SetSum(STAGE_GRADIENTS, "gradients", "Mgradients", STAGE_OCTAVE, NUMOCTAVES);
+      g_cInstrument.SetTotal(bMultiPass?
+        (long long)(NUMOCTAVES - octave)*(g_nLastRow - g_nFirstRow) - (first - g_nFirstRow): g_nLastRow - first);
+      g_cInstrument.Start(dProgressInterval, strLogFileName);
+#else
+      if(dProgressInterval != 10.0 || strLogFileName != NULL)
+        printf("Instrumentation is compiled out, ignoring -progress and -log\n");
+#endif
+
+      printf("  ");
+      if(g_sPartialHeader.complete)
+        printf("Nothing left to process."); //just report the saved statistics
+      else if(bPyramid)
+        ProcessSlopeDataPyramid(*total, eReduction);
+      else if(bMultiPass)
+        ProcessSlopeDataMultiPass(*total, octave, first);
+      else ProcessSlopeDataSinglePass(*total, first);
+      SetSlopeGlobals(*total);
+      if(g_cHeightData.GetNumBadTiles() > 0)
+        printf("\n  %d corrupt tiles were treated as having no data.", g_cHeightData.GetNumBadTiles());
+      printf("\nHeight data processed in %0.2f seconds (%0.2f seconds CPU time).\n",
+        (GetTime() - g_nStartTime)/1000.0f, (CPUTimeInMilliseconds() - g_nStartCPUTime)/1000.0f);
+      fflush(stdout);
+#ifdef INSTRUMENT
+      g_cInstrument.Stop();
+#endif
+      SaveSlopeStats();
+    } //if
+    else printf("Read fail\n");
+
+    //recover grid memory
+    printf("Deallocating memory...\n");
+    DeleteSlopeStats(total);
+    g_cHeightData.Close();
+    FreeOctaveTable();
+  } //else
 
 #if defined(_MSC_VER) //Windows Visual Studio 
   //wait for user keystroke and exit
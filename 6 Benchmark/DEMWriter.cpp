@@ -0,0 +1,285 @@
+/// \file DEMWriter.cpp
+/// \brief Code for the terrain output file writer.
+
+// Copyright Ian Parberry, May 2014.
+//
+// This file is made available under the GNU All-Permissive License.
+//
+// Copying and distribution of this file, with or without modification,
+// are permitted in any medium without royalty provided the copyright
+// notice and this notice are preserved.  This file is offered as-is,
+// without any warranty.
+
+#include <string.h>
+#include <math.h>
+
+#include "DEMWriter.h"
+
+/// Get a file format from its name on the command line, which is one of
+/// asc, uint16, float32, packed, and compressed.
+/// \param name Name of format.
+/// \param format The format with that name.
+/// \return true if the name is recognized.
+
+bool ParseDEMFormat(const char* name, DEMFormat& format){
+  if(!strcmp(name, "asc"))format = DEMFORMAT_ASC;
+  else if(!strcmp(name, "uint16"))format = DEMFORMAT_UINT16;
+  else if(!strcmp(name, "float32"))format = DEMFORMAT_FLOAT32;
+  else if(!strcmp(name, "packed"))format = DEMFORMAT_PACKED;
+  else if(!strcmp(name, "compressed"))format = DEMFORMAT_COMPRESSED;
+  else return false;
+  return true;
+} //ParseDEMFormat
+
+/// Format a height with two digits after the decimal point, giving exactly
+/// the same characters as printf("%0.2f"). A float times 100 is exact in double
+/// precision, so rounding it to the nearest integer with ties going to even
+/// rounds the exact value of the float the same way that printf does.
+/// \param value Height.
+/// \param dest Buffer for at least 48 characters, which are not nul terminated.
+/// \return Number of characters written.
+
+int FormatHeight(const float value, char* dest){
+  unsigned int bits; //bits of value
+  memcpy(&bits, &value, sizeof(bits));
+  const double x = fabs((double)value*100.0); //exact
+
+  //checking the bits instead of x catches infinity and NaN even with -ffast-math
+  if(((bits >> 23) & 0xFF) == 0xFF || x >= 1e15) //too large, infinite, or not a number
+    return sprintf(dest, "%0.2f", value);
+
+  //round to nearest, ties to even
+  const double whole = floor(x);
+  const double frac = x - whole; //exact
+  long long n = (long long)whole;
+  if(frac > 0.5 || (frac == 0.5 && (n&1)))n++;
+
+  //digits in reverse order, at least three of them
+  char digit[24];
+  int ndigits = 0;
+  do{
+    digit[ndigits++] = (char)('0' + n%10);
+    n /= 10;
+  }while(n > 0 || ndigits < 3);
+
+  //printf puts a minus sign on anything with the sign bit set, even if it rounds to 0
+  char* p = dest;
+  if(bits >> 31)*p++ = '-';
+  while(ndigits > 2)*p++ = digit[--ndigits];
+  *p++ = '.';
+  *p++ = digit[1];
+  *p++ = digit[0];
+
+  return (int)(p - dest);
+} //FormatHeight
+
+/// The constructor doesn't do much, that's what Open() is for.
+
+CDEMWriter::CDEMWriter():
+  m_eFormat(DEMFORMAT_ASC), m_pFile(NULL), m_pBuffer(NULL), m_nBufferBytes(0), m_pRow(NULL),
+  m_nWidth(0), m_nHeight(0), m_dCellSize(0.0), m_nBytesWritten(0), m_bFailed(false)
+{
+  m_szFileName[0] = '\0';
+} //constructor
+
+/// The destructor finishes writing the file if it is still open.
+
+CDEMWriter::~CDEMWriter(){
+  Close();
+} //destructor
+
+/// Create a terrain file. Its name is the base file name with an extension
+/// that depends on the format: .asc for ASCII grids, .img for raw heights,
+/// which also get a .hdr file, and .bin for packed files.
+/// \param basefilename Name of file without extension.
+/// \param format File format.
+/// \param width Number of heights in each row.
+/// \param height Number of rows.
+/// \param cellsize Distance between points in meters.
+/// \return true if it succeeds, false if it fails.
+
+bool CDEMWriter::Open(const char* basefilename, const DEMFormat format,
+  const int width, const int height, const double cellsize)
+{
+  Close();
+
+  m_eFormat = format;
+  m_nWidth = width;
+  m_nHeight = height;
+  m_dCellSize = cellsize;
+  m_nBytesWritten = 0;
+  m_bFailed = false;
+
+  switch(format){
+    case DEMFORMAT_ASC:
+      sprintf(m_szFileName, "%.250s.asc", basefilename);
+      m_pFile = fopen(m_szFileName, "wt");
+      break;
+
+    case DEMFORMAT_UINT16:
+    case DEMFORMAT_FLOAT32: {
+      char hdrfilename[256];
+      sprintf(hdrfilename, "%.250s.hdr", basefilename);
+      if(!WriteENVIHeader(hdrfilename))return false;
+      sprintf(m_szFileName, "%.250s.img", basefilename);
+      m_pFile = fopen(m_szFileName, "wb");
+    } break;
+
+    case DEMFORMAT_PACKED:
+    case DEMFORMAT_COMPRESSED: {
+      sprintf(m_szFileName, "%.250s.bin", basefilename);
+      DEMFileHeader header;
+      InitDEMHeader(header, width, height, DEMFILE_TILESIZE, DEMWRITER_HEIGHTSCALE, 0, cellsize);
+      header.codec = format == DEMFORMAT_COMPRESSED? DEMCODEC_RICE: DEMCODEC_RAW;
+      if(!m_cPackedFile.Open(m_szFileName, header))return false;
+    } break;
+  } //switch
+
+  const bool bPacked = format == DEMFORMAT_PACKED || format == DEMFORMAT_COMPRESSED;
+  if(!bPacked && m_pFile == NULL)return false;
+
+  m_pBuffer = new char [DEMWRITER_BUFSIZE];
+  m_nBufferBytes = 0;
+  if(format != DEMFORMAT_FLOAT32)
+    m_pRow = new unsigned short [width];
+
+  if(format == DEMFORMAT_ASC){ //header
+    char header[256];
+    const int n = sprintf(header,
+      "nrows %d\nncols %d\nxllcenter %0.6f\nyllcenter %0.6f\ncellsize %0.6f\nNODATA_value  -9999\n",
+      height, width, 0.0f, 0.0f, cellsize);
+    Write(header, n);
+  } //if
+
+  return true;
+} //Open
+
+/// Write an ENVI header file describing a raw terrain file, so that GIS
+/// programs can read it.
+/// \param filename Name of header file.
+/// \return true if it succeeds, false if it fails.
+
+bool CDEMWriter::WriteENVIHeader(const char* filename){
+  FILE* output = fopen(filename, "wt");
+  if(output == NULL)return false;
+
+  const unsigned short one = 1;
+  const bool bLittleEndian = *(const unsigned char*)&one == 1;
+  const bool bFloat = m_eFormat == DEMFORMAT_FLOAT32;
+
+  fprintf(output, "ENVI\n");
+  fprintf(output, "description = {Terrain heights in %s}\n", bFloat? "meters": "decimeters");
+  fprintf(output, "samples = %d\n", m_nWidth);
+  fprintf(output, "lines = %d\n", m_nHeight);
+  fprintf(output, "bands = 1\n");
+  fprintf(output, "header offset = 0\n");
+  fprintf(output, "file type = ENVI Standard\n");
+  fprintf(output, "data type = %d\n", bFloat? 4: 12);
+  fprintf(output, "interleave = bsq\n");
+  fprintf(output, "byte order = %d\n", bLittleEndian? 0: 1);
+  fprintf(output, "pixel size = {%0.6f, %0.6f}\n", m_dCellSize, m_dCellSize);
+  if(!bFloat)
+    fprintf(output, "data gain values = {%g}\n", 1.0/DEMWRITER_HEIGHTSCALE);
+
+  return fclose(output) == 0;
+} //WriteENVIHeader
+
+/// Write data to the output buffer, writing out the buffer when it is full.
+/// \param data Pointer to data.
+/// \param size Size of data in bytes.
+
+void CDEMWriter::Write(const void* data, const int size){
+  const char* p = (const char*)data;
+  for(int left=size; left>0; ){
+    if(m_nBufferBytes == DEMWRITER_BUFSIZE)Flush();
+    int n = DEMWRITER_BUFSIZE - m_nBufferBytes;
+    if(n > left)n = left;
+    memcpy(m_pBuffer + m_nBufferBytes, p, n);
+    m_nBufferBytes += n; p += n; left -= n;
+  } //for
+} //Write
+
+/// Write out the output buffer.
+
+void CDEMWriter::Flush(){
+  if(m_nBufferBytes > 0 && m_pFile != NULL){
+    m_bFailed |= fwrite(m_pBuffer, m_nBufferBytes, 1, m_pFile) != 1;
+    m_nBytesWritten += m_nBufferBytes;
+  } //if
+  m_nBufferBytes = 0;
+} //Flush
+
+/// Write the next row of heights.
+/// \param row Array of width heights in meters.
+/// \return true if it succeeds, false if it fails.
+
+bool CDEMWriter::WriteRow(const float* row){
+  if(m_pBuffer == NULL)return false;
+
+  //16-bit heights are stored the way Pack does it
+  if(m_pRow != NULL)
+    for(int j=0; j<m_nWidth; j++)
+      m_pRow[j] = PackHeight(row[j]);
+
+  switch(m_eFormat){
+    case DEMFORMAT_ASC:
+      for(int j=0; j<m_nWidth; j++){
+        if(m_nBufferBytes > DEMWRITER_BUFSIZE - 64)Flush();
+        m_nBufferBytes += FormatHeight(row[j], m_pBuffer + m_nBufferBytes);
+        m_pBuffer[m_nBufferBytes++] = ' ';
+      } //for
+      Write("\n", 1);
+      break;
+
+    case DEMFORMAT_UINT16:
+      Write(m_pRow, m_nWidth*sizeof(unsigned short));
+      break;
+
+    case DEMFORMAT_FLOAT32:
+      Write(row, m_nWidth*sizeof(float));
+      break;
+
+    case DEMFORMAT_PACKED:
+    case DEMFORMAT_COMPRESSED:
+      m_bFailed |= !m_cPackedFile.WriteRow(m_pRow);
+      break;
+  } //switch
+
+  return !m_bFailed;
+} //WriteRow
+
+/// Write out whatever is left in the buffer and close the file.
+/// \return true if the whole file was written successfully.
+
+bool CDEMWriter::Close(){
+  if(m_pBuffer == NULL)return !m_bFailed;
+
+  Flush();
+  if(m_pFile != NULL){
+    m_bFailed |= fclose(m_pFile) != 0;
+    m_pFile = NULL;
+  } //if
+  else{ //packed
+    m_nBytesWritten = m_cPackedFile.GetBytesWritten();
+    m_bFailed |= !m_cPackedFile.Close();
+  } //else
+
+  delete [] m_pBuffer; m_pBuffer = NULL;
+  delete [] m_pRow; m_pRow = NULL;
+
+  return !m_bFailed;
+} //Close
+
+/// Reader function for the output file name.
+/// \return Name of output file.
+
+const char* CDEMWriter::GetFileName(){
+  return m_szFileName;
+} //GetFileName
+
+/// Reader function for the number of bytes written.
+/// \return Number of bytes written to the output file so far.
+
+long long CDEMWriter::GetBytesWritten(){
+  return m_nBytesWritten;
+} //GetBytesWritten
@@ -0,0 +1,23 @@
+/// \file ExponentialHash.h
+/// \brief Header for generating an exponentially distributed hash function.
+
+// Copyright Ian Parberry, May 2014.
+//
+// This file is made available under the GNU All-Permissive License.
+// Copying and distribution of this file, with or without modification,
+// are permitted in any medium without royalty provided the copyright
+// notice and this notice are preserved.  This file is offered as-is,
+// without any warranty.
+//
+// Created by Ian Parberry, May 2014.
+// Last updated May 31, 2014.
+
+#pragma once
+
+float UniformHash(unsigned int x, unsigned int max); ///< Uniformly distributed hash function.
+float ExpHash(unsigned int x, unsigned int max); ///< Exponentially distributed hash function.
+float ExpHash(unsigned int x, unsigned int y, unsigned int m, float omega); ///< Exponentially distributed hash function.
+
+float FastLog2(float x); ///< Fast approximate base 2 logarithm.
+float ExpHashFast(unsigned int x, unsigned int max); ///< Fast exponentially distributed hash function.
+float ExpHashFast(unsigned int x, unsigned int y, unsigned int m, float omega); ///< Fast exponentially distributed hash function.
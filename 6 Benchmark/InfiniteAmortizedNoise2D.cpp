@@ -0,0 +1,761 @@
+/// \file InfiniteAmortizedNoise2D.cpp
+/// \brief Code file for the 2D amortized noise class CInfiniteAmortizedNoise2D.
+
+// Copyright Ian Parberry, September 2013.
+//
+// This file is made available under the GNU All-Permissive License.
+//
+// Copying and distribution of this file, with or without modification,
+// are permitted in any medium without royalty provided the copyright
+// notice and this notice are preserved.  This file is offered as-is,
+// without any warranty.
+//
+// Created by Ian Parberry, September 2013.
+// Last updated May 6, 2014.
+
+#define _USE_MATH_DEFINES //for M_SQRT2
+#include <math.h> //for trig functions
+
+#include <atomic> //for std::atomic
+#include <algorithm> //for std::sort
+
+#include "InfiniteAmortizedNoise2D.h"
+#include "Common.h"
+#include "MurmurHash3.h"
+#include "NoiseKernel.h"
+
+/// \brief One octave of subcells.
+///
+/// Everything that the threads generating the subcells of an octave need to
+/// know. The threads take rows of subcells one at a time, so that a thread
+/// that finishes early takes more of them. It is handed to the worker pool
+/// twice, once to compute the lattice gradients and once for the subcells.
+
+struct OctaveJob: CWorkerTask{
+  CInfiniteAmortizedNoise2D* pNoise; ///< Generator.
+  bool bLattice; ///< Whether the lattice gradients are being computed, instead of the subcells.
+  int x; ///< x coordinate of top left corner of cell in this octave.
+  int y; ///< y coordinate of top left corner of cell in this octave.
+  int r; ///< Side length of cell divided by side length of subcell.
+  int n; ///< Granularity.
+  float scale; ///< Scale factor for this octave.
+  bool bFirst; ///< Whether this is the first octave, which is copied instead of added.
+  float** cell; ///< Cell to put generated noise into.
+  std::atomic<int> next; ///< Next row of lattice corners or subcells.
+
+  /// Do the calling thread's share of the job, using its own edge tables.
+  /// \param index Index of thread, 0 for the one that generates the cell.
+
+  void Run(const int index){
+    if(bLattice)pNoise->fillLattice(this);
+    else pNoise->generateSubcells(this,
+      index == 0? &pNoise->tables: pNoise->threadTables[index - 1]);
+  } //Run
+}; //OctaveJob
+
+/// Constructor.
+/// \param n Cell size.
+
+CEdgeTables::CEdgeTables(const unsigned int n){
+  uax = new float [n]; vax = new float [n]; //ax
+  ubx = new float [n]; vbx = new float [n]; //bx
+  uay = new float [n]; uby = new float [n]; //ay
+  vay = new float [n]; vby = new float [n]; //by
+} //constructor
+
+CEdgeTables::~CEdgeTables(){
+  delete [] uax; delete [] vax; //ax
+  delete [] ubx; delete [] vbx; //bx
+  delete [] uay; delete [] uby; //ay
+  delete [] vay; delete [] vby; //by
+} //destructor
+
+CWorkerTask::~CWorkerTask(){
+} //destructor
+
+/// The constructor makes an empty pool.
+
+CWorkerPool::CWorkerPool():
+  m_pTask(NULL), m_nTaskThreads(0), m_nBusy(0), m_nGeneration(0), m_bStop(false){
+} //constructor
+
+/// The destructor stops the worker threads.
+
+CWorkerPool::~CWorkerPool(){
+  Stop();
+} //destructor
+
+/// Tell the worker threads to stop and wait for them to do so. They are
+/// never in the middle of a task, since Run waits for them to finish.
+
+void CWorkerPool::Stop(){
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_bStop = true;
+  }
+  m_cvStart.notify_all();
+
+  for(int i=0; i<(int)m_vThreads.size(); i++)
+    m_vThreads[i].join();
+
+  m_vThreads.clear();
+  m_bStop = false;
+} //Stop
+
+/// Set the number of worker threads, starting them over if it changes. New
+/// workers are told how many tasks have already been handed out, so that
+/// they wait for the next one.
+/// \param n Number of worker threads, not counting the caller.
+
+void CWorkerPool::Resize(const int n){
+  if(n == (int)m_vThreads.size())return;
+
+  Stop();
+
+  for(int i=0; i<n; i++)
+    m_vThreads.push_back(std::thread(&CWorkerPool::WorkerThread, this, i + 1, m_nGeneration));
+} //Resize
+
+/// Reader function for the number of worker threads.
+/// \return Number of worker threads, not counting the caller.
+
+int CWorkerPool::GetSize(){
+  return (int)m_vThreads.size();
+} //GetSize
+
+/// Worker thread. Wait for a task, do this thread's share of it if it has
+/// one, and go back to waiting, until told to stop.
+/// \param index Index of thread in tasks, from 1.
+/// \param generation Number of tasks handed out before this thread started.
+
+void CWorkerPool::WorkerThread(const int index, unsigned int generation){
+  std::unique_lock<std::mutex> lock(m_mutex);
+
+  for(;;){
+    while(!m_bStop && m_nGeneration == generation)
+      m_cvStart.wait(lock);
+    if(m_bStop)return;
+
+    generation = m_nGeneration;
+
+    if(index < m_nTaskThreads){ //this thread has a share of the task
+      CWorkerTask* task = m_pTask;
+      lock.unlock();
+      task->Run(index);
+      lock.lock();
+      if(--m_nBusy == 0)m_cvDone.notify_one();
+    } //if
+  } //for
+} //WorkerThread
+
+/// Do a task in the calling thread and n - 1 of the worker threads, or all
+/// of them if there are fewer, and wait until it is done.
+/// \param task The task.
+/// \param n Number of threads, including the caller.
+
+void CWorkerPool::Run(CWorkerTask* task, const int n){
+  const int nThreads = n < (int)m_vThreads.size() + 1? n: (int)m_vThreads.size() + 1;
+
+  if(nThreads > 1){ //hand it out to the workers
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_pTask = task;
+      m_nTaskThreads = nThreads;
+      m_nBusy = nThreads - 1;
+      m_nGeneration++;
+    }
+    m_cvStart.notify_all();
+  } //if
+
+  task->Run(0);
+
+  if(nThreads > 1){ //wait for the workers
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while(m_nBusy > 0)
+      m_cvDone.wait(lock);
+  } //if
+} //Run
+
+/// Constructor.
+/// \param n Cell size.
+/// \param s Hash function seed.
+
+CInfiniteAmortizedNoise2D::CInfiniteAmortizedNoise2D(const unsigned int n, const unsigned int s):
+  tables(n), latticeSize(0), seed(s), size(n), threads(1), gradientMode(GRADIENT_TRIG)
+{ 
+  //Allocate space for spline table.
+  spline = new float [n]; 
+} //constructor
+
+CInfiniteAmortizedNoise2D::~CInfiniteAmortizedNoise2D(){
+  //Deallocate space for the other threads' amortized noise tables.
+  for(int i=0; i<(int)threadTables.size(); i++)
+    delete threadTables[i];
+  
+  //Deallocate space for spline table.
+  delete [] spline; 
+} //destructor
+
+/// Set the number of threads used to generate a cell. Each thread after the
+/// first gets its own edge tables, and is started here and kept in the
+/// worker pool until the number of threads changes.
+/// \param n Number of threads, 0 for one per hardware thread.
+
+void CInfiniteAmortizedNoise2D::setThreads(const int n){
+  threads = n > 0? n: (int)std::thread::hardware_concurrency();
+  if(threads < 1)threads = 1;
+
+  while((int)threadTables.size() < threads - 1)
+    threadTables.push_back(new CEdgeTables(size));
+
+  pool.Resize(threads - 1);
+} //setThreads
+
+/// Reader function for the hash seed.
+/// \return Hash seed.
+
+unsigned int CInfiniteAmortizedNoise2D::getSeed(){
+  return seed;
+} //getSeed
+
+/// Fill amortized noise table bottom up.
+/// \param t Amortized noise table.
+/// \param s Initial value.
+/// \param n Granularity.
+
+void CInfiniteAmortizedNoise2D::FillUp(float* t, const float s, const int n){
+  const float d = s/n; //increment amount
+  t[0] = 0.0f; //corner
+  for(int i=1; i<n; i++) //edge values
+    t[i] = t[i-1] + d;
+} //FillUp
+
+/// Fill amortized noise table top down.
+/// \param t Amortized noise table.
+/// \param s Initial value.
+/// \param n Granularity.
+
+void CInfiniteAmortizedNoise2D::FillDn(float* t, const float s, const int n){
+  const float d = -s/n;  //increment amount
+  t[n-1] = d; //corner
+  for(int i=n-2; i>=0; i--) //edge values
+    t[i] = t[i+1] + d;
+} //FillDn
+
+/// A 2D hash function.
+/// Hash two dimensions into a single unsigned int using MurmurHash.
+/// \param x X coordinate of value to be hashed.
+/// \param y Y coordinate of value to be hashed.
+/// \return Hash of (x, y).
+
+unsigned int CInfiniteAmortizedNoise2D::h(const unsigned int x, const unsigned int y){
+  unsigned int result;
+  unsigned long long key = ((unsigned long long)x<<32) | y;
+  MurmurHash3_32(&key, 8, seed, &result); //do the heavy lifting
+  return result;
+} //h
+
+/// Set how gradient directions are computed. The table of unit vectors is
+/// made the first time that it is needed.
+/// \param mode Gradient direction mode.
+
+void CInfiniteAmortizedNoise2D::setGradientMode(const GradientMode mode){
+  gradientMode = mode;
+  gradientCache.clear(); //the gradients have changed
+
+  if(mode == GRADIENT_TABLE && directionX.empty()){
+    directionX.resize(GRADIENT_TABLE_SIZE);
+    directionY.resize(GRADIENT_TABLE_SIZE);
+    for(int k=0; k<GRADIENT_TABLE_SIZE; k++){
+      const double theta = 2.0*3.14159265358979323846*k/GRADIENT_TABLE_SIZE;
+      directionX[k] = (float)cos(theta);
+      directionY[k] = (float)sin(theta);
+    } //for
+  } //if
+} //setGradientMode
+
+/// Get the direction of a gradient from the hash of its lattice corner.
+/// \param b Hash of the lattice corner.
+/// \param dx X coordinate of the unit vector in that direction.
+/// \param dy Y coordinate of the unit vector in that direction.
+
+void CInfiniteAmortizedNoise2D::getDirection(const unsigned int b, float& dx, float& dy){
+  if(gradientMode == GRADIENT_TABLE){
+    const unsigned int k = b >> (32 - GRADIENT_TABLE_BITS); //top bits are best mixed
+    dx = directionX[k];
+    dy = directionY[k];
+  } //if
+  else{
+    dx = cosf((float)b);
+    dy = sinf((float)b);
+  } //else
+} //getDirection
+
+/// Get the gradient at a lattice corner, which has a direction that depends
+/// on a hash of its coordinates and a magnitude of 1.
+/// \param x x coordinate of lattice corner.
+/// \param y y coordinate of lattice corner.
+/// \param gx X coordinate of gradient.
+/// \param gy Y coordinate of gradient.
+
+void CInfiniteAmortizedNoise2D::getGradient(const int x, const int y, float& gx, float& gy){
+  getDirection(h(x, y), gx, gy);
+} //getGradient
+
+/// Get the gradients at a row of lattice corners, the same as calling
+/// getGradient for each of them, but hashing a batch of corners at a time
+/// with the lattice hash kernels.
+/// \param x x coordinate of the lattice corners.
+/// \param y0 y coordinate of the first lattice corner.
+/// \param n Number of lattice corners.
+/// \param gx X coordinates of gradients.
+/// \param gy Y coordinates of gradients.
+
+void CInfiniteAmortizedNoise2D::getGradientRow(const int x, const int y0, const int n, float* gx, float* gy){
+  unsigned int xs[LATTICE_BATCH], ys[LATTICE_BATCH], b[LATTICE_BATCH];
+
+  for(int j0=0; j0<n; j0+=LATTICE_BATCH){
+    const int m = n - j0 < LATTICE_BATCH? n - j0: LATTICE_BATCH; //corners in this batch
+    for(int j=0; j<m; j++){
+      xs[j] = x; ys[j] = y0 + j0 + j;
+    } //for
+
+    LatticeHashBatch(xs, ys, m, &seed, 1, b);
+
+    for(int j=0; j<m; j++)
+      getDirection(b[j], gx[j0 + j], gy[j0 + j]);
+  } //for
+} //getGradientRow
+
+/// Get the gradient at a lattice corner for a point query, computing it only
+/// if it isn't in the cache already. The cache is emptied when it gets full.
+/// \param x x coordinate of lattice corner.
+/// \param y y coordinate of lattice corner.
+/// \param gx X coordinate of gradient.
+/// \param gy Y coordinate of gradient.
+
+void CInfiniteAmortizedNoise2D::getCachedGradient(const int x, const int y, float& gx, float& gy){
+  const unsigned long long key = ((unsigned long long)(unsigned int)x << 32) | (unsigned int)y;
+  std::unordered_map<unsigned long long, LatticeGradient>::iterator it = gradientCache.find(key);
+
+  if(it != gradientCache.end()){ //cache hit
+    gx = it->second.x;
+    gy = it->second.y;
+  } //if
+  else{ //cache miss
+    getGradient(x, y, gx, gy);
+    if(gradientCache.size() >= GRADIENT_CACHE_SIZE)
+      gradientCache.clear();
+    LatticeGradient& g = gradientCache[key];
+    g.x = gx; g.y = gy;
+  } //else
+} //getCachedGradient
+
+/// Fill the amortized noise tables from the gradients at the corners of a
+/// subcell. CFixedAmortizedNoise2D calls this too, so that its tables are
+/// filled by the same code and are bitwise the same.
+/// \param gx X coordinates of the gradients at the top left, top right,
+///   bottom left, and bottom right corners.
+/// \param gy Y coordinates of the gradients at the corners, in the same order.
+/// \param n Granularity.
+/// \param t Edge tables.
+
+void CInfiniteAmortizedNoise2D::fillEdgeTables(const float* gx, const float* gy, const int n, CEdgeTables& t){
+  FillUp(t.uax, gx[0], n); FillDn(t.vax, gx[1], n);
+  FillUp(t.ubx, gx[2], n); FillDn(t.vbx, gx[3], n);
+  FillUp(t.uay, gy[0], n); FillUp(t.vay, gy[1], n);
+  FillDn(t.uby, gy[2], n); FillDn(t.vby, gy[3], n);
+} //fillEdgeTables
+
+/// Initialize the amortized noise tables from the gradients at the corners of
+/// a subcell, which are taken from the lattice for the current octave.
+/// \param i0 Row of subcell in cell.
+/// \param j0 Column of subcell in cell.
+/// \param n Granularity.
+/// \param t Edge tables.
+
+void CInfiniteAmortizedNoise2D::initEdgeTables(const int i0, const int j0, const int n, CEdgeTables& t){
+  //gradients at corner points
+  const int k00 = i0*latticeSize + j0;
+  const int k01 = k00 + 1; 
+  const int k10 = k00 + latticeSize;
+  const int k11 = k10 + 1;
+  
+  //fill inferred gradient tables from corner gradients
+  const float gx[4] = {latticeX[k00], latticeX[k01], latticeX[k10], latticeX[k11]};
+  const float gy[4] = {latticeY[k00], latticeY[k01], latticeY[k10], latticeY[k11]};
+  fillEdgeTables(gx, gy, n, t);
+} //initEdgeTables
+
+/// Fill a spline table as described in the paper "Amortized Noise".
+/// \param t Spline table.
+/// \param n Granularity.
+
+void CInfiniteAmortizedNoise2D::fillSplineTable(float* t, const int n){
+  for(int i=0; i<n; i++){ //for each table entry
+    float u = (float)i/n; //offset between grid points
+    t[i] = s_curve2(u); //quintic spline
+  } //for
+} //fillSplineTable
+
+/// Initialize the spline table.
+/// \param n Granularity.
+
+void CInfiniteAmortizedNoise2D::initSplineTable(const int n){
+  fillSplineTable(spline, n);
+} //initSplineTable
+
+/// Compute a single point of a single octave of Perlin noise. This is similar
+/// to Perlin's noise2 function except that it substitutes table lookups for
+///  floating pointmultiplication as described in the paper "Amortized Noise".
+/// It uses the edge tables of the calling thread.
+/// \param i x coordinate of point.
+/// \param j y coordinate of point.
+/// \return Noise value at (x, y).
+
+float CInfiniteAmortizedNoise2D::getNoise(const int i, const int j){  
+  float u = tables.uax[j] + tables.uay[i];
+  float v = tables.vax[j] + tables.vay[i];
+  const float a = lerp(spline[j], u, v); 
+  u = tables.ubx[j] + tables.uby[i];
+  v = tables.vbx[j] + tables.vby[i];
+  const float b = lerp(spline[j], u, v);   
+  return lerp(spline[i], a, b);   
+} //getNoise
+
+/// Set the values of the y tables and spline table for one row of a subcell
+/// in a noise row for the row kernels.
+/// \param i x coordinate of row.
+/// \param t Edge tables.
+/// \param row Noise row.
+
+void CInfiniteAmortizedNoise2D::initNoiseRow(const int i, const CEdgeTables& t, NoiseRow& row){
+  row.uay = t.uay[i]; row.vay = t.vay[i];
+  row.uby = t.uby[i]; row.vby = t.vby[i];
+  row.si = spline[i];
+} //initNoiseRow
+
+/// Get a single octave of noise into a subcell.
+/// This differs from CInfiniteAmortizedNoise2D::addNoise in that it copies the noise
+/// to the cell instead of adding it in. The noise is computed a row at a time
+/// by a SIMD kernel that gives the same results as getNoise(i, j).
+/// \param n Granularity.
+/// \param i0 x offset of this subcell in cell.
+/// \param j0 y offset of this subcell in cell.
+/// \param t Edge tables.
+/// \param cell Noise cell.
+
+void CInfiniteAmortizedNoise2D::getNoise(const int n, const int i0, const int j0, const CEdgeTables& t, float** cell){  
+  NoiseRow row = {t.uax, t.vax, t.ubx, t.vbx, spline, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+  for(int i=0; i<n; i++){
+    initNoiseRow(i, t, row);
+    GetNoiseRow(row, n, cell[i0 + i] + j0); //the only line that differs from addNoise
+  } //for
+} //getNoise
+
+/// Add a single octave of noise into a subcell.
+/// This differs from CInfiniteAmortizedNoise2D::getNoise in that it adds the noise
+/// to the cell instead of copying it there. The noise is computed a row at a time
+/// by a SIMD kernel that gives the same results as getNoise(i, j).
+/// \param n Granularity.
+/// \param i0 x offset of this subcell in cell.
+/// \param j0 y offset of this subcell in cell.
+/// \param scale Noise is to be rescaled by this factor.
+/// \param t Edge tables.
+/// \param cell Noise cell.
+
+void CInfiniteAmortizedNoise2D::addNoise(const int n, const int i0, const int j0, const float scale,
+  const CEdgeTables& t, float** cell)
+{  
+  NoiseRow row = {t.uax, t.vax, t.ubx, t.vbx, spline, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+  for(int i=0; i<n; i++){
+    initNoiseRow(i, t, row);
+    AddNoiseRow(row, n, scale, cell[i0 + i] + j0); //the only line that differs from getNoise
+  } //for
+} //addNoise
+
+/// Compute rows of gradients at the lattice corners of one octave until there
+/// are none left. Neighboring subcells share corners, so computing each
+/// gradient once here saves hashing it up to four times.
+/// \param job Octave to be generated.
+
+void CInfiniteAmortizedNoise2D::fillLattice(OctaveJob* job){
+  for(int i; (i = job->next++) < latticeSize; ){ //for each row of corners
+    const int k = i*latticeSize;
+    getGradientRow(job->x + i, job->y, latticeSize, &latticeX[k], &latticeY[k]);
+  } //for
+} //fillLattice
+
+/// Generate rows of subcells of one octave until there are none left. Each
+/// row of subcells covers its own rows of the cell, so threads never write to
+/// the same part of it.
+/// \param job Octave to be generated.
+/// \param t Edge tables for this thread.
+
+void CInfiniteAmortizedNoise2D::generateSubcells(OctaveJob* job, CEdgeTables* t){
+  const int n = job->n;
+
+  for(int i0; (i0 = job->next++) < job->r; ) //for each row of subcells
+    for(int j0=0; j0<job->r; j0++){ //for each subcell in that row
+      initEdgeTables(i0, j0, n, *t); //initialize the edge tables
+      if(job->bFirst)getNoise(n, i0*n, j0*n, *t, job->cell);
+      else addNoise(n, i0*n, j0*n, job->scale, *t, job->cell);
+    } //for
+} //generateSubcells
+
+/// Generate all of the subcells of one octave, sharing the rows of subcells
+/// out among the threads of the worker pool. The calling thread does its share too. The lattice of
+/// gradients at the corners of the subcells, including the corners along the
+/// far edges of the cell, is computed first.
+/// \param job Octave to be generated.
+
+void CInfiniteAmortizedNoise2D::generateOctave(OctaveJob& job){
+  latticeSize = job.r + 1;
+  latticeX.resize(latticeSize*latticeSize);
+  latticeY.resize(latticeSize*latticeSize);
+
+  const int nThreads = threads < job.r? threads: job.r; //no more threads than rows of subcells
+  job.pNoise = this;
+
+  //lattice gradients
+  job.bLattice = true;
+  job.next = 0;
+  pool.Run(&job, nThreads);
+
+  //subcells
+  job.bLattice = false;
+  job.next = 0;
+  pool.Run(&job, nThreads);
+} //generateOctave
+
+/// Generate a cell of 1/f amortized noise with persistence 0.5 and lacunarity 2.0.
+/// \param x x coordinate of top left corner of cell.
+/// \param y y coordinate of top left corner of cell.
+/// \param m0 First octave.
+/// \param m1 Last octave.
+/// \param n Granularity.
+/// \param cell Cell to put generated noise into.
+/// \return Multiply noise by this to get into the range -1..1
+
+float CInfiniteAmortizedNoise2D::generate(int x, int y, const int m0, const int m1, int n, float** cell){
+  int r = 1; //side length of cell divided by side length of subcell.
+
+  //Skip over unwanted octaves.
+  for(int i=1; i<m0; i++){
+    n /= 2; r += r;
+  } //for
+
+  if(n < 2)return 1.0f; //fail and bail - should not happen
+
+  //Generate first octave directly into cell.
+  //  We could add all octaves into the cell directly if we zero out the cell
+  //  before we begin. However, that is a nontrivial overhead that Perlin noise
+  //  does not have, and we can avoid it too by putting in the first octave and
+  // adding in the rest.
+
+  OctaveJob job; //subcells of the current octave
+  job.x = x; job.y = y; job.r = r; job.n = n;
+  job.scale = 1.0f; job.bFirst = true; job.cell = cell;
+
+  initSplineTable(n); //initialize the spline table to cells of size n
+  generateOctave(job); //generate noise directly into cell
+
+  float scale = 1.0f; //scale factor
+
+  //Generate the other octaves and add them into cell. See previous comment.
+  for(int k=m0; k<m1 && n>=2; k++){ //for each octave after the first
+    n /= 2; r += r;  x += x; y += y; scale *= 0.5f; //rescale for next octave
+    job.x = x; job.y = y; job.r = r; job.n = n;
+    job.scale = scale; job.bFirst = false;
+
+    initSplineTable(n); //initialize the spline table to cells of size n
+    generateOctave(job); //generate directly into cell
+  } //for each octave
+
+  //Compute 1/magnitude and return it. 
+  //  A single octave of Perlin noise returns a value of magnitude at most 
+  //  1/sqrt(2). Adding magnitudes over all scaled octaves gives a total
+  //  magnitude of (1 + 0.5 + 0.25 +...+ scale)/sqrt(2). This is equal to
+  //  (2 - scale)/sqrt(2) (using the standard formula for the sum of a geometric
+  //  progression). 1/magnitude is therefore sqrt(2)/(2-scale).
+
+  return (float)M_SQRT2/(2.0f - scale); //multiply by this to bring noise to [-1,1]
+} //generate
+
+/// Generate a cell of 1/f amortized noise with persistence 0.5 and lacunarity 2.0
+/// into a contiguous noise cell. The noise is the same as the other version of
+/// generate gives.
+/// \param x x coordinate of top left corner of cell.
+/// \param y y coordinate of top left corner of cell.
+/// \param m0 First octave.
+/// \param m1 Last octave.
+/// \param cell Cell to put generated noise into, whose size is the granularity.
+/// \return Multiply noise by this to get into the range -1..1
+
+float CInfiniteAmortizedNoise2D::generate(const int x, const int y, const int m0, const int m1, CNoiseCell& cell){
+  return generate(x, y, m0, m1, cell.GetSize(), cell.GetRows());
+} //generate
+
+/// \brief Round down a quotient.
+///
+/// Divide, rounding towards minus infinity instead of towards zero.
+/// \param a Dividend.
+/// \param b Divisor, greater than 0.
+/// \return The largest integer that is at most a/b.
+
+static long long FloorDiv(const long long a, const long long b){
+  return a >= 0? a/b: -((b - 1 - a)/b);
+} //FloorDiv
+
+/// \brief Point order for queries.
+///
+/// Orders the points of a query by the subcell that they are in, so that
+/// the edge tables of each subcell are filled only once.
+
+struct SubcellOrder{
+  const long long* row; ///< Lattice row of the subcell that each point is in.
+  const long long* col; ///< Lattice column of the subcell that each point is in.
+
+  /// Compare two points.
+  /// \param a Index of one point.
+  /// \param b Index of the other point.
+  /// \return true if point a comes before point b.
+
+  bool operator()(const int a, const int b) const{
+    return row[a] < row[b] || (row[a] == row[b] && col[a] < col[b]);
+  } //operator()
+}; //SubcellOrder
+
+/// Get 1/f amortized noise at a set of points without generating a cell.
+/// Point (i, j) is in row i and column j of the cell at (x, y) that generate
+/// would make with the same octaves, and can be outside of it, in which case
+/// it is in one of the neighboring cells. The noise is exactly the same as
+/// generate gives for that point. Octaves past m2 are left out for a
+/// coarser level of detail, so the
+/// noise is the same as generate gives with last octave m2, but it is scaled
+/// for last octave m1 so that it can be compared with the full detail.
+/// Each subcell of each octave that has points in it is computed only once,
+/// and the gradients at its corners are kept in a cache for later queries,
+/// so points should be asked for a batch at a time. Only the calling thread
+/// is used, and generate must not be called at the same time.
+/// \param x x coordinate of top left corner of cell.
+/// \param y y coordinate of top left corner of cell.
+/// \param m0 First octave.
+/// \param m1 Last octave, for scaling.
+/// \param m2 Last octave to compute, from m0 to m1.
+/// \param count Number of points.
+/// \param i Row of each point.
+/// \param j Column of each point.
+/// \param value [out] Noise at each point.
+/// \return Multiply noise by this to get into the range -1..1
+
+float CInfiniteAmortizedNoise2D::getPoints(const int x, const int y, const int m0, const int m1, const int m2,
+  const int count, const int* i, const int* j, float* value)
+{
+  int n = size; //granularity
+
+  //Skip over unwanted octaves.
+  for(int k=1; k<m0; k++)
+    n /= 2;
+
+  if(n < 2 || count <= 0){ //fail and bail - should not happen
+    for(int p=0; p<count; p++)
+      value[p] = 0.0f;
+    return 1.0f;
+  } //if
+
+  //Points have the same coordinates, counting in finest points of the
+  //  first octave from the origin, in every octave.
+
+  std::vector<long long> row(count), col(count); //coordinates of points
+  std::vector<long long> subrow(count), subcol(count); //lattice coordinates of subcells
+  std::vector<int> order(count); //points sorted by subcell
+
+  for(int p=0; p<count; p++){
+    row[p] = (long long)x*n + i[p];
+    col[p] = (long long)y*n + j[p];
+  } //for
+
+  float scale = 1.0f; //scale factor
+  SubcellOrder cmp = {&subrow[0], &subcol[0]};
+
+  for(int k=m0; k<=m2; k++){ //for each octave
+    if(k > m0){ //rescale for next octave
+      if(n < 2)break;
+      n /= 2; scale *= 0.5f;
+    } //if
+
+    initSplineTable(n); //initialize the spline table to cells of size n
+
+    for(int p=0; p<count; p++){
+      subrow[p] = FloorDiv(row[p], n);
+      subcol[p] = FloorDiv(col[p], n);
+      order[p] = p;
+    } //for
+
+    std::sort(order.begin(), order.end(), cmp);
+
+    for(int q=0; q<count; ){ //for each subcell with points in it
+      const int sx = (int)subrow[order[q]]; //lattice coordinates of subcell
+      const int sy = (int)subcol[order[q]];
+
+      float gx[4], gy[4]; //gradients at corners
+      getCachedGradient(sx, sy, gx[0], gy[0]);
+      getCachedGradient(sx, sy + 1, gx[1], gy[1]);
+      getCachedGradient(sx + 1, sy, gx[2], gy[2]);
+      getCachedGradient(sx + 1, sy + 1, gx[3], gy[3]);
+      fillEdgeTables(gx, gy, n, tables);
+
+      for(; q<count && subrow[order[q]] == sx && subcol[order[q]] == sy; q++){ //for each point in it
+        const int p = order[q];
+        const int a = (int)(row[p] - (long long)sx*n); //row in subcell
+        const int b = (int)(col[p] - (long long)sy*n); //column in subcell
+
+        NoiseRow r = {tables.uax + b, tables.vax + b, tables.ubx + b, tables.vbx + b, spline + b,
+          0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+        initNoiseRow(a, tables, r);
+        if(k == m0)GetNoiseRow(r, 1, value + p); //same kernels as generate
+        else AddNoiseRow(r, 1, scale, value + p);
+      } //for
+    } //for
+  } //for each octave
+
+  //Scale for the last octave that generate would have computed.
+  for(int k=m2; k<m1 && n>=2; k++){
+    n /= 2; scale *= 0.5f;
+  } //for
+
+  return (float)M_SQRT2/(2.0f - scale); //multiply by this to bring noise to [-1,1]
+} //getPoints
+
+/// Get 1/f amortized noise at a grid of evenly spaced points without
+/// generating a cell, for instance for a coarse level of detail. The noise
+/// is the same as getPoints gives for each of them.
+/// \param x x coordinate of top left corner of cell.
+/// \param y y coordinate of top left corner of cell.
+/// \param m0 First octave.
+/// \param m1 Last octave, for scaling.
+/// \param m2 Last octave to compute, from m0 to m1.
+/// \param i0 Row of top left point.
+/// \param j0 Column of top left point.
+/// \param rows Number of rows of points.
+/// \param cols Number of columns of points.
+/// \param stride Distance between adjacent points.
+/// \param value [out] Noise at each point, rows*cols of them in row-major order.
+/// \return Multiply noise by this to get into the range -1..1
+
+float CInfiniteAmortizedNoise2D::getGrid(const int x, const int y, const int m0, const int m1, const int m2,
+  const int i0, const int j0, const int rows, const int cols, const int stride, float* value)
+{
+  const int count = rows*cols; //number of points
+  std::vector<int> i(count), j(count); //coordinates of points
+
+  for(int r=0; r<rows; r++)
+    for(int c=0; c<cols; c++){
+      i[r*cols + c] = i0 + r*stride;
+      j[r*cols + c] = j0 + c*stride;
+    } //for
+
+  if(count <= 0)return 1.0f;
+  return getPoints(x, y, m0, m1, m2, count, &i[0], &j[0], value);
+} //getGrid
@@ -0,0 +1,66 @@
+/// \file NoiseCell.h
+/// \brief Header for the noise cell CNoiseCell and its pool CNoiseCellPool.
+///
+/// A noise cell used to be allocated as an array of separately allocated
+/// rows, which is thousands of heap allocations per cell and scatters the rows
+/// around memory. CNoiseCell keeps the whole cell in one 64-byte aligned
+/// block with each row starting on a 64-byte boundary, and CNoiseCellPool
+/// recycles cells so that generating one tile after another does no heap
+/// allocation after the first.
+
+// Copyright Ian Parberry, May 2014.
+//
+// This file is made available under the GNU All-Permissive License.
+//
+// Copying and distribution of this file, with or without modification,
+// are permitted in any medium without royalty provided the copyright
+// notice and this notice are preserved.  This file is offered as-is,
+// without any warranty.
+
+#pragma once
+
+#include <vector>
+
+const int NOISECELL_ALIGN = 64; ///< Alignment of the cell and each of its rows in bytes.
+
+/// \brief Noise cell.
+///
+/// A square array of floats stored a row at a time in a single aligned block,
+/// with GetStride() floats from the start of one row to the start of the next.
+/// There is also a table of pointers to the rows so that it can be indexed
+/// as cell[i][j] by code that takes a float**.
+
+class CNoiseCell{
+  private:
+    char* m_pBlock; ///< Memory block, including slack for alignment.
+    float* m_pData; ///< Start of the first row, aligned.
+    float** m_pRow; ///< Pointers to the start of each row.
+    int m_nSize; ///< Width and height.
+    int m_nStride; ///< Number of floats from one row to the next.
+
+  public:
+    CNoiseCell(const int n); ///< Constructor.
+    ~CNoiseCell(); ///< Destructor.
+
+    float* GetData(); ///< Get the start of the first row.
+    float* GetRow(const int i); ///< Get the start of a row.
+    float** GetRows(); ///< Get the table of row pointers.
+    int GetSize(); ///< Get the width and height.
+    int GetStride(); ///< Get the number of floats from one row to the next.
+}; //CNoiseCell
+
+/// \brief Noise cell pool.
+///
+/// Hands out noise cells, reusing ones that have been given back.
+
+class CNoiseCellPool{
+  private:
+    std::vector<CNoiseCell*> m_vFree; ///< Cells that have been released.
+
+  public:
+    ~CNoiseCellPool(); ///< Destructor.
+
+    CNoiseCell* Acquire(const int n); ///< Get a cell.
+    void Release(CNoiseCell* cell); ///< Give back a cell.
+    void Clear(); ///< Delete the released cells.
+}; //CNoiseCellPool
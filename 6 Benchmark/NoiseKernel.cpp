@@ -0,0 +1,761 @@
+/// \file NoiseKernel.cpp
+/// \brief Code for the amortized noise row kernels.
+///
+/// Each kernel computes, for each column j of a row,
+///
+///   a = lerp(spline[j], uax[j] + uay, vax[j] + vay)
+///   b = lerp(spline[j], ubx[j] + uby, vbx[j] + vby)
+///   noise = lerp(si, a, b)
+///
+/// exactly as CInfiniteAmortizedNoise2D::getNoise(i, j) does, with lerp(t, a, b)
+/// being a + t*(b - a). The SIMD kernels use separate multiplies and adds, never
+/// fused multiply-adds, so that every point is rounded the same way as in the
+/// scalar kernel. Columns left over at the end of a row are done by the scalar kernel.
+
+// Copyright Ian Parberry, May 2014.
+//
+// This file is made available under the GNU All-Permissive License.
+//
+// Copying and distribution of this file, with or without modification,
+// are permitted in any medium without royalty provided the copyright
+// notice and this notice are preserved.  This file is offered as-is,
+// without any warranty.
+
+#include <stdio.h>
+#include <string.h>
+
+#include <mutex> //for std::call_once
+
+#include "NoiseKernel.h"
+#include "Common.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+  #define NOISEKERNEL_X86 ///< Compile the SSE2 and AVX kernels.
+  #include <immintrin.h>
+  #if defined(_MSC_VER)
+    #include <intrin.h> //for __cpuid
+    #define TARGET_SSE2 ///< Nothing needed to use SSE2 instructions.
+    #define TARGET_AVX ///< Nothing needed to use AVX instructions.
+    #define TARGET_AVX2 ///< Nothing needed to use AVX2 instructions.
+  #else
+    #define TARGET_SSE2 __attribute__((target("sse2"))) ///< Allow SSE2 in one function.
+    #define TARGET_AVX __attribute__((target("avx"))) ///< Allow AVX in one function.
+    #define TARGET_AVX2 __attribute__((target("avx2"))) ///< Allow AVX2 in one function.
+  #endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+  #define NOISEKERNEL_ARM ///< Compile the NEON kernel.
+  #include <arm_neon.h>
+#endif
+
+#define X86_SSE2_BIT (1 << 26) ///< SSE2 bit of cpuid(1).edx.
+#define X86_AVX_BIT (1 << 28) ///< AVX bit of cpuid(1).ecx.
+#define X86_OSXSAVE_BIT (1 << 27) ///< OSXSAVE bit of cpuid(1).ecx.
+#define X86_AVX2_BIT (1 << 5) ///< AVX2 bit of cpuid(7).ebx.
+
+#define MURMUR_C1 0xcc9e2d51 ///< MurmurHash3_x86_32 block multiplier 1.
+#define MURMUR_C2 0x1b873593 ///< MurmurHash3_x86_32 block multiplier 2.
+#define MURMUR_N 0xe6546b64 ///< MurmurHash3_x86_32 block addend.
+#define MURMUR_F1 0x85ebca6b ///< MurmurHash3_x86_32 finalization multiplier 1.
+#define MURMUR_F2 0xc2b2ae35 ///< MurmurHash3_x86_32 finalization multiplier 2.
+
+///////////////////////////////////////////////////////////////////////////////
+// Scalar kernel
+
+/// Compute a row of noise a point at a time. This is the reference that the
+/// SIMD kernels must agree with.
+/// \param row Noise row.
+/// \param j0 First column.
+/// \param n Number of columns.
+/// \param scale Noise is rescaled by this factor if it is added.
+/// \param dest Row of cell, indexed by column.
+
+template<bool ADD> static void NoiseRowScalar(const NoiseRow& row, const int j0, const int n,
+  const float scale, float* dest)
+{
+  for(int j=j0; j<n; j++){
+    float u = row.uax[j] + row.uay;
+    float v = row.vax[j] + row.vay;
+    const float a = lerp(row.spline[j], u, v);
+    u = row.ubx[j] + row.uby;
+    v = row.vbx[j] + row.vby;
+    const float b = lerp(row.spline[j], u, v);
+    const float noise = lerp(row.si, a, b);
+    if(ADD)dest[j] += scale * noise;
+    else dest[j] = noise;
+  } //for
+} //NoiseRowScalar
+
+///////////////////////////////////////////////////////////////////////////////
+// x86 kernels
+
+#if defined(NOISEKERNEL_X86)
+
+/// Compute a row of noise 4 points at a time using SSE2.
+/// \param row Noise row.
+/// \param n Number of columns.
+/// \param scale Noise is rescaled by this factor if it is added.
+/// \param dest Row of cell, indexed by column.
+
+template<bool ADD> TARGET_SSE2 static void NoiseRowSSE2(const NoiseRow& row, const int n,
+  const float scale, float* dest)
+{
+  const __m128 uay = _mm_set1_ps(row.uay), vay = _mm_set1_ps(row.vay);
+  const __m128 uby = _mm_set1_ps(row.uby), vby = _mm_set1_ps(row.vby);
+  const __m128 si = _mm_set1_ps(row.si), s = _mm_set1_ps(scale);
+
+  int j = 0;
+  for(; j+4<=n; j+=4){
+    const __m128 t = _mm_loadu_ps(row.spline + j);
+    __m128 u = _mm_add_ps(_mm_loadu_ps(row.uax + j), uay);
+    __m128 v = _mm_add_ps(_mm_loadu_ps(row.vax + j), vay);
+    const __m128 a = _mm_add_ps(u, _mm_mul_ps(t, _mm_sub_ps(v, u)));
+    u = _mm_add_ps(_mm_loadu_ps(row.ubx + j), uby);
+    v = _mm_add_ps(_mm_loadu_ps(row.vbx + j), vby);
+    const __m128 b = _mm_add_ps(u, _mm_mul_ps(t, _mm_sub_ps(v, u)));
+    const __m128 noise = _mm_add_ps(a, _mm_mul_ps(si, _mm_sub_ps(b, a)));
+    if(ADD)_mm_storeu_ps(dest + j, _mm_add_ps(_mm_loadu_ps(dest + j), _mm_mul_ps(s, noise)));
+    else _mm_storeu_ps(dest + j, noise);
+  } //for
+
+  NoiseRowScalar<ADD>(row, j, n, scale, dest);
+} //NoiseRowSSE2
+
+/// Compute a row of noise 8 points at a time using AVX. Only AVX instructions
+/// are needed for this, not AVX2 or FMA, and the latter would change the rounding.
+/// \param row Noise row.
+/// \param n Number of columns.
+/// \param scale Noise is rescaled by this factor if it is added.
+/// \param dest Row of cell, indexed by column.
+
+template<bool ADD> TARGET_AVX static void NoiseRowAVX(const NoiseRow& row, const int n,
+  const float scale, float* dest)
+{
+  const __m256 uay = _mm256_set1_ps(row.uay), vay = _mm256_set1_ps(row.vay);
+  const __m256 uby = _mm256_set1_ps(row.uby), vby = _mm256_set1_ps(row.vby);
+  const __m256 si = _mm256_set1_ps(row.si), s = _mm256_set1_ps(scale);
+
+  int j = 0;
+  for(; j+8<=n; j+=8){
+    const __m256 t = _mm256_loadu_ps(row.spline + j);
+    __m256 u = _mm256_add_ps(_mm256_loadu_ps(row.uax + j), uay);
+    __m256 v = _mm256_add_ps(_mm256_loadu_ps(row.vax + j), vay);
+    const __m256 a = _mm256_add_ps(u, _mm256_mul_ps(t, _mm256_sub_ps(v, u)));
+    u = _mm256_add_ps(_mm256_loadu_ps(row.ubx + j), uby);
+    v = _mm256_add_ps(_mm256_loadu_ps(row.vbx + j), vby);
+    const __m256 b = _mm256_add_ps(u, _mm256_mul_ps(t, _mm256_sub_ps(v, u)));
+    const __m256 noise = _mm256_add_ps(a, _mm256_mul_ps(si, _mm256_sub_ps(b, a)));
+    if(ADD)_mm256_storeu_ps(dest + j, _mm256_add_ps(_mm256_loadu_ps(dest + j), _mm256_mul_ps(s, noise)));
+    else _mm256_storeu_ps(dest + j, noise);
+  } //for
+
+  _mm256_zeroupper(); //avoid the penalty for mixing AVX and SSE code
+
+  NoiseRowScalar<ADD>(row, j, n, scale, dest);
+} //NoiseRowAVX
+
+#endif //NOISEKERNEL_X86
+
+///////////////////////////////////////////////////////////////////////////////
+// ARM kernel
+
+#if defined(NOISEKERNEL_ARM)
+
+/// Compute a row of noise 4 points at a time using NEON. The multiply and
+/// add intrinsics are used separately instead of vmlaq_f32, which may be fused.
+/// \param row Noise row.
+/// \param n Number of columns.
+/// \param scale Noise is rescaled by this factor if it is added.
+/// \param dest Row of cell, indexed by column.
+
+template<bool ADD> static void NoiseRowNEON(const NoiseRow& row, const int n,
+  const float scale, float* dest)
+{
+  const float32x4_t uay = vdupq_n_f32(row.uay), vay = vdupq_n_f32(row.vay);
+  const float32x4_t uby = vdupq_n_f32(row.uby), vby = vdupq_n_f32(row.vby);
+  const float32x4_t si = vdupq_n_f32(row.si), s = vdupq_n_f32(scale);
+
+  int j = 0;
+  for(; j+4<=n; j+=4){
+    const float32x4_t t = vld1q_f32(row.spline + j);
+    float32x4_t u = vaddq_f32(vld1q_f32(row.uax + j), uay);
+    float32x4_t v = vaddq_f32(vld1q_f32(row.vax + j), vay);
+    const float32x4_t a = vaddq_f32(u, vmulq_f32(t, vsubq_f32(v, u)));
+    u = vaddq_f32(vld1q_f32(row.ubx + j), uby);
+    v = vaddq_f32(vld1q_f32(row.vbx + j), vby);
+    const float32x4_t b = vaddq_f32(u, vmulq_f32(t, vsubq_f32(v, u)));
+    const float32x4_t noise = vaddq_f32(a, vmulq_f32(si, vsubq_f32(b, a)));
+    if(ADD)vst1q_f32(dest + j, vaddq_f32(vld1q_f32(dest + j), vmulq_f32(s, noise)));
+    else vst1q_f32(dest + j, noise);
+  } //for
+
+  NoiseRowScalar<ADD>(row, j, n, scale, dest);
+} //NoiseRowNEON
+
+#endif //NOISEKERNEL_ARM
+
+///////////////////////////////////////////////////////////////////////////////
+// Lattice hash kernels
+//
+// These compute MurmurHash3_x86_32 of the 8-byte key ((unsigned long long)x<<32)|y
+// on a little-endian processor, which is two 4-byte blocks, y and then x, and
+// no tail. The SIMD kernels hash several keys at once, one per lane.
+
+/// Hash a batch of lattice points one at a time.
+/// \param x X coordinates.
+/// \param y Y coordinates.
+/// \param j0 First point.
+/// \param n Number of points.
+/// \param seed Hash seed.
+/// \param out Hashes.
+
+static void LatticeHashScalar(const unsigned int* x, const unsigned int* y, const int j0, const int n,
+  const unsigned int seed, unsigned int* out)
+{
+  for(int j=j0; j<n; j++)
+    out[j] = LatticeHash(x[j], y[j], seed);
+} //LatticeHashScalar
+
+/// Hash a batch of lattice points one at a time, starting at the first.
+/// \param x X coordinates.
+/// \param y Y coordinates.
+/// \param n Number of points.
+/// \param seed Hash seed.
+/// \param out Hashes.
+
+static void LatticeHashScalar(const unsigned int* x, const unsigned int* y, const int n,
+  const unsigned int seed, unsigned int* out)
+{
+  LatticeHashScalar(x, y, 0, n, seed, out);
+} //LatticeHashScalar
+
+#if defined(NOISEKERNEL_X86)
+
+/// Multiply 4 unsigned ints by a constant, keeping the low 32 bits of each
+/// product. SSE2 has no instruction for this, only one that multiplies the even lanes
+/// into 64-bit products.
+/// \param a Multiplicands.
+/// \param b Multiplier in every lane.
+/// \return Products.
+
+TARGET_SSE2 static inline __m128i MulLo32SSE2(const __m128i a, const __m128i b){
+  const __m128i even = _mm_mul_epu32(a, b); //lanes 0 and 2
+  const __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32)); //lanes 1 and 3
+  return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+} //MulLo32SSE2
+
+#define ROTL32SSE2(v, r) _mm_or_si128(_mm_slli_epi32(v, r), _mm_srli_epi32(v, 32 - (r))) ///< Rotate 4 lanes left.
+
+/// Hash a batch of lattice points 4 at a time using SSE2.
+/// \param x X coordinates.
+/// \param y Y coordinates.
+/// \param n Number of points.
+/// \param seed Hash seed.
+/// \param out Hashes.
+
+TARGET_SSE2 static void LatticeHashSSE2(const unsigned int* x, const unsigned int* y, const int n,
+  const unsigned int seed, unsigned int* out)
+{
+  const __m128i c1 = _mm_set1_epi32((int)MURMUR_C1), c2 = _mm_set1_epi32((int)MURMUR_C2);
+  const __m128i f1 = _mm_set1_epi32((int)MURMUR_F1), f2 = _mm_set1_epi32((int)MURMUR_F2);
+  const __m128i add = _mm_set1_epi32((int)MURMUR_N), len = _mm_set1_epi32(8);
+  const __m128i h0 = _mm_set1_epi32((int)seed);
+
+  int j = 0;
+  for(; j+4<=n; j+=4){
+    __m128i h = h0;
+
+    for(int b=0; b<2; b++){ //y block then x block
+      __m128i k = _mm_loadu_si128((const __m128i*)((b? x: y) + j));
+      k = MulLo32SSE2(k, c1);
+      k = ROTL32SSE2(k, 15);
+      k = MulLo32SSE2(k, c2);
+      h = _mm_xor_si128(h, k);
+      h = ROTL32SSE2(h, 13);
+      h = _mm_add_epi32(_mm_add_epi32(_mm_slli_epi32(h, 2), h), add); //h*5 + n
+    } //for
+
+    h = _mm_xor_si128(h, len);
+    h = _mm_xor_si128(h, _mm_srli_epi32(h, 16));
+    h = MulLo32SSE2(h, f1);
+    h = _mm_xor_si128(h, _mm_srli_epi32(h, 13));
+    h = MulLo32SSE2(h, f2);
+    h = _mm_xor_si128(h, _mm_srli_epi32(h, 16));
+    _mm_storeu_si128((__m128i*)(out + j), h);
+  } //for
+
+  LatticeHashScalar(x, y, j, n, seed, out);
+} //LatticeHashSSE2
+
+#define ROTL32AVX2(v, r) _mm256_or_si256(_mm256_slli_epi32(v, r), _mm256_srli_epi32(v, 32 - (r))) ///< Rotate 8 lanes left.
+
+/// Hash a batch of lattice points 8 at a time using AVX2.
+/// \param x X coordinates.
+/// \param y Y coordinates.
+/// \param n Number of points.
+/// \param seed Hash seed.
+/// \param out Hashes.
+
+TARGET_AVX2 static void LatticeHashAVX2(const unsigned int* x, const unsigned int* y, const int n,
+  const unsigned int seed, unsigned int* out)
+{
+  const __m256i c1 = _mm256_set1_epi32((int)MURMUR_C1), c2 = _mm256_set1_epi32((int)MURMUR_C2);
+  const __m256i f1 = _mm256_set1_epi32((int)MURMUR_F1), f2 = _mm256_set1_epi32((int)MURMUR_F2);
+  const __m256i add = _mm256_set1_epi32((int)MURMUR_N), len = _mm256_set1_epi32(8);
+  const __m256i h0 = _mm256_set1_epi32((int)seed);
+
+  int j = 0;
+  for(; j+8<=n; j+=8){
+    __m256i h = h0;
+
+    for(int b=0; b<2; b++){ //y block then x block
+      __m256i k = _mm256_loadu_si256((const __m256i*)((b? x: y) + j));
+      k = _mm256_mullo_epi32(k, c1);
+      k = ROTL32AVX2(k, 15);
+      k = _mm256_mullo_epi32(k, c2);
+      h = _mm256_xor_si256(h, k);
+      h = ROTL32AVX2(h, 13);
+      h = _mm256_add_epi32(_mm256_add_epi32(_mm256_slli_epi32(h, 2), h), add); //h*5 + n
+    } //for
+
+    h = _mm256_xor_si256(h, len);
+    h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 16));
+    h = _mm256_mullo_epi32(h, f1);
+    h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 13));
+    h = _mm256_mullo_epi32(h, f2);
+    h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 16));
+    _mm256_storeu_si256((__m256i*)(out + j), h);
+  } //for
+
+  _mm256_zeroupper(); //avoid the penalty for mixing AVX and SSE code
+
+  LatticeHashScalar(x, y, j, n, seed, out);
+} //LatticeHashAVX2
+
+#endif //NOISEKERNEL_X86
+
+#if defined(NOISEKERNEL_ARM)
+
+#define ROTL32NEON(v, r) vorrq_u32(vshlq_n_u32(v, r), vshrq_n_u32(v, 32 - (r))) ///< Rotate 4 lanes left.
+
+/// Hash a batch of lattice points 4 at a time using NEON.
+/// \param x X coordinates.
+/// \param y Y coordinates.
+/// \param n Number of points.
+/// \param seed Hash seed.
+/// \param out Hashes.
+
+static void LatticeHashNEON(const unsigned int* x, const unsigned int* y, const int n,
+  const unsigned int seed, unsigned int* out)
+{
+  const uint32x4_t c1 = vdupq_n_u32(MURMUR_C1), c2 = vdupq_n_u32(MURMUR_C2);
+  const uint32x4_t f1 = vdupq_n_u32(MURMUR_F1), f2 = vdupq_n_u32(MURMUR_F2);
+  const uint32x4_t add = vdupq_n_u32(MURMUR_N), len = vdupq_n_u32(8), five = vdupq_n_u32(5);
+  const uint32x4_t h0 = vdupq_n_u32(seed);
+
+  int j = 0;
+  for(; j+4<=n; j+=4){
+    uint32x4_t h = h0;
+
+    for(int b=0; b<2; b++){ //y block then x block
+      uint32x4_t k = vld1q_u32((b? x: y) + j);
+      k = vmulq_u32(k, c1);
+      k = ROTL32NEON(k, 15);
+      k = vmulq_u32(k, c2);
+      h = veorq_u32(h, k);
+      h = ROTL32NEON(h, 13);
+      h = vaddq_u32(vmulq_u32(h, five), add);
+    } //for
+
+    h = veorq_u32(h, len);
+    h = veorq_u32(h, vshrq_n_u32(h, 16));
+    h = vmulq_u32(h, f1);
+    h = veorq_u32(h, vshrq_n_u32(h, 13));
+    h = vmulq_u32(h, f2);
+    h = veorq_u32(h, vshrq_n_u32(h, 16));
+    vst1q_u32(out + j, h);
+  } //for
+
+  LatticeHashScalar(x, y, j, n, seed, out);
+} //LatticeHashNEON
+
+#endif //NOISEKERNEL_ARM
+
+///////////////////////////////////////////////////////////////////////////////
+// Dispatch
+
+/// Scalar kernel for getting noise.
+
+static void GetNoiseRowScalar(const NoiseRow& row, const int n, const float scale, float* dest){
+  NoiseRowScalar<false>(row, 0, n, scale, dest);
+} //GetNoiseRowScalar
+
+/// Scalar kernel for adding noise.
+
+static void AddNoiseRowScalar(const NoiseRow& row, const int n, const float scale, float* dest){
+  NoiseRowScalar<true>(row, 0, n, scale, dest);
+} //AddNoiseRowScalar
+
+typedef void (*NoiseRowFunction)(const NoiseRow&, const int, const float, float*); ///< Pointer to a kernel.
+typedef void (*LatticeHashFunction)(const unsigned int*, const unsigned int*, const int,
+  const unsigned int, unsigned int*); ///< Pointer to a lattice hash kernel.
+
+static NoiseKernel g_eNoiseKernel = NOISEKERNEL_SCALAR; ///< Current kernel.
+static NoiseRowFunction g_pGetNoiseRow = GetNoiseRowScalar; ///< Current kernel for getting noise.
+static NoiseRowFunction g_pAddNoiseRow = AddNoiseRowScalar; ///< Current kernel for adding noise.
+static LatticeHashFunction g_pLatticeHash = LatticeHashScalar; ///< Current kernel for hashing lattice points.
+static bool g_bNoiseKernelSelected = false; ///< Whether a kernel has been selected.
+static std::once_flag g_cNoiseKernelOnce; ///< Flag for choosing the default kernel once.
+
+#if defined(NOISEKERNEL_X86)
+
+/// Get processor information.
+/// \param leaf Which information.
+/// \param info Registers eax, ebx, ecx, and edx.
+
+static void Cpuid(const int leaf, int info[4]){
+  #if defined(_MSC_VER)
+    __cpuidex(info, leaf, 0);
+  #else
+    __asm__ __volatile__("cpuid": "=a"(info[0]), "=b"(info[1]), "=c"(info[2]), "=d"(info[3]): "a"(leaf), "c"(0));
+  #endif
+} //Cpuid
+
+/// Determine whether the processor and operating system support AVX.
+/// \return true if AVX can be used.
+
+static bool X86HasAVX(){
+  int info[4]; //eax, ebx, ecx, edx
+  Cpuid(1, info);
+  if((info[2] & X86_AVX_BIT) == 0 || (info[2] & X86_OSXSAVE_BIT) == 0)
+    return false;
+
+  //check that the operating system saves the AVX registers
+  #if defined(_MSC_VER)
+    const unsigned long long xcr0 = _xgetbv(0);
+  #else
+    unsigned int lo, hi;
+    __asm__ __volatile__("xgetbv": "=a"(lo), "=d"(hi): "c"(0));
+    const unsigned long long xcr0 = ((unsigned long long)hi << 32) | lo;
+  #endif
+  return (xcr0 & 6) == 6;
+} //X86HasAVX
+
+/// Determine whether the processor and operating system support AVX2.
+/// \return true if AVX2 can be used.
+
+static bool X86HasAVX2(){
+  if(!X86HasAVX())return false;
+  int info[4]; //eax, ebx, ecx, edx
+  Cpuid(0, info);
+  if(info[0] < 7)return false;
+  Cpuid(7, info);
+  return (info[1] & X86_AVX2_BIT) != 0;
+} //X86HasAVX2
+
+#endif //NOISEKERNEL_X86
+
+/// Determine whether the processor and operating system support a kernel.
+/// \param kernel Noise kernel.
+/// \return true if it can be used.
+
+static bool NoiseKernelSupported(const NoiseKernel kernel){
+  switch(kernel){
+    case NOISEKERNEL_SCALAR:
+      return true;
+
+#if defined(NOISEKERNEL_X86)
+    case NOISEKERNEL_SSE2: {
+      int info[4]; //eax, ebx, ecx, edx
+      Cpuid(1, info);
+      return (info[3] & X86_SSE2_BIT) != 0;
+    } //case
+
+    case NOISEKERNEL_AVX:
+      return X86HasAVX();
+#endif //NOISEKERNEL_X86
+
+#if defined(NOISEKERNEL_ARM)
+    case NOISEKERNEL_NEON:
+      return true;
+#endif //NOISEKERNEL_ARM
+
+    default:
+      return false;
+  } //switch
+} //NoiseKernelSupported
+
+/// Get the functions that make up a kernel.
+/// \param kernel Noise kernel other than NOISEKERNEL_BEST.
+/// \param get [out] Kernel for getting noise.
+/// \param add [out] Kernel for adding noise.
+/// \param hash [out] Kernel for hashing lattice points.
+/// \return true if it succeeds, false if this processor doesn't support that kernel.
+
+static bool GetNoiseKernelFunctions(const NoiseKernel kernel,
+  NoiseRowFunction& get, NoiseRowFunction& add, LatticeHashFunction& hash)
+{
+  if(!NoiseKernelSupported(kernel))return false;
+
+  switch(kernel){
+#if defined(NOISEKERNEL_X86)
+    case NOISEKERNEL_SSE2:
+      get = NoiseRowSSE2<false>;
+      add = NoiseRowSSE2<true>;
+      hash = LatticeHashSSE2;
+      break;
+
+    case NOISEKERNEL_AVX:
+      get = NoiseRowAVX<false>;
+      add = NoiseRowAVX<true>;
+      hash = X86HasAVX2()? LatticeHashAVX2: LatticeHashSSE2; //integer AVX needs AVX2
+      break;
+#endif //NOISEKERNEL_X86
+
+#if defined(NOISEKERNEL_ARM)
+    case NOISEKERNEL_NEON:
+      get = NoiseRowNEON<false>;
+      add = NoiseRowNEON<true>;
+      hash = LatticeHashNEON;
+      break;
+#endif //NOISEKERNEL_ARM
+
+    default:
+      get = GetNoiseRowScalar;
+      add = AddNoiseRowScalar;
+      hash = LatticeHashScalar;
+      break;
+  } //switch
+
+  return true;
+} //GetNoiseKernelFunctions
+
+/// Choose the kernel used by GetNoiseRow and AddNoiseRow.
+/// \param kernel Noise kernel, or NOISEKERNEL_BEST for the fastest one supported.
+/// \return true if it succeeds, false if this processor doesn't support that kernel.
+
+bool SelectNoiseKernel(const NoiseKernel kernel){
+  if(kernel == NOISEKERNEL_BEST){
+    if(SelectNoiseKernel(NOISEKERNEL_AVX))return true;
+    if(SelectNoiseKernel(NOISEKERNEL_SSE2))return true;
+    if(SelectNoiseKernel(NOISEKERNEL_NEON))return true;
+    return SelectNoiseKernel(NOISEKERNEL_SCALAR);
+  } //if
+
+  if(!GetNoiseKernelFunctions(kernel, g_pGetNoiseRow, g_pAddNoiseRow, g_pLatticeHash))
+    return false;
+
+  g_eNoiseKernel = kernel;
+  g_bNoiseKernelSelected = true;
+  return true;
+} //SelectNoiseKernel
+
+/// Choose the fastest kernel unless one has already been selected.
+
+static void SelectDefaultNoiseKernel(){
+  if(!g_bNoiseKernelSelected)SelectNoiseKernel(NOISEKERNEL_BEST);
+} //SelectDefaultNoiseKernel
+
+/// Make sure that a kernel has been chosen. The first call may be made by
+/// several worker threads at once, so the default is chosen under
+/// std::call_once. SelectNoiseKernel itself must only be called
+/// while no other thread is using the kernels.
+
+static void InitNoiseKernel(){
+  std::call_once(g_cNoiseKernelOnce, SelectDefaultNoiseKernel);
+} //InitNoiseKernel
+
+/// Get a kernel from its name on the command line, which is one of
+/// scalar, sse2, avx, neon, and best.
+/// \param name Name of kernel.
+/// \param kernel The kernel with that name.
+/// \return true if the name is recognized.
+
+bool ParseNoiseKernel(const char* name, NoiseKernel& kernel){
+  if(!strcmp(name, "scalar"))kernel = NOISEKERNEL_SCALAR;
+  else if(!strcmp(name, "sse2"))kernel = NOISEKERNEL_SSE2;
+  else if(!strcmp(name, "avx"))kernel = NOISEKERNEL_AVX;
+  else if(!strcmp(name, "neon"))kernel = NOISEKERNEL_NEON;
+  else if(!strcmp(name, "best"))kernel = NOISEKERNEL_BEST;
+  else return false;
+  return true;
+} //ParseNoiseKernel
+
+/// Get the name of a kernel.
+/// \param kernel Noise kernel.
+/// \return Name of kernel.
+
+static const char* NoiseKernelName(const NoiseKernel kernel){
+  switch(kernel){
+    case NOISEKERNEL_SSE2: return "SSE2";
+    case NOISEKERNEL_AVX: return "AVX";
+    case NOISEKERNEL_NEON: return "NEON";
+    default: return "scalar";
+  } //switch
+} //NoiseKernelName
+
+/// Get the name of the kernel used by GetNoiseRow and AddNoiseRow.
+/// \return Name of kernel.
+
+const char* GetNoiseKernelName(){
+  InitNoiseKernel();
+  return NoiseKernelName(g_eNoiseKernel);
+} //GetNoiseKernelName
+
+/// Put a row of noise into a cell, using the fastest kernel that the processor
+/// supports unless a different one has been selected.
+/// \param row Noise row.
+/// \param n Number of columns.
+/// \param dest Row of cell, indexed by column.
+
+void GetNoiseRow(const NoiseRow& row, const int n, float* dest){
+  InitNoiseKernel();
+  g_pGetNoiseRow(row, n, 1.0f, dest);
+} //GetNoiseRow
+
+/// Add a scaled row of noise into a cell, using the fastest kernel that the
+/// processor supports unless a different one has been selected.
+/// \param row Noise row.
+/// \param n Number of columns.
+/// \param scale Noise is rescaled by this factor.
+/// \param dest Row of cell, indexed by column.
+
+void AddNoiseRow(const NoiseRow& row, const int n, const float scale, float* dest){
+  InitNoiseKernel();
+  g_pAddNoiseRow(row, n, scale, dest);
+} //AddNoiseRow
+
+/// Hash a batch of lattice points against one or more seeds, giving the same
+/// hashes as MurmurHash3_x86_32 of the key ((unsigned long long)x<<32)|y, using
+/// the fastest kernel that the processor supports unless a different one
+/// has been selected.
+/// \param x X coordinates.
+/// \param y Y coordinates.
+/// \param n Number of points.
+/// \param seed Hash seeds.
+/// \param nseeds Number of hash seeds.
+/// \param out Hashes, n for the first seed, then n for the next, and so on.
+
+void LatticeHashBatch(const unsigned int* x, const unsigned int* y, const int n,
+  const unsigned int* seed, const int nseeds, unsigned int* out)
+{
+  InitNoiseKernel();
+  for(int i=0; i<nseeds; i++)
+    g_pLatticeHash(x, y, n, seed[i], out + i*n);
+} //LatticeHashBatch
+
+///////////////////////////////////////////////////////////////////////////////
+// Self check
+
+#define CHECK_COLUMNS 160 ///< Largest number of columns in a checked row.
+#define CHECK_OFFSETS 8 ///< Number of misalignments of the rows checked.
+
+/// Get a pseudo-random number from a 32-bit xorshift generator.
+/// \param state [in, out] Generator state, which must not be 0.
+/// \return Pseudo-random number.
+
+static unsigned int CheckRandom(unsigned int& state){
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return state;
+} //CheckRandom
+
+/// Get a pseudo-random float.
+/// \param state [in, out] Generator state, which must not be 0.
+/// \param lo Smallest value.
+/// \param hi Largest value.
+/// \return Pseudo-random float between lo and hi.
+
+static float CheckRandom(unsigned int& state, const float lo, const float hi){
+  return lo + (hi - lo)*(float)(CheckRandom(state) >> 8)/16777216.0f;
+} //CheckRandom
+
+/// Check that a kernel gets exactly the same bits as the scalar kernel for
+/// rows of random noise, and exactly the same hashes as LatticeHash for
+/// random lattice points, for rows of many lengths and misalignments. The kernel
+/// is called directly, so this doesn't change which one is selected.
+/// \param kernel Noise kernel other than NOISEKERNEL_BEST.
+/// \return true if the kernel agrees with the scalar kernel everywhere.
+
+static bool CheckNoiseKernel(const NoiseKernel kernel){
+  NoiseRowFunction get, add; //kernels for getting and adding noise
+  LatticeHashFunction hash; //kernel for hashing lattice points
+  if(!GetNoiseKernelFunctions(kernel, get, add, hash))return false;
+
+  const int size = CHECK_COLUMNS + CHECK_OFFSETS; //floats per buffer
+  float uax[size], vax[size], ubx[size], vbx[size], spline[size];
+  float init[size], expected[size], actual[size];
+  unsigned int x[size], y[size], h[size];
+  unsigned int state = 0x9e3779b9; //random number generator state
+  bool bOK = true;
+
+  for(int trial=0; trial<8; trial++){
+    for(int j=0; j<size; j++){
+      uax[j] = CheckRandom(state, -2.0f, 2.0f);
+      vax[j] = CheckRandom(state, -2.0f, 2.0f);
+      ubx[j] = CheckRandom(state, -2.0f, 2.0f);
+      vbx[j] = CheckRandom(state, -2.0f, 2.0f);
+      spline[j] = CheckRandom(state, 0.0f, 1.0f);
+      init[j] = CheckRandom(state, -8.0f, 8.0f);
+      x[j] = CheckRandom(state);
+      y[j] = CheckRandom(state);
+    } //for
+
+    for(int off=0; off<CHECK_OFFSETS; off++)
+      for(int n=0; n<=CHECK_COLUMNS; n+=(n < 20? 1: 7)){
+        const NoiseRow row = {uax + off, vax + off, ubx + off, vbx + off, spline + off,
+          CheckRandom(state, -2.0f, 2.0f), CheckRandom(state, -2.0f, 2.0f),
+          CheckRandom(state, -2.0f, 2.0f), CheckRandom(state, -2.0f, 2.0f),
+          CheckRandom(state, 0.0f, 1.0f)};
+        const float scale = CheckRandom(state, 0.0f, 1.0f);
+
+        //get noise, checking the whole buffer so that overruns are caught too
+        memcpy(expected, init, sizeof(init));
+        memcpy(actual, init, sizeof(init));
+        GetNoiseRowScalar(row, n, 1.0f, expected + off);
+        get(row, n, 1.0f, actual + off);
+        bOK = bOK && !memcmp(expected, actual, sizeof(init));
+
+        //add noise
+        memcpy(expected, init, sizeof(init));
+        memcpy(actual, init, sizeof(init));
+        AddNoiseRowScalar(row, n, scale, expected + off);
+        add(row, n, scale, actual + off);
+        bOK = bOK && !memcmp(expected, actual, sizeof(init));
+
+        //hash lattice points
+        const unsigned int seed = trial == 0? 0: trial == 1? 0xffffffff: CheckRandom(state);
+        memset(h, 0, sizeof(h));
+        hash(x + off, y + off, n, seed, h + off);
+        for(int j=0; j<size; j++){
+          const bool inside = j >= off && j < off + n; //whether it should be hashed
+          bOK = bOK && h[j] == (inside? LatticeHash(x[j], y[j], seed): 0);
+        } //for
+      } //for
+  } //for
+
+  return bOK;
+} //CheckNoiseKernel
+
+/// Check every kernel that this processor supports against the scalar kernel
+/// and LatticeHash, bit for bit, and print a line for each of them. This
+/// doesn't change which kernel is selected, and is safe to call while
+/// other threads are generating noise.
+/// \return true if every supported kernel passes.
+
+bool CheckNoiseKernels(){
+  const NoiseKernel kernel[] = {NOISEKERNEL_SCALAR, NOISEKERNEL_SSE2, NOISEKERNEL_AVX, NOISEKERNEL_NEON};
+  bool bOK = true;
+
+  for(int i=0; i<(int)(sizeof(kernel)/sizeof(kernel[0])); i++)
+    if(!NoiseKernelSupported(kernel[i]))
+      printf("Kernel %s: not supported on this processor\n", NoiseKernelName(kernel[i]));
+    else if(CheckNoiseKernel(kernel[i]))
+      printf("Kernel %s: passed\n", NoiseKernelName(kernel[i]));
+    else{
+      printf("Kernel %s: FAILED, differs from the scalar kernel\n", NoiseKernelName(kernel[i]));
+      bOK = false;
+    } //else
+
+  return bOK;
+} //CheckNoiseKernels
@@ -0,0 +1,99 @@
+/// \file NoiseKernel.h
+/// \brief Header for the amortized noise row kernels.
+///
+/// Amortized noise is computed a row at a time. Along a row of a subcell the
+/// y table values are constant and the x tables and spline table are read
+/// contiguously, so the row can be computed several points at a time using
+/// SIMD instructions. There is a scalar kernel, which does exactly what
+/// CInfiniteAmortizedNoise2D::getNoise(i, j) does, and SSE2, AVX, and NEON kernels
+/// that perform the same floating point operations in the same order and
+/// therefore give bitwise identical results. The fastest kernel that the
+/// processor supports is chosen the first time that a row is computed, which
+/// is safe even if that happens in several threads at once. A different kernel
+/// can be selected before any threads are started.
+///
+/// There are also kernels for hashing lattice points with MurmurHash3 several
+/// at a time, which give the same hashes as calling MurmurHash3_x86_32 on
+/// each of them.
+
+// Copyright Ian Parberry, May 2014.
+//
+// This file is made available under the GNU All-Permissive License.
+//
+// Copying and distribution of this file, with or without modification,
+// are permitted in any medium without royalty provided the copyright
+// notice and this notice are preserved.  This file is offered as-is,
+// without any warranty.
+
+#pragma once
+
+/// \brief Noise kernel instruction set.
+
+enum NoiseKernel{
+  NOISEKERNEL_SCALAR, ///< Plain C++.
+  NOISEKERNEL_SSE2, ///< x86 SSE2, 4 points at a time.
+  NOISEKERNEL_AVX, ///< x86 AVX, 8 points at a time, and AVX2 for hashing if there is AVX2.
+  NOISEKERNEL_NEON, ///< ARM NEON, 4 points at a time.
+  NOISEKERNEL_BEST, ///< Whichever of the above is fastest on this processor.
+}; //NoiseKernel
+
+/// \brief Noise row.
+///
+/// Everything needed to compute one row of one octave of amortized noise in a subcell.
+
+struct NoiseRow{
+  const float* uax; ///< X coordinate of u used to compute a, indexed by column.
+  const float* vax; ///< X coordinate of v used to compute a, indexed by column.
+  const float* ubx; ///< X coordinate of u used to compute b, indexed by column.
+  const float* vbx; ///< X coordinate of v used to compute b, indexed by column.
+  const float* spline; ///< Spline table, indexed by column.
+  float uay; ///< Y coordinate of u used to compute a for this row.
+  float vay; ///< Y coordinate of v used to compute a for this row.
+  float uby; ///< Y coordinate of u used to compute b for this row.
+  float vby; ///< Y coordinate of v used to compute b for this row.
+  float si; ///< Spline value for this row.
+}; //NoiseRow
+
+bool SelectNoiseKernel(const NoiseKernel kernel); ///< Choose the kernel.
+bool ParseNoiseKernel(const char* name, NoiseKernel& kernel); ///< Get a kernel from its name.
+const char* GetNoiseKernelName(); ///< Get the name of the current kernel.
+bool CheckNoiseKernels(); ///< Check every supported kernel against the scalar one.
+
+void GetNoiseRow(const NoiseRow& row, const int n, float* dest); ///< Put a row of noise into dest.
+void AddNoiseRow(const NoiseRow& row, const int n, const float scale, float* dest); ///< Add a scaled row of noise into dest.
+#define LATTICE_BATCH 64 ///< Number of lattice points that callers hash at a time.
+
+void LatticeHashBatch(const unsigned int* x, const unsigned int* y, const int n,
+  const unsigned int* seed, const int nseeds, unsigned int* out); ///< Hash a batch of lattice points.
+
+/// Hash one lattice point with MurmurHash3_x86_32, specialized for an 8-byte key
+/// ((unsigned long long)x<<32)|y on a little-endian processor, which hashes
+/// y and then x as 4-byte blocks.
+/// \param x X coordinate.
+/// \param y Y coordinate.
+/// \param seed Hash seed.
+/// \return Hash of (x, y).
+
+inline unsigned int LatticeHash(const unsigned int x, const unsigned int y, const unsigned int seed){
+  unsigned int h = seed;
+  unsigned int k = y;
+
+  for(int b=0; b<2; b++){ //y block then x block
+    k *= 0xcc9e2d51;
+    k = (k << 15) | (k >> 17);
+    k *= 0x1b873593;
+    h ^= k;
+    h = (h << 13) | (h >> 19);
+    h = h*5 + 0xe6546b64;
+    k = x;
+  } //for
+
+  h ^= 8; //length
+  h ^= h >> 16;
+  h *= 0x85ebca6b;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35;
+  h ^= h >> 16;
+
+  return h;
+} //LatticeHash
@@ -0,0 +1,102 @@
+/// \file PerfCounter.cpp
+/// \brief Code for the timer and hardware performance counter CPerfCounter.
+
+// Copyright Ian Parberry, May 2014.
+//
+// This file is made available under the GNU All-Permissive License.
+//
+// Copying and distribution of this file, with or without modification,
+// are permitted in any medium without royalty provided the copyright
+// notice and this notice are preserved.  This file is offered as-is,
+// without any warranty.
+
+#include "PerfCounter.h"
+
+#if defined(_MSC_VER) //Windows Visual Studio
+  #include <windows.h> //for QueryPerformanceCounter()
+#else //other OS
+  #include <string.h>
+  #include <time.h>
+  #include <unistd.h>
+  #if defined(__linux__)
+    #include <sys/ioctl.h>
+    #include <sys/syscall.h>
+    #include <linux/perf_event.h>
+  #endif
+#endif
+
+/// Get the time in seconds since some fixed point in the past from a clock
+/// that never goes backwards and has a resolution of a microsecond or better.
+/// \return Time in seconds.
+
+double GetSeconds(){
+  #if defined(_MSC_VER) //Windows Visual Studio
+    LARGE_INTEGER count, frequency;
+    QueryPerformanceCounter(&count);
+    QueryPerformanceFrequency(&frequency);
+    return (double)count.QuadPart/frequency.QuadPart;
+  #else //other OS
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec*1e-9;
+  #endif
+} //GetSeconds
+
+/// Open a cache miss counter for the calling thread, if there can be one.
+
+CPerfCounter::CPerfCounter(): m_nFd(-1){
+  #if defined(__linux__)
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    m_nFd = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0); //this thread, any processor
+  #endif
+} //constructor
+
+/// Close the counter.
+
+CPerfCounter::~CPerfCounter(){
+  #if !defined(_MSC_VER)
+    if(m_nFd >= 0)close(m_nFd);
+  #endif
+} //destructor
+
+/// Reader function for availability.
+/// \return true if cache misses are being counted.
+
+bool CPerfCounter::IsAvailable(){
+  return m_nFd >= 0;
+} //IsAvailable
+
+/// Reset the count and start counting.
+
+void CPerfCounter::Start(){
+  #if defined(__linux__)
+    if(m_nFd >= 0){
+      ioctl(m_nFd, PERF_EVENT_IOC_RESET, 0);
+      ioctl(m_nFd, PERF_EVENT_IOC_ENABLE, 0);
+    } //if
+  #endif
+} //Start
+
+/// Stop counting.
+/// \return Number of cache misses since Start(), or -1 if they can't be counted.
+
+long long CPerfCounter::Stop(){
+  long long count = -1;
+
+  #if defined(__linux__)
+    if(m_nFd >= 0){
+      ioctl(m_nFd, PERF_EVENT_IOC_DISABLE, 0);
+      if(read(m_nFd, &count, sizeof(count)) != sizeof(count))
+        count = -1;
+    } //if
+  #endif
+
+  return count;
+} //Stop
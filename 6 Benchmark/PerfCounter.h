@@ -0,0 +1,38 @@
+/// \file PerfCounter.h
+/// \brief Header for the timer and hardware performance counter CPerfCounter.
+
+// Copyright Ian Parberry, May 2014.
+//
+// This file is made available under the GNU All-Permissive License.
+//
+// Copying and distribution of this file, with or without modification,
+// are permitted in any medium without royalty provided the copyright
+// notice and this notice are preserved.  This file is offered as-is,
+// without any warranty.
+
+#pragma once
+
+double GetSeconds(); ///< Get the time from a monotonic high resolution clock.
+
+/// \brief Cache miss counter.
+///
+/// Counts the last level cache misses of the calling thread between Start()
+/// and Stop() using the processor's performance counters. This needs
+/// Linux perf events, and IsAvailable() returns false anywhere else or if
+/// the operating system doesn't allow it, in which case Stop() returns -1.
+
+class CPerfCounter{
+  private:
+    int m_nFd; ///< Perf event file descriptor, or -1 if there is none.
+
+    CPerfCounter(const CPerfCounter&); ///< Not copyable.
+    CPerfCounter& operator=(const CPerfCounter&); ///< Not assignable.
+
+  public:
+    CPerfCounter(); ///< Constructor.
+    ~CPerfCounter(); ///< Destructor.
+
+    bool IsAvailable(); ///< Whether cache misses can be counted.
+    void Start(); ///< Start counting from 0.
+    long long Stop(); ///< Stop counting.
+}; //CPerfCounter
@@ -0,0 +1,124 @@
+/// \file TerrainGenerator.cpp
+/// \brief Code file for the terrain generator CTerrainGenerator.
+
+// Copyright Ian Parberry, May 2014.
+//
+// This file is made available under the GNU All-Permissive License.
+//
+// Copying and distribution of this file, with or without modification,
+// are permitted in any medium without royalty provided the copyright
+// notice and this notice are preserved.  This file is offered as-is,
+// without any warranty.
+//
+// Created by Ian Parberry, May 2014.
+// Last updated May 30, 2014.
+
+#define _USE_MATH_DEFINES //for M_SQRT2
+#include <math.h> //for trig functions
+
+#include "TerrainGenerator.h"
+#include "Common.h"
+#include "MurmurHash3.h"
+
+#include "ExponentialHash.h"
+
+/// The constructor initializes the new random number seeds and omega, and
+/// relies on the CInfiniteAmortizedNoise2D constructor to do the rest.
+/// \param n Cell size.
+/// \param s Hash function seed.
+/// \param tail Value of omega.
+
+CTerrainGenerator::CTerrainGenerator(const unsigned int n, const unsigned int s, float tail):
+  CInfiniteAmortizedNoise2D(n, s), omega(tail), fastExpHash(false)
+{ 
+  seed1 = s + 9999; //hopefully murmurhash can handle this
+  seed2 = s + 314159;  //hopefully murmurhash can handle this too
+
+  //ExpHash has a static local that not all compilers initialize thread safely,
+  //so make sure that it is initialized before any threads call it
+  ExpHash(0, 0, 0xFFFFFFFF, omega);
+} //constructor
+
+/// Reader function for omega.
+/// \return Tail height multiplier.
+
+float CTerrainGenerator::getOmega(){
+  return omega;
+} //getOmega
+
+/// Choose between ExpHash, which is used by default and by the paper, and
+/// ExpHashFast, which doesn't call log and gives terrain that differs from
+/// it by a tiny fraction of a meter.
+/// \param fast true to use ExpHashFast.
+
+void CTerrainGenerator::setFastExpHash(const bool fast){
+  fastExpHash = fast;
+  gradientCache.clear(); //the gradients have changed
+} //setFastExpHash
+
+/// Hash two unsigned ints into a single unsigned int using MurmurHash.
+/// \param x X coordinate of value to be hashed.
+/// \param y Y coordinate of value to be hashed.
+/// \param seed Seed for the hash function.
+/// \return Hash of (x, y).
+
+unsigned int CTerrainGenerator::h(const unsigned int x, const unsigned int y, unsigned int seed){
+  unsigned int result;
+  unsigned long long key = ((unsigned long long)x<<32) | y;
+  MurmurHash3_32(&key, 8, seed, &result); //do the heavy lifting
+  return result;
+} //h
+
+/// Get the gradient at a lattice corner, which has a uniformly distributed
+/// direction and an exponentially distributed magnitude.
+/// \param x x coordinate of lattice corner.
+/// \param y y coordinate of lattice corner.
+/// \param gx X coordinate of gradient.
+/// \param gy Y coordinate of gradient.
+
+void CTerrainGenerator::getGradient(const int x, const int y, float& gx, float& gy){
+  //direction
+  const unsigned int b = CInfiniteAmortizedNoise2D::h(x, y);
+
+  //magnitude
+  const unsigned int max = 0xFFFFFFFF;
+  const unsigned int x1 = h(x, y, seed1), x2 = h(x, y, seed2);
+  const float m = fastExpHash? ExpHashFast(x1, x2, max, omega): ExpHash(x1, x2, max, omega);
+
+  getDirection(b, gx, gy);
+  gx *= m;
+  gy *= m;
+} //getGradient
+
+/// Get the gradients at a row of lattice corners, the same as calling
+/// getGradient for each of them. The direction and both magnitude hashes of
+/// a batch of corners are computed together by the lattice hash kernels.
+/// \param x x coordinate of the lattice corners.
+/// \param y0 y coordinate of the first lattice corner.
+/// \param n Number of lattice corners.
+/// \param gx X coordinates of gradients.
+/// \param gy Y coordinates of gradients.
+
+void CTerrainGenerator::getGradientRow(const int x, const int y0, const int n, float* gx, float* gy){
+  const unsigned int seeds[3] = {seed, seed1, seed2}; //direction, magnitude, tail
+  unsigned int xs[LATTICE_BATCH], ys[LATTICE_BATCH], b[3*LATTICE_BATCH];
+  const unsigned int max = 0xFFFFFFFF;
+
+  for(int j0=0; j0<n; j0+=LATTICE_BATCH){
+    const int m = n - j0 < LATTICE_BATCH? n - j0: LATTICE_BATCH; //corners in this batch
+    for(int j=0; j<m; j++){
+      xs[j] = x; ys[j] = y0 + j0 + j;
+    } //for
+
+    LatticeHashBatch(xs, ys, m, seeds, 3, b);
+
+    for(int j=0; j<m; j++){
+      const float mag = fastExpHash? ExpHashFast(b[m + j], b[2*m + j], max, omega):
+        ExpHash(b[m + j], b[2*m + j], max, omega);
+      float dx, dy; //direction
+      getDirection(b[j], dx, dy);
+      gx[j0 + j] = mag * dx;
+      gy[j0 + j] = mag * dy;
+    } //for
+  } //for
+} //getGradientRow
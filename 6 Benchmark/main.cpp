@@ -0,0 +1,634 @@
+/// \file Main.cpp
+/// \brief Main.
+///
+/// \mainpage Terrain Generator Benchmark
+///
+/// This program times the Perlin noise terrain generator from the first
+/// folder against the amortized noise terrain generator from the second
+/// folder, so that changes to either of them that make it slower can be
+/// caught. It generates cells of terrain for each combination of cell size,
+/// range of octaves, and number of threads, and writes one line of results
+/// for each of them to standard output as CSV, or as JSON with -json.
+///
+/// Times are wall clock times from a monotonic high resolution clock. Each
+/// combination is run -warmup times, default 1, before it is timed, and is
+/// then timed -repeats times, default 5, giving the minimum, median, and
+/// mean time to generate a cell. The time for each stage of the
+/// amortized noise generator, that is, hashing the lattice gradients
+/// (hash), filling the edge tables (edge), filling the spline table (spline),
+/// and adding up the octaves (accumulate), is measured in a single thread
+/// by a copy of the generator that times each stage separately and checks that
+/// it gets the same noise as the real one. The Perlin noise generator has only
+/// one stage, accumulate. The output stage is the time to convert the cell to
+/// heights and write it to a float32 DEM file.
+///
+/// The command line options are -generator perlin, amortized, or both
+/// (the default), -sizes followed by a comma separated list of cell sizes,
+/// default 1024,4096, -octaves followed by a comma separated list of octave
+/// ranges, default 5-12, -threads followed by a comma separated list of
+/// numbers of threads, 0 meaning one per hardware thread, default 1,0,
+/// -repeats N, -warmup N, -seed N, -json, and -selftest, which checks every
+/// noise kernel that the processor supports against the scalar one, bit for
+/// bit, instead of benchmarking anything. A range of octaves m0-m1 means
+/// octaves m0 through m1 of the amortized noise generator, as in the
+/// generator program, and m1 - m0 + 1 octaves of Perlin noise.
+///
+/// The amortized noise generator compiled for a fixed cell size and range
+/// of octaves, CFixedAmortizedNoise2D, is timed too as generator fixed for the
+/// combinations that it is compiled for here, which are sizes 1024 and 4096
+/// with octaves 5-12, and is checked against the real generator.
+
+// Copyright Ian Parberry, May 2014.
+//
+// This file is made available under the GNU All-Permissive License.
+//
+// Copying and distribution of this file, with or without modification,
+// are permitted in any medium without royalty provided the copyright
+// notice and this notice are preserved.  This file is offered as-is,
+// without any warranty.
+
+#include <stdio.h> //for printf()
+#include <stdlib.h> //for atoi()
+#include <string.h> //for strcmp()
+
+#include <vector>
+#include <algorithm> //for std::sort
+#include <thread> //for std::thread
+#include <atomic> //for std::atomic
+
+#include "defines.h" //OS porting defines
+
+#include "TerrainGenerator.h"
+#include "FixedAmortizedNoise2D.h"
+#include "NoiseCell.h"
+#include "DEMWriter.h"
+#include "PerfCounter.h"
+#include "perlin.h"
+
+/// \brief Time taken by each stage of generating a cell.
+///
+/// Times in seconds, or -1 for a stage that a generator doesn't have.
+
+struct StageTimes{
+  double hash; ///< Hashing lattice gradients.
+  double edge; ///< Filling edge tables.
+  double spline; ///< Filling spline tables.
+  double accumulate; ///< Computing and adding up octaves.
+  double output; ///< Converting to heights and saving.
+}; //StageTimes
+
+/// \brief Benchmark result.
+///
+/// Times for one combination of generator, cell size, octaves, and threads.
+
+struct Result{
+  const char* generator; ///< Name of generator.
+  int size; ///< Cell size.
+  int m0; ///< Largest octave.
+  int m1; ///< Smallest octave.
+  int threads; ///< Number of threads.
+  double min; ///< Shortest time to generate a cell in seconds.
+  double median; ///< Median time to generate a cell in seconds.
+  double mean; ///< Mean time to generate a cell in seconds.
+  StageTimes stages; ///< Time taken by each stage in a single thread.
+}; //Result
+
+/// \brief Amortized noise generator with timed stages.
+///
+/// The terrain generator, but with a version of generate() that does the
+/// stages of each octave one after the other in the calling thread and times
+/// each of them. The edge tables are filled once on their own, to time them,
+/// and again with the noise, so that the accumulation time is the difference.
+
+class CStagedGenerator: public CTerrainGenerator{
+  public:
+    CStagedGenerator(const unsigned int n, const unsigned int s, float tail); ///< Constructor.
+    void generateStaged(int x, int y, const int m0, const int m1, CNoiseCell& cell, StageTimes& t); ///< Generate with timed stages.
+}; //CStagedGenerator
+
+bool g_bPerlin = true; ///< Whether to benchmark the Perlin noise generator.
+bool g_bAmortized = true; ///< Whether to benchmark the amortized noise generator.
+bool g_bJSON = false; ///< Whether to write JSON instead of CSV.
+bool g_bSelfTest = false; ///< Whether to check the noise kernels instead of benchmarking.
+int g_nRepeats = 5; ///< Number of timed runs.
+int g_nWarmup = 1; ///< Number of untimed runs before the timed ones.
+unsigned int g_nSeed = 9999; ///< Hash seed.
+const float OMEGA = 0.3f; ///< Tail multiplier for the amortized noise generator.
+const float MU = 1.02f; ///< Gradient magnitude exponent for the Perlin noise generator.
+const float ALTITUDE = 5000.0f; ///< Elevation cap in meters.
+
+std::vector<int> g_vSizes; ///< Cell sizes.
+std::vector<int> g_vOctaves; ///< Ranges of octaves, two entries m0, m1 per range.
+std::vector<int> g_vThreads; ///< Numbers of threads.
+
+/// The constructor just passes its parameters on to the terrain generator.
+/// \param n Cell size.
+/// \param s Hash function seed.
+/// \param tail Value of omega.
+
+CStagedGenerator::CStagedGenerator(const unsigned int n, const unsigned int s, float tail):
+  CTerrainGenerator(n, s, tail){
+} //constructor
+
+/// Generate a cell of noise in the calling thread, the same as generate(),
+/// adding the time taken by each stage to t.
+/// \param x x coordinate of top left corner of cell.
+/// \param y y coordinate of top left corner of cell.
+/// \param m0 Largest octave.
+/// \param m1 Smallest octave.
+/// \param cell Cell to put generated noise into.
+/// \param t Stage times.
+
+void CStagedGenerator::generateStaged(int x, int y, const int m0, const int m1,
+  CNoiseCell& cell, StageTimes& t)
+{
+  int n = size; //granularity
+  int r = 1; //side length of cell divided by side length of subcell.
+
+  for(int i=1; i<m0; i++){ //skip over unwanted octaves
+    n /= 2; r += r;
+  } //for
+
+  float scale = 1.0f; //scale factor
+
+  for(int k=m0; k<=m1 && n>=2; k++){ //for each octave
+    if(k > m0){ //rescale for next octave
+      n /= 2; r += r;  x += x; y += y; scale *= 0.5f;
+    } //if
+
+    double start = GetSeconds();
+    initSplineTable(n);
+    t.spline += GetSeconds() - start;
+
+    start = GetSeconds();
+    latticeSize = r + 1;
+    latticeX.resize(latticeSize*latticeSize);
+    latticeY.resize(latticeSize*latticeSize);
+    for(int i=0; i<latticeSize; i++)
+      getGradientRow(x + i, y, latticeSize, &latticeX[i*latticeSize], &latticeY[i*latticeSize]);
+    t.hash += GetSeconds() - start;
+
+    start = GetSeconds();
+    for(int i0=0; i0<r; i0++)
+      for(int j0=0; j0<r; j0++)
+        initEdgeTables(i0, j0, n, tables);
+    const double edge = GetSeconds() - start;
+    t.edge += edge;
+
+    start = GetSeconds();
+    for(int i0=0; i0<r; i0++)
+      for(int j0=0; j0<r; j0++){
+        initEdgeTables(i0, j0, n, tables);
+        if(k == m0)getNoise(n, i0*n, j0*n, tables, cell.GetRows());
+        else addNoise(n, i0*n, j0*n, scale, tables, cell.GetRows());
+      } //for
+    t.accumulate += GetSeconds() - start - edge;
+  } //for
+} //generateStaged
+
+/// \brief Parse a list.
+///
+/// Parse a comma separated list of integers, or of ranges of the form
+/// m0-m1, which are put in the list as m0 followed by m1.
+/// \param s String to be parsed.
+/// \param v List to append to.
+/// \param ranges Whether the entries are ranges.
+/// \return true if it is a list of the right form.
+
+bool ParseList(const char* s, std::vector<int>& v, const bool ranges){
+  v.clear();
+
+  while(*s){
+    char* end;
+    v.push_back((int)strtol(s, &end, 10));
+    if(end == s)return false;
+    s = end;
+
+    if(ranges){
+      if(*s++ != '-')return false;
+      v.push_back((int)strtol(s, &end, 10));
+      if(end == s)return false;
+      s = end;
+    } //if
+
+    if(*s == ',')s++;
+    else if(*s)return false;
+  } //while
+
+  return !v.empty();
+} //ParseList
+
+/// \brief Save a cell.
+///
+/// Convert a cell of noise to heights and save it as a float32 DEM file,
+/// which is then deleted.
+/// \param cell Noise cell.
+/// \param scale Multiply noise by this to bring it to [-1, 1].
+/// \return Time taken in seconds.
+
+double SaveCell(CNoiseCell& cell, const float scale){
+  const double start = GetSeconds();
+  const int n = cell.GetSize();
+
+  CDEMWriter output;
+  if(output.Open("benchmark_output", DEMFORMAT_FLOAT32, n, n, 5.0)){
+    float* row = new float [n]; //one row of heights
+    for(int i=0; i<n; i++){
+      const float* noise = cell.GetRow(i);
+      for(int j=0; j<n; j++)
+        row[j] = ALTITUDE * (1.0f + noise[j] * scale)/2.0f;
+      output.WriteRow(row);
+    } //for
+    delete [] row;
+
+    if(!output.Close())
+      fprintf(stderr, "Failed to save %s\n", output.GetFileName());
+    remove(output.GetFileName());
+    remove("benchmark_output.hdr");
+  } //if
+  else fprintf(stderr, "Failed to save benchmark_output\n");
+
+  return GetSeconds() - start;
+} //SaveCell
+
+/// \brief Band of rows of Perlin noise.
+///
+/// Rows of a cell of Perlin noise shared out among threads a row at a time.
+
+struct PerlinJob{
+  const CPerlinNoise2D* noise; ///< Perlin noise generator.
+  CNoiseCell* cell; ///< Cell to put generated noise into.
+  int octaves; ///< Number of octaves.
+  std::atomic<int> next; ///< Next row to be generated.
+}; //PerlinJob
+
+/// \brief Generate rows of Perlin noise.
+///
+/// Generate rows of a cell of Perlin noise until there are none left.
+/// \param job The cell.
+
+void GeneratePerlinRows(PerlinJob* job){
+  const int n = job->cell->GetSize();
+  for(int i; (i = job->next++) < n; )
+    job->noise->generateRow(7777 + i/256.0f, 9999.0f, 1/256.0f, n, job->octaves, job->cell->GetRow(i));
+} //GeneratePerlinRows
+
+/// \brief Generate a cell of Perlin noise.
+///
+/// Generate a cell of Perlin noise using several threads, the calling thread
+/// being one of them.
+/// \param job The cell.
+/// \param threads Number of threads.
+
+void GeneratePerlinCell(PerlinJob& job, const int threads){
+  job.next = 0;
+
+  std::vector<std::thread> thread;
+  for(int k=1; k<threads; k++)
+    thread.push_back(std::thread(GeneratePerlinRows, &job));
+  GeneratePerlinRows(&job);
+
+  for(int k=0; k<(int)thread.size(); k++)
+    thread[k].join();
+} //GeneratePerlinCell
+
+/// \brief Summarize times.
+///
+/// Put the minimum, median, and mean of a list of times into a result.
+/// \param times Times in seconds.
+/// \param result Where to put them.
+
+void Summarize(std::vector<double> times, Result& result){
+  std::sort(times.begin(), times.end());
+  const int n = (int)times.size();
+
+  result.min = times[0];
+  result.median = n%2? times[n/2]: (times[n/2 - 1] + times[n/2])/2.0;
+  result.mean = 0.0;
+  for(int i=0; i<n; i++)
+    result.mean += times[i];
+  result.mean /= n;
+} //Summarize
+
+/// \brief Print a stage time.
+///
+/// Print a stage time, or nothing in CSV and null in JSON for a missing stage.
+/// \param name Name of stage for JSON.
+/// \param t Time in seconds, negative if the generator doesn't have this stage.
+
+void PrintStage(const char* name, const double t){
+  if(g_bJSON){
+    if(t < 0.0)printf(", \"%s_s\": null", name);
+    else printf(", \"%s_s\": %0.6f", name, t);
+  } //if
+  else{
+    if(t < 0.0)printf(",");
+    else printf(",%0.6f", t);
+  } //else
+} //PrintStage
+
+/// \brief Print a result.
+///
+/// Print a result as a line of CSV, or as a JSON object.
+/// \param result The result.
+/// \param first Whether this is the first result.
+
+void PrintResult(const Result& result, const bool first){
+  const double ns = 1e9*result.median/((double)result.size*result.size);
+
+  if(g_bJSON){
+    printf("%s  {\"generator\": \"%s\", \"size\": %d, \"m0\": %d, \"m1\": %d, \"threads\": %d, ",
+      first? "": ",\n", result.generator, result.size, result.m0, result.m1, result.threads);
+    printf("\"repeats\": %d, \"min_s\": %0.6f, \"median_s\": %0.6f, \"mean_s\": %0.6f, \"ns_per_point\": %0.3f",
+      g_nRepeats, result.min, result.median, result.mean, ns);
+  } //if
+  else{
+    printf("%s,%d,%d,%d,%d,%d,%0.6f,%0.6f,%0.6f,%0.3f", result.generator, result.size,
+      result.m0, result.m1, result.threads, g_nRepeats, result.min, result.median, result.mean, ns);
+  } //else
+
+  PrintStage("hash", result.stages.hash);
+  PrintStage("edge", result.stages.edge);
+  PrintStage("spline", result.stages.spline);
+  PrintStage("accumulate", result.stages.accumulate);
+  PrintStage("output", result.stages.output);
+
+  printf(g_bJSON? "}": "\n");
+  fflush(stdout);
+} //PrintResult
+
+/// \brief Benchmark a fixed amortized noise generator.
+///
+/// Benchmark an instance of CFixedAmortizedNoise2D for each number of threads,
+/// checking that it gets the same noise as the real generator.
+/// \param x x coordinate of top left corner of cell.
+/// \param y y coordinate of top left corner of cell.
+/// \param m0 Largest octave, which ENGINE must be compiled for.
+/// \param m1 Smallest octave, which ENGINE must be compiled for.
+/// \param reference Cell generated by the real generator.
+/// \param first Whether no results have been printed yet.
+
+template<class ENGINE> void BenchmarkFixed(const int x, const int y, const int m0, const int m1,
+  CNoiseCell& reference, bool& first)
+{
+  const int n = reference.GetSize();
+  CNoiseCell cell(n);
+  ENGINE generator(g_nSeed, OMEGA);
+
+  Result result;
+  result.generator = "fixed";
+  result.size = n; result.m0 = m0; result.m1 = m1;
+  result.stages.hash = result.stages.edge = result.stages.spline = -1.0;
+  result.stages.accumulate = result.stages.output = -1.0;
+
+  for(int k=0; k<(int)g_vThreads.size(); k++){
+    generator.setThreads(g_vThreads[k]);
+    result.threads = g_vThreads[k] > 0? g_vThreads[k]: (int)std::thread::hardware_concurrency();
+    fprintf(stderr, "fixed size %d octaves %d-%d threads %d\n", n, m0, m1, result.threads);
+
+    for(int i=0; i<g_nWarmup; i++)
+      generator.generate(x, y, cell);
+
+    std::vector<double> times;
+    for(int i=0; i<g_nRepeats; i++){
+      const double start = GetSeconds();
+      generator.generate(x, y, cell);
+      times.push_back(GetSeconds() - start);
+    } //for
+
+    Summarize(times, result);
+
+    for(int i=0; i<n; i++)
+      if(memcmp(cell.GetRow(i), reference.GetRow(i), n*sizeof(float))){
+        fprintf(stderr, "Warning: the fixed generator doesn't match the real one\n");
+        break;
+      } //if
+
+    PrintResult(result, first);
+    first = false;
+  } //for
+} //BenchmarkFixed
+
+/// \brief Benchmark the amortized noise generator.
+///
+/// Benchmark the amortized noise generator for each number of threads, with
+/// one cell size and range of octaves.
+/// \param n Cell size.
+/// \param m0 Largest octave.
+/// \param m1 Smallest octave.
+/// \param first Whether no results have been printed yet.
+
+void BenchmarkAmortized(const int n, const int m0, const int m1, bool& first){
+  //tile (7777, 9999) as in the generator program
+  int x = 9999, y = 7777;
+  for(int i=1; i<m0; i++){
+    x *= 2; y *= 2;
+  } //for
+
+  CNoiseCell cell(n), staged(n);
+  CStagedGenerator generator(n, g_nSeed, OMEGA);
+
+  //time the stages in a single thread
+  Result result;
+  result.generator = "amortized";
+  result.size = n; result.m0 = m0; result.m1 = m1;
+  memset(&result.stages, 0, sizeof(result.stages));
+
+  for(int i=0; i<g_nWarmup; i++){
+    StageTimes t;
+    memset(&t, 0, sizeof(t));
+    generator.generateStaged(x, y, m0, m1, staged, t);
+  } //for
+
+  for(int i=0; i<g_nRepeats; i++)
+    generator.generateStaged(x, y, m0, m1, staged, result.stages);
+
+  result.stages.hash /= g_nRepeats;
+  result.stages.edge /= g_nRepeats;
+  result.stages.spline /= g_nRepeats;
+  result.stages.accumulate /= g_nRepeats;
+
+  //time the real generator
+  for(int k=0; k<(int)g_vThreads.size(); k++){
+    generator.setThreads(g_vThreads[k]);
+    result.threads = g_vThreads[k] > 0? g_vThreads[k]: (int)std::thread::hardware_concurrency();
+    fprintf(stderr, "amortized size %d octaves %d-%d threads %d\n", n, m0, m1, result.threads);
+
+    float scale = 1.0f;
+    for(int i=0; i<g_nWarmup; i++)
+      scale = generator.generate(x, y, m0, m1, cell);
+
+    std::vector<double> times;
+    for(int i=0; i<g_nRepeats; i++){
+      const double start = GetSeconds();
+      scale = generator.generate(x, y, m0, m1, cell);
+      times.push_back(GetSeconds() - start);
+    } //for
+
+    Summarize(times, result);
+
+    if(k == 0){ //check and save only once
+      for(int i=0; i<n; i++)
+        if(memcmp(cell.GetRow(i), staged.GetRow(i), n*sizeof(float))){
+          fprintf(stderr, "Warning: the staged generator doesn't match the real one\n");
+          break;
+        } //if
+
+      result.stages.output = SaveCell(cell, scale);
+    } //if
+
+    PrintResult(result, first);
+    first = false;
+  } //for
+
+  //time the fixed generator if it is compiled for this size and octaves
+  if(m0 == 5 && m1 == 12){
+    if(n == 1024)BenchmarkFixed<CFixedAmortizedNoise2D<1024, 5, 12, ExpMagnitude> >(x, y, m0, m1, cell, first);
+    else if(n == 4096)BenchmarkFixed<CFixedAmortizedNoise2D<4096, 5, 12, ExpMagnitude> >(x, y, m0, m1, cell, first);
+  } //if
+} //BenchmarkAmortized
+
+/// \brief Benchmark the Perlin noise generator.
+///
+/// Benchmark the Perlin noise generator for each number of threads, with
+/// one cell size and number of octaves.
+/// \param n Cell size.
+/// \param m0 Largest octave.
+/// \param m1 Smallest octave.
+/// \param first Whether no results have been printed yet.
+
+void BenchmarkPerlin(const int n, const int m0, const int m1, bool& first){
+  CNoiseCell cell(n);
+  CPerlinNoise2D noise(g_nSeed, MU);
+
+  PerlinJob job;
+  job.noise = &noise;
+  job.cell = &cell;
+  job.octaves = m1 - m0 + 1;
+
+  Result result;
+  result.generator = "perlin";
+  result.size = n; result.m0 = m0; result.m1 = m1;
+  result.stages.hash = result.stages.edge = result.stages.spline = -1.0;
+
+  for(int k=0; k<(int)g_vThreads.size(); k++){
+    int threads = g_vThreads[k] > 0? g_vThreads[k]: (int)std::thread::hardware_concurrency();
+    if(threads < 1)threads = 1;
+    result.threads = threads;
+    fprintf(stderr, "perlin size %d octaves %d-%d threads %d\n", n, m0, m1, threads);
+
+    for(int i=0; i<g_nWarmup; i++)
+      GeneratePerlinCell(job, threads);
+
+    std::vector<double> times;
+    for(int i=0; i<g_nRepeats; i++){
+      const double start = GetSeconds();
+      GeneratePerlinCell(job, threads);
+      times.push_back(GetSeconds() - start);
+    } //for
+
+    Summarize(times, result);
+
+    if(k == 0){ //accumulate is the whole thing in a single thread
+      if(threads == 1)result.stages.accumulate = result.mean;
+      else{
+        const double start = GetSeconds();
+        GeneratePerlinCell(job, 1);
+        result.stages.accumulate = GetSeconds() - start;
+      } //else
+
+      result.stages.output = SaveCell(cell, 1.0f);
+    } //if
+
+    PrintResult(result, first);
+    first = false;
+  } //for
+} //BenchmarkPerlin
+
+/// \brief Main.
+///
+/// Parse the command line and run the benchmarks.
+/// \param argc Argument count
+/// \param argv Arguments.
+/// \return 0 for success, 1 for failure.
+
+int main(int argc, char *argv[]){
+  g_vSizes.push_back(1024); g_vSizes.push_back(4096);
+  g_vOctaves.push_back(5); g_vOctaves.push_back(12);
+  g_vThreads.push_back(1); g_vThreads.push_back(0);
+
+  //parse command line
+  for(int i=1; i<argc; i++)
+    if(!strcmp(argv[i], "-generator") && i+1 < argc){
+      i++;
+      g_bPerlin = !strcmp(argv[i], "perlin") || !strcmp(argv[i], "both");
+      g_bAmortized = !strcmp(argv[i], "amortized") || !strcmp(argv[i], "both");
+      if(!g_bPerlin && !g_bAmortized){
+        fprintf(stderr, "Unknown generator %s\n", argv[i]);
+        return 1;
+      } //if
+    } //if
+    else if(!strcmp(argv[i], "-sizes") && i+1 < argc){
+      if(!ParseList(argv[++i], g_vSizes, false)){
+        fprintf(stderr, "Bad list of sizes %s\n", argv[i]);
+        return 1;
+      } //if
+    } //else if
+    else if(!strcmp(argv[i], "-octaves") && i+1 < argc){
+      if(!ParseList(argv[++i], g_vOctaves, true)){
+        fprintf(stderr, "Bad list of octaves %s\n", argv[i]);
+        return 1;
+      } //if
+    } //else if
+    else if(!strcmp(argv[i], "-threads") && i+1 < argc){
+      if(!ParseList(argv[++i], g_vThreads, false)){
+        fprintf(stderr, "Bad list of threads %s\n", argv[i]);
+        return 1;
+      } //if
+    } //else if
+    else if(!strcmp(argv[i], "-repeats") && i+1 < argc)
+      g_nRepeats = atoi(argv[++i]);
+    else if(!strcmp(argv[i], "-warmup") && i+1 < argc)
+      g_nWarmup = atoi(argv[++i]);
+    else if(!strcmp(argv[i], "-seed") && i+1 < argc)
+      g_nSeed = (unsigned int)atoi(argv[++i]);
+    else if(!strcmp(argv[i], "-json"))
+      g_bJSON = true;
+    else if(!strcmp(argv[i], "-selftest"))
+      g_bSelfTest = true;
+    else fprintf(stderr, "Ignoring unknown option %s\n", argv[i]);
+
+  if(g_nRepeats < 1)g_nRepeats = 1;
+  if(g_nWarmup < 0)g_nWarmup = 0;
+
+  for(int i=0; i<(int)g_vSizes.size(); i++)
+    if(g_vSizes[i] < 2 || (g_vSizes[i] & (g_vSizes[i] - 1))){
+      fprintf(stderr, "Cell sizes must be powers of 2\n");
+      return 1;
+    } //if
+
+  for(int i=0; i<(int)g_vOctaves.size(); i+=2)
+    if(g_vOctaves[i] < 1 || g_vOctaves[i + 1] < g_vOctaves[i]){
+      fprintf(stderr, "Octave ranges must be m0-m1 with 1 <= m0 <= m1\n");
+      return 1;
+    } //if
+
+  if(g_bSelfTest)
+    return CheckNoiseKernels()? 0: 1;
+
+  if(g_bJSON)printf("[\n");
+  else printf("generator,size,m0,m1,threads,repeats,min_s,median_s,mean_s,ns_per_point,"
+    "hash_s,edge_s,spline_s,accumulate_s,output_s\n");
+
+  bool first = true; //whether no results have been printed yet
+
+  for(int i=0; i<(int)g_vSizes.size(); i++)
+    for(int j=0; j<(int)g_vOctaves.size(); j+=2){
+      if(g_bPerlin)BenchmarkPerlin(g_vSizes[i], g_vOctaves[j], g_vOctaves[j + 1], first);
+      if(g_bAmortized)BenchmarkAmortized(g_vSizes[i], g_vOctaves[j], g_vOctaves[j + 1], first);
+    } //for
+
+  if(g_bJSON)printf("\n]\n");
+
+  return 0;
+} //main
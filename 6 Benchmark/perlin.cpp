@@ -0,0 +1,355 @@
+/// \file perlin.cpp
+/// \brief Code file for 2D Perlin noise with exponentially distributed gradients.
+///
+/// The permutation, gradient, and magnitude tables belong to a CPerlinNoise2D
+/// object instead of being static, so that several of them with different
+/// seeds or mu can be used at once, and all functions that compute noise are
+/// const, so that any number of threads can use the same one. The lattice
+/// size is a power of 2 chosen when the object is constructed, 256 by default
+/// as in Perlin's code. The gradient and magnitude at each corner are packed
+/// into one aligned 16-byte record, so looking up a corner touches one cache line.
+
+// Copyright Ian Parberry, May 2014.
+//
+// This file is made available under the GNU All-Permissive License.
+//
+// Copying and distribution of this file, with or without modification,
+// are permitted in any medium without royalty provided the copyright
+// notice and this notice are preserved.  This file is offered as-is,
+// without any warranty.
+
+// Created by Ian Parberry, May 2014.
+// Last updated May 31, 2014.
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "perlin.h"
+
+#define _USE_MATH_DEFINES ///< Enable use of constant M_SQRT2 in math.h
+#include <math.h>
+const float FM_SQRT2 = (float)M_SQRT2; ///< Square root of 2 as a float.
+
+#define N 0x1000 ///< Perlin's N.
+#define PERLIN_CHUNK 256 ///< Number of points that generateRow does at a time.
+
+#define lerp(t, a, b) (a + t*(b - a)) ///< Linear interpolation.
+#define s_curve(t) (t*t*(3.0f - 2.0f*t)) ///< Cubic spline.
+
+/// Perlin's setup macro.
+#define setup(i,b0,b1,r0,r1)\
+  t = vec[i] + N;\
+  b0 = ((int)t) & m_nMask;\
+  b1 = (b0+1) & m_nMask;\
+  r0 = t - (int)t;\
+  r1 = r0 - 1.0f;
+
+#define at2(rx, ry) (rx*q[0] + ry*q[1]) ///< Perlin's dot product macro.
+
+/// \brief 2D vector normalize.
+///
+/// Works by side-effect on the parameter v.
+/// \param v 2D vector as a 2-element array.
+
+static void normalize2(float v[2]){
+  float s = sqrt(v[0]*v[0] + v[1]*v[1]);
+  v[0] /= s; v[1] /= s;
+} //normalize2
+
+/// \brief Swap two integers.
+///
+/// Works by side-effect.
+/// \param x First value.
+/// \param y Second value.
+
+static void swap(int& x, int& y){
+  int k = x; x = y; y = k;
+} //swap
+
+/// \brief Get random floating point number.
+///
+/// Get random floating point number between -1 and 1. Uses rand() to
+/// do the heavy lifting.
+/// \return Pseudorandom floating point number between -1 and 1.
+
+static float randomflt(){
+  return (2.0f*rand())/RAND_MAX - 1.0f;
+} //randomflt
+
+/// \brief SplitMix64.
+///
+/// Get the value of Steele, Lea, and Flood's SplitMix64 generator at a
+/// position in its sequence. This is counter based, with no state
+/// other than the seed and the position.
+/// \param seed Random number seed.
+/// \param k Position in the sequence.
+/// \return Pseudorandom 64-bit value.
+
+static unsigned long long SplitMix64(const unsigned long long seed, const unsigned long long k){
+  unsigned long long z = seed + (k + 1)*0x9E3779B97F4A7C15ULL;
+  z = (z ^ (z >> 30))*0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27))*0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+} //SplitMix64
+
+/// \brief Constructor.
+///
+/// Initialize the permutation and gradient tables using rand(), exactly as
+/// the original initPerlin2D() did, so that seeding rand() with srand() first
+/// reproduces the terrain in the paper when the lattice size is B and the
+/// noise is computed a point at a time with generate. The gradients are
+/// normalized in place, as initPerlin2D() did, because with -ffast-math
+/// the compiler rounds a copy made through a temporary differently.
+/// \param mu Gradient magnitude exponent.
+/// \param n Lattice size, a power of 2, at most RAND_MAX + 1.
+
+CPerlinNoise2D::CPerlinNoise2D(const float mu, const int n){  
+  allocate(n);
+
+  //random gradient vectors
+  for(int i=0; i<n; i++){
+    float* v = &m_pCorner[i].gx; //gx and gy, normalized in place as Perlin did
+    v[0] = randomflt();
+    v[1] = randomflt();
+    normalize2(v);
+  } //for
+  
+  //random permutation 
+  for(int i=0; i<n; i++) //identity permutation
+    m_pPerm[i] =  i;
+  for(int i=n-1; i>0; i--) //randomly transpose elements
+    swap(m_pPerm[i], m_pPerm[rand()%(i + 1)]); //bug fix - Perlin had i, not i+1.
+  
+  initMagnitudes(mu);
+} //constructor
+
+/// \brief Constructor.
+///
+/// Initialize the permutation and gradient tables using SplitMix64 instead of
+/// rand(), so that the tables depend only on the seed and not on what
+/// anyone else has done with rand(), and can be made in any thread.
+/// \param seed Random number seed.
+/// \param mu Gradient magnitude exponent.
+/// \param n Lattice size, a power of 2.
+
+CPerlinNoise2D::CPerlinNoise2D(const unsigned int seed, const float mu, const int n){
+  allocate(n);
+  unsigned long long k = 0; //position in the random sequence
+
+  //random gradient vectors
+  for(int i=0; i<n; i++){
+    float v[2];
+    for(int j=0; j<2; j++) //top 24 bits give a float between -1 and 1
+      v[j] = (float)(SplitMix64(seed, k++) >> 40)*(2.0f/16777216.0f) - 1.0f;
+    normalize2(v);
+    m_pCorner[i].gx = v[0]; m_pCorner[i].gy = v[1];
+  } //for
+
+  //random permutation 
+  for(int i=0; i<n; i++) //identity permutation
+    m_pPerm[i] =  i;
+  for(int i=n-1; i>0; i--) //randomly transpose elements
+    swap(m_pPerm[i], m_pPerm[SplitMix64(seed, k++)%(i + 1)]);
+
+  initMagnitudes(mu);
+} //constructor
+
+/// \brief Destructor.
+
+CPerlinNoise2D::~CPerlinNoise2D(){
+  delete [] m_pPerm;
+  delete [] m_pBlock;
+} //destructor
+
+/// \brief Allocate tables.
+///
+/// Allocate the permutation table and the corner records, which are aligned
+/// to PERLIN_ALIGN bytes so that no record straddles two cache lines.
+/// \param n Lattice size, a power of 2.
+
+void CPerlinNoise2D::allocate(const int n){
+  m_nSize = n;
+  m_nMask = n - 1;
+  m_pPerm = new int [n];
+
+  m_pBlock = new char [n*sizeof(PerlinCorner) + PERLIN_ALIGN];
+  const size_t offset = (size_t)m_pBlock%PERLIN_ALIGN;
+  m_pCorner = (PerlinCorner*)(m_pBlock + (offset? PERLIN_ALIGN - offset: 0));
+} //allocate
+
+/// \brief Initialize gradient magnitudes.
+///
+/// Initialize the magnitudes so that they fall off exponentially with rank,
+/// going down by a factor of mu every n/B corners, so that the distribution of 
+/// magnitudes is the same whatever the lattice size n. When n is
+/// B they go down by a factor of exactly mu every corner, as in the paper.
+/// \param mu Gradient magnitude exponent.
+
+void CPerlinNoise2D::initMagnitudes(const float mu){
+  const float step = powf(mu, (float)B/m_nSize); //mu itself when n is B
+  float s = 1.0; //current magnitude
+  for(int i=0; i<m_nSize; i++){
+    m_pCorner[i].m = s; s /= step;
+    m_pCorner[i].pad = 0.0f;
+  } //for
+} //initMagnitudes
+
+/// \brief Reader function for the lattice size.
+/// \return Lattice size.
+
+int CPerlinNoise2D::getSize() const{
+  return m_nSize;
+} //getSize
+
+/// \brief Compute one point of Perlin noise.
+///
+/// Compute a single octave of noise at 2D noise at a single point.
+/// This is mostly taken from Perlin's original code, with a few tweaks.
+/// \param vec Point at which to evaluate noise.
+/// \return Noise value between -1.0 and 1.0.
+
+float CPerlinNoise2D::noise2(float vec[2]) const{
+  int bx0, bx1, by0, by1;
+  float rx0, rx1, ry0, ry1, t;
+  const float* q;
+
+  setup(0, bx0, bx1, rx0, rx1);
+  setup(1, by0, by1, ry0, ry1);
+
+  const int* p = m_pPerm;
+  const PerlinCorner* c = m_pCorner;
+
+  int b00 = p[(p[bx0] + by0) & m_nMask];
+  int b10 = p[(p[bx1] + by0) & m_nMask];
+  int b01 = p[(p[bx0] + by1) & m_nMask];
+  int b11 = p[(p[bx1] + by1) & m_nMask];
+
+  float sx = s_curve(rx0);
+
+  float u, v;
+  q = &c[b00].gx; u = c[b00].m * at2(rx0, ry0);
+  q = &c[b10].gx; v = c[b10].m * at2(rx1, ry0);
+  float a = lerp(sx, u, v);
+
+  q = &c[b01].gx; u = c[b01].m * at2(rx0, ry1);
+  q = &c[b11].gx; v = c[b11].m * at2(rx1, ry1);
+  float b = lerp(sx, u, v);
+
+  float sy = s_curve(ry0);
+  return lerp(sy, a, b);
+} //noise2
+
+/// \brief Compute turbulence value.
+//
+/// Turbulence is also known as 1/f noise.
+/// \param x X coordinate.
+/// \param y Y coordinate.
+/// \param n Number of octaves.
+/// \return Noise value in the range -1 to 1.
+
+float CPerlinNoise2D::generate(const float x, const float y, const int n) const{
+  float sum=0.0f, p[2], scale=1.0f;
+  p[0] = x; p[1] = y;
+
+  for(int i=0; i<n; i++){ //for each octave
+    scale *= 0.5f; //apply persistence
+    sum += noise2(p)*scale; //add in an octave of noise
+    p[0] *= 2.0f;	p[1] *= 2.0f; //apply lacunarity
+  } //for
+  return FM_SQRT2*sum/(1.0f - scale);
+} //generate
+
+/// \brief Compute turbulence values along a row.
+///
+/// Compute generate(x, y0 + j*dy, n) for each j from 0 to count - 1, with
+/// the same arithmetic in the same order, so the results are the same as
+/// calling generate for each point when built without -ffast-math. With
+/// -ffast-math the compiler may round the two differently, so the paper's
+/// terrain needs generate. Each octave is much cheaper than count calls
+/// to noise2, though. The x coordinate is the same all along the row, so the
+/// setup for x and its two permutation lookups are done once per octave
+/// instead of once per point. Consecutive points usually lie in the same
+/// lattice cell, and the other permutation, gradient, and magnitude lookups
+/// are only done again when a point is in a different cell from the one
+/// before it. The points are done in chunks of PERLIN_CHUNK, with the
+/// coordinates and sums for each chunk in small arrays that the compiler
+/// can vectorize over.
+/// \param x X coordinate of the row.
+/// \param y0 Y coordinate of the first point.
+/// \param dy Distance between points.
+/// \param count Number of points.
+/// \param n Number of octaves.
+/// \param out Noise values in the range -1 to 1, count of them.
+
+void CPerlinNoise2D::generateRow(const float x, const float y0, const float dy, const int count,
+  const int n, float* out) const
+{
+  const int* p = m_pPerm;
+  const int mask = m_nMask;
+
+  float y[PERLIN_CHUNK]; //y coordinates at the current octave
+  float sum[PERLIN_CHUNK]; //sums of octaves so far
+
+  for(int j0=0; j0<count; j0+=PERLIN_CHUNK){ //for each chunk
+    const int c = count - j0 < PERLIN_CHUNK? count - j0: PERLIN_CHUNK; //number of points in this chunk
+
+    for(int j=0; j<c; j++){
+      y[j] = y0 + (j0 + j)*dy;
+      sum[j] = 0.0f;
+    } //for
+
+    float vx = x, scale = 1.0f;
+
+    for(int i=0; i<n; i++){ //for each octave
+      scale *= 0.5f; //apply persistence
+
+      //the x part of Perlin's setup, once for the whole row
+      const float tx = vx + N;
+      const int bx0 = ((int)tx) & mask;
+      const int bx1 = (bx0+1) & mask;
+      const float rx0 = tx - (int)tx;
+      const float rx1 = rx0 - 1.0f;
+      const float sx = s_curve(rx0);
+      const int px0 = p[bx0], px1 = p[bx1];
+
+      int by0prev = -1; //lattice cell of the previous point
+      const PerlinCorner *c00 = NULL, *c10 = NULL, *c01 = NULL, *c11 = NULL; //cell corners
+
+      for(int j=0; j<c; j++){ //for each point
+        const float t = y[j] + N;
+        const int by0 = ((int)t) & mask;
+        const float ry0 = t - (int)t;
+        const float ry1 = ry0 - 1.0f;
+
+        if(by0 != by0prev){ //new lattice cell
+          const int by1 = (by0+1) & mask;
+          c00 = m_pCorner + p[(px0 + by0) & mask];
+          c10 = m_pCorner + p[(px1 + by0) & mask];
+          c01 = m_pCorner + p[(px0 + by1) & mask];
+          c11 = m_pCorner + p[(px1 + by1) & mask];
+          by0prev = by0;
+        } //if
+
+        float u, v;
+        const float* q;
+        q = &c00->gx; u = c00->m * at2(rx0, ry0);
+        q = &c10->gx; v = c10->m * at2(rx1, ry0);
+        const float a = lerp(sx, u, v);
+
+        q = &c01->gx; u = c01->m * at2(rx0, ry1);
+        q = &c11->gx; v = c11->m * at2(rx1, ry1);
+        const float b = lerp(sx, u, v);
+
+        const float sy = s_curve(ry0);
+        sum[j] += lerp(sy, a, b)*scale; //add in an octave of noise
+      } //for
+
+      vx *= 2.0f; //apply lacunarity
+      for(int j=0; j<c; j++)
+        y[j] *= 2.0f;
+    } //for
+
+    for(int j=0; j<c; j++)
+      out[j0 + j] = FM_SQRT2*sum[j]/(1.0f - scale);
+  } //for
+} //generateRow
@@ -0,0 +1,66 @@
+/// \file perlin.h
+/// \brief Header file for 2D Perlin noise with exponentially distributed gradients.
+
+// Copyright Ian Parberry, May 2014.
+//
+// This file is made available under the GNU All-Permissive License.
+//
+// Copying and distribution of this file, with or without modification,
+// are permitted in any medium without royalty provided the copyright
+// notice and this notice are preserved.  This file is offered as-is,
+// without any warranty.
+
+// Created by Ian Parberry, May 2014.
+// Last updated May 28, 2014.
+
+#pragma once
+
+#define B 0x100 ///< Perlin's B, the default lattice size, a power of 2 usually equal to 256.
+#define PERLIN_ALIGN 16 ///< Alignment of corner records in bytes.
+
+/// \brief Lattice corner record.
+///
+/// The gradient and gradient magnitude at a lattice corner, padded to
+/// 16 bytes so that everything needed from a corner is in one cache line.
+
+struct PerlinCorner{
+  float gx; ///< X coordinate of unit gradient.
+  float gy; ///< Y coordinate of unit gradient.
+  float m; ///< Gradient magnitude.
+  float pad; ///< Padding.
+}; //PerlinCorner
+
+/// \brief 2D Perlin noise.
+///
+/// 2D Perlin noise with exponentially distributed gradient magnitudes. Each
+/// object owns its permutation, gradient, and magnitude tables, and they
+/// don't change once it has been constructed, so one object can be used
+/// by any number of threads at once. The lattice size, which is the period
+/// of the noise, is a power of 2 that defaults to B.
+
+class CPerlinNoise2D{
+  private:
+    int m_nSize; ///< Lattice size, a power of 2.
+    int m_nMask; ///< A bit mask, one less than the lattice size.
+    int* m_pPerm; ///< Perlin's permutation table.
+    char* m_pBlock; ///< Memory that the corner records are in.
+    PerlinCorner* m_pCorner; ///< Perlin's gradients with Ian Parberry's magnitudes, aligned.
+
+    CPerlinNoise2D(const CPerlinNoise2D&); ///< Not copyable.
+    CPerlinNoise2D& operator=(const CPerlinNoise2D&); ///< Not assignable.
+
+    void allocate(const int n); ///< Allocate the tables.
+    void initMagnitudes(const float mu); ///< Initialize the gradient magnitudes.
+    float noise2(float vec[2]) const; ///< Compute one octave at one point.
+
+  public:
+    CPerlinNoise2D(const float mu, const int n=B); ///< Constructor using rand().
+    CPerlinNoise2D(const unsigned int seed, const float mu, const int n=B); ///< Constructor using a seeded generator.
+    ~CPerlinNoise2D(); ///< Destructor.
+
+    int getSize() const; ///< Get the lattice size.
+
+    float generate(const float x, const float y, const int n) const; ///< Compute 2D Perlin noise at a point.
+    void generateRow(const float x, const float y0, const float dy, const int count,
+      const int n, float* out) const; ///< Compute 2D Perlin noise along a row.
+}; //CPerlinNoise2D